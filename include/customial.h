@@ -236,6 +236,11 @@ typedef struct tagINPUT {
 
     // since 5.0.0, save the mouse device
     char*   mdev;
+
+    // Since 5.0.16, optional; stores the fds which wait_event or
+    // wait_event_ex reads the input events from in fds, and returns
+    // the number of the fds, or -1 if the engine can not tell them.
+    int (*get_event_fds) (int* fds, int max_fds);
 } INPUT;
 
 #ifdef __cplusplus
@@ -584,7 +584,12 @@ enum {
 /**
  * MiniGUI's private block data heap.
  *
- * \sa InitBlockDataHeap, DestroyBlockDataHeap
+ * Since 5.0.16, a block heap consists of one or more segments. When
+ * there is no free block in the heap, the heap grows by a new segment.
+ * The fields of this structure are private to MiniGUI; please use
+ * \a GetBlockDataHeapStats to get the statistics of a heap.
+ *
+ * \sa InitBlockDataHeap, DestroyBlockDataHeap, GetBlockDataHeapStats
  */
 typedef struct _BLOCKHEAP {
 #ifdef _MGHAVE_VIRTUAL_WINDOW
@@ -592,16 +597,16 @@ typedef struct _BLOCKHEAP {
 #endif
     /** Size of one block element in bytes. */
     size_t          sz_block;
-    /** Size of the heap in blocks. */
+    /** Size of the heap (the first segment since 5.0.16) in blocks. */
     size_t          sz_heap;
-    /** The number of blocks extra allocated. */
+    /** The number of blocks extra allocated (in the grown segments). */
     size_t          nr_alloc;
-    /** The size of usage bitmap in bytes. */
+    /** The size of usage bitmap in bytes; always zero since 5.0.16. */
     size_t          sz_usage_bmp;
 
-    /** The pointer to the pre-allocated heap. */
+    /** The pointer to the private data of the heap since 5.0.16. */
     unsigned char*  heap;
-    /** The pointer to the usage bitmap. */
+    /** The pointer to the usage bitmap; always NULL since 5.0.16. */
     unsigned char*  usage_bmp;
 } BLOCKHEAP;
 
@@ -640,8 +645,8 @@ MG_EXPORT BOOL InitBlockDataHeap (PBLOCKHEAP heap,
  *
  * This function allocates a data block from an initialized
  * block data heap. The allocated block will have the size of \a heap->bd_size.
- * If there is no free block in the heap, this function will try to allocate
- * the block from the system heap by using \a malloc(3) function.
+ * If there is no free block in the heap, this function will grow the heap
+ * by allocating a new segment from the system heap.
  *
  * \param heap The pointer to the initialized heap.
  * \return Pointer to the allocated data block, NULL on error.
@@ -656,8 +661,8 @@ MG_EXPORT void* BlockDataAlloc (PBLOCKHEAP heap);
  * \brief Frees an allocated data block.
  *
  * This function frees the specified data block pointed to by \a data to
- * the heap \a heap. If the block was allocated by using \a malloc function,
- * this function will free the element by using \a free(3) function.
+ * the heap \a heap. Note that the memory of the segments will not be
+ * returned to the system until the heap is destroyed.
  *
  * \param heap The pointer to the heap.
  * \param data The pointer to the element to be freed.
@@ -666,6 +671,53 @@ MG_EXPORT void* BlockDataAlloc (PBLOCKHEAP heap);
  */
 MG_EXPORT void BlockDataFree (PBLOCKHEAP heap, void* data);
 
+/**
+ * The statistics of a block data heap.
+ *
+ * \sa GetBlockDataHeapStats
+ *
+ * Since 5.0.16
+ */
+typedef struct _BLOCKHEAPSTATS {
+    /** The number of blocks in all segments. */
+    size_t nr_blocks;
+    /** The number of segments. */
+    size_t nr_segments;
+    /**
+     * The number of blocks in use. Note that the free blocks cached by
+     * the threads are also counted as in use.
+     */
+    size_t nr_used;
+    /** The high-water mark of the blocks in use. */
+    size_t max_used;
+    /**
+     * The number of times the heap grows; i.e., the number of times that
+     * the initial size of the heap was not enough.
+     */
+    size_t nr_grows;
+    /** The number of failed allocations. */
+    size_t nr_failures;
+} BLOCKHEAPSTATS;
+
+/**
+ * \fn BOOL GetBlockDataHeapStats (PBLOCKHEAP heap, BLOCKHEAPSTATS* stats)
+ * \brief Gets the statistics of a private block data heap.
+ *
+ * This function gets the statistics of the block data heap \a heap. You can
+ * use the statistics to tune the initial size of a heap.
+ *
+ * \param heap The pointer to the heap.
+ * \param stats The pointer to a BLOCKHEAPSTATS structure to return
+ *        the statistics.
+ *
+ * \return TRUE on success, FALSE on error.
+ *
+ * \sa BLOCKHEAPSTATS, InitBlockDataHeap
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GetBlockDataHeapStats (PBLOCKHEAP heap, BLOCKHEAPSTATS* stats);
+
 /**
  * \fn void DestroyBlockDataHeap (PBLOCKHEAP heap)
  * \brief Destroys a private block data heap.
@@ -1552,6 +1604,46 @@ MG_EXPORT HDC GUIAPI GetSubDC (HDC hdc, int off_x, int off_y, int width, int hei
  */
 MG_EXPORT void GUIAPI ReleaseDC (HDC hdc);
 
+/**
+ * The statistics of the pool of general DCs.
+ *
+ * \sa GetDCPoolStats
+ *
+ * Since 5.0.16
+ */
+typedef struct _DCPOOLSTATS {
+    /** The number of DCs allocated for the pool. */
+    size_t nr_dcs;
+    /** The number of DCs in use. */
+    size_t nr_used;
+    /** The high-water mark of the DCs in use. */
+    size_t max_used;
+    /**
+     * The number of times the pool was exhausted; in this case,
+     * \a GetDC and \a GetClientDC return HDC_SCREEN.
+     */
+    size_t nr_exhausted;
+} DCPOOLSTATS;
+
+/**
+ * \fn BOOL GUIAPI GetDCPoolStats (DCPOOLSTATS* stats)
+ * \brief Gets the statistics of the pool of general DCs.
+ *
+ * The DCs returned by \a GetDC, \a GetClientDC, and \a GetSubDC are
+ * allocated from an internal pool, which grows on demand. This function
+ * gets the statistics of the pool.
+ *
+ * \param stats The pointer to a DCPOOLSTATS structure to return
+ *        the statistics.
+ *
+ * \return TRUE on success, FALSE on error.
+ *
+ * \sa DCPOOLSTATS, GetDC, ReleaseDC
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetDCPoolStats (DCPOOLSTATS* stats);
+
 /**
  * \fn HWND GUIAPI WindowFromDC (HDC hdc)
  * \brief Get the window handle from DC.
@@ -5830,6 +5922,67 @@ static inline void GUIAPI StretchBlt (HDC hsdc, int sx, int sy, int sw, int sh,
 MG_EXPORT void GUIAPI StretchBltLegacy (HDC hsdc, int sx, int sy, int sw, int sh,
                        HDC hddc, int dx, int dy, int dw, int dh, DWORD dwRop);
 
+/**
+ * The statistics of the blit selection cache.
+ *
+ * \sa GetBlitCacheStats
+ *
+ * Since 5.0.16
+ */
+typedef struct _BLITCACHESTATS {
+    /** The number of slots in the cache. */
+    int nr_slots;
+    /** The number of slots in use. */
+    int nr_used;
+    /** The number of selections resolved from the cache. */
+    unsigned long nr_hits;
+    /** The number of selections resolved by the full decision. */
+    unsigned long nr_misses;
+    /** The number of selections which can not be cached
+        (hardware or RLE accelerated blits). */
+    unsigned long nr_bypasses;
+    /** The number of times the cache was flushed. */
+    unsigned long nr_flushes;
+    /** The number of full selections run to sample the time of
+        the cached ones. */
+    unsigned long nr_samples;
+    /** The total nanoseconds spent in the missed selections. */
+    Uint64 miss_nsecs;
+    /** The total nanoseconds spent in the sampled selections. */
+    Uint64 sample_nsecs;
+    /** The estimated nanoseconds saved by the hits. */
+    Uint64 saved_nsecs;
+} BLITCACHESTATS;
+
+/**
+ * \fn BOOL GUIAPI GetBlitCacheStats (BLITCACHESTATS* stats)
+ * \brief Get the statistics of the blit selection cache.
+ *
+ * Before blitting a surface to another one, MiniGUI selects the blit
+ * routine from the pixel formats of the surfaces, the color key and
+ * the alpha modes, and the acceleration capabilities of the video
+ * devices. The software selections are kept in a small cache per process,
+ * which is flushed when a palette or a pixel format changes.
+ *
+ * This function returns the statistics of the cache in the
+ * calling process.
+ *
+ * \param stats The pointer to a BLITCACHESTATS structure to return
+ *      the statistics.
+ *
+ * \return TRUE on success, otherwise FALSE.
+ *
+ * \note The saved time is estimated by the average time of the
+ *      sampled selections: one of 256 hits runs the full selection
+ *      again to measure it, because the first selections of a format
+ *      pair are much slower than the repeated ones.
+ *
+ * \sa BitBlt, StretchBlt
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetBlitCacheStats (BLITCACHESTATS* stats);
+
 /**
  * \fn BOOL GUIAPI ScaleBitmapEx (BITMAP* dst, const BITMAP* src, \
  *             HDC ref_dc)
@@ -8569,6 +8722,49 @@ MG_EXPORT DEVFONT* GUIAPI LoadDevFontFromFile (const char *devfont_name,
  */
 MG_EXPORT void GUIAPI DestroyDynamicDevFont (DEVFONT **devfont);
 
+/**
+ * The statistics of the glyph cache.
+ *
+ * \sa GetGlyphCacheStats
+ *
+ * Since 5.0.16
+ */
+typedef struct _GLYPHCACHESTATS {
+    /** The byte budget of the cache; zero if the cache is disabled. */
+    size_t max_bytes;
+    /** The number of bytes used by the cached glyphs. */
+    size_t nr_bytes;
+    /** The number of cached glyphs. */
+    size_t nr_glyphs;
+    /** The number of lookups which found the glyph in the cache. */
+    unsigned long nr_hits;
+    /** The number of lookups which missed. */
+    unsigned long nr_misses;
+    /** The number of glyphs evicted to honor the byte budget. */
+    unsigned long nr_evictions;
+} GLYPHCACHESTATS;
+
+/**
+ * \fn BOOL GUIAPI GetGlyphCacheStats (GLYPHCACHESTATS* stats)
+ * \brief Gets the statistics of the glyph cache.
+ *
+ * MiniGUI caches the glyph bitmaps which need extra work to render,
+ * such as the bold, scaled, or flipped glyphs of the bitmap fonts, in a
+ * glyph cache shared by all device fonts. The byte budget of the cache
+ * can be specified by the key `max_kbytes` in the section `glyphcache` of
+ * the runtime configuration; zero disables the cache.
+ *
+ * \param stats The pointer to a GLYPHCACHESTATS structure to return
+ *        the statistics.
+ *
+ * \return TRUE on success, FALSE on error.
+ *
+ * \sa GLYPHCACHESTATS
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetGlyphCacheStats (GLYPHCACHESTATS* stats);
+
     /** @} end of font_fns */
 
     /**
@@ -10453,6 +10649,57 @@ MG_EXPORT int GUIAPI UStrGetBreaks(LanguageCode lang_code,
         Uint8 ctr, Uint8 wbr, Uint8 lbp,
         Uchar32* ucs, int nr_ucs, BreakOppo** break_oppos);
 
+/**
+ * \fn int GUIAPI UStrUpdateBreaks(LanguageCode lang_code,
+ *          Uint8 ctr, Uint8 wbr, Uint8 lbp,
+ *          Uchar32* ucs, int nr_ucs,
+ *          int* start_index, int* nr_del_ucs, int* nr_ins_ucs,
+ *          BreakOppo** break_oppos)
+ * \brief Update the breaking opportunities of a Uchar32 string after
+ *      the string changed.
+ *
+ * This function updates the breaking opportunities returned by
+ * \a UStrGetBreaks after the characters in the range [\a *start_index,
+ * \a *start_index + \a *nr_del_ucs) of the string have been replaced by
+ * \a *nr_ins_ucs new characters. It calculates the breaking opportunities
+ * of the edited text and its context only: the context extends to
+ * the nearest hard line break before and after the edited text, or to
+ * the start and the end of the string. The breaking opportunities of
+ * the other characters are kept.
+ *
+ * On return, the range will be widened to cover all characters whose
+ * breaking opportunities changed. You can pass the range to
+ * \a UpdateTextRuns and \a UpdateLayout.
+ *
+ * \param lang_code The language code; not used so far, reserved for future.
+ * \param ctr The character transformation rule; see \a char_transform_rules.
+ * \param wbr The word breaking rule; see \a word_break_rules.
+ * \param lbp The line breaking policy; see \a line_break_policies.
+ * \param ucs The Uchar32 string after the edit.
+ * \param nr_ucs The length of the Uchar32 string after the edit.
+ * \param start_index The pointer to the start index of the edited text.
+ * \param nr_del_ucs The pointer to the number of characters deleted.
+ * \param nr_ins_ucs The pointer to the number of characters inserted.
+ * \param break_oppos The pointer to the buffer which stores the address of
+ *        the breaking opportunities of the string before the edit. The array
+ *        must be allocated by \a UStrGetBreaks, for it will be reallocated
+ *        if the string becomes longer.
+ *
+ * \return The length of break oppoortunities array; zero on error.
+ *      On error, the breaking opportunities and the range are not changed.
+ *
+ * \note Only available when support for UNICODE is enabled.
+ *
+ * \sa UStrGetBreaks, UpdateTextRuns, UpdateLayout
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT int GUIAPI UStrUpdateBreaks(LanguageCode lang_code,
+        Uint8 ctr, Uint8 wbr, Uint8 lbp,
+        Uchar32* ucs, int nr_ucs,
+        int* start_index, int* nr_del_ucs, int* nr_ins_ucs,
+        BreakOppo** break_oppos);
+
 MG_EXPORT void GUIAPI UStrTailorBreaks(ScriptType writing_system,
         const Uchar32* ucs, int nr_ucs, BreakOppo* break_oppos);
 
@@ -14308,6 +14555,47 @@ MG_EXPORT BOOL GUIAPI SetBackgroundColorInTextRuns(TEXTRUNS* truns,
 MG_EXPORT RGBCOLOR GUIAPI GetBackgroundColorInTextRuns(
         const TEXTRUNS* truns, int index);
 
+/**
+ * \fn BOOL GUIAPI UpdateTextRuns(TEXTRUNS* truns,
+ *      const Uchar32* ucs, int nr_ucs, BreakOppo* break_oppos,
+ *      int* start_index, int* nr_del_ucs, int* nr_ins_ucs)
+ * \brief Update a TEXTRUNS object after the text of the paragraph changed.
+ *
+ * This function updates the text runs of the TEXTRUNS object \a truns
+ * after the characters in the range [\a *start_index,
+ * \a *start_index + \a *nr_del_ucs) of the paragraph have been replaced by
+ * \a *nr_ins_ucs new characters. It keeps the font names and the colors
+ * set for the unchanged text; the inserted text inherits them from
+ * the character before it.
+ *
+ * On return, the range will be widened to cover all characters whose
+ * text runs changed, for example, the embedding levels of the neighbor
+ * characters. You can pass the range to \a UpdateLayout to lay out
+ * the changed lines only.
+ *
+ * \param truns The TEXTRUNS object.
+ * \param ucs The Uchar32 string after the edit. It can be the same buffer
+ *      passed to \a CreateTextRuns.
+ * \param nr_ucs The length of the Uchar32 string after the edit.
+ * \param break_oppos If not NULL, the break opportunities of the new text
+ *      will be tailored as \a CreateTextRuns does.
+ * \param start_index The pointer to the start index of the edited text.
+ * \param nr_del_ucs The pointer to the number of characters deleted.
+ * \param nr_ins_ucs The pointer to the number of characters inserted.
+ *
+ * \return TRUE for success, otherwise FALSE. If the function failed after
+ *      changed the text runs, the range will cover the whole paragraph.
+ *
+ * \note Only available when support for UNICODE is enabled.
+ *
+ * \sa CreateTextRuns, UpdateLayout
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI UpdateTextRuns(TEXTRUNS* truns,
+        const Uchar32* ucs, int nr_ucs, BreakOppo* break_oppos,
+        int* start_index, int* nr_del_ucs, int* nr_ins_ucs);
+
 /**
  * \fn BOOL GUIAPI DestroyTextRuns(TEXTRUNS* truns)
  *
@@ -14469,6 +14757,95 @@ MG_EXPORT LAYOUT* GUIAPI CreateLayout(
  */
 MG_EXPORT BOOL GUIAPI DestroyLayout(LAYOUT* layout);
 
+/**
+ * \fn int GUIAPI UpdateLayout(LAYOUT* layout,
+ *      const BreakOppo* break_oppos,
+ *      int start_index, int nr_del_ucs, int nr_ins_ucs,
+ *      LAYOUTLINE** last_kept_line)
+ * \brief Update a layout object after the text of the paragraph changed.
+ *
+ * This function updates the LAYOUT object \a layout after its TEXTRUNS
+ * object has been updated by \a UpdateTextRuns. It keeps the lines before
+ * the changed text, and removes the others. Please continue to call
+ * \a LayoutNextLine with the last line kept (or NULL if no line is kept)
+ * to lay out the changed lines.
+ *
+ * Only the changed lines will be re-broken and reshaped: once a new line
+ * starts where a removed line after the changed text started, and the
+ * line is laid out with the same maximal extent, \a LayoutNextLine
+ * reuses the removed line instead of shaping it again.
+ *
+ * The breaking opportunities of the changed paragraph can be updated by
+ * \a UStrUpdateBreaks, which calculates them for the changed text and its
+ * context only.
+ *
+ * \param layout The LAYOUT object.
+ * \param break_oppos The breaking opportunities of the changed paragraph.
+ * \param start_index The start index of the changed text.
+ * \param nr_del_ucs The number of characters removed.
+ * \param nr_ins_ucs The number of characters inserted.
+ * \param last_kept_line The buffer to return the last line kept; can be NULL.
+ *
+ * \return The number of lines kept; < 0 for error.
+ *
+ * \note The lines are kept and reused only if the layout object
+ *      persists the lines.
+ *
+ * \sa UStrUpdateBreaks, UpdateTextRuns, CreateLayout, LayoutNextLine
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT int GUIAPI UpdateLayout(LAYOUT* layout,
+        const BreakOppo* break_oppos,
+        int start_index, int nr_del_ucs, int nr_ins_ucs,
+        LAYOUTLINE** last_kept_line);
+
+/**
+ * The statistics of the shaped run cache.
+ *
+ * \sa GetShapedRunCacheStats
+ *
+ * Since 5.0.16
+ */
+typedef struct _SHAPEDRUNCACHESTATS {
+    /** The byte budget of the cache; zero if the cache is disabled. */
+    size_t max_bytes;
+    /** The number of bytes used by the cached runs. */
+    size_t nr_bytes;
+    /** The number of cached runs. */
+    size_t nr_runs;
+    /** The number of lookups which found the shaped run in the cache. */
+    unsigned long nr_hits;
+    /** The number of lookups which missed. */
+    unsigned long nr_misses;
+    /** The number of runs evicted to honor the byte budget. */
+    unsigned long nr_evictions;
+} SHAPEDRUNCACHESTATS;
+
+/**
+ * \fn BOOL GUIAPI GetShapedRunCacheStats(SHAPEDRUNCACHESTATS* stats)
+ * \brief Gets the statistics of the shaped run cache.
+ *
+ * MiniGUI keeps the glyph strings returned by the shaping engines for
+ * the runs of the layout objects in a cache shared by all layouts. The
+ * runs are keyed by the characters, the logfont, the script, the language,
+ * the embedding level, the direction, the orientation, and the shaping
+ * engine; so a label laid out again with the same font will not be shaped
+ * again. The least recently used runs are evicted when the byte budget
+ * specified by the key `shaped_run_kbytes` in the section `glyphcache`
+ * of the runtime configuration is exceeded; zero disables the cache.
+ *
+ * \param stats The pointer to a SHAPEDRUNCACHESTATS structure to return
+ *        the statistics.
+ *
+ * \return TRUE on success, FALSE on error.
+ *
+ * \sa SHAPEDRUNCACHESTATS, CreateLayout, LayoutNextLine
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetShapedRunCacheStats(SHAPEDRUNCACHESTATS* stats);
+
 /*
  * \var typedef struct _RENDERDATA RENDERDATA
  * \brief The extra rendering data of the shaped glyph.
@@ -14875,6 +15252,47 @@ MG_EXPORT int GUIAPI SetUserCompositionOps (HDC hdc,
  */
 MG_EXPORT GHANDLE GetVideoHandle (HDC hdc);
 
+/**
+ * The structure type defines the statistics of copying the content
+ * of the shadow screen to the real screen by a video engine.
+ *
+ * Since 5.0.16
+ */
+typedef struct _VIDEOUPDATESTATS {
+    /** The number of frames copied to the real screen. */
+    DWORD nr_frames;
+    /** The number of rectangles copied to the real screen. */
+    DWORD nr_rects;
+    /** The total kilobytes copied to the real screen. */
+    DWORD total_kbytes;
+    /** The bytes copied for the last frame. */
+    DWORD last_frame_bytes;
+    /** The maximal bytes copied for one frame. */
+    DWORD max_frame_bytes;
+} VIDEOUPDATESTATS;
+
+/**
+ * This function gets the statistics of copying the content of the shadow
+ * screen to the real screen by the video engine in the calling process.
+ *
+ * The dirty rectangles are kept as a small list from the surfaces to
+ * the video engine, so the bytes copied per frame are proportional to
+ * the real damage, instead of the bounding rectangle of the damage.
+ *
+ * \param video The handle to the video returned by \a GetVideoHandle.
+ * \param stats The pointer to a VIDEOUPDATESTATS structure to return
+ *      the statistics.
+ *
+ * \return TRUE for success, FALSE on error.
+ *
+ * \note The statistics are only available for the engines which use
+ *      a shadow screen (double buffering); the others report zeros.
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetVideoUpdateStats (GHANDLE video,
+        VIDEOUPDATESTATS* stats);
+
 #ifdef _MGGAL_DRM
 
 /**
@@ -15027,6 +15445,47 @@ static inline HDC drmCreateDCFromHandle (GHANDLE video,
         handle, size, drm_format, 0, width, height, pitch);
 }
 
+/**
+ * The struct type defines the frame pacing statistics of the DRM engine.
+ *
+ * Since 5.0.16
+ */
+typedef struct _DrmFrameStats {
+    /** The number of scan-out buffers in use; 1 means no page flipping. */
+    int nr_buffers;
+    /** The number of frames updated to the screen. */
+    unsigned long nr_frames;
+    /** The number of page flips completed. */
+    unsigned long nr_flips;
+    /** The number of vertical blanks missed by the updater. */
+    unsigned long nr_missed_vblanks;
+    /** The total bytes copied from the shadow screen to scan-out buffers. */
+    uint64_t bytes_copied;
+    /** The bytes copied for the last frame. */
+    uint32_t last_frame_bytes;
+    /** The maximal bytes copied for one frame. */
+    uint32_t max_frame_bytes;
+} DrmFrameStats;
+
+/**
+ * This function gets the frame pacing statistics of the asynchronous
+ * updater of the DRM engine.
+ *
+ * \param video The video handle returned by \a GetVideoHandle.
+ * \param stats The pointer to a DrmFrameStats structure to hold
+ *      the statistics.
+ *
+ * \return TRUE for success; FALSE if \a video is not a video handle of
+ *      the DRM engine, or the asynchronous updater is not running
+ *      (e.g., the double buffering is disabled or the caller is a client).
+ *
+ * \note The page flipping is enabled by the key `flip_buffers` in the
+ *      section `drm` of the runtime configuration.
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL drmGetFrameStats (GHANDLE video, DrmFrameStats* stats);
+
 /** @} end of gdi_drm_fns */
 
 #endif /* _MGGAL_DRM */
@@ -1610,6 +1610,50 @@ MG_EXPORT int GUIAPI GetClientByPID (int pid);
  */
 MG_EXPORT BOOL GUIAPI SetTopmostClient (int cli);
 
+/**
+ * The statistics of the requests of a client handled by the server.
+ *
+ * The server handles the requests of a ready client in rounds; a round
+ * handles a limited number of requests, so that a busy client can not
+ * starve other clients. The latency of a request is the time it waited
+ * after the server noticed it plus the time the server took to handle it.
+ */
+typedef struct _CLIREQSTATS {
+    /** The number of requests handled. */
+    DWORD nr_requests;
+    /** The number of rounds in which the requests were handled. */
+    DWORD nr_rounds;
+    /**
+     * The number of rounds ended before all queued requests handled,
+     * because the client used up its budget of the round.
+     */
+    DWORD nr_deferred;
+    /** The total time (in microseconds) the rounds waited to start. */
+    Uint64 total_wait_us;
+    /** The maximal time (in microseconds) a round waited to start. */
+    DWORD max_wait_us;
+    /** The total time (in microseconds) spent in handling the requests. */
+    Uint64 total_busy_us;
+    /** The maximal time (in microseconds) spent in a round. */
+    DWORD max_busy_us;
+} CLIREQSTATS;
+
+/**
+ * \fn BOOL GUIAPI GetClientRequestStats (int cli, CLIREQSTATS* stats)
+ * \brief Get the statistics of the requests of a client.
+ *
+ * \param cli The identifier of the client.
+ * \param stats The buffer receives the statistics.
+ *
+ * \return TRUE on success, FALSE if \a cli is not a live client.
+ *
+ * \note Server-only function. The statistics is reset when a new client
+ *      takes the identifier.
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetClientRequestStats (int cli, CLIREQSTATS* stats);
+
 /**
  * \fn void GUIAPI DisableClientsOutput (void)
  * \brief Disable all clients output.
@@ -1919,6 +1963,18 @@ MG_EXPORT BOOL GUIAPI ServerUnregisterCompositor (const char* name);
 #define COMPSOR_NAME_DEFAULT        "default"
 #define COMPSOR_NAME_FALLBACK       "fallback"
 
+/**
+ * The name of the built-in tiled compositor (since 5.0.16).
+ *
+ * The tiled compositor behaves like the fallback compositor, but it
+ * composites the tiles of a dirty region in parallel by a pool of threads.
+ * The number of threads can be specified by the key
+ * `worker_threads` in the section `system` of MiniGUI runtime
+ * configuration, or by the environment variable `MG_WORKER_THREADS`.
+ * Zero means the number of online CPUs.
+ */
+#define COMPSOR_NAME_TILED          "tiled"
+
 /**
  * \brief Select a compositor as the current compositor.
  *
@@ -1959,6 +2015,41 @@ MG_EXPORT const CompositorOps* GUIAPI ServerSelectCompositor (
 MG_EXPORT const char* GUIAPI ServerGetCurrentCompositor (
         const CompositorOps** ops, CompositorCtxt** ctxt);
 
+/**
+ * The statistics of the compositing loop of the server.
+ */
+typedef struct _COMPOSITORSTATS {
+    /** The number of frames composited. */
+    DWORD nr_frames;
+    /** The number of znodes visited (locked and checked) in the last frame. */
+    DWORD nr_visited;
+    /** The number of znodes merged into the dirty region in the last frame. */
+    DWORD nr_composited;
+    /** The total number of znodes visited. */
+    Uint64 total_visited;
+    /** The total number of znodes merged into the dirty region. */
+    Uint64 total_composited;
+} COMPOSITORSTATS;
+
+/**
+ * \brief Get the statistics of the compositing loop.
+ *
+ * This function gets the numbers of the znodes visited and composited
+ * by the compositing loop of the server. When all clients flag their
+ * changed znodes in the dirty map of the layer, the compositor only
+ * visits the flagged znodes, and the number of visited znodes stays
+ * close to the number of composited ones.
+ *
+ * \param stats The buffer used to return the statistics.
+ *
+ * \return TRUE on success; FALSE on invalid argument.
+ *
+ * \note Only called by the server.
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI ServerGetCompositorStats (COMPOSITORSTATS* stats);
+
 #define COMPSOR_OPS_VERSION  2
 
 /**
@@ -2141,6 +2232,90 @@ static inline int ClientRequest (const REQUEST* request,
     return ClientRequestEx (request, NULL, 0, result, len_rslt);
 }
 
+/**
+ * The prototype of the callback called when an asynchronous request is done.
+ *
+ * \param req_seq The sequence number of the request returned by
+ *      \a ClientRequestAsync.
+ * \param context The context passed to \a ClientRequestAsync.
+ * \param result The buffer contains the reply.
+ * \param len_rslt The length of the buffer.
+ * \param fd_received The file descriptor received from the server,
+ *      or -1 if there is no one. The callback owns the file descriptor.
+ *
+ * Since 5.0.16
+ */
+typedef void (* CB_REQUEST_DONE) (int req_seq, void* context,
+        void* result, size_t len_rslt, int fd_received);
+
+/**
+ * \fn int ClientRequestAsync (const REQUEST* request,
+                const void* ex_data, size_t ex_data_len, int fd_to_send,
+                void* result, size_t len_rslt,
+                CB_REQUEST_DONE cb_done, void* context)
+ * \brief Sends a request to the server without waiting for the reply.
+ *
+ * This function sends a request to the server and returns immediately,
+ * so a client can have many requests outstanding, and the server can
+ * handle them in one batch. The replies come back in the order of the
+ * requests, and they will be delivered when the client handles the
+ * messages (in \a GetMessage or \a PeekMessage), or in
+ * \a WaitClientRequest:
+ *
+ *  - If \a cb_done is not NULL, it will be called with \a context.
+ *  - Otherwise, if \a context is not NULL, it is the handle of a window,
+ *    MiniGUI will post MSG_REQUESTDONE to the window.
+ *
+ * If \a result is NULL or \a len_rslt is zero, the request wants no reply,
+ * and it will not be delivered.
+ *
+ * \param request The pointer to REQUEST, which contains the data of
+ *        the request.
+ * \param ex_data The pointer to extra data to be sent to the server.
+ * \param ex_data_len The length of the extra data in bytes.
+ * \param fd_to_send The file descriptor which will be sent to the server;
+ *      it will be ignored if it is less than 0.
+ * \param result The buffer receives the reply. It must be valid until
+ *      the request is done.
+ * \param len_rslt The lenght of the buffer.
+ * \param cb_done The callback called when the request is done.
+ * \param context The context passed to the callback, or the handle of
+ *      the window to receive MSG_REQUESTDONE if \a cb_done is NULL.
+ *
+ * \return The sequence number (greater than zero) of the request on
+ *      success, -1 on error.
+ *
+ * \note Only used by clients to send a request to the server of
+ *       MiniGUI-Processes. The asynchronous requests always go through
+ *       the socket connected to the server.
+ *
+ * \sa WaitClientRequest, ClientRequestEx2, MSG_REQUESTDONE
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT int GUIAPI ClientRequestAsync (const REQUEST* request,
+                const void* ex_data, size_t ex_data_len, int fd_to_send,
+                void* result, size_t len_rslt,
+                CB_REQUEST_DONE cb_done, void* context);
+
+/**
+ * \fn int WaitClientRequest (int req_seq)
+ * \brief Waits for an asynchronous request to be done.
+ *
+ * This function reads the replies from the server until the asynchronous
+ * request specified by \a req_seq is done, then delivers the replies
+ * of all done requests.
+ *
+ * \param req_seq The sequence number returned by \a ClientRequestAsync.
+ *
+ * \return Zero on success, -1 on error.
+ *
+ * \sa ClientRequestAsync
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT int GUIAPI WaitClientRequest (int req_seq);
+
 /**
  * \fn int GUIAPI GetSockFD2Server (void)
  * \brief Get the file descriptor of the socket connected to the server.
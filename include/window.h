@@ -2908,6 +2908,11 @@ typedef struct _WINMASKINFO {
  *
  * Since 5.0.10, this messasge will be relayed to the active child control
  * if the main window is currently active.
+ *
+ * Since 5.0.16, if MiniGUI is configured with \--enable-tickless, a message
+ * thread sleeps until there is a timer, file descriptor, or message to
+ * handle, so this message will not be sent periodically to the windows
+ * of an idle message thread.
  */
 #define MSG_IDLE            0x0142
 
@@ -3007,6 +3012,32 @@ typedef struct _WINMASKINFO {
 /* Since 5.0.6: for waking up the client */
 #define MSG_WAKEUP_CLIENT       0x014D
 
+#ifdef _MGRM_PROCESSES
+/**
+ * \def MSG_REQUESTDONE
+ * \brief Indicates an asynchronous request has been done.
+ *
+ * MiniGUI posts this message to the window specified when calling
+ * \a ClientRequestAsync without a callback, after the reply of the request
+ * has been received.
+ *
+ * \code
+ * MSG_REQUESTDONE
+ * int req_seq = (int)wParam;
+ * int fd_received = (int)lParam;
+ * \endcode
+ *
+ * \param req_seq The sequence number of the request.
+ * \param fd_received The file descriptor received from the server,
+ *      or -1 if there is no one.
+ *
+ * \note Only available on MiniGUI-Processes.
+ *
+ * Since 5.0.16
+ */
+#define MSG_REQUESTDONE         0x014E
+#endif /* defined _MGRM_PROCESSES */
+
 /**
  * \def MSG_DOESNEEDIME
  * \brief Send to a window to query whether the window needs to open
@@ -3364,6 +3395,14 @@ MG_EXPORT BOOL GUIAPI PeekPostMessage (PMSG pMsg, HWND hWnd, UINT nMsgFilterMin,
  * \retval ERR_QUEUE_FULL The message queue is full.
  * \retval ERR_INV_HWND Invalid window handle.
  *
+ * \note Since 5.0.16, when the post message buffer of the message queue
+ *  is full, the message will be spilled to an overflow list of the
+ *  message queue instead of being dropped. The overflow list is bounded
+ *  by the runtime option `max_spilled_msgs` in the section `system`
+ *  (4096 by default). Therefore, ERR_QUEUE_FULL will be returned only if
+ *  the overflow list is full too, or if there is no memory for the message;
+ *  the new message is dropped in both cases.
+ *
  * \sa SendMessage
  */
 MG_EXPORT int GUIAPI PostMessage (HWND hWnd, UINT nMsg,
@@ -3418,6 +3457,129 @@ MG_EXPORT LRESULT GUIAPI SendMessage (HWND hWnd, UINT nMsg,
 MG_EXPORT void GUIAPI SetAutoRepeatMessage (HWND hwnd, UINT msg,
                 WPARAM wParam, LPARAM lParam);
 
+/**
+ * \def MSG_COALESCE_NONE
+ * \brief Never coalesce the posted message.
+ *
+ * \sa SetMsgCoalescingPolicy
+ */
+#define MSG_COALESCE_NONE           0
+
+/**
+ * \def MSG_COALESCE_SAMEWPARAM
+ * \brief Coalesce the posted message into a queued one which has
+ *      the same window, identifier, and \a wParam; only \a lParam
+ *      and the time of the queued message are updated.
+ *
+ * \sa SetMsgCoalescingPolicy
+ */
+#define MSG_COALESCE_SAMEWPARAM     1
+
+/**
+ * \def MSG_COALESCE_ANYWPARAM
+ * \brief Coalesce the posted message into a queued one which has
+ *      the same window and identifier; \a wParam, \a lParam, and the time
+ *      of the queued message are all updated.
+ *
+ * \sa SetMsgCoalescingPolicy
+ */
+#define MSG_COALESCE_ANYWPARAM      2
+
+/**
+ * \fn int GUIAPI SetMsgCoalescingPolicy (UINT nMsg, int policy)
+ * \brief Set the coalescing policy of a message.
+ *
+ * When a message is posted to a message queue, MiniGUI can merge it into
+ * a message of the same kind which is still waiting in the queue instead of
+ * appending a new one. The merge is done in constant time by using
+ * a coalescing index maintained for each message queue.
+ *
+ * By default, MSG_MOUSEMOVE, MSG_NCMOUSEMOVE, and MSG_DT_MOUSEMOVE use
+ * \a MSG_COALESCE_SAMEWPARAM, while MSG_TIMEOUT, MSG_IDLE, and MSG_CARETBLINK
+ * use \a MSG_COALESCE_ANYWPARAM. All other messages are never coalesced.
+ *
+ * \param nMsg The message identifier; must be less than MSG_FIRSTUSERMSG.
+ * \param policy The new policy, can be one of the following values:
+ *  - MSG_COALESCE_NONE
+ *  - MSG_COALESCE_SAMEWPARAM
+ *  - MSG_COALESCE_ANYWPARAM
+ *
+ * \return The old policy of the message, < 0 for invalid arguments.
+ *
+ * \note The policy is shared by all message threads. You should change it
+ *      before creating the windows which receive the message.
+ *
+ * \sa GetMsgCoalescingPolicy, GetMsgQueueStats
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT int GUIAPI SetMsgCoalescingPolicy (UINT nMsg, int policy);
+
+/**
+ * \fn int GUIAPI GetMsgCoalescingPolicy (UINT nMsg)
+ * \brief Get the coalescing policy of a message.
+ *
+ * \param nMsg The message identifier.
+ *
+ * \return The current policy of the message; MSG_COALESCE_NONE for
+ *      the messages not less than MSG_FIRSTUSERMSG.
+ *
+ * \sa SetMsgCoalescingPolicy
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT int GUIAPI GetMsgCoalescingPolicy (UINT nMsg);
+
+/**
+ * The statistics of the post message buffer and the idle sleeping of
+ * a message queue.
+ */
+typedef struct _MSGQUEUESTATS {
+    /** The number of messages appended to the post message buffer. */
+    DWORD nr_posted;
+    /** The number of posts merged into a queued message. */
+    DWORD nr_coalesced;
+    /**
+     * The number of posts dropped because the overflow list was full
+     * or there was no memory for the message.
+     */
+    DWORD nr_dropped;
+    /** The maximal number of messages ever held by the buffer. */
+    DWORD max_depth;
+    /** The longest probe sequence ever taken by the coalescing index. */
+    DWORD max_probes;
+    /** The number of posts spilled to the overflow list (since 5.0.16). */
+    DWORD nr_spilled;
+    /** The maximal length of the overflow list (since 5.0.16). */
+    DWORD max_spilled;
+    /** The number of times the message thread woke up from the idle sleep. */
+    DWORD nr_idle_wakeups;
+    /**
+     * The number of idle wakeups without any expired timer, ready
+     * listening fd, or new message. It keeps increasing every 10ms
+     * unless MiniGUI is configured with \--enable-tickless.
+     */
+    DWORD nr_empty_wakeups;
+} MSGQUEUESTATS;
+
+/**
+ * \fn BOOL GUIAPI GetMsgQueueStats (HWND hWnd, MSGQUEUESTATS* stats)
+ * \brief Get the statistics of the message queue of a window.
+ *
+ * \param hWnd The handle to a window in the message queue; HWND_NULL for
+ *      the message queue of the current thread.
+ * \param stats The pointer to a MSGQUEUESTATS structure to return
+ *      the statistics.
+ *
+ * \return TRUE on success, FALSE on invalid window handle or the current
+ *      thread is not a message thread.
+ *
+ * \sa SetMsgCoalescingPolicy
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI GetMsgQueueStats (HWND hWnd, MSGQUEUESTATS* stats);
+
 #ifdef _MGRM_PROCESSES
 
 #define CLIENTS_TOPMOST          -1
@@ -6925,6 +7087,14 @@ static inline BOOL MainWindowThreadCleanup (HWND hMainWnd)
 #define ST_PIXEL_ARGB8888       0x0003
 #define ST_PIXEL_XRGB565        0x0004
 
+/**
+ * The color channels of the pixels in the surface are premultiplied by
+ * the alpha channel. Only valid for a pixel format having alpha channel.
+ *
+ * Since 5.0.16
+ */
+#define ST_PREMULTIPLIED        0x0100
+
 /* other flags for future use */
 
 /* for default surface flags */
@@ -6969,6 +7139,14 @@ static inline BOOL MainWindowThreadCleanup (HWND hMainWnd)
  *          - ST_PIXEL_ARGB8888\n
  *            Creating a surface for this main window with
  *            the pixel format ARGB8888.
+ *
+ *      Since 5.0.16, you can OR a pixel format having alpha channel with
+ *      \a ST_PREMULTIPLIED, for a surface of which the color channels are
+ *      premultiplied by the alpha channel. The compositor then blends the
+ *      window with a single multiply-add per channel when the compositing
+ *      type is \a CT_ALPHAPIXEL. The main window must draw premultiplied
+ *      pixels to the surface itself; \a bkgnd_color is premultiplied
+ *      by the system.
  * \param bkgnd_color The background color of the main window if you specify
  *  the main window's surface type other than the default. In this case,
  *  you must use this argument to specify the background color of the main
@@ -10058,6 +10236,10 @@ typedef BOOL (* TIMERPROC)(HWND, LINT, DWORD);
  * Since 5.0.0, if the specified timer already exists when you call
  * this function, MiniGUI will reset the timer by using the new parameters.
  *
+ * Since 5.0.16, there is no limit on the number of timers in a message
+ * thread, and the cost to check the expired timers does not depend on
+ * the number of the timers installed.
+ *
  * \param hWnd The window receives the MSG_TIMER message. If \a timer_proc
  *        is not NULL, MiniGUI will call \a timer_proc instead sending
  *        MSG_TIMER message to this window. If you use timer callback
@@ -10096,6 +10278,37 @@ MG_EXPORT BOOL GUIAPI SetTimerEx (HWND hWnd, LINT id, DWORD speed,
 #define SetTimer(hwnd, id, speed) \
                 SetTimerEx(hwnd, id, speed, NULL)
 
+/**
+ * \fn BOOL GUIAPI SetHiResTimer (HWND hWnd, LINT id, DWORD interv_ms, \
+ *              TIMERPROC timer_proc)
+ * \brief Creates a timer with the timeout value in milliseconds.
+ *
+ * This function is the same as \a SetTimerEx, but the timeout value
+ * \a interv_ms is in the unit of millisecond, so you can create a timer
+ * with a timeout value less than 10 ms.
+ *
+ * Note that the parameter passed to the timer callback procedure or the
+ * lParam of MSG_TIMER message is still the tick count (in the unit of 10 ms)
+ * when the timer had expired.
+ *
+ * \param hWnd The window receives the MSG_TIMER message.
+ * \param id The identifier of the timer.
+ * \param interv_ms The timeout value of the timer in milliseconds.
+ * \param timer_proc The timer callback procedure. If this argument is NULL,
+ *        MiniGUI will send MSG_TIMER to the window procedure of \a hWnd.
+ *
+ * \return TRUE on success, FALSE on error.
+ *
+ * \sa SetTimerEx, KillTimer
+ *
+ * \note Calling \a ResetTimerEx on the timer will change the timeout value
+ *      in the unit of 10 ms.
+ *
+ * Since 5.0.16
+ */
+MG_EXPORT BOOL GUIAPI SetHiResTimer (HWND hWnd, LINT id, DWORD interv_ms,
+                TIMERPROC timer_proc);
+
 /**
  * \fn int GUIAPI KillTimer (HWND hWnd, LINT id)
  * \brief Destroys a timer.
@@ -10178,6 +10391,9 @@ MG_EXPORT BOOL GUIAPI IsTimerInstalled (HWND hWnd, LINT id);
  *
  * \return TRUE for yes, otherwise FALSE.
  *
+ * \note Since 5.0.16, there is no limit on the number of timers, so this
+ *      function always returns TRUE if it is called in a message thread.
+ *
  * \sa IsTimerInstalled
  */
 MG_EXPORT BOOL GUIAPI HaveFreeTimer (void);
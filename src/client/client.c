@@ -79,11 +79,27 @@
 #include "sharedres.h"
 #include "drawsemop.h"
 #include "cursor.h"
+#include "reqring.h"
+
+#ifdef _MGHAVE_CLIENT_REQRING
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "misc.h"
+#endif
 
 int __mg_client_id;
 
 static int conn_fd = -1;         /* connected socket */
 
+#ifdef _MGHAVE_CLIENT_REQRING
+/* Since 5.0.16: the request ring shared with the server */
+static REQRING* cli_ring;
+static int cli_doorbell = -1;
+static int cli_spin_count;
+#endif
+
 ON_LOCK_CLIENT_REQ  OnLockClientReq = NULL;
 ON_TRYLOCK_CLIENT_REQ  OnTrylockClientReq = NULL;
 ON_UNLOCK_CLIENT_REQ  OnUnlockClientReq = NULL;
@@ -138,8 +154,15 @@ BOOL client_ClientStartup (void)
     return TRUE;
 }
 
+#ifdef _MGHAVE_CLIENT_REQRING
+static void cleanup_reqring (void);
+#endif
+
 void client_ClientCleanup (void)
 {
+#ifdef _MGHAVE_CLIENT_REQRING
+    cleanup_reqring ();
+#endif
     close (conn_fd);
     conn_fd = -1;
 }
@@ -213,6 +236,452 @@ static void process_socket_message (MSG *msg)
     }
 }
 
+/* Since 5.0.16: the asynchronous requests waiting for their replies */
+typedef struct _ASYNCREQ {
+    struct _ASYNCREQ*   next;
+
+    int                 seq;
+    void*               result;
+    size_t              len_rslt;
+    CB_REQUEST_DONE     cb_done;
+    void*               context;
+    int                 fd_received;
+} ASYNCREQ;
+
+/* the requests sent to the server, in the order of the replies */
+static ASYNCREQ* pending_head;
+static ASYNCREQ* pending_tail;
+
+/* the requests replied, waiting for delivering */
+static ASYNCREQ* done_head;
+static ASYNCREQ* done_tail;
+
+static int last_async_seq;
+
+#ifdef _MGHAVE_CLIENT_REQRING
+/* the number of requests sent through the socket after the request ring
+   was set up; the ring records it to keep the order of requests. */
+static Uint32 cli_sock_seq;
+#endif
+
+/* sends the header and the data of a request in one message if no
+   file descriptor to send */
+static int send_request (const REQUEST* request,
+                const void* ex_data, size_t ex_data_len, int fd_to_send)
+{
+    struct iovec    iov[5];
+    struct msghdr   msg;
+    struct cmsghdr  *cmsg = NULL;
+    int n, nr_iovs = 0;
+
+    if (ex_data_len <= 0 || ex_data == NULL) {
+        ex_data = NULL;
+        ex_data_len = 0;
+    }
+
+    iov[0].iov_base = (void*)&request->id;
+    iov[0].iov_len  = sizeof (int);
+    iov[1].iov_base = (void*)&request->len_data;
+    iov[1].iov_len  = sizeof (size_t);
+    iov[2].iov_base = &ex_data_len;
+    iov[2].iov_len  = sizeof (size_t);
+
+    msg.msg_name    = NULL;
+    msg.msg_namelen = 0;
+    msg.msg_control    = NULL;
+    msg.msg_controllen = 0;
+
+    if (fd_to_send >= 0) {
+        /* the file descriptor must come with the data, not the header,
+           because the server reads the header without a control buffer */
+        msg.msg_iov     = iov;
+        msg.msg_iovlen  = 3;
+        if ((n = sock_sendmsg (conn_fd, &msg, 0)) < 0)
+            return n;
+    }
+    else {
+        nr_iovs = 3;
+    }
+
+    iov[nr_iovs].iov_base = (void*)request->data;
+    iov[nr_iovs].iov_len  = request->len_data;
+    iov[nr_iovs + 1].iov_base = (void*)ex_data;
+    iov[nr_iovs + 1].iov_len  = ex_data_len;
+
+    msg.msg_iov     = iov;
+    msg.msg_iovlen  = nr_iovs + 2;
+
+    if (fd_to_send >= 0) {
+        cmsg = alloca (CMSG_LEN (sizeof (int)));
+
+        cmsg->cmsg_level    = SOL_SOCKET;
+        cmsg->cmsg_type     = SCM_RIGHTS;
+        cmsg->cmsg_len      = CMSG_LEN (sizeof (int));
+        memcpy (CMSG_DATA (cmsg), &fd_to_send, sizeof (int));
+
+        msg.msg_control     = cmsg;
+        msg.msg_controllen  = CMSG_LEN (sizeof (int));
+    }
+
+    if ((n = sock_sendmsg (conn_fd, &msg, 0)) < 0)
+        return n;
+
+#ifdef _MGHAVE_CLIENT_REQRING
+    if (cli_ring)
+        cli_sock_seq++;
+#endif
+    return 0;
+}
+
+/* receives the reply following a reply message */
+static int recv_reply (void* result, size_t len_rslt, int* fd_received)
+{
+    struct iovec    iov[1];
+    struct msghdr   msg;
+    struct cmsghdr  *cmsg = NULL;
+    int n;
+
+    /* receive the real reply result */
+    iov[0].iov_base = result;
+    iov[0].iov_len  = len_rslt;
+
+    msg.msg_iov     = iov;
+    msg.msg_iovlen  = 1;
+    msg.msg_name    = NULL;
+    msg.msg_namelen = 0;
+
+    if (fd_received) {
+        *fd_received = -1;
+
+        cmsg = alloca (CMSG_LEN (sizeof (int)));
+        msg.msg_control     = cmsg;
+        msg.msg_controllen  = CMSG_LEN (sizeof (int));
+    }
+    else {
+        msg.msg_control     = NULL;
+        msg.msg_controllen  = 0;
+    }
+
+    if ((n = sock_recvmsg (conn_fd, &msg, MSG_WAITALL)) < 0)
+        return n;
+
+    if (fd_received && msg.msg_controllen == CMSG_LEN (sizeof (int))) {
+        memcpy (fd_received, CMSG_DATA(cmsg), sizeof (int));
+    }
+
+    return 0;
+}
+
+/* reads the reply of the oldest pending asynchronous request */
+static int recv_async_reply (void)
+{
+    ASYNCREQ* req = pending_head;
+    int n;
+
+    pending_head = req->next;
+    if (pending_head == NULL)
+        pending_tail = NULL;
+
+    if ((n = recv_reply (req->result, req->len_rslt, &req->fd_received)) < 0) {
+        free (req);
+        return n;
+    }
+
+    req->next = NULL;
+    if (done_tail)
+        done_tail->next = req;
+    else
+        done_head = req;
+    done_tail = req;
+    return 0;
+}
+
+/* reads a message from the server; a reply of an asynchronous request
+   will be read as well. returns 1 if it is a reply message of
+   a synchronous request. */
+static int read_socket_message (MSG* msg)
+{
+    int n;
+
+    if ((n = sock_read (conn_fd, msg, sizeof (MSG))) < 0)
+        return n;
+
+    if (msg->hwnd != HWND_INVALID) {
+        process_socket_message (msg);
+        return 0;
+    }
+
+    if (pending_head) {
+        if ((n = recv_async_reply ()) < 0)
+            return n;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* delivers the replies of asynchronous requests; call it without
+   holding the request lock. returns the number of replies delivered. */
+static int deliver_async_replies (void)
+{
+    ASYNCREQ* req;
+    int nr_delivered = 0;
+
+    while (TRUE) {
+        if (OnLockClientReq && OnUnlockClientReq)
+            OnLockClientReq();
+        req = done_head;
+        if (req) {
+            done_head = req->next;
+            if (done_head == NULL)
+                done_tail = NULL;
+        }
+        if (OnLockClientReq && OnUnlockClientReq)
+            OnUnlockClientReq();
+
+        if (req == NULL)
+            break;
+
+        if (req->cb_done) {
+            req->cb_done (req->seq, req->context,
+                    req->result, req->len_rslt, req->fd_received);
+        }
+        else if (req->context) {
+            PostMessage ((HWND)req->context, MSG_REQUESTDONE,
+                    (WPARAM)req->seq, (LPARAM)req->fd_received);
+        }
+        else if (req->fd_received >= 0) {
+            close (req->fd_received);
+        }
+
+        free (req);
+        nr_delivered++;
+    }
+
+    return nr_delivered;
+}
+
+static BOOL is_async_pending (int seq)
+{
+    ASYNCREQ* req = pending_head;
+
+    while (req) {
+        if (req->seq == seq)
+            return TRUE;
+        req = req->next;
+    }
+
+    return FALSE;
+}
+
+#ifdef _MGHAVE_CLIENT_REQRING
+#define REQRING_SPIN_COUNT      200
+#define REQRING_WAIT_TIMEOUT    100     /* ms */
+
+/* returns TRUE if the server has closed the connection */
+static BOOL server_hung_up (int timeout)
+{
+    struct pollfd pfd = { conn_fd, 0, 0 };
+
+    if (poll (&pfd, 1, timeout) > 0 && (pfd.revents & (POLLHUP | POLLERR)))
+        return TRUE;
+
+    return FALSE;
+}
+
+static void ring_doorbell (REQRING* ring)
+{
+    if (__atomic_exchange_n (&ring->doorbell_armed, 0, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        if (write (cli_doorbell, &one, sizeof (one)) < 0)
+            _WRN_PRINTF ("failed to ring the doorbell: %m\n");
+    }
+}
+
+/* ring the doorbell for the batched requests which want no reply */
+static void flush_reqring (void)
+{
+    if (cli_ring && __atomic_load_n (&cli_ring->head, __ATOMIC_RELAXED) !=
+            __atomic_load_n (&cli_ring->tail, __ATOMIC_RELAXED))
+        ring_doorbell (cli_ring);
+}
+
+static BOOL wait_for_reply (REQRING* ring, Uint32 seq)
+{
+    struct timespec timeout = { 0, REQRING_WAIT_TIMEOUT * 1000000 };
+    int i;
+
+    for (i = 0; i < cli_spin_count; i++) {
+        if (__atomic_load_n (&ring->reply_seq, __ATOMIC_ACQUIRE) != seq)
+            return TRUE;
+    }
+
+    while (TRUE) {
+        __atomic_store_n (&ring->reply_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n (&ring->reply_seq, __ATOMIC_SEQ_CST) != seq)
+            break;
+
+        if (syscall (SYS_futex, &ring->reply_seq, FUTEX_WAIT, seq,
+                    &timeout, NULL, 0) < 0 && errno == ETIMEDOUT &&
+                server_hung_up (0)) {
+            __atomic_store_n (&ring->reply_waiting, 0, __ATOMIC_RELAXED);
+            return FALSE;
+        }
+    }
+
+    __atomic_store_n (&ring->reply_waiting, 0, __ATOMIC_RELAXED);
+    return TRUE;
+}
+
+static BOOL wait_for_slot (REQRING* ring, Uint32 head)
+{
+    struct timespec timeout = { 0, REQRING_WAIT_TIMEOUT * 1000000 };
+    Uint32 tail;
+
+    ring_doorbell (ring);
+    while (TRUE) {
+        __atomic_store_n (&ring->slot_waiting, 1, __ATOMIC_SEQ_CST);
+        tail = __atomic_load_n (&ring->tail, __ATOMIC_SEQ_CST);
+        if (head - tail < REQRING_NR_SLOTS)
+            break;
+
+        if (syscall (SYS_futex, &ring->tail, FUTEX_WAIT, tail,
+                    &timeout, NULL, 0) < 0 && errno == ETIMEDOUT &&
+                server_hung_up (0)) {
+            __atomic_store_n (&ring->slot_waiting, 0, __ATOMIC_RELAXED);
+            return FALSE;
+        }
+    }
+
+    __atomic_store_n (&ring->slot_waiting, 0, __ATOMIC_RELAXED);
+    return TRUE;
+}
+
+/* process the messages sent by the server while it handled the request,
+   as we do for a request sent through the socket. */
+static int process_pending_socket_messages (void)
+{
+    struct pollfd pfd = { conn_fd, POLLIN, 0 };
+    MSG msg;
+    int n;
+
+    while (poll (&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        if ((n = read_socket_message (&msg)) < 0)
+            return n;
+    }
+
+    return 0;
+}
+
+static int ring_request (const REQUEST* request,
+                const void* ex_data, size_t ex_data_len,
+                void* result, size_t len_rslt)
+{
+    REQRING* ring = cli_ring;
+    REQRINGSLOT* slot;
+    Uint32 head = ring->head;
+    Uint32 seq = 0;
+
+    if (head - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) >=
+            REQRING_NR_SLOTS && !wait_for_slot (ring, head))
+        return SOCKERR_CLOSED;
+
+    slot = ring->slots + (head % REQRING_NR_SLOTS);
+    slot->req_id = request->id;
+    slot->len_data = request->len_data + ex_data_len;
+    slot->len_rslt = len_rslt;
+    slot->sock_seq = cli_sock_seq;
+    memcpy (slot->data, request->data, request->len_data);
+    if (ex_data_len > 0)
+        memcpy (slot->data + request->len_data, ex_data, ex_data_len);
+
+    if (len_rslt > 0)
+        seq = __atomic_load_n (&ring->reply_seq, __ATOMIC_ACQUIRE);
+    __atomic_store_n (&ring->head, head + 1, __ATOMIC_SEQ_CST);
+
+    if (len_rslt == 0) {
+        /* batch the requests which want no reply */
+        if (head + 1 - __atomic_load_n (&ring->tail, __ATOMIC_RELAXED) >=
+                REQRING_NR_SLOTS / 2)
+            ring_doorbell (ring);
+        return 0;
+    }
+
+    ring_doorbell (ring);
+    if (!wait_for_reply (ring, seq))
+        return SOCKERR_CLOSED;
+
+    if (ring->len_reply == REQRING_NO_REPLY)
+        return SOCKERR_IO;
+
+    memcpy (result, ring->reply, MIN (ring->len_reply, len_rslt));
+    return process_pending_socket_messages ();
+}
+
+static void setup_reqring (void)
+{
+    REQUEST req;
+    REQRING* ring;
+    const char* env;
+    int size = sizeof (REQRING);
+    int mem_fd, doorbell = -1, result = -1;
+
+    env = getenv ("MG_CLIENT_REQRING");
+    if (env && strcmp (env, "0") == 0)
+        return;
+
+    mem_fd = __mg_create_anonymous_file (sizeof (REQRING), "minigui-reqring",
+            S_IRUSR | S_IWUSR);
+    if (mem_fd < 0)
+        goto failed;
+
+    ring = mmap (NULL, sizeof (REQRING), PROT_READ | PROT_WRITE,
+            MAP_SHARED, mem_fd, 0);
+    if (ring == MAP_FAILED) {
+        close (mem_fd);
+        goto failed;
+    }
+
+    ring->magic = REQRING_MAGIC;
+    ring->nr_slots = REQRING_NR_SLOTS;
+
+    req.id = REQID_SETUPREQRING;
+    req.data = &size;
+    req.len_data = sizeof (int);
+    if (ClientRequestEx2 (&req, NULL, 0, mem_fd,
+                &result, sizeof (int), &doorbell) < 0 ||
+            result != 0 || doorbell < 0) {
+        if (doorbell >= 0)
+            close (doorbell);
+        munmap (ring, sizeof (REQRING));
+        close (mem_fd);
+        goto failed;
+    }
+
+    close (mem_fd);
+    cli_ring = ring;
+    cli_doorbell = doorbell;
+    cli_spin_count = (sysconf (_SC_NPROCESSORS_ONLN) > 1) ?
+        REQRING_SPIN_COUNT : 0;
+    return;
+
+failed:
+    _WRN_PRINTF ("failed to set up the request ring; use the socket only\n");
+}
+
+static void cleanup_reqring (void)
+{
+    if (cli_ring) {
+        flush_reqring ();
+        munmap (cli_ring, sizeof (REQRING));
+        close (cli_doorbell);
+        cli_ring = NULL;
+        cli_doorbell = -1;
+        cli_sock_seq = 0;
+    }
+}
+#endif  /* _MGHAVE_CLIENT_REQRING */
+
 int GUIAPI ClientRequestEx2 (const REQUEST* request,
                 const void* ex_data, size_t ex_data_len, int fd_to_send,
                 void* result, size_t len_rslt, int* fd_received)
@@ -245,164 +714,156 @@ int GUIAPI ClientRequestEx2 (const REQUEST* request,
     if (OnLockClientReq && OnUnlockClientReq)
         OnLockClientReq();
 
-#if 0
-    {
-        size_t len_data;
-
-        n = sock_write (conn_fd, &request->id, sizeof (int));
-        if (n < 0) goto sock_error;
-
-        if (ex_data_len <= 0 || ex_data == NULL) {
-            ex_data = NULL;
-            ex_data_len = 0;
-        }
-
-        len_data = request->len_data + ex_data_len;
-        n = sock_write (conn_fd, &len_data, sizeof (size_t));
-        if (n < 0) goto sock_error;
-
-        n = sock_write (conn_fd, request->data, request->len_data);
-        if (n < 0) goto sock_error;
-
-        if (ex_data_len > 0) {
-            n = sock_write (conn_fd, ex_data, ex_data_len);
-            if (n < 0) goto sock_error;
-        }
-    }
-#else /* use sendmsg */
-    {
-        struct iovec    iov[2];
-        struct msghdr   msg;
-        struct cmsghdr  *cmsg = NULL;
-
-        n = sock_write (conn_fd, &request->id, sizeof (int));
-        if (n < 0) goto sock_error;
+#ifdef _MGHAVE_CLIENT_REQRING
+    /* Since 5.0.16: use the request ring if the request fits in a slot */
+    if (cli_ring && fd_to_send < 0 && fd_received == NULL &&
+            request->len_data + ex_data_len <= REQRING_SIZE_DATA &&
+            len_rslt <= REQRING_SIZE_REPLY) {
+        if (result == NULL)
+            len_rslt = 0;
 
-        n = sock_write (conn_fd, &request->len_data, sizeof (size_t));
-        if (n < 0) goto sock_error;
-
-        n = sock_write (conn_fd, &ex_data_len, sizeof (size_t));
-        if (n < 0) goto sock_error;
-
-        iov[0].iov_base = (void*)request->data;
-        iov[0].iov_len  = request->len_data;
-
-        iov[1].iov_base = (void*)ex_data;
-        iov[1].iov_len  = ex_data_len;
-
-        msg.msg_iov     = iov;
-        msg.msg_iovlen  = 2;
-        msg.msg_name    = NULL;
-        msg.msg_namelen = 0;
-
-        if (fd_to_send >= 0) {
-            cmsg = alloca (CMSG_LEN (sizeof (int)));
-
-            cmsg->cmsg_level    = SOL_SOCKET;
-            cmsg->cmsg_type     = SCM_RIGHTS;
-            cmsg->cmsg_len      = CMSG_LEN (sizeof (int));
-            memcpy (CMSG_DATA (cmsg), &fd_to_send, sizeof (int));
-
-            msg.msg_control     = cmsg;
-            msg.msg_controllen  = CMSG_LEN (sizeof (int));
-        }
-        else {
-            msg.msg_control    = NULL;
-            msg.msg_controllen = 0;
-        }
+        n = ring_request (request, ex_data, ex_data_len, result, len_rslt);
+        if (OnLockClientReq && OnUnlockClientReq)
+            OnUnlockClientReq();
 
-        if ((n = sock_sendmsg (conn_fd, &msg, 0)) < 0)
-            goto sock_error;
+        if (n == SOCKERR_CLOSED)
+            exit (255);
+        return (n < 0) ? -1 : 0;
     }
 #endif
 
+    if ((n = send_request (request, ex_data, ex_data_len, fd_to_send)) < 0)
+        goto sock_error;
+
     if (result == NULL || len_rslt == 0) {
         if (OnLockClientReq && OnUnlockClientReq)
             OnUnlockClientReq();
         return 0;
     }
 
+    /* Since 5.0.16: the replies of the asynchronous requests sent before
+       this one come first */
     {
         MSG msg;
 
         do {
-            n = sock_read (conn_fd, &msg, sizeof (MSG));
+            n = read_socket_message (&msg);
             if (n < 0) {
                 goto sock_error;
             }
-
-            if (msg.hwnd == HWND_INVALID) {
-                break;
-            }
-            else {
-                process_socket_message(&msg);
-            }
-        } while (TRUE);
+        } while (n == 0);
     }
 
-#if 0
-    {
-        n = sock_read (conn_fd, result, len_rslt);
-        if (n < 0) goto sock_error;
+    if ((n = recv_reply (result, len_rslt, fd_received)) < 0)
+        goto sock_error;
+
+    if (fd_received && *fd_received == -1) {
+        _WRN_PRINTF ("Received an invalid file descriptor.\n");
     }
-#else /* use recvmsg */
-    {
-        struct iovec    iov[1];
-        struct msghdr   msg;
-        struct cmsghdr  *cmsg = NULL;
 
-        /* receive the real reply result */
-        iov[0].iov_base = result;
-        iov[0].iov_len  = len_rslt;
+    if (OnLockClientReq && OnUnlockClientReq)
+        OnUnlockClientReq();
 
-        msg.msg_iov     = iov;
-        msg.msg_iovlen  = 1;
-        msg.msg_name    = NULL;
-        msg.msg_namelen = 0;
+    return 0;
 
-        if (fd_received) {
-            *fd_received = -1;
+sock_error:
+    if (OnLockClientReq && OnUnlockClientReq)
+        OnUnlockClientReq();
 
-            cmsg = alloca (CMSG_LEN (sizeof (int)));
-            msg.msg_control     = cmsg;
-            msg.msg_controllen  = CMSG_LEN (sizeof (int));
-        }
-        else {
-            msg.msg_control     = NULL;
-            msg.msg_controllen  = 0;
-        }
+    if (n == SOCKERR_CLOSED) {
+        exit (255);
+    }
 
-        if ((n = sock_recvmsg (conn_fd, &msg, 0)) < 0) {
-            goto sock_error;
-        }
+    return -1;
+}
 
-        if (fd_received && msg.msg_controllen == CMSG_LEN (sizeof (int))) {
-            memcpy (fd_received, CMSG_DATA(cmsg), sizeof (int));
-        }
+int GUIAPI ClientRequestAsync (const REQUEST* request,
+                const void* ex_data, size_t ex_data_len, int fd_to_send,
+                void* result, size_t len_rslt,
+                CB_REQUEST_DONE cb_done, void* context)
+{
+    ASYNCREQ* req = NULL;
+    int n, seq;
 
-        if (fd_received && *fd_received == -1) {
-            _WRN_PRINTF ("Received an invalid file descriptor.\n");
-        }
+    if (mgIsServer)
+        return -1;
+
+    if (__mg_client_id == 0 && (request->id & REQMASK_JOINLAYERFIRST)) {
+        _ERR_PRINTF ("CLIENT: please call JoinLayer first.\n");
+        exit (255);
+        return -1;
+    }
+
+    if (result && len_rslt > 0) {
+        if ((req = malloc (sizeof (ASYNCREQ))) == NULL)
+            return -1;
     }
-#endif
 
     if (OnLockClientReq && OnUnlockClientReq)
-        OnUnlockClientReq();
+        OnLockClientReq();
 
-    return 0;
+    seq = ++last_async_seq;
+    if (seq <= 0)
+        seq = last_async_seq = 1;
 
-sock_error:
-    if (n == SOCKERR_IO) {
+    /* the asynchronous requests always go through the socket, so that
+       many of them can be outstanding */
+    if ((n = send_request (request, ex_data, ex_data_len, fd_to_send)) < 0) {
         if (OnLockClientReq && OnUnlockClientReq)
             OnUnlockClientReq();
+
+        free (req);
+        if (n == SOCKERR_CLOSED)
+            exit (255);
+        return -1;
     }
-    else if (n == SOCKERR_CLOSED) {
-        if (OnLockClientReq && OnUnlockClientReq)
-            OnUnlockClientReq();
-        exit (255);
+
+    if (req) {
+        req->next = NULL;
+        req->seq = seq;
+        req->result = result;
+        req->len_rslt = len_rslt;
+        req->cb_done = cb_done;
+        req->context = context;
+        req->fd_received = -1;
+
+        if (pending_tail)
+            pending_tail->next = req;
+        else
+            pending_head = req;
+        pending_tail = req;
     }
 
-    return -1;
+    if (OnLockClientReq && OnUnlockClientReq)
+        OnUnlockClientReq();
+
+    return seq;
+}
+
+int GUIAPI WaitClientRequest (int req_seq)
+{
+    MSG msg;
+    int n = 0;
+
+    if (mgIsServer)
+        return -1;
+
+    if (OnLockClientReq && OnUnlockClientReq)
+        OnLockClientReq();
+
+    while (is_async_pending (req_seq)) {
+        if ((n = read_socket_message (&msg)) < 0)
+            break;
+    }
+
+    if (OnLockClientReq && OnUnlockClientReq)
+        OnUnlockClientReq();
+
+    if (n == SOCKERR_CLOSED)
+        exit (255);
+
+    deliver_async_replies ();
+    return (n < 0) ? -1 : 0;
 }
 
 BOOL client_IdleHandler4Client (PMSGQUEUE msg_queue, BOOL wait)
@@ -412,11 +873,18 @@ BOOL client_IdleHandler4Client (PMSGQUEUE msg_queue, BOOL wait)
     fd_set rset, wset, eset;
     fd_set* wsetptr = NULL;
     fd_set* esetptr = NULL;
-    int n, nread;
+    int n, nread, nr_done;
     struct timeval sel_timeout;
     MSG Msg;
 
     check_live (FALSE);
+#ifdef _MGHAVE_CLIENT_REQRING
+    /* Since 5.0.16: let the server handle the batched requests */
+    flush_reqring ();
+#endif
+
+    /* Since 5.0.16: deliver the replies of asynchronous requests */
+    nr_done = deliver_async_replies ();
 
     /* rset gets modified each time around */
     rset = msg_queue->rfdset;
@@ -429,9 +897,11 @@ BOOL client_IdleHandler4Client (PMSGQUEUE msg_queue, BOOL wait)
         esetptr = &eset;
     }
 
-    if (wait) {
+    if (wait && nr_done == 0) {
+        /* Since 5.0.16: sleep until the next timer expires if it is sooner */
         sel_timeout.tv_sec = 0;
-        sel_timeout.tv_usec = USEC_10MS;
+        sel_timeout.tv_usec =
+            __mg_get_timer_timeout (msg_queue, USEC_10MS / 1000) * 1000;
     }
     else {  /* check fd only: for HavePendingMessage function */
         sel_timeout.tv_sec = 0;
@@ -495,9 +965,7 @@ BOOL client_IdleHandler4Client (PMSGQUEUE msg_queue, BOOL wait)
     }
 
     /* Since 5.0.0: always check timer */
-    n += __mg_check_expired_timers (msg_queue,
-            SHAREDRES_TIMER_COUNTER - msg_queue->old_tick_count);
-    msg_queue->old_tick_count = SHAREDRES_TIMER_COUNTER;
+    n += __mg_check_expired_timers (msg_queue);
 
     if (FD_ISSET (conn_fd, &rset) &&
         (!OnTrylockClientReq || !OnUnlockClientReq ||
@@ -515,6 +983,15 @@ BOOL client_IdleHandler4Client (PMSGQUEUE msg_queue, BOOL wait)
             __mg_err_sys ("client: server closed");
             close (conn_fd);
         }
+        else if (Msg.hwnd == HWND_INVALID && pending_head) {
+            /* Since 5.0.16: the reply of an asynchronous request */
+            nread = recv_async_reply ();
+            if (OnTrylockClientReq && OnUnlockClientReq)
+                OnUnlockClientReq();
+            if (nread < 0)
+                __mg_err_sys ("client: read error on fd %d", conn_fd);
+            nr_done += deliver_async_replies ();
+        }
         else {           /* process event from server */
             if (OnTrylockClientReq && OnUnlockClientReq)
                 OnUnlockClientReq();
@@ -527,6 +1004,7 @@ BOOL client_IdleHandler4Client (PMSGQUEUE msg_queue, BOOL wait)
 
     check_live (FALSE);
 
+    n += nr_done;
     if (n > 0) {
         old_timer = __mg_tick_counter;
         repeat_timeout = TIMEOUT_START_REPEAT;
@@ -597,6 +1075,9 @@ GHANDLE GUIAPI JoinLayerEx (const char* layer_name, const char* client_name,
         }
 
         __mg_zorder_info = zi;
+#ifdef _MGSCHEMA_COMPOSITING
+        __mg_zorder_dirty_map = __kernel_attach_znode_dirty_map (zi);
+#endif
         if (joined_info.zi_shmid == joined_info.def_zi_shmid) {
             __mg_def_zorder_info = zi;
         }
@@ -612,6 +1093,10 @@ GHANDLE GUIAPI JoinLayerEx (const char* layer_name, const char* client_name,
 
     __mg_tick_counter = SHAREDRES_TIMER_COUNTER;
 
+#ifdef _MGHAVE_CLIENT_REQRING
+    setup_reqring ();
+#endif
+
     __mg_start_client_desktop ();
 
     if (cli_id)
@@ -736,14 +1221,23 @@ BOOL __mg_client_on_layer_changed (GHANDLE layer_handle, int zi_shmid)
     if (layer_handle != INV_LAYER_HANDLE) {
         ZORDERINFO* zi;
 
-        __mg_layer = INV_LAYER_HANDLE;
-        __mg_zorder_info = NULL;
+#ifdef _MGSCHEMA_COMPOSITING
+        /* the surfaces must not flag the map after it is detached */
+        __mg_bind_znode_surfaces (FALSE);
+        __kernel_detach_znode_dirty_map (__mg_zorder_dirty_map);
+        __mg_zorder_dirty_map = NULL;
+#endif
 
-        if (shmdt (__mg_zorder_info) < 0) {
+        /* the default zorder info may be attached only once */
+        if (__mg_zorder_info != __mg_def_zorder_info &&
+                shmdt (__mg_zorder_info) < 0) {
             _ERR_PRINTF ("Failed to detach from the shared zorder info: %m\n");
             return FALSE;
         }
 
+        __mg_layer = INV_LAYER_HANDLE;
+        __mg_zorder_info = NULL;
+
         zi  = (ZORDERINFO*) shmat (zi_shmid, 0, SHM_RDONLY);
         if (zi == (void*)-1) {
             _ERR_PRINTF ("Failed to attach to the shared zorder info: %m\n");
@@ -752,6 +1246,10 @@ BOOL __mg_client_on_layer_changed (GHANDLE layer_handle, int zi_shmid)
 
         __mg_layer = layer_handle;
         __mg_zorder_info = zi;
+#ifdef _MGSCHEMA_COMPOSITING
+        __mg_zorder_dirty_map = __kernel_attach_znode_dirty_map (zi);
+        __mg_bind_znode_surfaces (TRUE);
+#endif
 
 #if 0 /* obsolete */
         ZORDERNODE* nodes;
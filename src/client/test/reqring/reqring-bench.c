@@ -0,0 +1,246 @@
+/*
+** reqring-bench.c: compare the request ring with the socket for the
+** requests of a client of MiniGUI-Processes.
+**
+** When run as the server (mginit), this program registers three request
+** handlers, then runs itself as a client twice: with the request ring
+** disabled (MG_CLIENT_REQRING=0) and enabled. The client reports:
+**
+**  - the average latency of a request which wants a reply;
+**  - the throughput of the requests which want no reply, followed by
+**    a request which checks that the server got all of them;
+**  - the throughput of the asynchronous requests (ClientRequestAsync)
+**    with NR_OUTSTANDING requests outstanding;
+**  - whether the order of the asynchronous requests and the requests
+**    sent through the ring is kept.
+**
+** MiniGUI should be configured with --enable-reqring. Run it as:
+**
+**  $ ln -sf reqring-bench mginit
+**  $ ./mginit [nr_requests]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define REQID_BENCH_ECHO    (MAX_SYS_REQID + 1)
+#define REQID_BENCH_NOTE    (MAX_SYS_REQID + 2)
+#define REQID_BENCH_SYNC    (MAX_SYS_REQID + 3)
+
+#define DEF_NR_REQUESTS     20000
+#define SIZE_PAYLOAD        64
+#define NR_OUTSTANDING      32
+
+static const char* nr_requests_arg;
+static int nr_notes;
+static int nr_runs;
+
+static int echo_handler (int cli, int clifd, void* buff, size_t len)
+{
+    return ServerSendReply (clifd, buff, len);
+}
+
+static int note_handler (int cli, int clifd, void* buff, size_t len)
+{
+    nr_notes++;
+    return 0;
+}
+
+static int sync_handler (int cli, int clifd, void* buff, size_t len)
+{
+    int n = nr_notes;
+
+    nr_notes = 0;
+    return ServerSendReply (clifd, &n, sizeof (int));
+}
+
+static void run_client (BOOL use_ring)
+{
+    if (fork () == 0) {
+        setenv ("MG_CLIENT_REQRING", use_ring ? "1" : "0", 1);
+        execl ("./reqring-bench", "reqring-bench", nr_requests_arg, NULL);
+        perror ("execl");
+        exit (1);
+    }
+}
+
+static void on_new_del_client (int op, int cli)
+{
+    if (op == LCO_DEL_CLIENT) {
+        if (++nr_runs == 1)
+            run_client (TRUE);
+        else
+            PostQuitMessage (HWND_DESKTOP);
+    }
+}
+
+static char async_replies [NR_OUTSTANDING][SIZE_PAYLOAD];
+static int nr_async_done, nr_async_bad;
+
+static void on_async_done (int req_seq, void* context,
+        void* result, size_t len_rslt, int fd_received)
+{
+    if (((char*)result)[0] != (char)(intptr_t)context)
+        nr_async_bad++;
+    nr_async_done++;
+}
+
+static double elapsed_us (const struct timespec* ts)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - ts->tv_sec) * 1000000.0 +
+        (now.tv_nsec - ts->tv_nsec) / 1000.0;
+}
+
+static int bench (int nr_requests)
+{
+    REQUEST req;
+    char payload [SIZE_PAYLOAD], reply [SIZE_PAYLOAD];
+    struct timespec ts;
+    double us;
+    int i, n, seqs [NR_OUTSTANDING];
+
+    memset (payload, 'x', sizeof (payload));
+    req.data = payload;
+    req.len_data = sizeof (payload);
+
+    /* warm up */
+    req.id = REQID_BENCH_ECHO;
+    for (i = 0; i < 100; i++)
+        ClientRequest (&req, reply, sizeof (reply));
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    for (i = 0; i < nr_requests; i++) {
+        payload [0] = (char)i;
+        if (ClientRequest (&req, reply, sizeof (reply)) < 0 ||
+                memcmp (payload, reply, sizeof (payload))) {
+            fprintf (stderr, "bad reply of request %d\n", i);
+            return 1;
+        }
+    }
+    us = elapsed_us (&ts);
+    printf ("%-8s request with reply: %8.2f us/request\n",
+            getenv ("MG_CLIENT_REQRING")[0] == '0' ? "socket:" : "ring:",
+            us / nr_requests);
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    req.id = REQID_BENCH_NOTE;
+    for (i = 0; i < nr_requests; i++)
+        ClientRequest (&req, NULL, 0);
+
+    /* the socket can not pass a request without any data */
+    req.id = REQID_BENCH_SYNC;
+    req.len_data = sizeof (int);
+    n = -1;
+    ClientRequest (&req, &n, sizeof (int));
+    us = elapsed_us (&ts);
+    printf ("%-8s request without reply: %8.2f us/request (%d handled)\n",
+            getenv ("MG_CLIENT_REQRING")[0] == '0' ? "socket:" : "ring:",
+            us / nr_requests, n);
+
+    if (n != nr_requests)
+        return 1;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    req.id = REQID_BENCH_ECHO;
+    req.data = payload;
+    req.len_data = sizeof (payload);
+    for (i = 0; i < nr_requests; i++) {
+        int k = i % NR_OUTSTANDING;
+
+        if (i >= NR_OUTSTANDING)
+            WaitClientRequest (seqs [k]);
+
+        payload [0] = (char)i;
+        seqs [k] = ClientRequestAsync (&req, NULL, 0, -1,
+                async_replies [k], SIZE_PAYLOAD,
+                on_async_done, (void*)(intptr_t)(char)i);
+        if (seqs [k] < 0) {
+            fprintf (stderr, "failed to send async request %d\n", i);
+            return 1;
+        }
+    }
+    WaitClientRequest (seqs [(nr_requests - 1) % NR_OUTSTANDING]);
+    us = elapsed_us (&ts);
+    printf ("%-8s async request with reply: %8.2f us/request "
+            "(%d done, %d bad)\n",
+            getenv ("MG_CLIENT_REQRING")[0] == '0' ? "socket:" : "ring:",
+            us / nr_requests, nr_async_done, nr_async_bad);
+    if (nr_async_done != nr_requests || nr_async_bad)
+        return 1;
+
+    /* the asynchronous requests go through the socket; the server
+       should handle them and the requests in the ring in order. */
+    req.id = REQID_BENCH_NOTE;
+    for (i = 0; i < NR_OUTSTANDING; i++)
+        ClientRequestAsync (&req, NULL, 0, -1, NULL, 0, NULL, NULL);
+    req.id = REQID_BENCH_SYNC;
+    req.len_data = sizeof (int);
+    ClientRequest (&req, &n, sizeof (int));
+    if (n != NR_OUTSTANDING) {
+        fprintf (stderr, "async then sync: %d handled\n", n);
+        return 1;
+    }
+
+    req.id = REQID_BENCH_NOTE;
+    for (i = 0; i < NR_OUTSTANDING; i++)
+        ClientRequest (&req, NULL, 0);
+    req.id = REQID_BENCH_SYNC;
+    WaitClientRequest (ClientRequestAsync (&req, NULL, 0, -1,
+                &n, sizeof (int), NULL, NULL));
+    if (n != NR_OUTSTANDING) {
+        fprintf (stderr, "sync then async: %d handled\n", n);
+        return 1;
+    }
+    printf ("%-8s order of async and sync requests: ok\n",
+            getenv ("MG_CLIENT_REQRING")[0] == '0' ? "socket:" : "ring:");
+
+    fflush (stdout);
+    return 0;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    MSG msg;
+
+    nr_requests_arg = (argc > 1) ? argv [1] : "0";
+
+    if (mgIsServer) {
+        if (!ServerStartup (0, 0, 0)) {
+            fprintf (stderr, "Can not start the server.\n");
+            return 1;
+        }
+
+        RegisterRequestHandler (REQID_BENCH_ECHO, echo_handler);
+        RegisterRequestHandler (REQID_BENCH_NOTE, note_handler);
+        RegisterRequestHandler (REQID_BENCH_SYNC, sync_handler);
+        OnNewDelClient = on_new_del_client;
+
+        run_client (FALSE);
+        while (GetMessage (&msg, HWND_DESKTOP)) {
+            DispatchMessage (&msg);
+        }
+
+        return 0;
+    }
+
+    if (JoinLayer (NAME_DEF_LAYER, "reqring-bench", 0, 0) ==
+            INV_LAYER_HANDLE) {
+        fprintf (stderr, "Can not join the layer.\n");
+        return 1;
+    }
+
+    return bench ((argc > 1 && atoi (argv [1]) > 0) ?
+            atoi (argv [1]) : DEF_NR_REQUESTS);
+}
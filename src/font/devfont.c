@@ -874,6 +874,8 @@ BOOL font_TerminateIncoreFonts (void)
     for (i = 0; i < NR_UPFONTS && incore_upfonts[i]; i++) {
         const char* name = ((UPFV1_FILE_HEADER*)(incore_upfonts [i]->root_dir))->font_name;
         font_DelDevFont (name);
+        /* the index is built on the first use; see upf.c */
+        font_FreeUPFIndex (incore_upfonts [i]);
     }
 #endif
 
@@ -943,6 +945,12 @@ static void del_devfont_from_list(const char* font_name, BOOL is_mbc_list)
             if (!cur->relationship && cur->need_unload)
                 cur->font_ops->unload_font_data (cur, cur->data);
 
+            font_InvalidateGlyphCache (cur);
+#ifdef _MGCHARSET_UNICODE
+            /* the shaped runs refer to the glyphs of the device font */
+            gdi_InvalidateShapedRunCache ();
+#endif
+
             if (cur == head) {
                 cur = cur->next;
                 free (head);
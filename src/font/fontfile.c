@@ -0,0 +1,332 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+
+/*
+** fontfile.c: the zero-copy loading of font files.
+**
+** Create date: 2026/10/18
+**
+** The bitmap font engines map their font files read-only, so that all
+** processes loading the same font share one physical copy in the page cache.
+** When a cache directory is configured, the indices parsed from a font file
+** are kept in a sidecar file in that directory; the sidecar is mapped
+** read-only too, so the processes loading the font after the first one
+** do no parsing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "minigui.h"
+#include "gdi.h"
+
+#ifdef HAVE_MMAP
+#   include <errno.h>
+#   include <limits.h>
+#   include <unistd.h>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#endif
+
+#include "devfont.h"
+#include "fontfile.h"
+
+BOOL font_MapFontFile (FILE* fp, FONTFILEMAP* map)
+{
+    long size;
+
+    memset (map, 0, sizeof (FONTFILEMAP));
+
+    if (fseek (fp, 0, SEEK_END) || (size = ftell (fp)) <= 0)
+        return FALSE;
+
+#ifdef HAVE_MMAP
+    map->data = mmap (NULL, size, PROT_READ, MAP_SHARED, fileno (fp), 0);
+    if (map->data != MAP_FAILED) {
+        map->size = size;
+        map->mapped = TRUE;
+        return TRUE;
+    }
+    map->data = NULL;
+#endif
+
+    /* fall back to read the file into heap */
+    if ((map->data = malloc (size)) == NULL)
+        return FALSE;
+
+    if (fseek (fp, 0, SEEK_SET) ||
+            fread (map->data, 1, size, fp) < (size_t)size) {
+        free (map->data);
+        map->data = NULL;
+        return FALSE;
+    }
+
+    map->size = size;
+    return TRUE;
+}
+
+void font_UnmapFontFile (FONTFILEMAP* map)
+{
+    if (map->data == NULL)
+        return;
+
+#ifdef HAVE_MMAP
+    if (map->mapped)
+        munmap (map->data, map->size);
+    else
+#endif
+        free (map->data);
+
+    map->data = NULL;
+    map->size = 0;
+}
+
+#ifdef HAVE_MMAP
+/*
+ * Since 5.0.16: the directory of the index sidecars; the sidecars are
+ * not saved or used unless it is set in the environment variable
+ * MG_FONT_INDEX_CACHE or by the key font_index_cache in the section
+ * systemfont of MiniGUI.cfg. It is read by font_InitIndexCache when
+ * the GDI is initialized, before any font is loaded.
+ */
+static char index_cache_dir [MAX_PATH + 1];
+
+static const char* get_index_cache_dir (void)
+{
+    return index_cache_dir [0] ? index_cache_dir : NULL;
+}
+#endif  /* defined HAVE_MMAP */
+
+void font_InitIndexCache (void)
+{
+#ifdef HAVE_MMAP
+    char* env;
+
+    if ((env = getenv ("MG_FONT_INDEX_CACHE"))) {
+        strncpy (index_cache_dir, env, MAX_PATH);
+        index_cache_dir [MAX_PATH] = '\0';
+    }
+    else if (GetMgEtcValue ("systemfont", "font_index_cache",
+                index_cache_dir, MAX_PATH) < 0) {
+        index_cache_dir [0] = '\0';
+    }
+
+    if (index_cache_dir [0] && mkdir (index_cache_dir, 0755) &&
+            errno != EEXIST) {
+        _DBG_PRINTF ("FONT>Index: can not create cache directory: %s\n",
+                index_cache_dir);
+        index_cache_dir [0] = '\0';
+    }
+#endif  /* defined HAVE_MMAP */
+}
+
+#ifdef HAVE_MMAP
+/*
+ * The sidecar of a font file is named after the base name of the font file
+ * and a hash of its full path, so fonts with the same name in different
+ * directories do not share a sidecar.
+ */
+static BOOL get_index_sidecar_path (const char* file_name,
+        char* path, size_t size)
+{
+    const char* cache_dir;
+    const char* base_name;
+    char full_path [PATH_MAX];
+    const char* p;
+    Uint32 hash = 2166136261U;
+
+    if ((cache_dir = get_index_cache_dir ()) == NULL)
+        return FALSE;
+
+    if (realpath (file_name, full_path) == NULL)
+        return FALSE;
+
+    /* FNV-1a */
+    for (p = full_path; *p; p++) {
+        hash ^= (Uint8)*p;
+        hash *= 16777619U;
+    }
+
+    if ((base_name = strrchr (full_path, '/')))
+        base_name++;
+    else
+        base_name = full_path;
+
+    return snprintf (path, size, "%s/%s-%08x%s", cache_dir, base_name,
+            hash, FONT_INDEX_SUFFIX) < (int)size;
+}
+
+static BOOL map_index_sidecar (const char* path, const FONTINDEXHEADER* expected,
+        FONTFILEMAP* index)
+{
+    FONTINDEXHEADER header;
+    struct stat st;
+    int fd;
+    BOOL ok = FALSE;
+
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return FALSE;
+
+    if (read (fd, &header, sizeof (header)) == sizeof (header) &&
+            header.magic == expected->magic &&
+            header.engine == expected->engine &&
+            header.header_size == sizeof (FONTINDEXHEADER) &&
+            header.font_size == expected->font_size &&
+            header.font_mtime == expected->font_mtime &&
+            fstat (fd, &st) == 0 &&
+            st.st_size == (off_t)(header.header_size + header.index_size)) {
+        index->size = st.st_size;
+        index->data = mmap (NULL, index->size, PROT_READ, MAP_SHARED, fd, 0);
+        if (index->data != MAP_FAILED) {
+            index->mapped = TRUE;
+            ok = TRUE;
+        }
+        else
+            index->data = NULL;
+    }
+
+    close (fd);
+    return ok;
+}
+
+static void save_index_sidecar (const char* path, const FONTFILEMAP* index)
+{
+    char tmp_path [MAX_PATH + 1];
+    int fd;
+    ssize_t written;
+
+    /* write a temporary file and rename it for the concurrent loaders */
+    if (snprintf (tmp_path, sizeof (tmp_path), "%s.%d",
+                path, (int)getpid ()) >= (int)sizeof (tmp_path))
+        return;
+
+    if ((fd = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        _DBG_PRINTF ("FONT>Index: can not create sidecar: %s\n", tmp_path);
+        return;
+    }
+
+    written = write (fd, index->data, index->size);
+    close (fd);
+    if (written != (ssize_t)index->size || rename (tmp_path, path)) {
+        _DBG_PRINTF ("FONT>Index: can not save sidecar: %s\n", path);
+        unlink (tmp_path);
+    }
+}
+#endif  /* HAVE_MMAP */
+
+BOOL font_MapFontIndex (const char* file_name, const FONTFILEMAP* font,
+        Uint32 engine, CB_BUILD_FONT_INDEX cb_build,
+        CB_CHECK_FONT_INDEX cb_check, FONTFILEMAP* index)
+{
+    FONTINDEXHEADER header;
+    size_t index_size;
+#ifdef HAVE_MMAP
+    char path [MAX_PATH + 1];
+    struct stat st;
+#endif
+
+    memset (index, 0, sizeof (FONTFILEMAP));
+    memset (&header, 0, sizeof (header));
+    header.magic = FONT_INDEX_MAGIC;
+    header.engine = engine;
+    header.header_size = sizeof (FONTINDEXHEADER);
+    header.font_size = font->size;
+
+#ifdef HAVE_MMAP
+    if (stat (file_name, &st) ||
+            !get_index_sidecar_path (file_name, path, sizeof (path))) {
+        path [0] = '\0';
+    }
+    else {
+        header.font_mtime = (Uint32)st.st_mtime;
+        if (map_index_sidecar (path, &header, index)) {
+            if (cb_check (font, index))
+                return TRUE;
+
+            /* a corrupted sidecar; build the index and replace it */
+            _WRN_PRINTF ("FONT>Index: bad sidecar: %s\n", path);
+            font_UnmapFontFile (index);
+        }
+    }
+#endif
+
+    if ((index_size = cb_build (font, NULL, 0)) == 0)
+        return FALSE;
+
+    index->size = sizeof (FONTINDEXHEADER) + index_size;
+    if ((index->data = calloc (1, index->size)) == NULL)
+        return FALSE;
+
+    header.index_size = index_size;
+    memcpy (index->data, &header, sizeof (header));
+    if (cb_build (font, FONT_INDEX_DATA (index), index_size) == 0) {
+        font_UnmapFontFile (index);
+        return FALSE;
+    }
+
+#ifdef HAVE_MMAP
+    /* share the saved sidecar with the other processes */
+    if (path [0]) {
+        FONTFILEMAP saved;
+
+        save_index_sidecar (path, index);
+        if (map_index_sidecar (path, &header, &saved)) {
+            if (cb_check (font, &saved)) {
+                font_UnmapFontFile (index);
+                *index = saved;
+            }
+            else
+                font_UnmapFontFile (&saved);
+        }
+    }
+#endif
+
+    return TRUE;
+}
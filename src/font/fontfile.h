@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** fontfile.h: the head file of the zero-copy loading of font files.
+**
+** Create date: 2026/10/18
+*/
+
+#ifndef GUI_FONT_FILE_H
+    #define GUI_FONT_FILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/* The content of a font file or an index sidecar. */
+typedef struct _FONTFILEMAP {
+    void*   data;
+    size_t  size;
+    /* TRUE if the data are mapped read-only; FALSE if allocated from heap */
+    BOOL    mapped;
+} FONTFILEMAP;
+
+/* The header of an index sidecar. */
+typedef struct _FONTINDEXHEADER {
+    /* FONT_INDEX_MAGIC; also tells the byte order */
+    Uint32  magic;
+    /* the identifier of the font engine and the version of the index */
+    Uint32  engine;
+    Uint32  header_size;
+    Uint32  index_size;
+    /* the size and the modification time of the font file */
+    Uint32  font_size;
+    Uint32  font_mtime;
+} FONTINDEXHEADER;
+
+#define FONT_INDEX_MAGIC        0x5846474D      /* "MGFX" */
+#define FONT_INDEX_SUFFIX       ".mgidx"
+
+#define FONT_INDEX_DATA(map)    \
+    ((void*)((Uint8*)(map)->data + sizeof (FONTINDEXHEADER)))
+
+/*
+ * Builds the index of a font file. When buff is NULL, returns the size of
+ * the index; otherwise fills the index in buff. Returns 0 on error.
+ */
+typedef size_t (*CB_BUILD_FONT_INDEX) (const FONTFILEMAP* font,
+        void* buff, size_t size);
+
+/*
+ * Checks an index mapped from a sidecar against the font file, since
+ * a sidecar may be stale or corrupted. Returns TRUE if every offset in
+ * the index lies in the font file.
+ */
+typedef BOOL (*CB_CHECK_FONT_INDEX) (const FONTFILEMAP* font,
+        const FONTFILEMAP* index);
+
+/* Maps the whole font file read-only, or reads it if mmap is unavailable. */
+BOOL font_MapFontFile (FILE* fp, FONTFILEMAP* map);
+void font_UnmapFontFile (FONTFILEMAP* map);
+
+/*
+ * Maps the index of a font file from its sidecar in the index cache
+ * directory, if one is configured. If the sidecar is missing or stale,
+ * builds the index and tries to save the sidecar, so that the other
+ * processes loading the same font share the index instead of building
+ * it again. An index read from a sidecar is used only if cb_check
+ * accepts it; otherwise, it is rebuilt.
+ */
+BOOL font_MapFontIndex (const char* file_name, const FONTFILEMAP* font,
+        Uint32 engine, CB_BUILD_FONT_INDEX cb_build,
+        CB_CHECK_FONT_INDEX cb_check, FONTFILEMAP* index);
+#define font_UnmapFontIndex     font_UnmapFontFile
+
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#endif /* GUI_FONT_FILE_H */
@@ -0,0 +1,475 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+
+/*
+** glyphcache.c: the glyph cache shared by the font engines.
+**
+** Create date: 2026/10/18
+**
+** The cache keeps the final glyph bitmaps produced by the text renderer
+** (after the bold, scale, and flip expansion), keyed by the device font,
+** the size, the style, the rotation, and the glyph value.
+**
+** The glyphs are distributed over a few shards by the hash of the key.
+** Every shard has its own read-write lock, hash table, and byte budget,
+** so the lookups from different threads hardly contend with each other.
+** A lookup only takes the read lock: it marks the glyph as referenced and
+** increases the reference count atomically. When a shard is full,
+** the unreferenced glyphs are evicted in the CLOCK order; the glyphs in use
+** are never freed until they are released.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+#   include <pthread.h>
+#endif
+
+#include "minigui.h"
+#include "gdi.h"
+#include "list.h"
+#include "devfont.h"
+
+#define NR_GLYPH_SHARDS         16
+#define GLYPH_SHARD_BITS        4
+#define MIN_SHARD_BUCKETS       64
+
+/* the average size of a cached glyph, used to size the hash tables */
+#define AVG_GLYPH_BYTES         256
+
+/* the default byte budget of the cache in KiB */
+#define DEF_GLYPH_CACHE_KBYTES  512
+
+/* the reference count of a glyph removed from the cache while in use */
+#define GLYPH_DEAD              0x80000000U
+
+typedef struct _GLYPHENTRY {
+    /* must be the first member; see font_ReleaseGlyph */
+    CACHEDGLYPH         glyph;
+    GLYPHKEY            key;
+    unsigned int        hash;
+    unsigned int        refs;
+    int                 referenced;
+    size_t              nr_bytes;
+    struct _GLYPHENTRY* hash_next;
+    struct list_head    clock;
+} GLYPHENTRY;
+
+typedef struct _GLYPHSHARD {
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_rwlock_t    lock;
+#endif
+    GLYPHENTRY**        buckets;
+    unsigned int        bucket_mask;
+    size_t              max_bytes;
+    size_t              nr_bytes;
+    size_t              nr_glyphs;
+    struct list_head    entries;
+    struct list_head*   hand;
+
+    unsigned long       nr_hits;
+    unsigned long       nr_misses;
+    unsigned long       nr_evictions;
+} GLYPHSHARD;
+
+static GLYPHSHARD glyph_shards [NR_GLYPH_SHARDS];
+static BOOL glyph_cache_enabled;
+
+#if defined(_MGHAVE_VIRTUAL_WINDOW) && defined(__GNUC__)
+#   define _MG_LOCKFREE_GLYPHCACHE  1
+#endif
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+#   define WRLOCK_SHARD(shard)      pthread_rwlock_wrlock (&(shard)->lock)
+#   define UNLOCK_SHARD(shard)      pthread_rwlock_unlock (&(shard)->lock)
+#else
+#   define WRLOCK_SHARD(shard)
+#   define UNLOCK_SHARD(shard)
+#endif
+
+#ifdef _MG_LOCKFREE_GLYPHCACHE
+#   define RDLOCK_SHARD(shard)      pthread_rwlock_rdlock (&(shard)->lock)
+#   define GLYPH_STATS_INC(shard, field)    \
+        __atomic_add_fetch (&(shard)->field, 1, __ATOMIC_RELAXED)
+#   define GLYPH_REFS_LOAD(entry)           \
+        __atomic_load_n (&(entry)->refs, __ATOMIC_ACQUIRE)
+#   define GLYPH_REFS_ADD(entry, n)         \
+        __atomic_fetch_add (&(entry)->refs, n, __ATOMIC_ACQ_REL)
+#   define GLYPH_REFS_SUB(entry, n)         \
+        __atomic_fetch_sub (&(entry)->refs, n, __ATOMIC_ACQ_REL)
+#   define GLYPH_REFS_KILL(entry)           \
+        __atomic_fetch_or (&(entry)->refs, GLYPH_DEAD, __ATOMIC_ACQ_REL)
+#   define GLYPH_SET_REFERENCED(entry)      \
+        __atomic_store_n (&(entry)->referenced, 1, __ATOMIC_RELAXED)
+#else
+/* the shard is exclusively locked for all operations */
+#   define RDLOCK_SHARD(shard)      WRLOCK_SHARD (shard)
+#   define GLYPH_STATS_INC(shard, field)    (++(shard)->field)
+#   define GLYPH_REFS_LOAD(entry)           ((entry)->refs)
+#   define GLYPH_REFS_ADD(entry, n)         (((entry)->refs += (n)) - (n))
+#   define GLYPH_REFS_SUB(entry, n)         (((entry)->refs -= (n)) + (n))
+#   define GLYPH_REFS_KILL(entry)           \
+        (((entry)->refs |= GLYPH_DEAD) & ~GLYPH_DEAD)
+#   define GLYPH_SET_REFERENCED(entry)      ((entry)->referenced = 1)
+#endif
+
+static inline unsigned int hash_glyph_key (const GLYPHKEY* key)
+{
+    Uint64 h = (Uint64)(UINT_PTR)key->devfont;
+
+    h = (h ^ (Uint64)key->glyph) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ ((Uint64)key->style << 32 | (Uint32)key->size))
+            * 0xC2B2AE3D27D4EB4FULL;
+    h = (h ^ ((Uint64)key->flags << 32 | (Uint32)key->rotation))
+            * 0x165667B19E3779F9ULL;
+
+    return (unsigned int)(h >> 32);
+}
+
+static inline GLYPHSHARD* get_glyph_shard (unsigned int hash)
+{
+    return glyph_shards + (hash >> (32 - GLYPH_SHARD_BITS));
+}
+
+static inline BOOL equal_glyph_keys (const GLYPHKEY* a, const GLYPHKEY* b)
+{
+    return a->devfont == b->devfont && a->glyph == b->glyph &&
+        a->size == b->size && a->style == b->style &&
+        a->rotation == b->rotation && a->flags == b->flags;
+}
+
+static GLYPHENTRY* find_glyph_entry (GLYPHSHARD* shard,
+        const GLYPHKEY* key, unsigned int hash)
+{
+    GLYPHENTRY* entry = shard->buckets [hash & shard->bucket_mask];
+
+    while (entry) {
+        if (entry->hash == hash && equal_glyph_keys (&entry->key, key))
+            return entry;
+        entry = entry->hash_next;
+    }
+
+    return NULL;
+}
+
+/* remove an entry from the shard; the shard must be exclusively locked */
+static void remove_glyph_entry (GLYPHSHARD* shard, GLYPHENTRY* entry)
+{
+    GLYPHENTRY** pprev = shard->buckets + (entry->hash & shard->bucket_mask);
+
+    while (*pprev != entry)
+        pprev = &(*pprev)->hash_next;
+    *pprev = entry->hash_next;
+
+    if (shard->hand == &entry->clock)
+        shard->hand = entry->clock.next;
+    list_del (&entry->clock);
+    if (shard->hand == &shard->entries)
+        shard->hand = shard->entries.next;
+
+    shard->nr_bytes -= entry->nr_bytes;
+    shard->nr_glyphs--;
+
+    /* free it now, or let the last user free it */
+    if (GLYPH_REFS_KILL (entry) == 0)
+        free (entry);
+}
+
+/* evict unused glyphs in CLOCK order until nr_bytes more bytes fit */
+static BOOL evict_glyph_entries (GLYPHSHARD* shard, size_t nr_bytes)
+{
+    size_t nr_steps = shard->nr_glyphs * 2;
+
+    while (shard->nr_bytes + nr_bytes > shard->max_bytes && nr_steps > 0) {
+        GLYPHENTRY* entry;
+
+        if (shard->hand == &shard->entries)
+            shard->hand = shard->entries.next;
+        if (shard->hand == &shard->entries)
+            break;
+
+        entry = list_entry (shard->hand, GLYPHENTRY, clock);
+        shard->hand = entry->clock.next;
+        nr_steps--;
+
+        if (GLYPH_REFS_LOAD (entry))
+            continue;
+
+        if (entry->referenced) {
+            entry->referenced = 0;
+            continue;
+        }
+
+        remove_glyph_entry (shard, entry);
+        shard->nr_evictions++;
+    }
+
+    return shard->nr_bytes + nr_bytes <= shard->max_bytes;
+}
+
+BOOL font_InitGlyphCache (void)
+{
+    int i, kbytes;
+    unsigned int nr_buckets = MIN_SHARD_BUCKETS;
+    size_t max_bytes;
+
+    if (GetMgEtcIntValue ("glyphcache", "max_kbytes", &kbytes) < 0)
+        kbytes = DEF_GLYPH_CACHE_KBYTES;
+
+    if (kbytes <= 0) {
+        _DBG_PRINTF ("The glyph cache is disabled\n");
+        glyph_cache_enabled = FALSE;
+        return TRUE;
+    }
+
+    max_bytes = (size_t)kbytes * 1024 / NR_GLYPH_SHARDS;
+    while (nr_buckets * AVG_GLYPH_BYTES < max_bytes)
+        nr_buckets <<= 1;
+
+    for (i = 0; i < NR_GLYPH_SHARDS; i++) {
+        GLYPHSHARD* shard = glyph_shards + i;
+
+        memset (shard, 0, sizeof (GLYPHSHARD));
+        shard->buckets = calloc (nr_buckets, sizeof (GLYPHENTRY*));
+        if (shard->buckets == NULL) {
+            _WRN_PRINTF ("Failed to allocate the glyph cache\n");
+            while (--i >= 0) {
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+                pthread_rwlock_destroy (&glyph_shards [i].lock);
+#endif
+                free (glyph_shards [i].buckets);
+                glyph_shards [i].buckets = NULL;
+            }
+            return FALSE;
+        }
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+        pthread_rwlock_init (&shard->lock, NULL);
+#endif
+        shard->bucket_mask = nr_buckets - 1;
+        shard->max_bytes = max_bytes;
+        INIT_LIST_HEAD (&shard->entries);
+        shard->hand = &shard->entries;
+    }
+
+    glyph_cache_enabled = TRUE;
+    return TRUE;
+}
+
+void font_TermGlyphCache (void)
+{
+    int i;
+
+    if (!glyph_cache_enabled)
+        return;
+
+    font_InvalidateGlyphCache (NULL);
+    glyph_cache_enabled = FALSE;
+
+    for (i = 0; i < NR_GLYPH_SHARDS; i++) {
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+        pthread_rwlock_destroy (&glyph_shards [i].lock);
+#endif
+        free (glyph_shards [i].buckets);
+        glyph_shards [i].buckets = NULL;
+    }
+}
+
+const CACHEDGLYPH* font_LookupGlyph (const GLYPHKEY* key)
+{
+    unsigned int hash;
+    GLYPHSHARD* shard;
+    GLYPHENTRY* entry;
+
+    if (!glyph_cache_enabled)
+        return NULL;
+
+    hash = hash_glyph_key (key);
+    shard = get_glyph_shard (hash);
+
+    RDLOCK_SHARD (shard);
+    entry = find_glyph_entry (shard, key, hash);
+    if (entry) {
+        GLYPH_REFS_ADD (entry, 1);
+        GLYPH_SET_REFERENCED (entry);
+        GLYPH_STATS_INC (shard, nr_hits);
+    }
+    else {
+        GLYPH_STATS_INC (shard, nr_misses);
+    }
+    UNLOCK_SHARD (shard);
+
+    return (CACHEDGLYPH*)entry;
+}
+
+BOOL font_CacheGlyph (const GLYPHKEY* key, const SIZE* bbox,
+        int pitch, unsigned short scale, const BYTE* bits)
+{
+    unsigned int hash;
+    GLYPHSHARD* shard;
+    GLYPHENTRY* entry;
+    size_t sz_bits, nr_bytes;
+
+    if (!glyph_cache_enabled || bbox->cy <= 0 || pitch <= 0)
+        return FALSE;
+
+    sz_bits = (size_t)pitch * bbox->cy;
+    nr_bytes = sizeof (GLYPHENTRY) + sz_bits;
+    hash = hash_glyph_key (key);
+    shard = get_glyph_shard (hash);
+    if (nr_bytes > shard->max_bytes)
+        return FALSE;
+
+    /* copy the bits before taking the lock */
+    entry = malloc (nr_bytes);
+    if (entry == NULL)
+        return FALSE;
+
+    entry->glyph.bbox = *bbox;
+    entry->glyph.pitch = pitch;
+    entry->glyph.scale = scale;
+    entry->glyph.bits = (BYTE*)(entry + 1);
+    memcpy (entry + 1, bits, sz_bits);
+    entry->key = *key;
+    entry->hash = hash;
+    entry->refs = 0;
+    entry->referenced = 1;
+    entry->nr_bytes = nr_bytes;
+
+    WRLOCK_SHARD (shard);
+    /* another thread may have cached the glyph in the meantime */
+    if (find_glyph_entry (shard, key, hash) ||
+            !evict_glyph_entries (shard, nr_bytes)) {
+        UNLOCK_SHARD (shard);
+        free (entry);
+        return FALSE;
+    }
+
+    entry->hash_next = shard->buckets [hash & shard->bucket_mask];
+    shard->buckets [hash & shard->bucket_mask] = entry;
+    /* insert the new glyph just behind the hand; visited last */
+    if (shard->hand == &shard->entries)
+        list_add_tail (&entry->clock, &shard->entries);
+    else
+        list_add_tail (&entry->clock, shard->hand);
+    shard->nr_bytes += nr_bytes;
+    shard->nr_glyphs++;
+    UNLOCK_SHARD (shard);
+
+    return TRUE;
+}
+
+void font_ReleaseGlyph (const CACHEDGLYPH* glyph)
+{
+    GLYPHENTRY* entry = (GLYPHENTRY*)glyph;
+    unsigned int refs;
+
+#ifdef _MG_LOCKFREE_GLYPHCACHE
+    refs = GLYPH_REFS_SUB (entry, 1);
+#else
+    GLYPHSHARD* shard = get_glyph_shard (entry->hash);
+
+    WRLOCK_SHARD (shard);
+    refs = GLYPH_REFS_SUB (entry, 1);
+    UNLOCK_SHARD (shard);
+#endif
+
+    if (refs == (GLYPH_DEAD | 1))
+        free (entry);
+}
+
+void font_InvalidateGlyphCache (const DEVFONT* devfont)
+{
+    int i;
+
+    if (!glyph_cache_enabled)
+        return;
+
+    for (i = 0; i < NR_GLYPH_SHARDS; i++) {
+        GLYPHSHARD* shard = glyph_shards + i;
+        struct list_head *pos, *n;
+
+        WRLOCK_SHARD (shard);
+        list_for_each_safe (pos, n, &shard->entries) {
+            GLYPHENTRY* entry = list_entry (pos, GLYPHENTRY, clock);
+            if (devfont == NULL || entry->key.devfont == devfont)
+                remove_glyph_entry (shard, entry);
+        }
+        UNLOCK_SHARD (shard);
+    }
+}
+
+BOOL GUIAPI GetGlyphCacheStats (GLYPHCACHESTATS* stats)
+{
+    int i;
+
+    if (stats == NULL)
+        return FALSE;
+
+    memset (stats, 0, sizeof (GLYPHCACHESTATS));
+    if (!glyph_cache_enabled)
+        return TRUE;
+
+    for (i = 0; i < NR_GLYPH_SHARDS; i++) {
+        GLYPHSHARD* shard = glyph_shards + i;
+
+        RDLOCK_SHARD (shard);
+        stats->max_bytes += shard->max_bytes;
+        stats->nr_bytes += shard->nr_bytes;
+        stats->nr_glyphs += shard->nr_glyphs;
+        stats->nr_hits += shard->nr_hits;
+        stats->nr_misses += shard->nr_misses;
+        stats->nr_evictions += shard->nr_evictions;
+        UNLOCK_SHARD (shard);
+    }
+
+    return TRUE;
+}
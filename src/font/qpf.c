@@ -60,10 +60,6 @@
 
 #ifdef _MGFONT_QPF
 
-#ifdef HAVE_MMAP
-    #include <sys/mman.h>
-#endif
-
 #include "devfont.h"
 #include "charset.h"
 #include "qpf.h"
@@ -72,108 +68,178 @@
 #define QPFONT_INFO_P(devfont) ((QPFINFO*)(devfont->data))
 #define QPFONT_INFO(devfont) ((QPFINFO*)(devfont.data))
 
-/*load qpf from file, only support for linux*/
+/* the identifier and the version of the QPF glyph index: "QPF1" */
+#define QPF_INDEX_ENGINE    0x31465051
+
+#define QPF_NODE_SIZE       5
+
 typedef unsigned char uchar;
 
-static void read_node (QPF_GLYPHTREE* tree, uchar** data)
+/*
+ * The nodes of the glyph tree are stored in pre-order in a QPF file,
+ * followed by the metrics of all glyphs and the bitmaps of all glyphs in
+ * the same order. So the tree can be flattened to the sorted ranges and
+ * the glyph numbers in one pass, without building the tree.
+ */
+static int cmp_range (const void* a, const void* b)
 {
-    uchar rw, cl;
-    int flags, n;
+    const QPF_RANGE* ra = (const QPF_RANGE*)a;
+    const QPF_RANGE* rb = (const QPF_RANGE*)b;
 
-    rw = **data; (*data)++;
-    cl = **data; (*data)++;
-    tree->min = (rw << 8) | cl;
+    if (ra->min < rb->min)
+        return -1;
+    return (ra->min > rb->min) ? 1 : 0;
+}
 
-    rw = **data; (*data)++;
-    cl = **data; (*data)++;
-    tree->max = (rw << 8) | cl;
+static size_t build_qpf_index (const FONTFILEMAP* font, void* buff,
+        size_t size)
+{
+    const uchar* data = (const uchar*)font->data;
+    size_t off = sizeof (QPFMETRICS);
+    Uint32 nr_pending = 1, nr_ranges = 0, nr_glyphs = 0, i;
+    QPF_INDEX* index = (QPF_INDEX*)buff;
+    QPF_RANGE* ranges = NULL;
+    Uint32* data_offsets;
+
+    if (index)
+        ranges = (QPF_RANGE*)(index + 1);
+
+    while (nr_pending > 0) {
+        Uint32 min, max;
+        int flags;
+
+        if (off + QPF_NODE_SIZE > font->size)
+            return 0;
+
+        min = (data [off] << 8) | data [off + 1];
+        max = (data [off + 2] << 8) | data [off + 3];
+        flags = data [off + 4];
+        off += QPF_NODE_SIZE;
+        if (max < min)
+            return 0;
+
+        if (ranges) {
+            ranges [nr_ranges].min = min;
+            ranges [nr_ranges].max = max;
+            ranges [nr_ranges].first = nr_glyphs;
+        }
 
-    flags = **data; (*data)++;
-    if (flags & 1)
-        tree->less = calloc (1, sizeof (QPF_GLYPHTREE));
-    else
-        tree->less = NULL;
+        nr_ranges++;
+        nr_glyphs += max - min + 1;
+        nr_pending += ((flags & 1) ? 1 : 0) + ((flags & 2) ? 1 : 0) - 1;
+    }
 
-    if (flags & 2)
-        tree->more = calloc (1, sizeof (QPF_GLYPHTREE));
-    else
-        tree->more = NULL;
+    if (off + (size_t)nr_glyphs * sizeof (QPF_GLYPHMETRICS) > font->size)
+        return 0;
 
-    n = tree->max - tree->min + 1;
-    tree->glyph = calloc (n, sizeof (QPF_GLYPH));
+    if (index == NULL)
+        return sizeof (QPF_INDEX) + sizeof (QPF_RANGE) * nr_ranges +
+            sizeof (Uint32) * nr_glyphs;
 
-    if (tree->less)
-        read_node (tree->less, data);
-    if (tree->more)
-        read_node (tree->more, data);
-}
+    index->nr_ranges = nr_ranges;
+    index->nr_glyphs = nr_glyphs;
+    index->metrics_offset = off;
 
-static void read_metrics (QPF_GLYPHTREE* tree, uchar** data)
-{
-    int i;
-    int n = tree->max - tree->min + 1;
+    qsort (ranges, nr_ranges, sizeof (QPF_RANGE), cmp_range);
+    for (i = 1; i < nr_ranges; i++) {
+        if (ranges [i].min <= ranges [i - 1].max)
+            return 0;
+    }
 
-    for (i = 0; i < n; i++) {
-        tree->glyph[i].metrics = (QPF_GLYPHMETRICS*) *data;
+    data_offsets = (Uint32*)(ranges + nr_ranges);
+    off += (size_t)nr_glyphs * sizeof (QPF_GLYPHMETRICS);
+    for (i = 0; i < nr_glyphs; i++) {
+        const QPF_GLYPHMETRICS* metrics = (const QPF_GLYPHMETRICS*)
+            (data + index->metrics_offset + i * sizeof (QPF_GLYPHMETRICS));
 
-        *data += sizeof (QPF_GLYPHMETRICS);
+        data_offsets [i] = off;
+        off += metrics->linestep * metrics->height;
+        if (off > font->size)
+            return 0;
     }
 
-    if (tree->less)
-        read_metrics (tree->less, data);
-    if (tree->more)
-        read_metrics (tree->more, data);
+    return size;
 }
 
-static void read_data (QPF_GLYPHTREE* tree, uchar** data)
+/*
+ * The index may come from a stale or corrupted sidecar; check that every
+ * range, metrics, and bitmap it refers to lies in the font file, since
+ * get_glyph() uses it without checks.
+ */
+static BOOL check_qpf_index (const FONTFILEMAP* font,
+        const FONTFILEMAP* index_map)
 {
-    int i;
-    int n = tree->max - tree->min + 1;
+    const uchar* data = (const uchar*)font->data;
+    const QPF_INDEX* index;
+    const QPF_RANGE* ranges;
+    const Uint32* data_offsets;
+    Uint64 size;
+    Uint32 i;
+
+    if (index_map->size < sizeof (FONTINDEXHEADER) + sizeof (QPF_INDEX))
+        return FALSE;
+
+    index = (const QPF_INDEX*)FONT_INDEX_DATA (index_map);
+    size = sizeof (FONTINDEXHEADER) + sizeof (QPF_INDEX) +
+            sizeof (QPF_RANGE) * (Uint64)index->nr_ranges +
+            sizeof (Uint32) * (Uint64)index->nr_glyphs;
+    if (size != index_map->size)
+        return FALSE;
+
+    if (index->metrics_offset < sizeof (QPFMETRICS) ||
+            index->metrics_offset + sizeof (QPF_GLYPHMETRICS) *
+            (Uint64)index->nr_glyphs > font->size)
+        return FALSE;
+
+    ranges = (const QPF_RANGE*)(index + 1);
+    for (i = 0; i < index->nr_ranges; i++) {
+        if (ranges [i].max < ranges [i].min ||
+                (Uint64)ranges [i].first + ranges [i].max - ranges [i].min >=
+                index->nr_glyphs)
+            return FALSE;
+        if (i > 0 && ranges [i].min <= ranges [i - 1].max)
+            return FALSE;
+    }
 
-    for (i = 0; i < n; i++) {
-        int datasize;
+    data_offsets = (const Uint32*)(ranges + index->nr_ranges);
+    for (i = 0; i < index->nr_glyphs; i++) {
+        const QPF_GLYPHMETRICS* metrics = (const QPF_GLYPHMETRICS*)
+            (data + index->metrics_offset + i * sizeof (QPF_GLYPHMETRICS));
 
-        datasize = tree->glyph[i].metrics->linestep *
-                tree->glyph[i].metrics->height;
-        tree->glyph[i].data = *data; *data += datasize;
+        if ((Uint64)data_offsets [i] +
+                metrics->linestep * metrics->height > font->size)
+            return FALSE;
     }
 
-    if (tree->less)
-        read_data (tree->less, data);
-    if (tree->more)
-        read_data (tree->more, data);
+    return TRUE;
 }
 
-
-static void build_glyph_tree (QPF_GLYPHTREE* tree, uchar** data)
+static BOOL map_qpf_index (QPFINFO* qpf_info, const char* file_name)
 {
-    read_node (tree, data);
-    read_metrics (tree, data);
-    read_data (tree, data);
-}
+    const QPF_INDEX* index;
 
-static void clear_glyph_tree (QPF_GLYPHTREE* tree)
-{
-    if (tree->less) {
-        clear_glyph_tree (tree->less);
-    }
-    if (tree->more) {
-        clear_glyph_tree (tree->more);
-    }
+    if (!font_MapFontIndex (file_name, &qpf_info->font_map, QPF_INDEX_ENGINE,
+                build_qpf_index, check_qpf_index, &qpf_info->index_map))
+        return FALSE;
 
-    free (tree->glyph);
-    free (tree->less);
-    free (tree->more);
+    index = (const QPF_INDEX*)FONT_INDEX_DATA (&qpf_info->index_map);
+
+    qpf_info->nr_ranges = index->nr_ranges;
+    qpf_info->ranges = (const QPF_RANGE*)(index + 1);
+    qpf_info->data_offsets =
+        (const Uint32*)(qpf_info->ranges + index->nr_ranges);
+    qpf_info->metrics_offset = index->metrics_offset;
+    return TRUE;
 }
 
 static void* load_font_data (DEVFONT* devfont, const char* font_name, const char* file_name)
 {
     FILE* fp = NULL;
-    uchar* data;
-    long file_size;
     QPFINFO* qpf_info = NULL;
 
     qpf_info = (QPFINFO*) calloc (1, sizeof(QPFINFO));
+    if (qpf_info == NULL)
+        return NULL;
 
     if (!(fp = fopen (file_name, "rb"))) {
         _WRN_PRINTF ("FONT>QPF: open file error: %s.\n",
@@ -181,15 +247,6 @@ static void* load_font_data (DEVFONT* devfont, const char* font_name, const char
         goto error;
     }
 
-    file_size = get_opened_file_size (fp);
-    if (file_size == 0) {
-        _WRN_PRINTF ("FONT>QPF: empty font file: %s.\n",
-                file_name);
-        goto error;
-    }
-
-    qpf_info->file_size = file_size;
-
     if ((qpf_info->height
                 = fontGetHeightFromName (font_name)) == -1) {
         _WRN_PRINTF ("FONT>QPF: Invalid font name (height): %s.\n",
@@ -204,32 +261,32 @@ static void* load_font_data (DEVFONT* devfont, const char* font_name, const char
         goto error;
     }
 
-#ifdef HAVE_MMAP
-    qpf_info->fm = (QPFMETRICS*) mmap (0, file_size,
-            PROT_READ, MAP_SHARED, fileno(fp), 0);
-
-    if (!qpf_info->fm || qpf_info->fm == (QPFMETRICS *)MAP_FAILED)
-        goto error;
-#else
-    qpf_info->fm = calloc (1, file_size);
-    if (qpf_info->fm == NULL)
+    /* map the font file read-only to share the pages between processes */
+    if (!font_MapFontFile (fp, &qpf_info->font_map) ||
+            qpf_info->font_map.size <= sizeof (QPFMETRICS)) {
+        _WRN_PRINTF ("FONT>QPF: empty font file: %s.\n",
+                file_name);
         goto error;
+    }
 
-    fread (qpf_info->fm, sizeof(char), file_size, fp);
-#endif
+    fclose (fp);
+    fp = NULL;
 
-    qpf_info->tree = calloc (1, sizeof (QPF_GLYPHTREE));
+    qpf_info->file_size = qpf_info->font_map.size;
+    qpf_info->fm = (QPFMETRICS*)qpf_info->font_map.data;
 
-    data = (uchar*)qpf_info->fm;
-    data += sizeof (QPFMETRICS);
-    build_glyph_tree (qpf_info->tree, &data);
-    fclose (fp);
+    if (!map_qpf_index (qpf_info, file_name)) {
+        _WRN_PRINTF ("FONT>QPF: bad glyph tree: %s.\n",
+                file_name);
+        goto error;
+    }
 
     return qpf_info;
 
 error:
     if (fp)
         fclose (fp);
+    font_UnmapFontFile (&qpf_info->font_map);
     free (qpf_info);
     return NULL;
 }
@@ -241,37 +298,38 @@ static void unload_font_data (DEVFONT* devfont, void* data)
     if (qpf_info->file_size == 0)
         return;
 
-    clear_glyph_tree (qpf_info->tree);
-    free (qpf_info->tree);
-
-#ifdef HAVE_MMAP
-    munmap (qpf_info->fm, qpf_info->file_size);
-#else
-    free (qpf_info->fm);
-#endif
-
+    font_UnmapFontIndex (&qpf_info->index_map);
+    font_UnmapFontFile (&qpf_info->font_map);
     free (qpf_info);
 }
 
 
 /*************** QPF font operations *********************************/
-static QPF_GLYPH* get_glyph (QPF_GLYPHTREE* tree, unsigned int ch)
+static QPF_GLYPH* get_glyph (const QPFINFO* qpf_info, unsigned int ch,
+        QPF_GLYPH* glyph)
 {
-    if (ch < tree->min) {
+    const QPF_RANGE* ranges = qpf_info->ranges;
+    const uchar* data = (const uchar*)qpf_info->fm;
+    int low = 0, high = (int)qpf_info->nr_ranges - 1;
 
-        if (!tree->less)
-            return NULL;
+    while (low <= high) {
+        int mid = (low + high) >> 1;
 
-        return get_glyph (tree->less, ch);
-    } else if ( ch > tree->max ) {
+        if (ch < ranges [mid].min)
+            high = mid - 1;
+        else if (ch > ranges [mid].max)
+            low = mid + 1;
+        else {
+            Uint32 nr = ranges [mid].first + ch - ranges [mid].min;
 
-        if (!tree->more) {
-            return NULL;
+            glyph->metrics = (const QPF_GLYPHMETRICS*)(data +
+                    qpf_info->metrics_offset + nr * sizeof (QPF_GLYPHMETRICS));
+            glyph->data = data + qpf_info->data_offsets [nr];
+            return glyph;
         }
-        return get_glyph (tree->more, ch);
     }
 
-    return &tree->glyph [ch - tree->min];
+    return NULL;
 }
 
 static QPF_GLYPHMETRICS def_metrics = {1, 8, 2, 0, 0, 8, 0};
@@ -357,6 +415,7 @@ static const void* get_glyph_monobitmap (LOGFONT* logfont, DEVFONT* devfont,
 {
     unsigned int uc16;
     QPF_GLYPH* glyph;
+    QPF_GLYPH buff;
 
     glyph_value = REAL_GLYPH(glyph_value);
     if (devfont->charset_ops->conv_to_uc32)
@@ -364,7 +423,7 @@ static const void* get_glyph_monobitmap (LOGFONT* logfont, DEVFONT* devfont,
     else
         uc16 = glyph_value;
 
-    glyph = get_glyph (QPFONT_INFO_P (devfont)->tree, uc16);
+    glyph = get_glyph (QPFONT_INFO_P (devfont), uc16, &buff);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont) {   /* ASCII */
@@ -394,6 +453,7 @@ static const void* get_glyph_greybitmap (LOGFONT* logfont, DEVFONT* devfont,
 {
     unsigned int uc16;
     QPF_GLYPH* glyph;
+    QPF_GLYPH buff;
 
     glyph_value = REAL_GLYPH(glyph_value);
     if (scale)
@@ -408,7 +468,7 @@ static const void* get_glyph_greybitmap (LOGFONT* logfont, DEVFONT* devfont,
     else
         uc16 = glyph_value;
 
-    glyph = get_glyph (QPFONT_INFO_P (devfont)->tree, uc16);
+    glyph = get_glyph (QPFONT_INFO_P (devfont), uc16, &buff);
 
     if (glyph == NULL) {
         glyph = &def_smooth_glyph;
@@ -424,6 +484,7 @@ static int get_glyph_bbox (LOGFONT* logfont, DEVFONT* devfont,
 {
     unsigned int uc16;
     QPF_GLYPH* glyph;
+    QPF_GLYPH buff;
     unsigned short scale = GET_DEVFONT_SCALE (logfont, devfont);
 
     glyph_value = REAL_GLYPH(glyph_value);
@@ -432,7 +493,7 @@ static int get_glyph_bbox (LOGFONT* logfont, DEVFONT* devfont,
     else
         uc16 = glyph_value;
 
-    glyph = get_glyph (QPFONT_INFO_P (devfont)->tree, uc16);
+    glyph = get_glyph (QPFONT_INFO_P (devfont), uc16, &buff);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont) {   /* ASCII */
@@ -477,6 +538,7 @@ static int get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
 {
     unsigned int uc16;
     QPF_GLYPH* glyph;
+    QPF_GLYPH buff;
     int advance;
 
     glyph_value = REAL_GLYPH(glyph_value);
@@ -485,7 +547,7 @@ static int get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
     else
         uc16 = glyph_value;
 
-    glyph = get_glyph (QPFONT_INFO_P (devfont)->tree, uc16);
+    glyph = get_glyph (QPFONT_INFO_P (devfont), uc16, &buff);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont) {   /* ASCII */
@@ -526,6 +588,7 @@ static BOOL is_glyph_existed (LOGFONT* logfont, DEVFONT* devfont, Glyph32 glyph_
 {
     unsigned int uc16;
     QPF_GLYPH* glyph;
+    QPF_GLYPH buff;
 
     glyph_value = REAL_GLYPH(glyph_value);
     if(devfont->charset_ops->conv_to_uc32)
@@ -533,7 +596,7 @@ static BOOL is_glyph_existed (LOGFONT* logfont, DEVFONT* devfont, Glyph32 glyph_
     else
         uc16 = glyph_value;
 
-    glyph = get_glyph (QPFONT_INFO_P (devfont)->tree, uc16);
+    glyph = get_glyph (QPFONT_INFO_P (devfont), uc16, &buff);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont)   /* ASCII */
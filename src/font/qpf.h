@@ -52,6 +52,8 @@
 #ifndef GUI_FONT_QPF_H
     #define GUI_FONT_QPF_H
 
+#include "fontfile.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif  /* __cplusplus */
@@ -77,17 +79,26 @@ typedef struct _QPF_GLYPH
     const unsigned char* data;
 } QPF_GLYPH;
 
-typedef struct _QPF_GLYPHTREE
+/* A range of characters in the glyph index; sorted by min. */
+typedef struct _QPF_RANGE
 {
-    unsigned int min, max;
-    struct _QPF_GLYPHTREE* less;
-    struct _QPF_GLYPHTREE* more;
-    QPF_GLYPH* glyph;
-#ifdef _MGINCORE_RES
-    const QPF_GLYPHMETRICS* metrics;
-    const unsigned char* data;
-#endif
-} QPF_GLYPHTREE;
+    Uint32 min, max;
+    /* the index of the first glyph of the range */
+    Uint32 first;
+} QPF_RANGE;
+
+/*
+ * The glyph index built from the glyph tree of a QPF file; it is followed by
+ * the ranges and the offsets of the glyph bitmaps in the file.
+ */
+typedef struct _QPF_INDEX
+{
+    Uint32 nr_ranges;
+    Uint32 nr_glyphs;
+    /* the offset of the metrics of the first glyph in the file */
+    Uint32 metrics_offset;
+    Uint32 reserved;
+} QPF_INDEX;
 
 #ifdef __GNUC__
 typedef struct __attribute__ ((packed)) _QPFMETRICS
@@ -122,7 +133,14 @@ typedef struct
     unsigned int file_size;
     QPFMETRICS* fm;
 
-    QPF_GLYPHTREE* tree;
+    /* the mapped font file and the mapped glyph index */
+    FONTFILEMAP font_map;
+    FONTFILEMAP index_map;
+
+    Uint32 nr_ranges;
+    const QPF_RANGE* ranges;
+    const Uint32* data_offsets;
+    Uint32 metrics_offset;
 } QPFINFO;
 
 #ifdef __cplusplus
@@ -60,18 +60,13 @@
 #include "gdi.h"
 #include "misc.h"
 
-#undef HAVE_MMAP
-#ifdef HAVE_MMAP
-#error
-    #include <sys/mman.h>
-#endif
-
 #ifdef _MGFONT_RBF
 
 #include "devfont.h"
 #include "charset.h"
 #include "rawbitmap.h"
 #include "fontname.h"
+#include "fontfile.h"
 
 #define RBFONT_INFO_P(devfont) ((RBFINFO*)(devfont->data))
 #define RBFONT_INFO(devfont) ((RBFINFO*)(devfont.data))
@@ -81,7 +76,7 @@ static void* load_font_data (DEVFONT* devfont, const char* font_name, const char
 {
     FILE* fp = NULL;
     RBFINFO* rbf_info = calloc (1, sizeof(RBFINFO));
-    long data_size;
+    FONTFILEMAP map;
 
     if (!rbf_info)
         return NULL;
@@ -95,36 +90,17 @@ static void* load_font_data (DEVFONT* devfont, const char* font_name, const char
     if (!(fp = fopen (file_name, "rb")))
         goto error_load;
 
-    data_size = get_opened_file_size (fp);
-    rbf_info->data_size = data_size;
-
-    if (rbf_info->data_size <= 0)
+    /* map the font file read-only to share the pages between processes */
+    if (!font_MapFontFile (fp, &map))
         goto error_load;
+    fclose (fp);
 
+    rbf_info->data = map.data;
+    rbf_info->data_size = map.size;
+    rbf_info->mapped = map.mapped;
     rbf_info->nr_glyphs = rbf_info->data_size /
         (((rbf_info->width+7)>>3) * (rbf_info->height));
 
-#ifdef HAVE_MMAP
-    if ((rbf_info->data = mmap (NULL, rbf_info->data_size, PROT_READ, MAP_SHARED, fileno(fp), 0)) == MAP_FAILED) {
-        goto error_load;
-    }
-#else
-    // Allocate memory for font data.
-    if (!(rbf_info->data = (unsigned char*) malloc (data_size)))
-        goto error_load;
-
-    if (fread (rbf_info->data, sizeof(char), data_size, fp) < data_size) {
-        free (rbf_info->data);
-        goto error_load;
-    }
-#endif  /* HAVE_MMAP */
-    fclose (fp);
-
-#if 0
-    if (real_font_name)
-        strcpy (real_font_name, font_name);
-#endif
-
     return rbf_info;
 
 error_load:
@@ -140,12 +116,12 @@ error_load:
 static void unload_font_data (DEVFONT* devfont, void* data)
 {
     RBFINFO* rbfinfo = (RBFINFO*)data;
-#ifdef HAVE_MMAP
-    if (rbfinfo->data)
-        munmap (rbfinfo->data, rbfinfo->data_size);
-#else
-    free (rbfinfo->data);
-#endif
+    FONTFILEMAP map;
+
+    map.data = rbfinfo->data;
+    map.size = rbfinfo->data_size;
+    map.mapped = rbfinfo->mapped;
+    font_UnmapFontFile (&map);
     free (rbfinfo);
 }
 
@@ -66,6 +66,9 @@ typedef struct
 
     unsigned char* data;
     long data_size;
+
+    /* TRUE if the data are mapped from the font file */
+    BOOL mapped;
 } RBFINFO;
 
 typedef struct
@@ -0,0 +1,157 @@
+/*
+** upf-bench.c: benchmark for rendering CJK text with a UPF font.
+**
+** Usage: upf-bench <upf-file> [devfont-name]
+**
+** This program renders a paragraph of 10000 CJK characters with the given
+** UPF font, and reports the time to render the paragraph. Then it looks up
+** the glyphs four times per character, as the rendering does, both by the
+** range index of the engine and by walking the node tree of the font file
+** as the engine did before the range index was introduced; it reports the
+** time of both lookups, and checks that they find the same glyphs.
+**
+** The lookups are the internal functions of the UPF engine, declared in
+** src/font/upf.h.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#include "../../upf.h"
+
+#define NR_CHARS            10000
+#define NR_CHARS_PER_LINE   40
+#define NR_ROUNDS           20
+
+typedef UPFGLYPH* (*CB_FIND_GLYPH) (UPFINFO* upf_info, unsigned int ch);
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static Uint32 make_paragraph (Uint32* ucs, char* utf8)
+{
+    Uint32 seed = 20080126, i;
+    char* p = utf8;
+
+    for (i = 0; i < NR_CHARS; i++) {
+        seed = seed * 1103515245 + 12345;
+        /* the frequent ideographs are at the start of the block */
+        ucs [i] = 0x4E00 + ((seed >> 8) % 0x5000) * ((seed >> 4) % 4 + 1) / 4;
+        *p++ = 0xE0 | (ucs [i] >> 12);
+        *p++ = 0x80 | ((ucs [i] >> 6) & 0x3F);
+        *p++ = 0x80 | (ucs [i] & 0x3F);
+    }
+
+    return p - utf8;
+}
+
+static void bench_lookup (const char* desc, CB_FIND_GLYPH find,
+        UPFINFO* upf_info, const Uint32* ucs, UPFGLYPH** glyphs)
+{
+    int i, n, found = 0;
+    double t;
+
+    t = now_ms ();
+    for (n = 0; n < NR_ROUNDS; n++) {
+        for (i = 0; i < NR_CHARS * 4; i++) {
+            if ((glyphs [i / 4] = find (upf_info, ucs [i / 4])))
+                found++;
+        }
+    }
+    t = (now_ms () - t) / NR_ROUNDS;
+
+    printf ("%-30s %8.3f ms per paragraph (%d found)\n",
+            desc, t, found / NR_ROUNDS);
+}
+
+/* returns the number of the characters whose glyphs differ */
+static int bench_lookups (DEVFONT* devfont, const Uint32* ucs)
+{
+    static UPFGLYPH* by_index [NR_CHARS];
+    static UPFGLYPH* by_tree [NR_CHARS];
+    UPFINFO* upf_info = (UPFINFO*)devfont->data;
+    const UPFV1_FILE_HEADER* header = upf_info->root_dir;
+    int i, nr_diffs = 0;
+
+    printf ("%s: %u glyphs in %u zones\n", header->font_name,
+            (unsigned)header->nr_glyph, (unsigned)header->nr_zones);
+
+    /* the first lookup builds the index */
+    font_FindUPFGlyph (upf_info, ucs [0]);
+
+    bench_lookup ("index lookups (4 per char):",
+            font_FindUPFGlyph, upf_info, ucs, by_index);
+    bench_lookup ("tree walks (4 per char):",
+            font_WalkUPFNodeTree, upf_info, ucs, by_tree);
+
+    for (i = 0; i < NR_CHARS; i++) {
+        if (by_index [i] != by_tree [i])
+            nr_diffs++;
+    }
+
+    if (nr_diffs)
+        printf ("FAILED: %d characters found different glyphs\n", nr_diffs);
+    return nr_diffs;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    const char* name = "upf-bench-rrncnn-16-16-UTF-8";
+    static Uint32 ucs [NR_CHARS];
+    static char utf8 [NR_CHARS * 3];
+    DEVFONT* devfont;
+    PLOGFONT logfont;
+    HDC hdc;
+    int len, i, n, nr_diffs;
+    double t;
+
+    if (argc < 2) {
+        fprintf (stderr, "Usage: %s <upf-file> [devfont-name]\n", argv [0]);
+        return 1;
+    }
+
+    if (argc > 2)
+        name = argv [2];
+
+    devfont = LoadDevFontFromFile (name, argv [1]);
+    if (devfont == NULL) {
+        fprintf (stderr, "Failed to load the UPF font: %s\n", argv [1]);
+        return 1;
+    }
+
+    logfont = CreateLogFontByName ("upf-bench-rrncnn-*-16-UTF-8");
+    hdc = CreateMemDC (NR_CHARS_PER_LINE * 16, 16, 32,
+            MEMDC_FLAG_SWSURFACE, 0, 0, 0, 0);
+    SelectFont (hdc, logfont);
+
+    len = make_paragraph (ucs, utf8);
+
+    t = now_ms ();
+    for (n = 0; n < NR_ROUNDS; n++) {
+        for (i = 0; i < len; i += NR_CHARS_PER_LINE * 3) {
+            TextOutLen (hdc, 0, 0, utf8 + i,
+                    MIN (NR_CHARS_PER_LINE * 3, len - i));
+        }
+    }
+    t = (now_ms () - t) / NR_ROUNDS;
+    printf ("rendering %d characters:     %8.3f ms per paragraph\n",
+            NR_CHARS, t);
+
+    nr_diffs = bench_lookups (devfont, ucs);
+
+    DeleteMemDC (hdc);
+    DestroyLogFont (logfont);
+    DestroyDynamicDevFont (&devfont);
+    return nr_diffs ? 1 : 0;
+}
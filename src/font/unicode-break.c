@@ -48,6 +48,7 @@
 ** unicode-break.c: The implementation of the following APIs:
 **
 **      UStrGetBreaks
+**      UStrUpdateBreaks
 **
 ** Reference:
 **
@@ -3005,6 +3006,114 @@ error:
     return 0;
 }
 
+static inline BOOL is_hard_break(const Uint16* bos, int idx)
+{
+    return (bos[idx] & BOV_LB_MASK) == BOV_LB_MANDATORY;
+}
+
+/*
+ * All rules of the line, grapheme, word, and sentence breaking start over
+ * after a hard line break, so the breaks between two hard breaks depend on
+ * the characters between them only. However, some flags of the break after
+ * a character are set when the next character is checked, so the context
+ * includes the character after the hard break at its end.
+ */
+int GUIAPI UStrUpdateBreaks(LanguageCode lang_code,
+            Uint8 ctr, Uint8 wbr, Uint8 lbp,
+            Uchar32* ucs, int nr_ucs,
+            int* start_index, int* nr_del_ucs, int* nr_ins_ucs,
+            Uint16** break_oppos)
+{
+    Uint16 *bos, *ctx_bos = NULL;
+    int start, nr_del, nr_ins, old_nr_ucs, delta;
+    int ctx_start, ctx_end, nr_ctx_ucs, nr_calc_ucs, first, last, i;
+
+    if (ucs == NULL || nr_ucs <= 0 || break_oppos == NULL ||
+            *break_oppos == NULL || start_index == NULL ||
+            nr_del_ucs == NULL || nr_ins_ucs == NULL)
+        return 0;
+
+    start = *start_index;
+    nr_del = *nr_del_ucs;
+    nr_ins = *nr_ins_ucs;
+    delta = nr_ins - nr_del;
+    old_nr_ucs = nr_ucs - delta;
+    if (start < 0 || nr_del < 0 || nr_ins < 0 ||
+            start + nr_del > old_nr_ucs)
+        return 0;
+
+    bos = *break_oppos;
+
+    /* The context starts after the last hard break before the edit;
+       the break after a CR changes if a LF is inserted after it, and
+       the one at the end of the text is not a hard break. */
+    for (ctx_start = start; ctx_start > 0; ctx_start--) {
+        if (ctx_start < old_nr_ucs && is_hard_break(bos, ctx_start) &&
+                (ctx_start < start || ucs[ctx_start - 1] != 0x000D))
+            break;
+    }
+
+    /* and ends at the first hard break after the edit, in the old text */
+    for (ctx_end = start + nr_del + 1; ctx_end < old_nr_ucs; ctx_end++) {
+        if (is_hard_break(bos, ctx_end))
+            break;
+    }
+    if (ctx_end > old_nr_ucs)
+        ctx_end = old_nr_ucs;
+
+    nr_ctx_ucs = ctx_end + delta - ctx_start;
+    nr_calc_ucs = nr_ctx_ucs;
+    if (ctx_end < old_nr_ucs)
+        nr_calc_ucs++;
+    if (nr_calc_ucs > 0 && UStrGetBreaks(lang_code, ctr, wbr, lbp,
+                ucs + ctx_start, nr_calc_ucs, &ctx_bos) == 0)
+        return 0;
+
+    if (delta > 0) {
+        bos = (Uint16*)realloc(bos, sizeof(Uint16) * (nr_ucs + 1));
+        if (bos == NULL) {
+            free(ctx_bos);
+            return 0;
+        }
+        *break_oppos = bos;
+    }
+
+    /* move the breaks after the edit */
+    memmove(bos + start + nr_ins + 1, bos + start + nr_del + 1,
+            sizeof(Uint16) * (old_nr_ucs - start - nr_del));
+
+    /* The break before the first character of the context is a hard one
+       or the start of the text; the latter is the same in the context.
+       The start of the first sentence in the context is marked on it. */
+    first = start;
+    last = start + nr_ins;
+    if (ctx_start > 0 && nr_ctx_ucs > 0 &&
+            ((bos[ctx_start] ^ ctx_bos[0]) & BOV_SB_SENTENCE_START)) {
+        bos[ctx_start] ^= BOV_SB_SENTENCE_START;
+        if (ctx_start < first)
+            first = ctx_start;
+    }
+    for (i = (ctx_start > 0) ? 1 : 0; i <= nr_ctx_ucs; i++) {
+        int idx = ctx_start + i;
+
+        if (idx > 0 && (bos[idx] != ctx_bos[i] ||
+                    (idx > start && idx <= start + nr_ins))) {
+            if (idx - 1 < first)
+                first = idx - 1;
+            if (idx > last)
+                last = idx;
+        }
+        bos[idx] = ctx_bos[i];
+    }
+    free(ctx_bos);
+
+    /* widen the edit to cover the characters whose breaks changed */
+    *start_index = first;
+    *nr_del_ucs = nr_del + (start - first) + (last - start - nr_ins);
+    *nr_ins_ucs = last - first;
+    return nr_ucs + 1;
+}
+
 void GUIAPI UStrTailorBreaks(ScriptType writing_system,
         const Uchar32* ucs, int nr_ucs, BreakOppo* break_oppos)
 {
@@ -70,6 +70,12 @@
 #include "fontname.h"
 
 #define UPFONT_INFO_P(devfont) ((UPFINFO*)(devfont->data))
+
+/* the index of a font whose node tree is malformed; use the tree instead */
+static UPFINDEX no_index;
+
+static UPFINDEX* build_index (const UPFINFO* upf_info);
+
 static void* load_font_data (DEVFONT* devfont, const char* font_name, const char* file_name)
 {
     FILE* fp = NULL;
@@ -128,6 +134,7 @@ static void* load_font_data (DEVFONT* devfont, const char* font_name, const char
     }
 
     fclose (fp);
+    upf_info->index = build_index (upf_info);
     return upf_info;
 
 error:
@@ -137,8 +144,17 @@ error:
     return NULL;
 }
 
+void font_FreeUPFIndex (UPFINFO* upf_info)
+{
+    if (upf_info->index != &no_index)
+        free (upf_info->index);
+    upf_info->index = NULL;
+}
+
 static void unload_font_data (DEVFONT* devfont, void* data)
 {
+    font_FreeUPFIndex ((UPFINFO*) data);
+
 #ifdef HAVE_MMAP
     munmap (((UPFINFO*) data)->root_dir, ((UPFINFO*) data)->file_size);
 #else
@@ -251,6 +267,177 @@ static UPFGLYPH* get_glyph (Uint8 *upf_root, UPFNODE * tree, unsigned int ch)
     return (UPFGLYPH*)(upf_root + tree->glyph_offset + sizeof (UPFGLYPH) * (ch - tree->min));
 }
 
+/*
+ * Flattens the node tree into the sorted ranges. The in-order traversal of
+ * the tree visits the nodes in order of the code points; the tree is
+ * treated as malformed if it does not.
+ */
+static UPFINDEX* build_index (const UPFINFO* upf_info)
+{
+    const Uint8* upf_root = upf_info->root_dir;
+    const UPFV1_FILE_HEADER* filehead = (const UPFV1_FILE_HEADER*)upf_root;
+    Uint32 max_nodes, nr_ranges = 0, top = 0, off, page;
+    Uint32* stack = NULL;
+    UPFINDEX* index = NULL;
+
+    if (filehead->off_nodes == 0 ||
+            filehead->off_nodes > upf_info->file_size - sizeof (UPFNODE))
+        goto malformed;
+
+    max_nodes = (upf_info->file_size - filehead->off_nodes) / sizeof (UPFNODE);
+    if (filehead->len_nodes / sizeof (UPFNODE) < max_nodes)
+        max_nodes = filehead->len_nodes / sizeof (UPFNODE);
+    if (max_nodes == 0)
+        goto malformed;
+
+    stack = malloc (sizeof (Uint32) * max_nodes);
+    index = malloc (sizeof (UPFINDEX) + sizeof (UPFRANGE) * max_nodes);
+    if (stack == NULL || index == NULL)
+        goto error;
+    index->ranges = (UPFRANGE*)(index + 1);
+
+    off = filehead->off_nodes;
+    while (off || top > 0) {
+        const UPFNODE* node;
+
+        if (off) {
+            if (off > upf_info->file_size - sizeof (UPFNODE) ||
+                    top >= max_nodes)
+                goto malformed;
+            stack [top++] = off;
+            off = ((const UPFNODE*)(upf_root + off))->less_offset;
+            continue;
+        }
+
+        off = stack [--top];
+        node = (const UPFNODE*)(upf_root + off);
+        if (nr_ranges >= max_nodes || node->min > node->max ||
+                (nr_ranges > 0 &&
+                    node->min <= index->ranges [nr_ranges - 1].max) ||
+                node->glyph_offset > upf_info->file_size ||
+                (node->max - node->min) >= (upf_info->file_size -
+                    node->glyph_offset) / sizeof (UPFGLYPH))
+            goto malformed;
+
+        index->ranges [nr_ranges].min = node->min;
+        index->ranges [nr_ranges].max = node->max;
+        index->ranges [nr_ranges].glyph_offset = node->glyph_offset;
+        nr_ranges++;
+
+        off = node->more_offset;
+    }
+
+    /* the first range which ends at or after the start of the page */
+    off = 0;
+    for (page = 0; page <= NR_UPF_BMP_PAGES; page++) {
+        while (off < nr_ranges && index->ranges [off].max < (page << 8))
+            off++;
+        index->bmp_pages [page] = off;
+    }
+
+    index->nr_ranges = nr_ranges;
+    free (stack);
+    return index;
+
+malformed:
+    _WRN_PRINTF ("FONT>UPF: malformed node tree in %s\n", filehead->font_name);
+    free (stack);
+    free (index);
+    return &no_index;
+
+error:
+    free (stack);
+    free (index);
+    return NULL;
+}
+
+static UPFINDEX* get_index (UPFINFO* upf_info)
+{
+    UPFINDEX* index;
+
+#ifdef __GNUC__
+    index = __atomic_load_n (&upf_info->index, __ATOMIC_ACQUIRE);
+#else
+    index = upf_info->index;
+#endif
+    if (index)
+        return index;
+
+    /* the in-core fonts get the index when first used */
+    index = build_index (upf_info);
+    if (index == NULL)
+        return NULL;
+
+#ifdef __GNUC__
+    {
+        UPFINDEX* expected = NULL;
+        if (!__atomic_compare_exchange_n (&upf_info->index, &expected, index,
+                    FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            /* another thread built the index in the meantime */
+            if (index != &no_index)
+                free (index);
+            index = expected;
+        }
+    }
+#else
+    upf_info->index = index;
+#endif
+
+    return index;
+}
+
+UPFGLYPH* font_WalkUPFNodeTree (UPFINFO* upf_info, unsigned int ch)
+{
+    Uint8* upf_root = upf_info->root_dir;
+
+    return get_glyph (upf_root, (UPFNODE*)(upf_root +
+                ((UPFV1_FILE_HEADER*)upf_root)->off_nodes), ch);
+}
+
+static UPFGLYPH* find_glyph (UPFINFO* upf_info, unsigned int ch)
+{
+    Uint8* upf_root = upf_info->root_dir;
+    UPFINDEX* index = get_index (upf_info);
+    const UPFRANGE* range;
+    Uint32 lo, hi;
+
+    if (index == NULL || index == &no_index) {
+        return font_WalkUPFNodeTree (upf_info, ch);
+    }
+
+    if (ch < (NR_UPF_BMP_PAGES << 8)) {
+        lo = index->bmp_pages [ch >> 8];
+        hi = index->bmp_pages [(ch >> 8) + 1] + 1;
+        if (hi > index->nr_ranges)
+            hi = index->nr_ranges;
+    }
+    else {
+        lo = index->bmp_pages [NR_UPF_BMP_PAGES];
+        hi = index->nr_ranges;
+    }
+
+    /* find the first range which ends at or after ch */
+    while (lo < hi) {
+        Uint32 mid = (lo + hi) >> 1;
+        if (index->ranges [mid].max < ch)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo >= index->nr_ranges || ch < index->ranges [lo].min)
+        return NULL;
+
+    range = index->ranges + lo;
+    return (UPFGLYPH*)(upf_root + range->glyph_offset +
+            sizeof (UPFGLYPH) * (ch - range->min));
+}
+
+UPFGLYPH* font_FindUPFGlyph (UPFINFO* upf_info, unsigned int ch)
+{
+    return find_glyph (upf_info, ch);
+}
+
 static UPFGLYPH def_glyph = {0, 0, 8, 2, 1, 0, 8, 0, 0};
 static unsigned char def_bitmap [] = {0xFE, 0x7F};
 
@@ -308,7 +495,7 @@ static const void* get_glyph_monobitmap (LOGFONT* logfont, DEVFONT* devfont,
 #endif
         uc16 = glyph_value;
 
-    glyph = get_glyph (p_upf, (UPFNODE *)(((UPFV1_FILE_HEADER *)p_upf)->off_nodes + p_upf), uc16);
+    glyph = find_glyph (UPFONT_INFO_P (devfont), uc16);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont) {   /* ASCII */
@@ -364,7 +551,7 @@ static const void* get_glyph_greybitmap (LOGFONT* logfont, DEVFONT* devfont,
 #endif
         uc16 = glyph_value;
 
-    glyph = get_glyph (p_upf, (UPFNODE *)(((UPFV1_FILE_HEADER *)p_upf)->off_nodes + p_upf), uc16);
+    glyph = find_glyph (UPFONT_INFO_P (devfont), uc16);
 
     if (glyph == NULL) {
         glyph = &def_smooth_glyph;
@@ -398,7 +585,7 @@ static int get_glyph_bbox (LOGFONT* logfont, DEVFONT* devfont,
 #endif
         uc16 = glyph_value;
 
-    glyph = get_glyph (p_upf, (UPFNODE *)(((UPFV1_FILE_HEADER *)p_upf)->off_nodes + p_upf), uc16);
+    glyph = find_glyph (UPFONT_INFO_P (devfont), uc16);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont) {   /* ASCII */
@@ -443,11 +630,9 @@ static int get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
 {
     unsigned int uc16;
     UPFGLYPH* glyph;
-    Uint8   * p_upf;
     int advance;
 
     glyph_value = REAL_GLYPH(glyph_value);
-    p_upf = (Uint8 *)UPFONT_INFO_P (devfont)->root_dir;
 
 #ifdef _MGCHARSET_UNICODE
     if(devfont->charset_ops->conv_to_uc32)
@@ -456,7 +641,7 @@ static int get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
 #endif
         uc16 = glyph_value;
 
-    glyph = get_glyph (p_upf, (UPFNODE *)(((UPFV1_FILE_HEADER *)p_upf)->off_nodes + p_upf), uc16);
+    glyph = find_glyph (UPFONT_INFO_P (devfont), uc16);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont) {   /* ASCII */
@@ -505,10 +690,8 @@ static BOOL is_glyph_existed (LOGFONT* logfont, DEVFONT* devfont, Glyph32 glyph_
 {
     unsigned int uc16;
     UPFGLYPH* glyph;
-    Uint8   * p_upf;
 
     glyph_value = REAL_GLYPH(glyph_value);
-    p_upf = (Uint8 *)UPFONT_INFO_P (devfont)->root_dir;
 
 #ifdef _MGCHARSET_UNICODE
     if(devfont->charset_ops->conv_to_uc32)
@@ -517,7 +700,7 @@ static BOOL is_glyph_existed (LOGFONT* logfont, DEVFONT* devfont, Glyph32 glyph_
 #endif
         uc16 = glyph_value;
 
-    glyph = get_glyph (p_upf, (UPFNODE *)(((UPFV1_FILE_HEADER *)p_upf)->off_nodes + p_upf), uc16);
+    glyph = find_glyph (UPFONT_INFO_P (devfont), uc16);
 
     if (glyph == NULL) {
         if (uc16 < 0x80 && logfont->devfonts[0] != devfont)   /* ASCII */
@@ -90,6 +90,30 @@ typedef struct
     Uint32 glyph_offset;
 } UPFNODE;
 
+/* A range of glyphs flattened from a UPFNODE (Since 5.0.16). */
+typedef struct
+{
+    Uint32 min;
+    Uint32 max;
+    Uint32 glyph_offset;
+} UPFRANGE;
+
+#define NR_UPF_BMP_PAGES        256
+
+/*
+ * The index of the glyph ranges, built from the node tree (Since 5.0.16).
+ * The ranges are sorted by the code points. For a page of 256 code points
+ * in BMP, the ranges covering the page are between bmp_pages [page]
+ * and bmp_pages [page + 1] (inclusive); the ranges out of BMP start
+ * from bmp_pages [NR_UPF_BMP_PAGES].
+ */
+typedef struct
+{
+    Uint32      nr_ranges;
+    Uint32      bmp_pages [NR_UPF_BMP_PAGES + 1];
+    UPFRANGE*   ranges;
+} UPFINDEX;
+
 typedef struct
 {
     Uint8      width;
@@ -104,6 +128,8 @@ typedef struct
     Uint8      reserved[3];
     void*      root_dir;
     Uint32     file_size;
+    /* built on demand; NULL for the in-core fonts until the first use */
+    UPFINDEX*  index;
 } UPFINFO;
 
 typedef struct
@@ -141,6 +167,15 @@ typedef struct
 
 } UPFV1_FILE_HEADER;
 
+/* Frees the index of a UPF font; used for the in-core fonts too. */
+void font_FreeUPFIndex (UPFINFO* upf_info);
+
+/* Finds the glyph of a character by the index of the ranges, or by walking
+   the node tree as the engine did before 5.0.16; returns NULL if the font
+   has no glyph for the character. */
+UPFGLYPH* font_FindUPFGlyph (UPFINFO* upf_info, unsigned int ch);
+UPFGLYPH* font_WalkUPFNodeTree (UPFINFO* upf_info, unsigned int ch);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -63,14 +63,12 @@
 #include "endianrw.h"
 #include "misc.h"
 
-#ifdef HAVE_MMAP
-#include <sys/mman.h>
-#endif
 
 #include "devfont.h"
 #include "varbitmap.h"
 #include "charset.h"
 #include "fontname.h"
+#include "fontfile.h"
 
 #define HEADER_LEN              68
 #define LEN_VBF_NAME            79
@@ -368,7 +366,8 @@ static void* load_font_data (DEVFONT* devfont, const char* fontname,
 
     FILE_LAYOUT layout;
     const FONT_PROPT* propt;
-    char* temp = NULL;
+    FONTFILEMAP map = { NULL, 0, FALSE };
+    char* temp;
     Uint16 len_header;
 
     VBFINFO* info = (VBFINFO*) calloc (1, sizeof(VBFINFO));
@@ -401,21 +400,14 @@ static void* load_font_data (DEVFONT* devfont, const char* fontname,
     swap_intdata ((Uint32*)&layout, 11);
 #endif
 
-#ifdef HAVE_MMAP
-    if ((temp = mmap (NULL, layout.font_size, PROT_READ, MAP_SHARED,
-            fileno(fp), 0)) == MAP_FAILED)
-        goto error;
-    temp += len_header;
-#else
-    layout.font_size -= len_header;
-    if ((temp = (char *)malloc (layout.font_size)) == NULL)
+    /* map the whole file read-only to share the pages between processes */
+    if (!font_MapFontFile (fp, &map) || map.size < layout.font_size ||
+            len_header >= layout.font_size)
         goto error;
-    if (fread (temp, sizeof (char), layout.font_size, fp) < layout.font_size)
-        goto error;
-#endif
 
     fclose (fp);
     fp = NULL;
+    temp = (char*)map.data + len_header;
     propt = (const FONT_PROPT*) temp;
 
     strcpy (info->ver_info, "3.0");
@@ -425,7 +417,9 @@ static void* load_font_data (DEVFONT* devfont, const char* fontname,
     info->height = propt->height;
     info->descent = propt->descent;
 
-    info->font_size = layout.font_size;
+    info->font_size = map.size;
+    info->file_data = map.data;
+    info->file_mapped = map.mapped;
 
 #if MGUI_BYTEORDER == MGUI_BIG_ENDIAN
     info->first_glyph = ArchSwap32 (propt->first_glyph);
@@ -460,12 +454,7 @@ static void* load_font_data (DEVFONT* devfont, const char* fontname,
     return info;
 
 error:
-#ifdef HAVE_MMAP
-    if (temp)
-        munmap (temp, layout.font_size);
-#else
-    free (temp);
-#endif
+    font_UnmapFontFile (&map);
 
     if (fp)
         fclose (fp);
@@ -476,13 +465,12 @@ error:
 static void unload_font_data (DEVFONT* devfont, void* data)
 {
     VBFINFO* info = (VBFINFO*) data;
-#ifdef HAVE_MMAP
-    /*FIXME*/
-    if (info->name)
-        munmap ((void*)(info->name)-HEADER_LEN, info->font_size);
-#else
-    free ((void*)info->name);
-#endif
+    FONTFILEMAP map;
+
+    map.data = info->file_data;
+    map.size = info->font_size;
+    map.mapped = info->file_mapped;
+    font_UnmapFontFile (&map);
 
     free (info);
 }
@@ -104,6 +104,11 @@ typedef struct {
     const unsigned int* bits_offset;
     /* The 8-bit right-padded bitmap data for all glyphs. */
     const unsigned char* all_glyph_bits;
+
+    /* The whole font file; NULL for in-core vbfs. */
+    void* file_data;
+    /* TRUE if the font file is mapped read-only. */
+    BOOL file_mapped;
 } VBFINFO;
 
 #define VBF_LEN_VERSION_INFO 10
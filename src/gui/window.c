@@ -4426,7 +4426,15 @@ HWND GUIAPI CreateMainWindowEx2 (PMAINWINCREATE pCreateInfo, LINT id,
 #ifdef _MGSCHEMA_COMPOSITING
     pWin->surf = GAL_CreateSurfaceForZNode (surf_flag, pWin->right - pWin->left,
                 pWin->bottom - pWin->top);
-    if ((surf_flag & ST_PIXEL_MASK) != ST_PIXEL_DEFAULT) {
+    if (pWin->surf && (pWin->surf->flags & GAL_PREMULTIPLIED)) {
+        Uint8 a = GetAValue (bkgnd_color);
+
+        pWin->iBkColor = GAL_MapRGBA (pWin->surf->format,
+                GetRValue (bkgnd_color) * a / 255,
+                GetGValue (bkgnd_color) * a / 255,
+                GetBValue (bkgnd_color) * a / 255, a);
+    }
+    else if ((surf_flag & ST_PIXEL_MASK) != ST_PIXEL_DEFAULT) {
         pWin->iBkColor = GAL_MapRGBA (pWin->surf->format,
                 GetRValue (bkgnd_color), GetGValue (bkgnd_color),
                 GetBValue (bkgnd_color), GetAValue (bkgnd_color));
@@ -126,6 +126,12 @@ static int wait_event (int which, int maxfd, fd_set *in, fd_set *out, fd_set *ex
     return 0;
 }
 
+/* the dummy engine reads no fd */
+static int get_event_fds (int* fds, int max_fds)
+{
+    return 0;
+}
+
 BOOL ial_InitDummyInput (INPUT* input, const char* mdev, const char* mtype)
 {
     input->update_mouse = mouse_update;
@@ -139,6 +145,7 @@ BOOL ial_InitDummyInput (INPUT* input, const char* mdev, const char* mtype)
     input->set_leds = NULL;
 
     input->wait_event = wait_event;
+    input->get_event_fds = get_event_fds;
     mouse_x = 0;
     mouse_y = 0;
     mouse_button= 0;
@@ -546,6 +546,15 @@ static BOOL on_mouse_button_changed (uint32_t button,
     return TRUE;
 }
 
+static int get_event_fds (int* fds, int max_fds)
+{
+    if (max_fds < 1)
+        return -1;
+
+    fds [0] = my_ctxt.li_fd;
+    return 1;
+}
+
 static int wait_event_ex (int maxfd, fd_set *in, fd_set *out, fd_set *except,
                 struct timeval *timeout, EXTRA_INPUT_EVENT* extra)
 {
@@ -1421,6 +1430,7 @@ BOOL ial_InitLibInput (INPUT* input, const char* mdev, const char* mtype)
     input->set_leds = set_leds;
 
     input->wait_event_ex = wait_event_ex;
+    input->get_event_fds = get_event_fds;
     return TRUE;
 
 error:
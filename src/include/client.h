@@ -132,7 +132,9 @@
     #define ID_NAMEDSSURFOP_SET         2
     #define ID_NAMEDSSURFOP_REVOKE      3
 
-#define REQID_RESERVED              0x0020
+/* Since 5.0.16 */
+// Set up the shared memory request ring of the client
+#define REQID_SETUPREQRING          0x1020
 
 // Move the current client to another layer
 #define REQID_MOVETOLAYER           0x0021
@@ -290,6 +292,8 @@ typedef struct ZorderOpInfo
     int     ct;
     /* the compositing argument of ID_ZOOP_SETCOMPOSITING */
     DWORD   ct_arg;
+    /* whether the client flags the znode in the dirty map; since 5.0.16 */
+    BOOL    dirty_notify;
 #endif
 } ZORDEROPINFO;
 
@@ -147,11 +147,13 @@ enum {
   #define SIZE_CLIPRECTHEAP   16
   #define SIZE_INVRECTHEAP    32
   #define SIZE_QMSG_HEAP      32
+  #define DEF_MAX_SPILLED_MSGS  256
 #else
   #define DEF_MSGQUEUE_LEN    NR_BITS_DWORD
   #define SIZE_CLIPRECTHEAP   NR_BITS_DWORD
   #define SIZE_INVRECTHEAP    NR_BITS_DWORD
   #define SIZE_QMSG_HEAP      NR_BITS_DWORD
+  #define DEF_MAX_SPILLED_MSGS  4096
 #endif
 
 /* constants for fix string module */
@@ -60,6 +60,7 @@ extern "C" {
 #include "internals.h"
 #include "ctrlclass.h"
 
+/* Since 5.0.16, the number of DCs in a chunk of the general DC pool. */
 #if defined (__NOUNIX__) || defined (__uClinux__)
     #define DCSLOTNUMBER        8
 #else
@@ -162,6 +163,11 @@ struct tagDC
     unsigned char bInUse;
     unsigned char bIsClient;
 
+    /* the index in the general DC pool (since 5.0.16); 0 for other DCs */
+    unsigned int pool_idx;
+    /* the index of the next free DC in the general DC pool */
+    unsigned int next_free;
+
     HWND hwnd;
 
     /* surface of this DC */
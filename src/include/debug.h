@@ -223,11 +223,11 @@ dump_message_queue (const MSGQUEUE* msg_queue, const char* name)
             msg_queue->nrWindows, msg_queue->nr_timers, msg_queue->nr_fd_slots);
 
     nr = 0;
-    for (i = 0; i < DEF_NR_TIMERS; i++) {
-        if (msg_queue->timer_slots[i]) {
+    for (i = 0; i < msg_queue->nr_timers; i++) {
+        if (msg_queue->timer_heap[i]) {
             _MG_PRINTF ("  Timer #%d: hWnd (%p), id (%ld)\n",
-                    i, msg_queue->timer_slots[i]->hWnd,
-                    msg_queue->timer_slots[i]->id);
+                    i, msg_queue->timer_heap[i]->hWnd,
+                    msg_queue->timer_heap[i]->id);
             nr++;
         }
     }
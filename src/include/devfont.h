@@ -160,6 +160,49 @@ void font_DelMBDevFont (DEVFONT* dev_font);
 void dbg_dumpDevFonts (void);
 #endif
 
+/* Since 5.0.16: the glyph cache shared by the font engines (glyphcache.c) */
+typedef struct _GLYPHKEY {
+    const DEVFONT*  devfont;
+    Glyph32         glyph;
+    int             size;
+    int             rotation;
+    DWORD           style;
+    /* the rendering options not covered by the style, e.g. the bold width */
+    DWORD           flags;
+} GLYPHKEY;
+
+typedef struct _CACHEDGLYPH {
+    SIZE            bbox;
+    int             pitch;
+    unsigned short  scale;
+    const BYTE*     bits;
+} CACHEDGLYPH;
+
+BOOL font_InitGlyphCache (void);
+void font_TermGlyphCache (void);
+
+/* Since 5.0.16: reads the directory of the font index sidecars from the
+   environment or MiniGUI.cfg; called once when the GDI is initialized. */
+void font_InitIndexCache (void);
+
+/* returns a glyph which must be released by font_ReleaseGlyph, or NULL */
+const CACHEDGLYPH* font_LookupGlyph (const GLYPHKEY* key);
+BOOL font_CacheGlyph (const GLYPHKEY* key, const SIZE* bbox,
+        int pitch, unsigned short scale, const BYTE* bits);
+void font_ReleaseGlyph (const CACHEDGLYPH* glyph);
+
+/* drops the glyphs of the device font, or all glyphs if devfont is NULL */
+void font_InvalidateGlyphCache (const DEVFONT* devfont);
+
+#ifdef _MGCHARSET_UNICODE
+/* the cache of shaped layout runs; see src/newgdi/layout-cache.c */
+BOOL gdi_InitShapedRunCache (void);
+void gdi_TermShapedRunCache (void);
+
+/* drops all shaped runs */
+void gdi_InvalidateShapedRunCache (void);
+#endif
+
 static inline BOOL check_zero_width(unsigned int t)
 {
     return (t & ACHARTYPE_BASIC_MASK) == ACHAR_BASIC_ZEROWIDTH;
@@ -197,6 +197,15 @@ static inline int IAL_WaitEvent(int maxfd, fd_set *in, fd_set *out,
                 maxfd, in, out, except, timeout);
 }
 
+/* Since 5.0.16: returns -1 if the engine does not tell its fds */
+static inline int IAL_GetEventFds (int* fds, int max_fds)
+{
+    if (__mg_cur_input->get_event_fds)
+        return __mg_cur_input->get_event_fds (fds, max_fds);
+
+    return -1;
+}
+
 #define IAL_MType               (__mg_cur_input->mtype)
 #define IAL_MDev                (__mg_cur_input->mdev)
 
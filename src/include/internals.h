@@ -223,6 +223,19 @@ typedef struct _LISTEN_FD {
 #define QS_DESKTIMER        0x04000000
 #define QS_EMPTY            0x00000000
 
+/*
+ * Since 5.0.16, when there are multiple message threads, the messages posted
+ * by other threads are pushed to a lock-free inbox of the message queue,
+ * and moved to the post message buffer by the message thread.
+ * Set the runtime option `lockfree_postmsg` to `no` to use the mutex of
+ * the message queue instead, or define _MG_LOCKED_POSTMSG to leave out
+ * the inbox.
+ */
+#if defined(_MGHAVE_VIRTUAL_WINDOW) && defined(__GNUC__) \
+        && !defined(_MG_LOCKED_POSTMSG)
+#   define _MG_LOCKFREE_POSTMSG     1
+#endif
+
 // the MSGQUEUE struct is an internal struct.
 // use semaphores to implement message queue.
 struct _MSGQUEUE
@@ -255,6 +268,23 @@ struct _MSGQUEUE
     MSG* msg;                   // post message buffer
     int readpos, writepos;      // positions for reading and writing
 
+    /* Since 5.0.16: post messages spilled when the buffer is full */
+    PQMSG pFirstSpilledMsg;     // head of the overflow list
+    PQMSG pLastSpilledMsg;      // tail of the overflow list
+    DWORD nr_spilled;           // the length of the overflow list
+
+#ifdef _MG_LOCKFREE_POSTMSG
+    /* Since 5.0.16: messages posted by other threads, in LIFO order */
+    PQMSG pInboxMsgs;
+    DWORD nr_inbox_msgs;        // the length of the inbox
+#endif
+
+    /* Since 5.0.16: coalescing index for post messages */
+    int coalesce_mask;          // the number of index buckets minus 1
+    int* coalesce_index;        // ring slots of coalescable messages; -1 for free
+    BYTE* coalesce_flags;       // whether a ring slot is indexed
+    MSGQUEUESTATS stats;        // statistics of the post message buffer
+
     int loop_depth;             // message loop depth, for dialog boxes
 
     int idle_counter;           // the idle connter for MSG_IDLE
@@ -262,11 +292,14 @@ struct _MSGQUEUE
 
     /* Since 5.0.0, MiniGUI provides support for timers per message thread */
     int nr_timers;              // the number of active timers
-    int first_timer_slot;       // the first timer slot to be checked
-    TIMER* timer_slots [DEF_NR_TIMERS];
-                                // slots for timer
-    DWORD old_tick_count;       // the old tick count.
-    DWORD expired_timer_mask;   // timer slots mask
+    /* Since 5.0.16, the timers are organized in a min-heap by deadline */
+    int max_timers;             // the capacity of the timer heap
+    TIMER** timer_heap;         // the min-heap of the active timers
+    int nr_timer_buckets;       // the number of buckets of the timer hash
+    TIMER** timer_buckets;      // the timers hashed by (hWnd, id)
+    DWORD last_timer_serial;    // the serial number of the last new timer
+    TIMER* first_expired_timer; // the first timer expired
+    TIMER* last_expired_timer;  // the last timer expired
 
 #ifdef HAVE_SELECT
     /* Since 5.0.0, MiniGUI supports listening file descriptors
@@ -278,6 +311,19 @@ struct _MSGQUEUE
     fd_set      efdset;
     LISTEN_FD** fd_slots;
 #endif
+
+#ifdef _MGHAVE_TICKLESS_IDLE
+    /* Since 5.0.16, the message thread sleeps in epoll until the next
+       timer expires, a listening fd is ready, or it is woken up;
+       the fds are created on the first wait in tickless_idle_handler */
+    int epoll_fd;               // the epoll instance; -1 if not created
+    int wakeup_fd;              // the eventfd to wake up the thread
+    int timer_fd;               // the timerfd for the next timer
+    BOOL timer_fd_armed;        // whether the timerfd is armed
+    DWORD timer_fd_expected;    // the deadline (ms) armed in the timerfd
+    int sleeping;               // whether the thread is sleeping; atomic
+    BOOL tickless_failed;       // whether epoll failed; use select instead
+#endif
 };
 
 #ifdef __cplusplus
@@ -290,6 +336,12 @@ BOOL mg_InitMsgQueue (PMSGQUEUE pMsgQueue, int iBufferLen);
 void mg_DestroyMsgQueue (PMSGQUEUE pMsgQueue);
 BOOL kernel_QueueMessage (PMSGQUEUE pMsgQueue, PMSG pMsg);
 
+#ifdef _MGHAVE_TICKLESS_IDLE
+/* Since 5.0.16 */
+void __mg_wakeup_msg_queue (PMSGQUEUE pMsgQueue);
+void __mg_update_epoll_listen_fd (PMSGQUEUE pMsgQueue, int fd);
+#endif
+
 /* Since 5.0.0 */
 int __mg_broadcast_message (PMSGQUEUE msg_queue, MSG* msg);
 
@@ -346,8 +398,21 @@ static inline void SetDskIdleHandler (IDLEHANDLER idle_handler)
     if (sem_value <= 0) {\
         sem_post(&(pMsgQueue)->wait); \
     } \
+    WAKEUP_MSGQ (pMsgQueue); \
   } while(0)
 
+#ifdef _MGHAVE_TICKLESS_IDLE
+  /* Since 5.0.16: wake up the message thread sleeping in epoll */
+  #define WAKEUP_MSGQ(pMsgQueue) \
+  do { \
+    __atomic_thread_fence (__ATOMIC_SEQ_CST); \
+    if (__atomic_load_n (&(pMsgQueue)->sleeping, __ATOMIC_SEQ_CST)) \
+        __mg_wakeup_msg_queue (pMsgQueue); \
+  } while(0)
+#else
+  #define WAKEUP_MSGQ(pMsgQueue)
+#endif
+
 #else /* defined _MGHAVE_VIRTUAL_WINDOW */
 
   #define MG_MUTEX_INIT(lock)
@@ -540,6 +605,14 @@ extern ZORDERINFO* __mg_def_zorder_info;
 /* the zorder information for the current layer */
 extern ZORDERINFO* __mg_zorder_info;
 
+#if IS_COMPOSITING_SCHEMA
+/* the dirty map of the current layer attached by a client; since 5.0.16 */
+extern ZNODEDIRTYMAP* __mg_zorder_dirty_map;
+
+/* (un)bind the surfaces of the znodes to the dirty map; since 5.0.16 */
+void __mg_bind_znode_surfaces (BOOL bind);
+#endif
+
 #ifdef _MGRM_STANDALONE
 
 BOOL salone_IdleHandler4StandAlone (PMSGQUEUE msg_que, BOOL wait);
@@ -818,27 +891,6 @@ static inline MSGQUEUE* getMsgQueueForThisThread (void)
     return pMsgQueue;
 }
 
-static inline TIMER** getTimerSlotsForThisThread (PMSGQUEUE* retMsgQueue)
-{
-    MSGQUEUE* pMsgQueue;
-
-    pMsgQueue = (MSGQUEUE*)pthread_getspecific (__mg_threadinfo_key);
-#ifdef __VXWORKS__
-    if (pMsgQueue == (void *)-1) {
-        pMsgQueue = NULL;
-    }
-#endif
-
-    if (pMsgQueue) {
-        if (retMsgQueue) {
-            *retMsgQueue = pMsgQueue;
-        }
-        return pMsgQueue->timer_slots;
-    }
-
-    return NULL;
-}
-
 /* Be careful: does not check validity of hWnd */
 static inline PMAINWIN getMainWinIfWindowInThisThread (HWND hWnd)
 {
@@ -887,13 +939,6 @@ static inline MSGQUEUE* getMsgQueueForThisThread (void)
     return __mg_dsk_msg_queue;
 }
 
-static inline TIMER** getTimerSlotsForThisThread (PMSGQUEUE* retMsgQueue)
-{
-    if (retMsgQueue)
-        *retMsgQueue = __mg_dsk_msg_queue;
-    return __mg_dsk_msg_queue->timer_slots;
-}
-
 static inline PMAINWIN getMainWinIfWindowInThisThread (HWND hWnd)
 {
     return getMainWindowPtr(hWnd);
@@ -122,6 +122,30 @@ typedef int (*GAL_blit)(GAL_VideoDevice *video,
         struct GAL_Surface *src, GAL_Rect *srcrect,
         struct GAL_Surface *dst, GAL_Rect *dstrect);
 
+/* A bounded list of dirty rectangles; since 5.0.16. */
+typedef struct _DirtyRects {
+    /* the number of dirty rects */
+    int             nr_rcs;
+
+    /* the dirty rectangles */
+    RECT            rcs [NR_DIRTY_RECTS];
+} GAL_DirtyRects;
+
+/*
+ * Adds a rectangle to an array of at most max_rcs dirty rectangles and
+ * returns the new number of the rectangles. Two rectangles are merged only
+ * if the bound of them costs no more pixels than both of them; when the
+ * array is full, the rectangle is merged with the one growing least.
+ */
+int GAL_AddDirtyRect (RECT* rcs, int nr_rcs, int max_rcs, const RECT* rc);
+
+static inline void GAL_AddToDirtyRects (GAL_DirtyRects* dirty_rcs,
+        const RECT* rc)
+{
+    dirty_rcs->nr_rcs = GAL_AddDirtyRect (dirty_rcs->rcs, dirty_rcs->nr_rcs,
+            NR_DIRTY_RECTS, rc);
+}
+
 #if IS_COMPOSITING_SCHEMA
 typedef struct _DirtyInfo {
     /* the dirty age */
@@ -166,6 +190,8 @@ typedef struct _SharedSurfaceHeader {
     int             depth;
     /* the RGBA masks */
     Uint32          Rmask, Gmask, Bmask, Amask;
+    /* the surface flags known by the attachers: GAL_PREMULTIPLIED; since 5.0.16 */
+    Uint32          shared_flags;
 
     /* the size of the whole buffer */
     size_t          map_size;
@@ -177,10 +203,10 @@ typedef struct _SharedSurfaceHeader {
 } GAL_SharedSurfaceHeader;
 #endif /* IS_COMPOSITING_SCHEMA */
 
-/* The header for shadow screen; used to store the dirty rectangle. */
+/* The header for shadow screen; used to store the dirty rectangles. */
 typedef struct _ShadowSurfaceHeader {
-    /* The dirty rectangle */
-    RECT    dirty_rc;
+    /* The dirty rectangles; since 5.0.16, replaced the bounding rectangle */
+    GAL_DirtyRects  dirty_rcs;
 } GAL_ShadowSurfaceHeader;
 
 #ifdef _MGUSE_PIXMAN
@@ -240,6 +266,10 @@ typedef struct GAL_Surface {
     GAL_DirtyInfo *dirty_info;                  /* Private */
     /* The file descriptor if the surface is a shared surface. */
     int  fd;                                    /* Private; since 5.2.0. */
+    /* The word and the bit in the dirty map of the layer which are set
+       when the dirty age changes; since 5.0.16. */
+    Uint32 *dirty_word;                         /* Private */
+    Uint32  dirty_mask;                         /* Private */
 #endif
 } GAL_Surface;
 
@@ -256,6 +286,7 @@ typedef struct GAL_Surface {
 
 #define GAL_SRCALPHA         0x00010000     /* Blit uses source alpha blending */
 #define GAL_SRCPIXELALPHA    0x00020000     /* Blit uses source per-pixel alpha blending */
+#define GAL_PREMULTIPLIED    0x00040000     /* The color channels are premultiplied by alpha; since 5.0.16 */
 
 /* Used internally (read-only) */
 #define GAL_HWACCEL          0x00000100     /* Blit uses hardware acceleration */
@@ -654,6 +685,7 @@ GAL_Surface *GAL_CreateSharedRGBSurface (GAL_VideoDevice* video,
 #define ST_PIXEL_ARGB1555       0x0002
 #define ST_PIXEL_ARGB8888       0x0003
 #define ST_PIXEL_XRGB565        0x0004
+#define ST_PREMULTIPLIED        0x0100
 #endif /* not define ST_PIXEL_MASK */
 
 /* Allocate a shared RGB surface from the current video device. */
@@ -734,6 +766,13 @@ int GAL_SetColorKey (GAL_Surface *surface, Uint32 flag, Uint32 key);
  */
 int GAL_SetAlpha (GAL_Surface *surface, Uint32 flag, Uint8 alpha);
 
+/*
+ * Drops the RLE encodings of a surface which is to be drawn to. The
+ * surface will be encoded again by the next blit from it, if it is
+ * still requested to be RLE accelerated.
+ */
+void GAL_DropRLESurface (GAL_Surface *surface);
+
 /*
  * A function to calculate the intersection of two rectangles:
  * return true if the rectangles intersect, false otherwise
@@ -1021,6 +1060,148 @@ int GAL_StretchBlt (GAL_Surface *src, GAL_Rect *srcrect,
         GAL_Surface *dst, GAL_Rect *dstrect,
         const STRETCH_EXTRA_INFO *sei, DWORD ops);
 
+/*
+ * Since 5.0.16, the software stretch engine.
+ *
+ * The engine scales the pixels of a source rectangle to a destination
+ * rectangle which have the same pixel format. The nearest filter supports
+ * all pixel formats; the bilinear and the box (area averaging) filters
+ * support the pixel formats of 16, 24, and 32 bits per pixel, and
+ * fall back to the nearest filter for other formats. The box filter
+ * is replaced by the bilinear filter when enlarging in both directions.
+ *
+ * All state lives in a stretch context, so the engine is re-entrant.
+ */
+#define GAL_STRETCH_NEAREST     0
+#define GAL_STRETCH_BILINEAR    1
+#define GAL_STRETCH_BOX         2
+
+typedef struct _GAL_StretchContext GAL_StretchContext;
+
+/*
+ * Creates a stretch context to scale the source pixels of src_w x src_h
+ * to dst_w x dst_h. Returns NULL on bad arguments or memory shortage.
+ */
+GAL_StretchContext* GAL_CreateStretchContext (const GAL_PixelFormat* format,
+        int filter, const Uint8* src, int src_pitch, int src_w, int src_h,
+        int dst_w, int dst_h);
+
+/*
+ * Scales the destination line y, from the pixel x0 (included) to the pixel
+ * x1 (excluded). The argument dst points to the pixel x0 of the line.
+ */
+void GAL_StretchLine (GAL_StretchContext* ctxt, int y, int x0, int x1,
+        Uint8* dst);
+
+void GAL_DestroyStretchContext (GAL_StretchContext* ctxt);
+
+/*
+ * Scales the source pixels to the destination pixels in one call; only
+ * the destination pixels in clip (relative to dst) are written if clip
+ * is not NULL. Returns 0 on success, -1 on error.
+ */
+int GAL_StretchPixels (const GAL_PixelFormat* format, int filter,
+        const Uint8* src, int src_pitch, int src_w, int src_h,
+        Uint8* dst, int dst_pitch, int dst_w, int dst_h,
+        const GAL_Rect* clip);
+
+/*
+ * Creates a software surface of w x h which has the same pixel format,
+ * colorkey and alpha settings as src, to hold the scaled pixels of src
+ * before blitting them to a surface of another format.
+ */
+GAL_Surface* GAL_CreateScaledSurface (GAL_Surface* src, int w, int h);
+
+/* Returns the name of the kernels used by the stretch engine: c or sse2 */
+const char* GAL_GetStretchKernelsName (void);
+
+/* Returns the name of the kernels used by the per-pixel alpha blits:
+   c, sse2, or avx2 */
+const char* GAL_GetAlphaBlitKernelsName (void);
+
+/*
+ * Since 5.0.16, the prepared software blits.
+ *
+ * GAL_PrepareSoftBlit maps the source surface to the destination surface
+ * and takes the software blitter selected for the current colorkey and
+ * alpha settings of the source. GAL_RunSoftBlit then runs the blitter on
+ * rectangles which have been clipped by the caller. It touches neither the
+ * blit map nor the clipping rectangle of the surfaces, so the blits prepared
+ * for different source surfaces can run in different threads as long as
+ * their destination rectangles do not overlap and the surfaces are not
+ * changed meanwhile.
+ */
+typedef struct _GAL_PreparedBlit {
+    GAL_Surface* src;
+    GAL_Surface* dst;
+    void*   blit;       /* the low level blitter */
+    void*   aux_data;
+    Uint8*  table;
+} GAL_PreparedBlit;
+
+/*
+ * Returns 0 on success; -1 if the blit can not be done by the
+ * software blitter, for example, a hardware accelerated blit or
+ * an RLE encoded surface.
+ */
+int GAL_PrepareSoftBlit (GAL_Surface* src, GAL_Surface* dst, DWORD op,
+        GAL_PreparedBlit* pb);
+
+/* The rectangles must be in the surfaces and have the same size. */
+void GAL_RunSoftBlit (const GAL_PreparedBlit* pb,
+        const GAL_Rect* srcrect, const GAL_Rect* dstrect);
+
+/*
+ * Fills a rectangle which has been clipped by the caller by software;
+ * Since 5.0.16.
+ */
+void GAL_SoftFillRect (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color);
+
+/* Since 5.0.16: the raster operations of GAL_FillSpans */
+#define GAL_FILLOP_SET          0
+#define GAL_FILLOP_AND          1
+#define GAL_FILLOP_OR           2
+#define GAL_FILLOP_XOR          3
+/* OR'd with GAL_FILLOP_SET: the pixels are stored bypassing the caches */
+#define GAL_FILLOP_STREAM       0x10
+
+/*
+ * Sets, or ANDs, ORs, or XORs the h lines of w pixels at dst with pixel
+ * by the SIMD fill kernels; bpp is the bytes per pixel. Returns FALSE
+ * without touching the pixels if there are no kernels for bpp;
+ * Since 5.0.16.
+ */
+BOOL GAL_FillSpans (Uint8* dst, int pitch, int bpp, Uint32 pixel,
+        int op, int w, int h);
+
+/* Returns TRUE if a fill of so many bytes is larger than the last level
+   cache, and should be done with GAL_FILLOP_STREAM; Since 5.0.16. */
+BOOL GAL_IsLargeFill (size_t bytes);
+
+/* Returns the name of the fill kernels: c, sse2, or avx2 */
+const char* GAL_GetFillKernelsName (void);
+
+/*
+ * Returns the number of threads, including the caller, among which the
+ * large jobs of the graphics engine are split: the large fills, the RLE
+ * encoding, and the tiled compositor. It is specified by the environment
+ * variable MG_WORKER_THREADS or the key worker_threads in the section
+ * system of MiniGUI.cfg; zero means the number of online CPUs.
+ * Since 5.0.16.
+ */
+int GAL_GetNrWorkerThreads (void);
+
+/* The callback of a part of a job run by GAL_RunWorkerJob */
+typedef void (*CB_GAL_WORKER_JOB) (void* context, int part);
+
+/*
+ * Calls cb for the nr_parts parts of a job in the persistent worker
+ * threads and the caller, and returns after all parts are done. The caller
+ * does all parts by itself if the workers are used by another thread or
+ * are not available; Since 5.0.16.
+ */
+void GAL_RunWorkerJob (CB_GAL_WORKER_JOB cb, void* context, int nr_parts);
+
 #ifdef _MGSCHEMA_COMPOSITING
 extern GAL_Surface* __gal_screen;
 extern GAL_Surface* __gal_fake_screen;
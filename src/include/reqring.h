@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** reqring.h: the shared memory request ring of a client (MiniGUI-Processes).
+**
+** Create date: 2026/10/18
+*/
+
+#ifndef GUI_REQRING_H
+    #define GUI_REQRING_H
+
+#ifdef _MGHAVE_CLIENT_REQRING
+
+/*
+ * A client which has joined a layer maps a REQRING shared with the server.
+ * The client is the only producer of the request slots and the server is
+ * the only consumer, so the slots need no lock:
+ *
+ *  - the client fills the slot at head and increases head;
+ *  - the server handles the slot at tail and increases tail.
+ *
+ * The server only watches the doorbell (an eventfd) of the ring. Before it
+ * goes to sleep, the server arms the doorbell; a client which clears the
+ * armed flag writes the eventfd. Requests which do not want a reply are not
+ * doorbelled one by one: the client rings the doorbell when it pushes a
+ * request which wants a reply, when the ring becomes half full, or when
+ * its message loop goes idle.
+ *
+ * When the ring is full, the client sleeps on the futex word tail until
+ * the server releases a slot.
+ *
+ * There is at most one pending request wanting a reply. The server copies
+ * the reply to the reply buffer of the ring and increases reply_seq, which
+ * is also the futex word the client sleeps on.
+ *
+ * The socket is still used for requests which pass a file descriptor, the
+ * requests whose data or reply does not fit in a slot, and the messages
+ * sent by the server.
+ */
+
+#define REQRING_MAGIC           0x4D475252  /* MGRR */
+
+#define REQRING_NR_SLOTS        64
+#define REQRING_SIZE_SLOT       1024
+#define REQRING_SIZE_DATA       (REQRING_SIZE_SLOT - sizeof (Uint32) * 4)
+#define REQRING_SIZE_REPLY      1024
+
+/* the length of reply when the server did not reply a request */
+#define REQRING_NO_REPLY        0xFFFFFFFF
+
+typedef struct _REQRINGSLOT {
+    /* the request identifier */
+    Uint32      req_id;
+    /* the length of the request data plus the extra data */
+    Uint32      len_data;
+    /* the length of the expected reply; zero for no reply */
+    Uint32      len_rslt;
+    /* the number of requests sent through the socket before this one;
+       the server handles them first to keep the order of requests. */
+    Uint32      sock_seq;
+
+    char        data [REQRING_SIZE_DATA];
+} REQRINGSLOT;
+
+typedef struct _REQRING {
+    Uint32      magic;
+    Uint32      nr_slots;
+
+    /* written by the client only */
+    Uint32      head;
+    /* written by the server only */
+    Uint32      tail;
+
+    /* set by the server before it sleeps; cleared by the doorbell ringer */
+    Uint32      doorbell_armed;
+    /* set by the client while it sleeps on tail for a free slot */
+    Uint32      slot_waiting;
+
+    /* the futex word: increased by the server after copying a reply */
+    Uint32      reply_seq;
+    /* set by the client while it sleeps on reply_seq */
+    Uint32      reply_waiting;
+    /* the length of the last reply */
+    Uint32      len_reply;
+
+    char        reply [REQRING_SIZE_REPLY];
+
+    REQRINGSLOT slots [REQRING_NR_SLOTS];
+} REQRING;
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/* defined in server/reqring.c; used by the server only. */
+int  __mg_reqring_attach (int cli, int mem_fd);
+void __mg_reqring_detach (int cli);
+int  __mg_reqring_doorbell (int cli);
+int  __mg_reqring_handle (int cli, BOOL doorbell_rung);
+void __mg_reqring_socket_request_handled (int cli);
+BOOL __mg_reqring_send_reply (int clifd, const void* reply, int len);
+
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#endif  /* _MGHAVE_CLIENT_REQRING */
+
+#endif  /* GUI_REQRING_H */
+
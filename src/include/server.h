@@ -141,7 +141,17 @@ int __mg_get_shared_surface_srv(const char *itn_name, SHAREDSURFINFO *info);
 
 void __mg_remove_client (int cli, int clifd);
 
+/* Since 5.0.16: the types of the fds of a client watched by the server */
+#define SRVFD_SOCKET        0
+#define SRVFD_DOORBELL      1
+
+BOOL __mg_server_watch_client_fd (int cli, int fd, int type);
+void __mg_server_unwatch_client_fd (int cli, int fd, int type);
+
 int __mg_handle_request (int clifd, int req_id, int cli);
+int __mg_handle_client_requests (int cli, int clifd);
+int __mg_dispatch_request (int cli, int clifd, int req_id,
+                void* buff, size_t len_data, int fd_received);
 
 int __mg_send2client (const MSG* msg, MG_Client* client);
 void __mg_set_active_client (MG_Client* client);
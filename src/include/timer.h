@@ -57,11 +57,20 @@
 typedef struct _TIMER {
     HWND        hWnd;
     LINT        id;
-    DWORD       interv;
-    DWORD       ticks_expected;
+    DWORD       ms_interv;      // interval in ms; since 5.0.16
+    DWORD       ms_expected;    // the deadline in ms; since 5.0.16
     DWORD       ticks_fired;
     TIMERPROC   proc;
 
+    /* Since 5.0.16, timers are managed by a min-heap per message queue,
+       and the expired timers are linked in a FIFO list. */
+    int         heap_idx;       // the index in the timer heap
+    BOOL        expired;        // whether the timer is in the expired list
+    DWORD       serial;         // identifies this timer in the message queue
+    struct _TIMER* next_hashed; // the next timer in the same hash bucket
+    struct _TIMER* prev_expired;
+    struct _TIMER* next_expired;
+
     // removed since 5.0.0
     // PMSGQUEUE   msg_queue;
 } TIMER;
@@ -75,9 +84,22 @@ extern "C" {
 #endif  /* __cplusplus */
 
 DWORD __mg_update_tick_count (MSGQUEUE* msg_queue);
-int  __mg_check_expired_timers (MSGQUEUE* msg_queue, DWORD inter);
+int  __mg_check_expired_timers (MSGQUEUE* msg_queue);
 void __mg_remove_timers_by_msg_queue (MSGQUEUE* msg_queue);
-void __mg_remove_timer (MSGQUEUE* msg_queue, int slot);
+/* Since 5.0.16: removes the timer only if it is still the one identified by
+   the serial number; the timer may have been killed and set again with
+   the same identifier by a timer callback. */
+void __mg_remove_timer (MSGQUEUE* msg_queue, HWND hWnd, LINT id,
+        DWORD serial);
+
+/* Since 5.0.16: operations on the expired timer list */
+TIMER* __mg_fetch_expired_timer (MSGQUEUE* msg_queue);
+void __mg_unmark_expired_timer (MSGQUEUE* msg_queue, TIMER* timer);
+void __mg_clear_expired_timers (MSGQUEUE* msg_queue);
+
+/* Since 5.0.16: returns the milliseconds before the next timer expires,
+   or max_ms if there is no timer or the next timer expires later. */
+DWORD __mg_get_timer_timeout (MSGQUEUE* msg_queue, DWORD max_ms);
 
 #if 0
 TIMER* __mg_get_timer (int slot);
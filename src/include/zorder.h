@@ -100,6 +100,19 @@ typedef struct _ZORDERNODE {
 } ZORDERNODE;
 typedef ZORDERNODE* PZORDERNODE;
 
+#ifdef _MGSCHEMA_COMPOSITING
+/*
+ * Since 5.0.16: the dirty map of a layer, shared by the server and the
+ * clients in the layer. The process drawing to the surface of a window
+ * znode sets the bit of the znode after it bumps the dirty age, so
+ * the compositor only visits and locks the znodes which changed.
+ */
+typedef struct _ZNODEDIRTYMAP {
+    Uint32          nr_bits;
+    Uint32          bits [0];
+} ZNODEDIRTYMAP;
+#endif  /* defined _MGSCHEMA_COMPOSITING */
+
 typedef struct _ZORDERINFO {
     int             size_usage_bmp;
 
@@ -158,6 +171,16 @@ typedef struct _ZORDERINFO {
     int             zi_semnum;
 #endif
 
+#ifdef _MGSCHEMA_COMPOSITING
+    /* Since 5.0.16: the id of the shared memory for the dirty map. */
+    int             dirty_shmid;
+    /* Since 5.0.16: TRUE if a znode does not set the dirty map,
+       and the compositor should poll all znodes. */
+    BOOL            poll_dirty;
+    /* Since 5.0.16: the dirty map attached by the server. */
+    ZNODEDIRTYMAP*  dirty_map;
+#endif
+
     /* move to last for alignment */
     HWND            ptmi_in_cli;
 } ZORDERINFO;
@@ -255,12 +278,41 @@ typedef ZORDERINFO* PZORDERINFO;
 
 #define ZOF_TYPE_TO_LEVEL_IDX(type)     ((int)(8 - ((type) >> 28)))
 
+#ifdef _MGSCHEMA_COMPOSITING
+#define NR_ZNODE_DIRTY_BITS(zi)                             \
+    (MAX_NR_ZNODES(zi) + 1)
+
+#define NR_ZNODE_DIRTY_WORDS(nr_bits)                       \
+    (((nr_bits) + 31) >> 5)
+
+#define SIZE_ZNODE_DIRTY_MAP(nr_bits)                       \
+    (sizeof (ZNODEDIRTYMAP) +                               \
+     sizeof (Uint32) * NR_ZNODE_DIRTY_WORDS(nr_bits))
+
+static inline void __mg_set_znode_dirty (ZNODEDIRTYMAP* map, int idx_znode)
+{
+    if (map && idx_znode >= 0 && (Uint32)idx_znode < map->nr_bits) {
+#ifdef __GNUC__
+        __atomic_fetch_or (map->bits + (idx_znode >> 5),
+                1U << (idx_znode & 31), __ATOMIC_RELEASE);
+#else
+        map->bits [idx_znode >> 5] |= 1U << (idx_znode & 31);
+#endif
+    }
+}
+#endif  /* defined _MGSCHEMA_COMPOSITING */
+
 #ifdef __cplusplus
 extern "C" {
 #endif  /* __cplusplus */
 
 int __kernel_alloc_z_order_info (int nr_topmosts, int nr_normals, BOOL with_maskrc_heap);
 void __kernel_free_z_order_info (ZORDERINFO* zi);
+#ifdef _MGSCHEMA_COMPOSITING
+BOOL __kernel_alloc_znode_dirty_map (ZORDERINFO* zi);
+ZNODEDIRTYMAP* __kernel_attach_znode_dirty_map (const ZORDERINFO* zi);
+void __kernel_detach_znode_dirty_map (ZNODEDIRTYMAP* map);
+#endif
 int __kernel_get_window_region (HWND pWin, CLIPRGN* region);
 int __kernel_get_next_znode (const ZORDERINFO* zi, int from);
 int __kernel_get_prev_znode (const ZORDERINFO* zi, int from);
@@ -63,138 +63,517 @@
 #include "constants.h"
 #include "misc.h"
 
-BOOL InitBlockDataHeap (PBLOCKHEAP heap, size_t sz_block, size_t sz_heap)
+/*
+ * Since 5.0.16, a block heap consists of one or more segments. The first
+ * segment has the initial size of the heap; when there is no free block,
+ * the heap grows by a new segment instead of allocating the block from
+ * the system heap. The free blocks of all segments are linked in an
+ * intrusive free list, so allocating and freeing a block are both O(1).
+ * The segments are only released when the heap is destroyed.
+ *
+ * The state of the segments lives in a private structure pointed to by
+ * the member heap of BLOCKHEAP, so the layout of BLOCKHEAP does not change.
+ *
+ * When virtual window is enabled, every thread keeps a small cache of free
+ * blocks for each heap it uses, and only takes the lock of the heap to
+ * move a batch of blocks between its cache and the heap.
+ */
+
+#define MIN_BLOCKS_PER_SEGMENT      64
+
+typedef struct _BLOCKSEG {
+    struct _BLOCKSEG* next;
+} BLOCKSEG;
+
+typedef struct _BLOCKHEAPDATA {
+    /* the list of free blocks */
+    void*           free_list;
+    /* the list of segments */
+    BLOCKSEG*       segments;
+
+    size_t          nr_blocks;
+    size_t          nr_segments;
+    /* the blocks out of the free list, including the ones cached
+       by the threads */
+    size_t          nr_used;
+    size_t          max_used;
+    size_t          nr_grows;
+    size_t          nr_failures;
+
+    /* the serial number of the heap */
+    unsigned long   serial;
+} BLOCKHEAPDATA;
+
+#define HEAP_DATA(heap)             ((BLOCKHEAPDATA*)(heap)->heap)
+
+#define NEXT_FREE_BLOCK(block)      (*(void**)(block))
+
+#define SIZE_SEG_HEADER \
+    ROUND_TO_MULTIPLE (sizeof (BLOCKSEG), SIZEOF_PTR * 2)
+
+/* allocate a new segment and link its blocks to the free list */
+static BOOL grow_heap (PBLOCKHEAP heap)
+{
+    BLOCKHEAPDATA* hd = HEAP_DATA (heap);
+    size_t i, nr_blocks;
+    BLOCKSEG* seg;
+    unsigned char* block;
+
+    nr_blocks = heap->sz_heap;
+    if (hd->nr_segments > 0 && nr_blocks < MIN_BLOCKS_PER_SEGMENT)
+        nr_blocks = MIN_BLOCKS_PER_SEGMENT;
+
+    seg = malloc (SIZE_SEG_HEADER + heap->sz_block * nr_blocks);
+    if (seg == NULL)
+        return FALSE;
+
+    seg->next = hd->segments;
+    hd->segments = seg;
+    if (hd->nr_segments > 0) {
+        hd->nr_grows++;
+        heap->nr_alloc += nr_blocks;
+    }
+    hd->nr_segments++;
+    hd->nr_blocks += nr_blocks;
+
+    block = (unsigned char*)seg + SIZE_SEG_HEADER;
+    for (i = 0; i < nr_blocks; i++) {
+        NEXT_FREE_BLOCK (block) = hd->free_list;
+        hd->free_list = block;
+        block += heap->sz_block;
+    }
+
+    _DBG_PRINTF ("Block heap %p grows to %zu blocks in %zu segments\n",
+            heap, hd->nr_blocks, hd->nr_segments);
+    return TRUE;
+}
+
+/* take one block from the free list of the heap; the heap must be locked */
+static inline void* take_free_block (PBLOCKHEAP heap)
 {
+    BLOCKHEAPDATA* hd = HEAP_DATA (heap);
+    void* block;
+
+    if (hd->free_list == NULL && !grow_heap (heap)) {
+        hd->nr_failures++;
+        return NULL;
+    }
+
+    block = hd->free_list;
+    hd->free_list = NEXT_FREE_BLOCK (block);
+
+    hd->nr_used++;
+    if (hd->nr_used > hd->max_used)
+        hd->max_used = hd->nr_used;
+    return block;
+}
+
 #ifdef _MGHAVE_VIRTUAL_WINDOW
-    pthread_mutex_init (&heap->lock, NULL);
-#endif
 
-    heap->sz_usage_bmp = (sz_heap + 7) >> 3;
+#define NR_CACHED_HEAPS             8
+#define NR_BLOCKS_PER_BATCH         16
+
+typedef struct _BLOCKCACHE {
+    PBLOCKHEAP      heap;
+    unsigned long   serial;
+    size_t          nr_blocks;
+    void*           blocks;
+} BLOCKCACHE;
+
+typedef struct _THREADBLOCKCACHES {
+    /* the list of the caches of all threads */
+    struct _THREADBLOCKCACHES* prev;
+    struct _THREADBLOCKCACHES* next;
+
+    BLOCKCACHE      caches [NR_CACHED_HEAPS];
+} THREADBLOCKCACHES;
+
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+/*
+ * The live heaps, used to check whether a cached heap is still alive, and
+ * the caches of all threads. The members heap and serial of a cache are
+ * only changed with heaps_lock held, so that DestroyBlockDataHeap() can
+ * find the blocks cached by other threads.
+ */
+static pthread_mutex_t heaps_lock = PTHREAD_MUTEX_INITIALIZER;
+static PBLOCKHEAP* live_heaps;
+static int nr_live_heaps, max_live_heaps;
+static unsigned long heap_serial;
+static THREADBLOCKCACHES* thread_caches;
+
+static BOOL is_heap_alive (PBLOCKHEAP heap, unsigned long serial)
+{
+    int i;
+
+    for (i = 0; i < nr_live_heaps; i++) {
+        if (live_heaps [i] == heap)
+            return HEAP_DATA (heap)->serial == serial;
+    }
+
+    return FALSE;
+}
+
+/* return a list of blocks to the heap */
+static void put_blocks_to_heap (PBLOCKHEAP heap, void* first, void* last,
+        size_t nr_blocks)
+{
+    BLOCKHEAPDATA* hd = HEAP_DATA (heap);
+
+    pthread_mutex_lock (&heap->lock);
+    NEXT_FREE_BLOCK (last) = hd->free_list;
+    hd->free_list = first;
+    hd->nr_used -= nr_blocks;
+    pthread_mutex_unlock (&heap->lock);
+}
+
+/* return all cached blocks to the heap if it is still alive;
+   heaps_lock must be held */
+static void flush_block_cache (BLOCKCACHE* cache)
+{
+    if (cache->heap && cache->nr_blocks > 0 &&
+            is_heap_alive (cache->heap, cache->serial)) {
+        void* last = cache->blocks;
+
+        while (NEXT_FREE_BLOCK (last))
+            last = NEXT_FREE_BLOCK (last);
+        put_blocks_to_heap (cache->heap, cache->blocks, last,
+                cache->nr_blocks);
+    }
+
+    cache->heap = NULL;
+    cache->nr_blocks = 0;
+    cache->blocks = NULL;
+}
+
+static void destroy_thread_caches (void* data)
+{
+    THREADBLOCKCACHES* tcaches = data;
+    int i;
+
+    pthread_mutex_lock (&heaps_lock);
+    for (i = 0; i < NR_CACHED_HEAPS; i++)
+        flush_block_cache (tcaches->caches + i);
+
+    if (tcaches->prev)
+        tcaches->prev->next = tcaches->next;
+    else
+        thread_caches = tcaches->next;
+    if (tcaches->next)
+        tcaches->next->prev = tcaches->prev;
+    pthread_mutex_unlock (&heaps_lock);
+
+    free (tcaches);
+}
+
+static void create_cache_key (void)
+{
+    pthread_key_create (&cache_key, destroy_thread_caches);
+}
+
+/* get the cache of the heap for the current thread; NULL on error */
+static BLOCKCACHE* get_block_cache (PBLOCKHEAP heap)
+{
+    THREADBLOCKCACHES* tcaches;
+    BLOCKCACHE* victim = NULL;
+    unsigned long serial = HEAP_DATA (heap)->serial;
+    int i;
+
+    tcaches = pthread_getspecific (cache_key);
+    if (MG_UNLIKELY (tcaches == NULL)) {
+        tcaches = calloc (1, sizeof (THREADBLOCKCACHES));
+        if (tcaches == NULL || pthread_setspecific (cache_key, tcaches)) {
+            free (tcaches);
+            return NULL;
+        }
+
+        pthread_mutex_lock (&heaps_lock);
+        tcaches->next = thread_caches;
+        if (thread_caches)
+            thread_caches->prev = tcaches;
+        thread_caches = tcaches;
+        pthread_mutex_unlock (&heaps_lock);
+    }
+
+    for (i = 0; i < NR_CACHED_HEAPS; i++) {
+        BLOCKCACHE* cache = tcaches->caches + i;
+
+        if (cache->heap == heap && cache->serial == serial)
+            return cache;
+    }
+
+    pthread_mutex_lock (&heaps_lock);
+    for (i = 0; i < NR_CACHED_HEAPS; i++) {
+        BLOCKCACHE* cache = tcaches->caches + i;
+
+        if (cache->heap == heap) {
+            /* the heap was destroyed and a new one lives at the same
+               address; the cached blocks have gone with the old heap. */
+            cache->nr_blocks = 0;
+            cache->blocks = NULL;
+            victim = cache;
+            break;
+        }
+
+        if (victim == NULL || cache->heap == NULL ||
+                (victim->heap && cache->nr_blocks < victim->nr_blocks))
+            victim = cache;
+    }
+
+    flush_block_cache (victim);
+    victim->heap = heap;
+    victim->serial = serial;
+    pthread_mutex_unlock (&heaps_lock);
+    return victim;
+}
+
+/*
+ * Count the free blocks of the heap cached by all threads, and forget them.
+ * The heap must not be used by any other thread when it is destroyed,
+ * so the caches of the heap do not change meanwhile.
+ */
+static size_t drop_cached_blocks (PBLOCKHEAP heap)
+{
+    THREADBLOCKCACHES* tcaches;
+    unsigned long serial = HEAP_DATA (heap)->serial;
+    size_t nr_cached = 0;
+    int i;
+
+    pthread_mutex_lock (&heaps_lock);
+    for (tcaches = thread_caches; tcaches; tcaches = tcaches->next) {
+        for (i = 0; i < NR_CACHED_HEAPS; i++) {
+            BLOCKCACHE* cache = tcaches->caches + i;
+
+            if (cache->heap == heap && cache->serial == serial) {
+                nr_cached += cache->nr_blocks;
+                cache->heap = NULL;
+                cache->nr_blocks = 0;
+                cache->blocks = NULL;
+            }
+        }
+    }
+    pthread_mutex_unlock (&heaps_lock);
+
+    return nr_cached;
+}
+
+static void register_heap (PBLOCKHEAP heap)
+{
+    pthread_once (&cache_key_once, create_cache_key);
+
+    pthread_mutex_lock (&heaps_lock);
+    HEAP_DATA (heap)->serial = ++heap_serial;
+    if (nr_live_heaps >= max_live_heaps) {
+        int new_max = max_live_heaps ? max_live_heaps * 2 : 16;
+        PBLOCKHEAP* new_heaps;
+
+        new_heaps = realloc (live_heaps, sizeof (PBLOCKHEAP) * new_max);
+        if (new_heaps) {
+            live_heaps = new_heaps;
+            max_live_heaps = new_max;
+        }
+    }
+
+    /* a heap not registered is never flushed from the thread caches */
+    if (nr_live_heaps < max_live_heaps)
+        live_heaps [nr_live_heaps++] = heap;
+    pthread_mutex_unlock (&heaps_lock);
+}
+
+static void unregister_heap (PBLOCKHEAP heap)
+{
+    int i;
+
+    pthread_mutex_lock (&heaps_lock);
+    for (i = 0; i < nr_live_heaps; i++) {
+        if (live_heaps [i] == heap) {
+            live_heaps [i] = live_heaps [--nr_live_heaps];
+            break;
+        }
+    }
+
+    if (nr_live_heaps == 0) {
+        free (live_heaps);
+        live_heaps = NULL;
+        max_live_heaps = 0;
+    }
+    pthread_mutex_unlock (&heaps_lock);
+}
+
+#endif  /* defined _MGHAVE_VIRTUAL_WINDOW */
+
+BOOL InitBlockDataHeap (PBLOCKHEAP heap, size_t sz_block, size_t sz_heap)
+{
+    memset (heap, 0, sizeof (BLOCKHEAP));
+
     heap->sz_block = ROUND_TO_MULTIPLE (sz_block, SIZEOF_PTR);
-    heap->sz_heap = heap->sz_usage_bmp << 3;
-    heap->nr_alloc = 0;
+    heap->sz_heap = sz_heap;
 
     if (heap->sz_heap == 0 || heap->sz_block == 0)
-        goto failed;
+        return FALSE;
 
-    if ((heap->heap = calloc (heap->sz_heap, heap->sz_block)) == NULL)
-        goto failed;
+    if ((heap->heap = calloc (1, sizeof (BLOCKHEAPDATA))) == NULL)
+        return FALSE;
 
-    if ((heap->usage_bmp = calloc (heap->sz_usage_bmp, sizeof (char))) == NULL) {
+    if (!grow_heap (heap)) {
         free (heap->heap);
-        goto failed;
+        heap->heap = NULL;
+        return FALSE;
     }
 
-    memset (heap->usage_bmp, 0xFF, heap->sz_usage_bmp);
-    return TRUE;
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_mutex_init (&heap->lock, NULL);
+    register_heap (heap);
+#endif
 
-failed:
-    heap->heap = NULL;
-    heap->usage_bmp = NULL;
-    return FALSE;
+    return TRUE;
 }
 
 void* BlockDataAlloc (PBLOCKHEAP heap)
 {
-    int free_slot;
-    unsigned char* block_data = NULL;
+    void* block_data;
 
 #ifdef _MGHAVE_VIRTUAL_WINDOW
-    pthread_mutex_lock (&heap->lock);
-#endif
+    BLOCKCACHE* cache = get_block_cache (heap);
 
-    free_slot = __mg_lookfor_unused_slot (heap->usage_bmp, heap->sz_usage_bmp, 1);
-    if (free_slot >= 0) {
-        block_data = heap->heap + heap->sz_block * free_slot;
-        _DBG_PRINTF ("Allocated one block in the block heap: %p (%d)\n",
-                heap, free_slot);
-        goto ret;
-    }
+    if (MG_LIKELY (cache)) {
+        if (cache->nr_blocks == 0) {
+            /* refill the cache with a batch of blocks */
+            pthread_mutex_lock (&heap->lock);
+            while (cache->nr_blocks < NR_BLOCKS_PER_BATCH) {
+                void* block = take_free_block (heap);
+                if (block == NULL)
+                    break;
 
-    if ((block_data = calloc (1, heap->sz_block)) == NULL)
-        goto ret;
+                NEXT_FREE_BLOCK (block) = cache->blocks;
+                cache->blocks = block;
+                cache->nr_blocks++;
+            }
+            pthread_mutex_unlock (&heap->lock);
 
-    heap->nr_alloc++;
+            if (cache->nr_blocks == 0)
+                return NULL;
+        }
 
-ret:
+        block_data = cache->blocks;
+        cache->blocks = NEXT_FREE_BLOCK (block_data);
+        cache->nr_blocks--;
+        return block_data;
+    }
 
-#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_mutex_lock (&heap->lock);
+    block_data = take_free_block (heap);
     pthread_mutex_unlock (&heap->lock);
+#else
+    block_data = take_free_block (heap);
 #endif
+
     return block_data;
 }
 
 void BlockDataFree (PBLOCKHEAP heap, void* data)
 {
-    unsigned char* block_data = data;
-
 #ifdef _MGHAVE_VIRTUAL_WINDOW
-    pthread_mutex_lock (&heap->lock);
-#endif
+    BLOCKCACHE* cache = get_block_cache (heap);
+
+    if (MG_LIKELY (cache)) {
+        NEXT_FREE_BLOCK (data) = cache->blocks;
+        cache->blocks = data;
+        cache->nr_blocks++;
 
-    if (block_data < heap->heap ||
-            block_data > (heap->heap + heap->sz_block * heap->sz_heap)) {
-        free (block_data);
-        heap->nr_alloc--;
+        if (cache->nr_blocks >= NR_BLOCKS_PER_BATCH * 2) {
+            /* return a batch of blocks to the heap */
+            void* first = cache->blocks;
+            void* last = first;
+            size_t i;
+
+            for (i = 1; i < NR_BLOCKS_PER_BATCH; i++)
+                last = NEXT_FREE_BLOCK (last);
+
+            cache->blocks = NEXT_FREE_BLOCK (last);
+            cache->nr_blocks -= NR_BLOCKS_PER_BATCH;
+            put_blocks_to_heap (heap, first, last, NR_BLOCKS_PER_BATCH);
+        }
+        return;
     }
-    else {
-        int slot;
-        slot = (block_data - heap->heap) / heap->sz_block;
-        __mg_slot_clear_use (heap->usage_bmp, slot);
 
-        _DBG_PRINTF ("Freed one block in the block heap: %p (%d)\n",
-                heap, slot);
+    put_blocks_to_heap (heap, data, data, 1);
+#else
+    {
+        BLOCKHEAPDATA* hd = HEAP_DATA (heap);
+
+        NEXT_FREE_BLOCK (data) = hd->free_list;
+        hd->free_list = data;
+        hd->nr_used--;
     }
+#endif
+}
+
+BOOL GetBlockDataHeapStats (PBLOCKHEAP heap, BLOCKHEAPSTATS* stats)
+{
+    BLOCKHEAPDATA* hd;
+
+    if (heap == NULL || stats == NULL || heap->heap == NULL)
+        return FALSE;
+
+    hd = HEAP_DATA (heap);
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_mutex_lock (&heap->lock);
+#endif
+
+    stats->nr_blocks = hd->nr_blocks;
+    stats->nr_segments = hd->nr_segments;
+    stats->nr_used = hd->nr_used;
+    stats->max_used = hd->max_used;
+    stats->nr_grows = hd->nr_grows;
+    stats->nr_failures = hd->nr_failures;
 
 #ifdef _MGHAVE_VIRTUAL_WINDOW
     pthread_mutex_unlock (&heap->lock);
 #endif
+    return TRUE;
 }
 
 void DestroyBlockDataHeap (PBLOCKHEAP heap)
 {
-    int nr_free_slots;
+    BLOCKHEAPDATA* hd = HEAP_DATA (heap);
+    size_t nr_used;
+    BLOCKSEG* seg;
 
-    if (heap->nr_alloc > 0) {
-        _WRN_PRINTF ("There are still not freed extra blocks in the block heap: %p (%zu)\n",
-                heap, heap->nr_alloc);
-    }
+    if (hd == NULL)
+        return;
 
-    nr_free_slots = __mg_get_nr_idle_slots (heap->usage_bmp, heap->sz_usage_bmp);
-    if (nr_free_slots != heap->sz_heap) {
-        _WRN_PRINTF ("There are still not freed blocks in the block heap: %p (%zu)\n",
-                heap, heap->sz_heap - nr_free_slots);
-
-#ifdef _DEBUG
-        {
-            unsigned char* bitmap = heap->usage_bmp;
-            int slot = 0;
-            int i, j;
-
-            for (i = 0; i < heap->sz_usage_bmp; i++) {
-                for (j = 0; j < 8; j++) {
-                    if (!(*bitmap & (0x80 >> j))) {
-                        _WRN_PRINTF ("Still used slot in the block heap: %p (%d)\n",
-                                heap, slot);
-                    }
-                    slot++;
-                }
-                bitmap++;
-            }
-        }
+    nr_used = hd->nr_used;
 
-        assert (0);
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    unregister_heap (heap);
+
+    /* the blocks cached by the threads are free, not in use */
+    nr_used -= drop_cached_blocks (heap);
 #endif
+
+    if (nr_used > 0) {
+        _WRN_PRINTF ("There are still not freed blocks in the block heap: %p (%zu)\n",
+                heap, nr_used);
     }
 
-    free (heap->heap);
-    heap->heap = NULL;
+    _DBG_PRINTF ("Block heap %p: %zu blocks in %zu segments; max used: %zu\n",
+            heap, hd->nr_blocks, hd->nr_segments, hd->max_used);
 
-    free (heap->usage_bmp);
-    heap->usage_bmp = NULL;
+    seg = hd->segments;
+    while (seg) {
+        BLOCKSEG* next = seg->next;
+        free (seg);
+        seg = next;
+    }
+
+    free (hd);
+    heap->heap = NULL;
+    heap->nr_alloc = 0;
 
 #ifdef _MGHAVE_VIRTUAL_WINDOW
     pthread_mutex_destroy (&heap->lock);
 #endif
 }
-
@@ -44,7 +44,7 @@
  *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
  */
 /*
-** compsor-fallback.c: the fallback compositor.
+** compsor-fallback.c: the fallback compositor and the tiled compositor.
 **
 ** Create date: 2020-01-19
 **
@@ -55,15 +55,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "common.h"
 
 #if defined(_MGRM_PROCESSES) && defined(_MGSCHEMA_COMPOSITING)
 
+#include <pthread.h>
+
 #include "minigui.h"
 #include "gdi.h"
 #include "window.h"
 #include "debug.h"
+#include "newgal.h"
+#include "dc.h"
 
 #define SIZE_CLIPRC_HEAP        64
 
@@ -85,8 +90,21 @@ struct _CompositorCtxt {
     int         offx;       // the offset for the general znodes.
     int         offy;
     BOOL        scaled;     // is scaled?
+
+    /* Since 5.0.16: the engine of the tiled compositor; NULL for serial. */
+    struct _TILEDENGINE* tiled;
+
+    /* Since 5.0.16: the cached regions of the opaque window znodes
+       above a window znode of the topmost layer, indexed by the znode
+       index; the one for zidx 0 (the wallpaper) covers all opaque window
+       znodes. They are rebuilt only after the window znodes changed. */
+    CLIPRGN*    occluded_rgns;
+    int         nr_occluded_rgns;
+    BOOL        occluded_valid;
 };
 
+static BOOL composite_tiles (CompositorCtxt* ctxt, int from);
+
 static CompositorCtxt* initialize (const char* name)
 {
     CompositorCtxt* ctxt;
@@ -105,6 +123,11 @@ static CompositorCtxt* initialize (const char* name)
         ctxt->offx = 0;
         ctxt->offy = 0;
         ctxt->scaled = FALSE;
+        ctxt->tiled = NULL;
+
+        ctxt->occluded_rgns = NULL;
+        ctxt->nr_occluded_rgns = 0;
+        ctxt->occluded_valid = FALSE;
     }
 
     return ctxt;
@@ -113,6 +136,12 @@ static CompositorCtxt* initialize (const char* name)
 static void terminate (CompositorCtxt* ctxt)
 {
     if (ctxt) {
+        int i;
+
+        for (i = 0; i < ctxt->nr_occluded_rgns; i++)
+            EmptyClipRgn (ctxt->occluded_rgns + i);
+        free (ctxt->occluded_rgns);
+
         EmptyClipRgn (&ctxt->wins_rgn);
         EmptyClipRgn (&ctxt->dirty_rgn);
         EmptyClipRgn (&ctxt->inv_rgn);
@@ -121,13 +150,99 @@ static void terminate (CompositorCtxt* ctxt)
     }
 }
 
-/* return the number of subtracted windows above */
+static inline void invalidate_occluded_regions (CompositorCtxt* ctxt)
+{
+    ctxt->occluded_valid = FALSE;
+}
+
+static BOOL rebuild_occluded_regions (CompositorCtxt* ctxt)
+{
+    CLIPRGN above_rgn;
+    int i, next;
+
+    for (i = 0; i < ctxt->nr_occluded_rgns; i++)
+        EmptyClipRgn (ctxt->occluded_rgns + i);
+
+    InitClipRgn (&above_rgn, &ctxt->cliprc_heap);
+
+    /* walk the window znodes from top to bottom */
+    next = ServerGetNextZNode (NULL, 0, NULL);
+    while (next > 0) {
+        const ZNODEHEADER* znode_hdr;
+        CLIPRGN* rgn;
+
+        if (next >= ctxt->nr_occluded_rgns) {
+            int nr = MAX (next + 1, ctxt->nr_occluded_rgns * 2);
+            CLIPRGN* rgns;
+
+            rgns = realloc (ctxt->occluded_rgns, sizeof (CLIPRGN) * nr);
+            if (rgns == NULL) {
+                EmptyClipRgn (&above_rgn);
+                return FALSE;
+            }
+
+            for (i = ctxt->nr_occluded_rgns; i < nr; i++)
+                InitClipRgn (rgns + i, &ctxt->cliprc_heap);
+            ctxt->occluded_rgns = rgns;
+            ctxt->nr_occluded_rgns = nr;
+        }
+
+        CopyRegion (ctxt->occluded_rgns + next, &above_rgn);
+
+        znode_hdr = ServerGetWinZNodeHeader (NULL, next, (void**)&rgn, FALSE);
+        assert (znode_hdr);
+
+        if ((znode_hdr->flags & ZNIF_VISIBLE) && rgn &&
+                (znode_hdr->ct & CT_SYSTEM_MASK) == CT_OPAQUE) {
+            UnionRegion (&above_rgn, &above_rgn, rgn);
+        }
+
+        next = ServerGetNextZNode (NULL, next, NULL);
+    }
+
+    if (ctxt->nr_occluded_rgns > 0)
+        CopyRegion (ctxt->occluded_rgns, &above_rgn);
+
+    EmptyClipRgn (&above_rgn);
+    ctxt->occluded_valid = TRUE;
+    return TRUE;
+}
+
+/* Returns the cached region of the opaque window znodes above the znode;
+   NULL if the cache is not available. */
+static const CLIPRGN* get_occluded_region (CompositorCtxt* ctxt, int zidx)
+{
+    /* only cache the znodes of the topmost layer, not the combined ones */
+    if (ctxt->layer)
+        return NULL;
+
+    if (!ctxt->occluded_valid && !rebuild_occluded_regions (ctxt))
+        return NULL;
+
+    if (zidx < 0 || zidx >= ctxt->nr_occluded_rgns)
+        return NULL;
+
+    return ctxt->occluded_rgns + zidx;
+}
+
+/* return the number of subtracted windows above; or 1 for the cached
+   region of the opaque windows above */
 static int subtract_opaque_win_znodes_above_ex (CompositorCtxt* ctxt, CLIPRGN* dirty_rgn, int from)
 {
     const ZNODEHEADER* znode_hdr;
+    const CLIPRGN* occluded_rgn;
     int nr_subtracted = 0;
     int prev;
 
+    occluded_rgn = get_occluded_region (ctxt, from);
+    if (occluded_rgn) {
+        if (IsEmptyClipRgn (occluded_rgn))
+            return 0;
+
+        SubtractRegion (dirty_rgn, dirty_rgn, occluded_rgn);
+        return 1;
+    }
+
     /* subtract opaque window znodes */
     prev = ServerGetPrevZNode (ctxt->layer, from, NULL);
     while (prev > 0) {
@@ -164,31 +279,24 @@ static inline void tile_dirty_region_for_wallpaper (CompositorCtxt* ctxt)
     if (wp_w > 0 && wp_h > 0) {
 
         // tile the dirty region of the wallpaper pattern
-        int y = 0;
-        int left_h = RECTH (ctxt->rc_screen);
-
-        CopyRegion (&ctxt->inv_rgn, &ctxt->dirty_rgn);
-        while (left_h > 0) {
-
-            int x = 0;
-            int left_w = RECTW (ctxt->rc_screen);
-
-            while (left_w > 0) {
-                if (x > 0 || y > 0) {
-                    OffsetRegion (&ctxt->inv_rgn, x, y);
-                    UnionRegion (&ctxt->dirty_rgn,
-                            &ctxt->dirty_rgn, &ctxt->inv_rgn);
-                    OffsetRegion (&ctxt->inv_rgn, -x, -y);
-                }
-
-                x += wp_w;
-                left_w -= wp_w;
-            }
+        int span;
+
+        /* Since 5.0.16, double the tiled span every time instead of
+           merging the region once for every pattern cell; the copies
+           out of the screen are clipped at last. */
+        for (span = wp_w; span < RECTW (ctxt->rc_screen); span *= 2) {
+            CopyRegion (&ctxt->inv_rgn, &ctxt->dirty_rgn);
+            OffsetRegion (&ctxt->inv_rgn, span, 0);
+            UnionRegion (&ctxt->dirty_rgn, &ctxt->dirty_rgn, &ctxt->inv_rgn);
+        }
 
-            left_h -= wp_h;
-            y += wp_h;
+        for (span = wp_h; span < RECTH (ctxt->rc_screen); span *= 2) {
+            CopyRegion (&ctxt->inv_rgn, &ctxt->dirty_rgn);
+            OffsetRegion (&ctxt->inv_rgn, 0, span);
+            UnionRegion (&ctxt->dirty_rgn, &ctxt->dirty_rgn, &ctxt->inv_rgn);
         }
 
+        IntersectClipRect (&ctxt->dirty_rgn, &ctxt->rc_screen);
         EmptyClipRgn (&ctxt->inv_rgn);
     }
 }
@@ -201,13 +309,13 @@ static void composite_wallpaper_rect (CompositorCtxt* ctxt,
 
     if (wp_w > 0 && wp_h > 0) {
 
-        // tile the wallpaper pattern
-        int y = 0;
-        int left_h = RECTH (ctxt->rc_screen);
+        // tile the wallpaper pattern; only the cells in the dirty rect
+        int y = dirty_rc->top - dirty_rc->top % wp_h;
+        int left_h = dirty_rc->bottom - y;
         while (left_h > 0) {
 
-            int x = 0;
-            int left_w = RECTW (ctxt->rc_screen);
+            int x = dirty_rc->left - dirty_rc->left % wp_w;
+            int left_w = dirty_rc->right - x;
             while (left_w > 0) {
                 RECT rc = { x, y, x + wp_w, y + wp_h };
                 RECT eff_rc;
@@ -481,6 +589,12 @@ static void composite_on_dirty_region (CompositorCtxt* ctxt, int from)
         }
     }
 
+    /* Since 5.0.16: composite the tiles of the dirty region in parallel */
+    if (ctxt->tiled && composite_tiles (ctxt, from)) {
+        EmptyClipRgn (&ctxt->dirty_rgn);
+        goto done;
+    }
+
     // save the dirty region temporarily
     CopyRegion (&lucent_dirty_rgn, &ctxt->dirty_rgn);
 
@@ -598,6 +712,7 @@ static void purge_ppp_data (CompositorCtxt* ctxt, int zidx, void* data)
 static void purge_win_data (CompositorCtxt* ctxt, MG_Layer* layer,
         int zidx, void* data)
 {
+    invalidate_occluded_regions (ctxt);
     EmptyClipRgn ((CLIPRGN*)data);
     mg_slice_delete (CLIPRGN, data);
 }
@@ -779,6 +894,10 @@ static void on_dirty_screen (CompositorCtxt* ctxt,
     else if (layer != mgTopmostLayer)
         return;
 
+    /* the window znodes may have been changed, except for popup menus */
+    if (cause_type != ZNIT_POPUPMENU)
+        invalidate_occluded_regions (ctxt);
+
     /* generate the dirty region */
     if (rc_dirty) {
         SetClipRgn (&ctxt->dirty_rgn, &ctxt->rc_screen);
@@ -833,6 +952,7 @@ static void on_showing_win (CompositorCtxt* ctxt, MG_Layer* layer, int zidx)
 
     _DBG_PRINTF ("called: %d for layer %s\n", zidx, layer->name);
 
+    invalidate_occluded_regions (ctxt);
     ServerGetWinZNodeHeader (layer, zidx, (void**)&rgn, FALSE);
     if (rgn == NULL) {
         rgn = mg_slice_new (CLIPRGN);
@@ -849,6 +969,7 @@ static void on_hiding_win (CompositorCtxt* ctxt, MG_Layer* layer, int zidx)
 
     _DBG_PRINTF ("called: %d for layer %s\n", zidx, layer->name);
 
+    invalidate_occluded_regions (ctxt);
     znode_hdr = ServerGetWinZNodeHeader (layer, zidx, (void**)&rgn, FALSE);
     assert (znode_hdr);
 
@@ -865,6 +986,9 @@ static void refresh_win (CompositorCtxt* ctxt, MG_Layer* layer, int zidx)
     const ZNODEHEADER* znode_hdr;
     CLIPRGN* rgn = NULL;
 
+    /* the z-order or the compositing type changed */
+    invalidate_occluded_regions (ctxt);
+
     znode_hdr = ServerGetWinZNodeHeader (layer, zidx, (void**)&rgn, FALSE);
     assert(znode_hdr);
 
@@ -901,6 +1025,7 @@ static void on_moved_win (CompositorCtxt* ctxt, MG_Layer* layer, int zidx,
     // re-generate the region
     ServerGetWinZNodeRegion (layer, zidx, RGN_OP_SET | RGN_OP_FLAG_ABS, rgn);
     ServerSetWinZNodePrivateData (layer, zidx, rgn);
+    invalidate_occluded_regions (ctxt);
 
     // the fallback compositor only manages general znodes on the topmost layer.
     if (!(znode_hdr->flags & ZOF_IF_SPECIAL) && layer != mgTopmostLayer)
@@ -939,6 +1064,7 @@ static void on_changed_rgn (CompositorCtxt* ctxt, MG_Layer* layer,
     // re-generate the region
     ServerGetWinZNodeRegion (layer, zidx, RGN_OP_SET | RGN_OP_FLAG_ABS, rgn);
     ServerSetWinZNodePrivateData (layer, zidx, rgn);
+    invalidate_occluded_regions (ctxt);
 
     /* the fallback compositor only manages general znodes on the topmost layer. */
     if (!(znode_hdr->flags & ZOF_IF_SPECIAL) && layer != mgTopmostLayer)
@@ -958,6 +1084,8 @@ done:
 static void on_layer_op (CompositorCtxt* ctxt, int layer_op,
             MG_Layer* layer, MG_Client* client)
 {
+    invalidate_occluded_regions (ctxt);
+
     if (layer_op == LCO_TOPMOST_CHANGED) {
         _DBG_PRINTF ("Topmost layer changed to %s\n", mgTopmostLayer->name);
         refresh (ctxt);
@@ -1351,6 +1479,789 @@ CompositorOps __mg_fallback_compositor = {
     transit_to_layer: transit_to_layer,
 };
 
+/*
+ * The tiled compositor (since 5.0.16).
+ *
+ * The tiled compositor shares all operations with the fallback compositor,
+ * but it splits the dirty region into horizontal tiles and composites
+ * the tiles in parallel by a pool of worker threads. The main thread
+ * collects the visible window znodes intersected with the dirty region
+ * and prepares the software blits for them once per frame; then every
+ * worker takes the tiles one by one and composites the znodes touching
+ * the tile directly to the screen surface.
+ *
+ * A frame falls back to the serial compositing if any znode needs
+ * a blit which can not be done by the software blitters, for example,
+ * a hardware accelerated blit or an RLE encoded surface.
+ */
+#define MAX_TILE_THREADS        16
+#define NR_TILES_PER_THREAD     4
+#define MIN_TILE_HEIGHT         16
+#define MIN_TILED_AREA          (128 * 128)
+
+typedef struct _TILEZNODE {
+    const ZNODEHEADER*  hdr;
+    const CLIPRGN*      rgn;
+    int                 zidx;
+    BOOL                opaque;
+
+    /* the cached region of the opaque znodes above; may be NULL */
+    const CLIPRGN*      occluded;
+
+    /* the screen position of the source pixel (0, 0) */
+    int                 origin_x;
+    int                 origin_y;
+
+    /* the effective size of the source pixels */
+    int                 src_w;
+    int                 src_h;
+
+    GAL_Surface*        surf;
+    GAL_PreparedBlit    blit;
+
+    /* not NULL for a scaled znode */
+    GAL_StretchContext* stretch;
+
+    /* not NULL for a scaled znode which has a pixel format other than
+       the screen's; holds the scaled pixels to blit */
+    GAL_Surface*        scaled;
+} TILEZNODE;
+
+typedef struct _TILEWORKER {
+    struct _TILEDENGINE* engine;
+    pthread_t   th;
+
+    BLOCKHEAP   cliprc_heap;
+    CLIPRGN     dirty_rgn;  // the dirty region in the tile
+    CLIPRGN     lucent_rgn; // the dirty region for lucent znodes
+    CLIPRGN     my_rgn;     // the dirty region for a lucent znode
+    CLIPRGN     inv_rgn;    // the invalid region for a specific znode
+} TILEWORKER;
+
+typedef struct _TILEDENGINE {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond_start;
+    pthread_cond_t  cond_done;
+    unsigned int    frame;
+    int             nr_running; // the number of workers still running
+    int             next_tile;
+    BOOL            quit;
+
+    /* the main thread always works as the first worker */
+    int             nr_workers;
+    TILEWORKER      workers [MAX_TILE_THREADS];
+
+    /* the data of the current frame */
+    const CLIPRGN*  dirty_rgn;
+    GAL_Surface*    screen;
+
+    TILEZNODE*      znodes;
+    int             nr_znodes;
+    int             max_znodes;
+    int             first_opaque;
+
+    RECT*           tiles;
+    int*            nr_tile_znodes;
+    int*            tile_znodes;    // nr_tiles x nr_znodes
+    int             nr_tiles;
+    int             max_tiles;
+
+    /* the wallpaper */
+    int             wp_w;
+    int             wp_h;
+    GAL_PreparedBlit wp_blit;
+    Uint32          wp_pixel;
+} TILEDENGINE;
+
+static void draw_tile_znode (TILEDENGINE* engine, const TILEZNODE* tz,
+        const CLIPRGN* inv_rgn)
+{
+    GAL_Surface* screen = engine->screen;
+    int bpp = screen->format->BytesPerPixel;
+    const CLIPRECT* crc = inv_rgn->head;
+
+    while (crc) {
+        RECT rc = crc->rc;
+
+        if (tz->stretch && tz->scaled) {
+            const RECT* bound = &tz->rgn->rcBound;
+            int sbpp = tz->scaled->format->BytesPerPixel;
+            int y;
+
+            /* the tiles do not overlap, so the workers write different
+               lines of the scaled surface */
+            if (IntersectRect (&rc, &rc, bound)) {
+                GAL_Rect src_rect = { rc.left - bound->left,
+                        rc.top - bound->top, RECTW (rc), RECTH (rc) };
+                GAL_Rect dst_rect = { rc.left, rc.top,
+                        RECTW (rc), RECTH (rc) };
+
+                for (y = rc.top; y < rc.bottom; y++) {
+                    GAL_StretchLine (tz->stretch, y - bound->top,
+                            rc.left - bound->left, rc.right - bound->left,
+                            (Uint8*)tz->scaled->pixels +
+                            (y - bound->top) * tz->scaled->pitch +
+                            (rc.left - bound->left) * sbpp);
+                }
+
+                GAL_RunSoftBlit (&tz->blit, &src_rect, &dst_rect);
+            }
+        }
+        else if (tz->stretch) {
+            const RECT* bound = &tz->rgn->rcBound;
+            int y;
+
+            if (IntersectRect (&rc, &rc, bound)) {
+                for (y = rc.top; y < rc.bottom; y++) {
+                    GAL_StretchLine (tz->stretch, y - bound->top,
+                            rc.left - bound->left, rc.right - bound->left,
+                            (Uint8*)screen->pixels + y * screen->pitch +
+                            rc.left * bpp);
+                }
+            }
+        }
+        else {
+            RECT rc_src = { 0, 0, tz->src_w, tz->src_h };
+
+            OffsetRect (&rc, -tz->origin_x, -tz->origin_y);
+            if (IntersectRect (&rc, &rc, &rc_src)) {
+                GAL_Rect src_rect = { rc.left, rc.top,
+                        RECTW (rc), RECTH (rc) };
+                GAL_Rect dst_rect = { rc.left + tz->origin_x,
+                        rc.top + tz->origin_y, RECTW (rc), RECTH (rc) };
+
+                GAL_RunSoftBlit (&tz->blit, &src_rect, &dst_rect);
+            }
+        }
+
+        crc = crc->next;
+    }
+}
+
+static void draw_tile_wallpaper (TILEDENGINE* engine, const CLIPRGN* rgn)
+{
+    const CLIPRECT* crc = rgn->head;
+
+    while (crc) {
+        if (engine->wp_w > 0 && engine->wp_h > 0) {
+            int x, y;
+
+            // tile the wallpaper pattern
+            for (y = crc->rc.top - crc->rc.top % engine->wp_h;
+                    y < crc->rc.bottom; y += engine->wp_h) {
+                for (x = crc->rc.left - crc->rc.left % engine->wp_w;
+                        x < crc->rc.right; x += engine->wp_w) {
+                    RECT rc = { x, y, x + engine->wp_w, y + engine->wp_h };
+
+                    if (IntersectRect (&rc, &rc, &crc->rc)) {
+                        GAL_Rect src_rect = { rc.left - x, rc.top - y,
+                                RECTW (rc), RECTH (rc) };
+                        GAL_Rect dst_rect = { rc.left, rc.top,
+                                RECTW (rc), RECTH (rc) };
+
+                        GAL_RunSoftBlit (&engine->wp_blit,
+                                &src_rect, &dst_rect);
+                    }
+                }
+            }
+        }
+        else {
+            GAL_Rect dst_rect = { crc->rc.left, crc->rc.top,
+                    RECTW (crc->rc), RECTH (crc->rc) };
+
+            GAL_SoftFillRect (engine->screen, &dst_rect, engine->wp_pixel);
+        }
+
+        crc = crc->next;
+    }
+}
+
+static void composite_one_tile (TILEWORKER* worker, int tile)
+{
+    TILEDENGINE* engine = worker->engine;
+    const int* list = engine->tile_znodes + tile * engine->nr_znodes;
+    int nr = engine->nr_tile_znodes [tile];
+    int i, j;
+
+    CopyRegion (&worker->dirty_rgn, engine->dirty_rgn);
+    IntersectClipRect (&worker->dirty_rgn, engine->tiles + tile);
+    if (IsEmptyClipRgn (&worker->dirty_rgn))
+        return;
+
+    CopyRegion (&worker->lucent_rgn, &worker->dirty_rgn);
+
+    /* compositing the opaque znodes from top to bottom */
+    for (i = 0; i < nr; i++) {
+        const TILEZNODE* tz = engine->znodes + list [i];
+
+        if (!tz->opaque || list [i] < engine->first_opaque)
+            continue;
+
+        IntersectRegion (&worker->inv_rgn, &worker->dirty_rgn, tz->rgn);
+        if (!IsEmptyClipRgn (&worker->inv_rgn)) {
+            draw_tile_znode (engine, tz, &worker->inv_rgn);
+            SubtractRegion (&worker->dirty_rgn, &worker->dirty_rgn,
+                    &worker->inv_rgn);
+            if (IsEmptyClipRgn (&worker->dirty_rgn))
+                break;
+        }
+    }
+
+    /* compositing the wallpaper */
+    if (!IsEmptyClipRgn (&worker->dirty_rgn)) {
+        draw_tile_wallpaper (engine, &worker->dirty_rgn);
+        EmptyClipRgn (&worker->dirty_rgn);
+    }
+
+    /* compositing the lucent znodes from bottom to top */
+    for (i = nr - 1; i >= 0; i--) {
+        const TILEZNODE* tz = engine->znodes + list [i];
+
+        if (tz->opaque)
+            continue;
+
+        if (tz->occluded) {
+            SubtractRegion (&worker->my_rgn, &worker->lucent_rgn,
+                    tz->occluded);
+        }
+        else {
+            CopyRegion (&worker->my_rgn, &worker->lucent_rgn);
+            for (j = 0; j < i && !IsEmptyClipRgn (&worker->my_rgn); j++) {
+                const TILEZNODE* above = engine->znodes + list [j];
+                if (above->opaque)
+                    SubtractRegion (&worker->my_rgn, &worker->my_rgn,
+                            above->rgn);
+            }
+        }
+
+        if (IsEmptyClipRgn (&worker->my_rgn))
+            continue;
+
+        IntersectRegion (&worker->inv_rgn, &worker->my_rgn, tz->rgn);
+        if (!IsEmptyClipRgn (&worker->inv_rgn)) {
+            draw_tile_znode (engine, tz, &worker->inv_rgn);
+        }
+    }
+
+    EmptyClipRgn (&worker->lucent_rgn);
+    EmptyClipRgn (&worker->my_rgn);
+    EmptyClipRgn (&worker->inv_rgn);
+}
+
+static void composite_tiles_by_worker (TILEWORKER* worker)
+{
+    TILEDENGINE* engine = worker->engine;
+
+    while (1) {
+        int tile;
+
+        pthread_mutex_lock (&engine->lock);
+        if (engine->next_tile < engine->nr_tiles)
+            tile = engine->next_tile++;
+        else
+            tile = -1;
+        pthread_mutex_unlock (&engine->lock);
+
+        if (tile < 0)
+            break;
+
+        composite_one_tile (worker, tile);
+    }
+}
+
+static void* tile_worker_entry (void* arg)
+{
+    TILEWORKER* worker = (TILEWORKER*)arg;
+    TILEDENGINE* engine = worker->engine;
+    /* the workers are created with the engine, before the first frame;
+       do not read engine->frame here, the first frame may have been
+       started before this thread runs */
+    unsigned int frame = 0;
+
+    pthread_mutex_lock (&engine->lock);
+    while (1) {
+        while (!engine->quit && engine->frame == frame)
+            pthread_cond_wait (&engine->cond_start, &engine->lock);
+
+        if (engine->quit)
+            break;
+
+        frame = engine->frame;
+        pthread_mutex_unlock (&engine->lock);
+
+        composite_tiles_by_worker (worker);
+
+        pthread_mutex_lock (&engine->lock);
+        if (--engine->nr_running == 0)
+            pthread_cond_signal (&engine->cond_done);
+    }
+    pthread_mutex_unlock (&engine->lock);
+
+    return NULL;
+}
+
+static void release_tile_znodes (CompositorCtxt* ctxt, TILEDENGINE* engine)
+{
+    int i;
+
+    for (i = 0; i < engine->nr_znodes; i++) {
+        TILEZNODE* tz = engine->znodes + i;
+
+        if (tz->stretch) {
+            GAL_DestroyStretchContext (tz->stretch);
+            tz->stretch = NULL;
+        }
+        if (tz->scaled) {
+            GAL_FreeSurface (tz->scaled);
+            tz->scaled = NULL;
+        }
+        ServerReleaseWinZNodeHeader (ctxt->layer, tz->zidx);
+    }
+
+    engine->nr_znodes = 0;
+}
+
+/* Returns FALSE if the znode can not be composited by the workers. */
+static BOOL prepare_tile_znode (CompositorCtxt* ctxt, TILEDENGINE* engine,
+        TILEZNODE* tz)
+{
+    const ZNODEHEADER* znode_hdr = tz->hdr;
+    GAL_Surface* screen = engine->screen;
+    DWORD op = 0;
+    BOOL scaled = FALSE;
+
+    tz->opaque = FALSE;
+    switch (znode_hdr->ct & CT_SYSTEM_MASK) {
+    case CT_OPAQUE:
+        SetMemDCColorKey (znode_hdr->mem_dc, 0, 0);
+        SetMemDCAlpha (znode_hdr->mem_dc, 0, 0);
+        tz->opaque = TRUE;
+        break;
+
+    case CT_COLORKEY:
+        SetMemDCAlpha (znode_hdr->mem_dc, 0, 0);
+        SetMemDCColorKey (znode_hdr->mem_dc,
+                MEMDC_FLAG_SRCCOLORKEY,
+                DWORD2Pixel (znode_hdr->mem_dc, znode_hdr->ct_arg));
+        break;
+
+    case CT_ALPHACHANNEL:
+        SetMemDCColorKey (znode_hdr->mem_dc, 0, 0);
+        SetMemDCAlpha (znode_hdr->mem_dc,
+                MEMDC_FLAG_SRCALPHA, (BYTE)znode_hdr->ct_arg);
+        break;
+
+    case CT_ALPHAPIXEL:
+        SetMemDCColorKey (znode_hdr->mem_dc, 0, 0);
+        SetMemDCAlpha (znode_hdr->mem_dc,
+                MEMDC_FLAG_SRCPIXELALPHA, 0);
+        op = znode_hdr->ct_arg;
+        break;
+
+    default:
+        // CT_LOGICALPIXEL and CT_BLURRED are left to the serial compositing
+        return FALSE;
+    }
+
+    tz->surf = dc_HDC2PDC (znode_hdr->mem_dc)->surface;
+    tz->src_w = MIN (RECTW (znode_hdr->rc), tz->surf->w);
+    tz->src_h = MIN (RECTH (znode_hdr->rc), tz->surf->h);
+
+    if ((ctxt->offx || ctxt->offy || ctxt->scaled) &&
+            !(znode_hdr->flags & ZOF_IF_SPECIAL)) {
+        tz->origin_x = znode_hdr->rc.left + ctxt->offx;
+        tz->origin_y = znode_hdr->rc.top + ctxt->offy;
+        scaled = ctxt->scaled;
+    }
+    else {
+        tz->origin_x = znode_hdr->rc.left;
+        tz->origin_y = znode_hdr->rc.top;
+    }
+
+    if (scaled) {
+        const GAL_PixelFormat* sf = tz->surf->format;
+        const GAL_PixelFormat* df = screen->format;
+        int dst_w = RECTW (tz->rgn->rcBound);
+        int dst_h = RECTH (tz->rgn->rcBound);
+
+#ifdef _MGUSE_PIXMAN
+        /* the serial compositing scales the pixels by Pixman */
+        if (!(tz->surf->flags & GAL_SRCCOLORKEY))
+            return FALSE;
+#endif
+
+        if ((op & SCALING_FILTER_MASK) || (tz->surf->flags & GAL_RLEACCEL))
+            return FALSE;
+
+        /* like the serial compositing, the scaled pixels of the same
+           format are copied without blending. */
+        if (sf->Rmask == df->Rmask && sf->Gmask == df->Gmask &&
+                sf->Bmask == df->Bmask && sf->Amask == df->Amask) {
+            if (sf->BytesPerPixel != df->BytesPerPixel)
+                return FALSE;
+
+            tz->stretch = GAL_CreateStretchContext (df, GAL_STRETCH_NEAREST,
+                    tz->surf->pixels, tz->surf->pitch, tz->src_w, tz->src_h,
+                    dst_w, dst_h);
+            return tz->stretch != NULL;
+        }
+
+        /* the others are scaled to a surface of the source format,
+           then blitted with the colorkey and alpha settings. */
+        tz->stretch = GAL_CreateStretchContext (sf, GAL_STRETCH_NEAREST,
+                tz->surf->pixels, tz->surf->pitch, tz->src_w, tz->src_h,
+                dst_w, dst_h);
+        if (tz->stretch == NULL)
+            return FALSE;
+
+        tz->scaled = GAL_CreateScaledSurface (tz->surf, dst_w, dst_h);
+        if (tz->scaled == NULL)
+            return FALSE;
+
+        return GAL_PrepareSoftBlit (tz->scaled, screen, op, &tz->blit) == 0;
+    }
+
+    return GAL_PrepareSoftBlit (tz->surf, screen, op, &tz->blit) == 0;
+}
+
+static BOOL collect_tile_znodes (CompositorCtxt* ctxt, TILEDENGINE* engine,
+        const RECT* rc_dirty, int from)
+{
+    int next;
+
+    engine->nr_znodes = 0;
+    engine->first_opaque = (from < 0) ? 0 : -1;
+
+    next = ServerGetNextZNode (ctxt->layer, 0, NULL);
+    while (next > 0) {
+        const ZNODEHEADER* znode_hdr;
+        CLIPRGN* rgn;
+        TILEZNODE* tz;
+
+        if (next == from)
+            engine->first_opaque = engine->nr_znodes;
+
+        znode_hdr = ServerGetWinZNodeHeader (ctxt->layer, next,
+                (void**)&rgn, FALSE);
+        assert (znode_hdr);
+
+        if (!(znode_hdr->flags & ZNIF_VISIBLE) || rgn == NULL ||
+                !DoesIntersect (&rgn->rcBound, rc_dirty)) {
+            next = ServerGetNextZNode (ctxt->layer, next, NULL);
+            continue;
+        }
+
+        if (engine->nr_znodes == engine->max_znodes) {
+            int max = engine->max_znodes ? engine->max_znodes * 2 : 16;
+            TILEZNODE* znodes;
+
+            znodes = realloc (engine->znodes, sizeof (TILEZNODE) * max);
+            if (znodes == NULL)
+                return FALSE;
+
+            engine->znodes = znodes;
+            engine->max_znodes = max;
+        }
+
+        tz = engine->znodes + engine->nr_znodes;
+        tz->hdr = ServerGetWinZNodeHeader (ctxt->layer, next,
+                (void**)&rgn, TRUE);
+        tz->rgn = rgn;
+        tz->zidx = next;
+        tz->occluded = get_occluded_region (ctxt, next);
+        tz->stretch = NULL;
+        tz->scaled = NULL;
+        engine->nr_znodes++;
+
+        if (!prepare_tile_znode (ctxt, engine, tz)) {
+            _DBG_PRINTF ("win %d can not be composited in tiles: %s\n",
+                    next, znode_hdr->caption);
+            return FALSE;
+        }
+
+        next = ServerGetNextZNode (ctxt->layer, next, NULL);
+    }
+
+    if (engine->first_opaque < 0)
+        engine->first_opaque = engine->nr_znodes;
+
+    return TRUE;
+}
+
+static BOOL prepare_tile_wallpaper (TILEDENGINE* engine)
+{
+    engine->wp_w = GetGDCapability (HDC_SCREEN, GDCAP_HPIXEL);
+    engine->wp_h = GetGDCapability (HDC_SCREEN, GDCAP_VPIXEL);
+
+    if (engine->wp_w > 0 && engine->wp_h > 0) {
+        SetMemDCColorKey (HDC_SCREEN, 0, 0);
+        SetMemDCAlpha (HDC_SCREEN, 0, 0);
+        return GAL_PrepareSoftBlit (dc_HDC2PDC (HDC_SCREEN)->surface,
+                engine->screen, 0, &engine->wp_blit) == 0;
+    }
+
+    engine->wp_pixel = GetWindowElementPixelEx (HWND_DESKTOP, HDC_SCREEN_SYS,
+            WE_BGC_DESKTOP);
+    return TRUE;
+}
+
+static BOOL split_tiles (TILEDENGINE* engine, const RECT* rc_dirty)
+{
+    int i, nr_tiles, tile_h;
+
+    nr_tiles = engine->nr_workers * NR_TILES_PER_THREAD;
+    if (nr_tiles > RECTHP (rc_dirty) / MIN_TILE_HEIGHT)
+        nr_tiles = RECTHP (rc_dirty) / MIN_TILE_HEIGHT;
+    if (engine->nr_workers == 1 || nr_tiles < 1)
+        nr_tiles = 1;
+
+    if (nr_tiles > engine->max_tiles) {
+        RECT* tiles;
+        int* nr_tile_znodes;
+
+        tiles = realloc (engine->tiles, sizeof (RECT) * nr_tiles);
+        if (tiles == NULL)
+            return FALSE;
+        engine->tiles = tiles;
+
+        nr_tile_znodes = realloc (engine->nr_tile_znodes,
+                sizeof (int) * nr_tiles);
+        if (nr_tile_znodes == NULL)
+            return FALSE;
+        engine->nr_tile_znodes = nr_tile_znodes;
+
+        engine->max_tiles = nr_tiles;
+    }
+
+    free (engine->tile_znodes);
+    engine->tile_znodes = NULL;
+    if (engine->nr_znodes > 0) {
+        engine->tile_znodes = malloc (sizeof (int) *
+                nr_tiles * engine->nr_znodes);
+        if (engine->tile_znodes == NULL)
+            return FALSE;
+    }
+
+    tile_h = (RECTHP (rc_dirty) + nr_tiles - 1) / nr_tiles;
+    engine->nr_tiles = 0;
+    for (i = 0; i < nr_tiles; i++) {
+        RECT* rc_tile = engine->tiles + engine->nr_tiles;
+        int* list = engine->tile_znodes + engine->nr_tiles * engine->nr_znodes;
+        int j, nr = 0;
+
+        rc_tile->left = rc_dirty->left;
+        rc_tile->right = rc_dirty->right;
+        rc_tile->top = rc_dirty->top + tile_h * i;
+        rc_tile->bottom = MIN (rc_tile->top + tile_h, rc_dirty->bottom);
+        if (rc_tile->top >= rc_tile->bottom)
+            break;
+
+        /* the znodes touching this tile, in the z-order */
+        for (j = 0; j < engine->nr_znodes; j++) {
+            if (DoesIntersect (&engine->znodes [j].rgn->rcBound, rc_tile))
+                list [nr++] = j;
+        }
+
+        engine->nr_tile_znodes [engine->nr_tiles] = nr;
+        engine->nr_tiles++;
+    }
+
+    return TRUE;
+}
+
+static void run_tiles (TILEDENGINE* engine)
+{
+    pthread_mutex_lock (&engine->lock);
+    engine->next_tile = 0;
+    engine->nr_running = engine->nr_workers - 1;
+    engine->frame++;
+    if (engine->nr_running > 0)
+        pthread_cond_broadcast (&engine->cond_start);
+    pthread_mutex_unlock (&engine->lock);
+
+    composite_tiles_by_worker (engine->workers);
+
+    pthread_mutex_lock (&engine->lock);
+    while (engine->nr_running > 0)
+        pthread_cond_wait (&engine->cond_done, &engine->lock);
+    pthread_mutex_unlock (&engine->lock);
+}
+
+/* Returns FALSE if the dirty region should be composited serially. */
+static BOOL composite_tiles (CompositorCtxt* ctxt, int from)
+{
+    TILEDENGINE* engine = ctxt->tiled;
+    const RECT* rc_dirty = &ctxt->dirty_rgn.rcBound;
+    PDC pdc_screen = dc_HDC2PDC (HDC_SCREEN_SYS);
+    BOOL ok = FALSE;
+
+    if (RECTWP (rc_dirty) * RECTHP (rc_dirty) < MIN_TILED_AREA)
+        return FALSE;
+
+    /* The screen surfaces of the engines are marked as hardware surfaces
+       even if they are mapped to the memory; the pixels can be written
+       directly once the surface is locked. */
+    engine->screen = pdc_screen->surface;
+    if (engine->screen->pixels == NULL ||
+            (engine->screen->flags & GAL_RLEACCEL))
+        return FALSE;
+
+    if (!collect_tile_znodes (ctxt, engine, rc_dirty, from) ||
+            !prepare_tile_wallpaper (engine) ||
+            !split_tiles (engine, rc_dirty)) {
+        goto done;
+    }
+
+    engine->dirty_rgn = &ctxt->dirty_rgn;
+
+    pdc_screen->rc_output = *rc_dirty;
+    ENTER_DRAWING_NOCHECK (pdc_screen);
+    GAL_LockSurface (engine->screen);
+    run_tiles (engine);
+    GAL_UnlockSurface (engine->screen);
+    LEAVE_DRAWING_NOCHECK (pdc_screen);
+
+    engine->dirty_rgn = NULL;
+    ok = TRUE;
+
+done:
+    release_tile_znodes (ctxt, engine);
+    return ok;
+}
+
+static void destroy_tiled_engine (TILEDENGINE* engine)
+{
+    int i;
+
+    pthread_mutex_lock (&engine->lock);
+    engine->quit = TRUE;
+    pthread_cond_broadcast (&engine->cond_start);
+    pthread_mutex_unlock (&engine->lock);
+
+    for (i = 0; i < engine->nr_workers; i++) {
+        TILEWORKER* worker = engine->workers + i;
+
+        if (i > 0)
+            pthread_join (worker->th, NULL);
+
+        EmptyClipRgn (&worker->dirty_rgn);
+        EmptyClipRgn (&worker->lucent_rgn);
+        EmptyClipRgn (&worker->my_rgn);
+        EmptyClipRgn (&worker->inv_rgn);
+        DestroyFreeClipRectList (&worker->cliprc_heap);
+    }
+
+    pthread_cond_destroy (&engine->cond_done);
+    pthread_cond_destroy (&engine->cond_start);
+    pthread_mutex_destroy (&engine->lock);
+
+    free (engine->znodes);
+    free (engine->tiles);
+    free (engine->nr_tile_znodes);
+    free (engine->tile_znodes);
+    free (engine);
+}
+
+/* the tiles share the thread-count knob with the GAL workers */
+static int get_nr_tile_threads (void)
+{
+    int nr_threads = GAL_GetNrWorkerThreads ();
+
+    if (nr_threads > MAX_TILE_THREADS)
+        nr_threads = MAX_TILE_THREADS;
+
+    return nr_threads;
+}
+
+static TILEDENGINE* create_tiled_engine (void)
+{
+    TILEDENGINE* engine;
+    int i, nr_threads = get_nr_tile_threads ();
+
+    engine = calloc (1, sizeof (TILEDENGINE));
+    if (engine == NULL)
+        return NULL;
+
+    pthread_mutex_init (&engine->lock, NULL);
+    pthread_cond_init (&engine->cond_start, NULL);
+    pthread_cond_init (&engine->cond_done, NULL);
+
+    for (i = 0; i < nr_threads; i++) {
+        TILEWORKER* worker = engine->workers + i;
+
+        worker->engine = engine;
+        InitFreeClipRectList (&worker->cliprc_heap, SIZE_CLIPRC_HEAP);
+        InitClipRgn (&worker->dirty_rgn, &worker->cliprc_heap);
+        InitClipRgn (&worker->lucent_rgn, &worker->cliprc_heap);
+        InitClipRgn (&worker->my_rgn, &worker->cliprc_heap);
+        InitClipRgn (&worker->inv_rgn, &worker->cliprc_heap);
+
+        if (i > 0 && pthread_create (&worker->th, NULL,
+                    tile_worker_entry, worker)) {
+            _WRN_PRINTF ("failed to create tile worker: %d\n", i);
+            DestroyFreeClipRectList (&worker->cliprc_heap);
+            break;
+        }
+
+        engine->nr_workers++;
+    }
+
+    _DBG_PRINTF ("tiled compositor uses %d threads\n", engine->nr_workers);
+    return engine;
+}
+
+static CompositorCtxt* initialize_tiled (const char* name)
+{
+    CompositorCtxt* ctxt;
+
+    ctxt = initialize (name);
+    if (ctxt) {
+        ctxt->tiled = create_tiled_engine ();
+        if (ctxt->tiled == NULL) {
+            terminate (ctxt);
+            return NULL;
+        }
+    }
+
+    return ctxt;
+}
+
+static void terminate_tiled (CompositorCtxt* ctxt)
+{
+    if (ctxt) {
+        if (ctxt->tiled)
+            destroy_tiled_engine (ctxt->tiled);
+        terminate (ctxt);
+    }
+}
+
+CompositorOps __mg_tiled_compositor = {
+    initialize: initialize_tiled,
+    terminate: terminate_tiled,
+    refresh: refresh,
+    calc_mainwin_pos: calc_mainwin_pos,
+    purge_ppp_data: purge_ppp_data,
+    purge_win_data: purge_win_data,
+    reset_dirty_region: reset_dirty_region,
+    merge_dirty_ppp: merge_dirty_ppp,
+    merge_dirty_win: merge_dirty_win,
+    merge_dirty_wpp: merge_dirty_wpp,
+    refresh_dirty_region: refresh_dirty_region,
+    on_dirty_screen: on_dirty_screen,
+    on_showing_ppp: on_showing_ppp,
+    on_hiding_ppp: on_hiding_ppp,
+    on_closed_menu: on_closed_menu,
+    on_showing_win: on_showing_win,
+    on_hiding_win: on_hiding_win,
+    on_raised_win: refresh_win,
+    on_changed_ct: refresh_win,
+    on_changed_rgn: on_changed_rgn,
+    on_moved_win: on_moved_win,
+    on_layer_op: on_layer_op,
+    composite_layers: composite_layers,
+    transit_to_layer: transit_to_layer,
+};
+
 #endif /* defined(_MGRM_PROCESSES) && defined(_MGSCHEMA_COMPOSITING) */
 
 #if 0   /* deprecated code */
@@ -74,12 +74,14 @@
 #define LEN_COMPOSITOR_NAME     15
 
 extern CompositorOps __mg_fallback_compositor;
+extern CompositorOps __mg_tiled_compositor;
 
 static struct _compositors {
     char name [LEN_COMPOSITOR_NAME + 1];
     const CompositorOps* ops;
 } compositors [MAX_NR_COMPOSITORS] = {
     { "fallback", &__mg_fallback_compositor },
+    { "tiled", &__mg_tiled_compositor },
 };
 
 static void* dl_handle;
@@ -277,12 +279,93 @@ void __mg_composite_dirty_znodes (void)
 
 #else   /* not optimized */
 
+/* Since 5.0.16: the statistics of the compositing loop */
+static COMPOSITORSTATS sg_stats;
+
+/* Since 5.0.16: the buffers for the snapshot of a dirty map and
+   for the indices of the znodes locked while compositing a layer */
+static Uint32* sg_dirty_words;
+static int* sg_locked_znodes;
+static int sg_max_dirty_bits;
+
+static BOOL prepare_dirty_buffers (int nr_bits)
+{
+    if (nr_bits > sg_max_dirty_bits) {
+        Uint32* words;
+        int* locked;
+
+        words = realloc (sg_dirty_words,
+                sizeof (Uint32) * NR_ZNODE_DIRTY_WORDS(nr_bits));
+        if (words == NULL)
+            return FALSE;
+        sg_dirty_words = words;
+
+        locked = realloc (sg_locked_znodes, sizeof (int) * nr_bits);
+        if (locked == NULL)
+            return FALSE;
+        sg_locked_znodes = locked;
+
+        sg_max_dirty_bits = nr_bits;
+    }
+
+    return TRUE;
+}
+
+/* take the dirty bits and clear them in the map; the number of bits
+   comes from the server, since the clients can write the map */
+static void snapshot_dirty_map (ZNODEDIRTYMAP* map, int nr_bits)
+{
+    int i, nr_words = NR_ZNODE_DIRTY_WORDS(nr_bits);
+
+    for (i = 0; i < nr_words; i++) {
+#ifdef __GNUC__
+        sg_dirty_words [i] = __atomic_exchange_n (map->bits + i, 0,
+                __ATOMIC_ACQ_REL);
+#else
+        sg_dirty_words [i] = map->bits [i];
+        map->bits [i] = 0;
+#endif
+    }
+}
+
+static inline BOOL is_composited_win_znode (const ZORDERNODE* node)
+{
+    return node->hwnd != HWND_NULL && node->mem_dc &&
+            (node->flags & ZOF_VISIBLE);
+}
+
+/* lock the surface of a window znode and merge it if it changed */
+static void check_dirty_win (CompositorCtxt* ctxt, const CompositorOps* ops,
+        MG_Layer* layer, ZORDERNODE* nodes, int idx)
+{
+    PDC pdc = dc_HDC2PDC (nodes[idx].mem_dc);
+
+    assert (pdc->surface->dirty_info);
+
+    lock_znode_surface (pdc, nodes + idx);
+    sg_stats.nr_visited++;
+    if (pdc->surface->dirty_info->dirty_age != nodes[idx].changes) {
+        ops->merge_dirty_win (ctxt, layer, idx);
+        sg_stats.nr_composited++;
+    }
+}
+
+static void unlock_dirty_win (ZORDERNODE* nodes, int idx)
+{
+    PDC pdc = dc_HDC2PDC (nodes[idx].mem_dc);
+
+    if (unlock_znode_surface (pdc, nodes + idx))
+        reset_znode_surface_dirty (pdc, nodes + idx, idx);
+}
+
 static void composite_layer (MG_Layer* layer, CompositorCtxt* ctxt,
         const CompositorOps* ops)
 {
     ZORDERINFO* zi;
     ZORDERNODE* nodes;
     int i, next;
+    int nr_locked = 0;
+    BOOL use_dirty_map;
     unsigned int changes_in_dc;
     PDC pdc;
     zi = (ZORDERINFO*)layer->zorder_info;
@@ -290,6 +373,13 @@ static void composite_layer (MG_Layer* layer, CompositorCtxt* ctxt,
     if (!ops->reset_dirty_region (ctxt, layer))
         return;
 
+    /* If all clients on the layer flag their changed znodes in the dirty map,
+       only visit the flagged ones; otherwise, poll all visible znodes. */
+    use_dirty_map = zi->dirty_map && !zi->poll_dirty &&
+            prepare_dirty_buffers (NR_ZNODE_DIRTY_BITS(zi));
+    if (use_dirty_map)
+        snapshot_dirty_map (zi->dirty_map, NR_ZNODE_DIRTY_BITS(zi));
+
     /* travel menu znodes on the layer;
        this will only work for topmost layer */
     if (layer == mgTopmostLayer && zi->nr_popupmenus > 0) {
@@ -299,25 +389,55 @@ static void composite_layer (MG_Layer* layer, CompositorCtxt* ctxt,
             assert (pdc->surface->dirty_info);
 
             lock_znode_surface (pdc, nodes + i);
+            sg_stats.nr_visited++;
             changes_in_dc = pdc->surface->dirty_info->dirty_age;
             if (changes_in_dc != nodes[i].changes) {
                 ops->merge_dirty_ppp (ctxt, layer, i);
+                sg_stats.nr_composited++;
             }
         }
     }
 
     /* travel win znodes on the layer */
     nodes = GET_ZORDERNODE(zi);
-    next = 0;
-    while ((next = __kernel_get_next_znode (zi, next)) > 0) {
-        if (nodes [next].flags & ZOF_VISIBLE) {
-            pdc = dc_HDC2PDC (nodes[next].mem_dc);
-            assert (pdc->surface->dirty_info);
+    if (use_dirty_map) {
+        int nr_specials = MAX_NR_SPECIAL_ZNODES(zi);
+        int nr_bits = NR_ZNODE_DIRTY_BITS(zi);
+
+        /* the special znodes are shared by all layers, but only flagged
+           in the dirty map of the layer of the owner; poll them */
+        for (i = 1; i < nr_specials; i++) {
+            if (is_composited_win_znode (nodes + i)) {
+                check_dirty_win (ctxt, ops, layer, nodes, i);
+                sg_locked_znodes [nr_locked++] = i;
+            }
+        }
 
-            lock_znode_surface (pdc, nodes + next);
-            changes_in_dc = pdc->surface->dirty_info->dirty_age;
-            if (changes_in_dc != nodes[next].changes) {
-                ops->merge_dirty_win (ctxt, layer, next);
+        for (i = nr_specials; i < nr_bits; i++) {
+            Uint32 mask = 1U << (i & 31);
+
+            if (!(sg_dirty_words [i >> 5] & mask)) {
+                /* skip the clean words quickly */
+                if (sg_dirty_words [i >> 5] == 0)
+                    i |= 31;
+                continue;
+            }
+
+            if (is_composited_win_znode (nodes + i)) {
+                check_dirty_win (ctxt, ops, layer, nodes, i);
+                sg_locked_znodes [nr_locked++] = i;
+            }
+            else if (nodes [i].hwnd != HWND_NULL) {
+                /* re-arm the bit; check it again once the znode shows */
+                __mg_set_znode_dirty (zi->dirty_map, i);
+            }
+        }
+    }
+    else {
+        next = 0;
+        while ((next = __kernel_get_next_znode (zi, next)) > 0) {
+            if (nodes [next].flags & ZOF_VISIBLE) {
+                check_dirty_win (ctxt, ops, layer, nodes, next);
             }
         }
     }
@@ -349,12 +469,17 @@ static void composite_layer (MG_Layer* layer, CompositorCtxt* ctxt,
 
     /* unlock the znode surfaces for windows */
     nodes = GET_ZORDERNODE(zi);
-    next = 0;
-    while ((next = __kernel_get_next_znode (zi, next)) > 0) {
-        if (nodes [next].flags & ZOF_VISIBLE) {
-            pdc = dc_HDC2PDC (nodes[next].mem_dc);
-            if (unlock_znode_surface (pdc, nodes + next))
-                reset_znode_surface_dirty (pdc, nodes + next, next);
+    if (use_dirty_map) {
+        for (i = 0; i < nr_locked; i++) {
+            unlock_dirty_win (nodes, sg_locked_znodes [i]);
+        }
+    }
+    else {
+        next = 0;
+        while ((next = __kernel_get_next_znode (zi, next)) > 0) {
+            if (nodes [next].flags & ZOF_VISIBLE) {
+                unlock_dirty_win (nodes, next);
+            }
         }
     }
 
@@ -377,6 +502,9 @@ void __mg_composite_dirty_znodes (void)
 
     assert (ops);
 
+    sg_stats.nr_visited = 0;
+    sg_stats.nr_composited = 0;
+
     /* first handle the topmost layer */
     composite_layer (mgTopmostLayer, ctxt, ops);
 
@@ -389,6 +517,19 @@ void __mg_composite_dirty_znodes (void)
 
         layer = layer->next;
     }
+
+    sg_stats.nr_frames++;
+    sg_stats.total_visited += sg_stats.nr_visited;
+    sg_stats.total_composited += sg_stats.nr_composited;
+}
+
+BOOL GUIAPI ServerGetCompositorStats (COMPOSITORSTATS* stats)
+{
+    if (stats == NULL)
+        return FALSE;
+
+    *stats = sg_stats;
+    return TRUE;
 }
 
 #endif  /* optimized */
@@ -495,6 +636,12 @@ void mg_TerminateCompositor (void)
 
     if (dl_handle)
         dlclose (dl_handle);
+
+    free (sg_dirty_words);
+    free (sg_locked_znodes);
+    sg_dirty_words = NULL;
+    sg_locked_znodes = NULL;
+    sg_max_dirty_bits = 0;
 }
 
 const CompositorOps* GUIAPI ServerGetCompositorOps (const char* name)
@@ -538,7 +685,8 @@ BOOL GUIAPI ServerUnregisterCompositor (const char* name)
     const CompositorOps* curr_ops;
 
     if (name == NULL || name[0] == 0 ||
-            strcmp (name, COMPSOR_NAME_FALLBACK) == 0)
+            strcmp (name, COMPSOR_NAME_FALLBACK) == 0 ||
+            strcmp (name, COMPSOR_NAME_TILED) == 0)
         return FALSE;
 
     curr_ops = ServerSelectCompositor (NULL, NULL);
@@ -86,6 +86,11 @@ PMSGQUEUE __mg_dsk_msg_queue;
 
 GHANDLE __mg_layer;
 
+#ifdef _MGSCHEMA_COMPOSITING
+/* Since 5.0.16: the dirty map of the layer attached by a client */
+ZNODEDIRTYMAP* __mg_zorder_dirty_map;
+#endif
+
 static void lock_zi_for_read (const ZORDERINFO* zi)
 {
     struct sembuf sb;
@@ -257,6 +262,9 @@ void mg_TerminateDesktop (void)
     __mg_dsk_msg_queue = NULL;
 
 #ifndef _MGSCHEMA_COMPOSITING
+    /* give the rects back before destroying the heap */
+    EmptyClipRgn (&sg_ScrGCRInfo.crgn);
+    EmptyClipRgn (&sg_UpdateRgn);
     DestroyFreeClipRectList (&sg_FreeClipRectList);
 #endif
     DestroyFreeClipRectList (&sg_FreeInvRectList);
@@ -308,6 +316,64 @@ static int update_client_window_rgn (int cli, HWND hwnd)
 }
 #endif /* not defined _MGSCHEMA_COMPOSITING */
 
+#ifdef _MGSCHEMA_COMPOSITING
+/* Since 5.0.16: let the surface flag its znode in the dirty map on change */
+static void bind_surface_to_znode (GAL_Surface* surf, int idx_znode)
+{
+    const ZORDERINFO* zi;
+    ZNODEDIRTYMAP* map;
+
+    if (mgIsServer) {
+        zi = (const ZORDERINFO*)get_zi_from_client (0);
+        map = zi->dirty_map;
+    }
+    else {
+        zi = __mg_zorder_info;
+        map = __mg_zorder_dirty_map;
+    }
+
+    /* the map is writable by the clients; do not trust its header */
+    if (map && idx_znode > 0 && idx_znode < NR_ZNODE_DIRTY_BITS(zi)) {
+        surf->dirty_word = map->bits + (idx_znode >> 5);
+        surf->dirty_mask = 1U << (idx_znode & 31);
+    }
+    else {
+        surf->dirty_word = NULL;
+        surf->dirty_mask = 0;
+    }
+}
+
+static BOOL _cb_bind_surface (void* context,
+                const ZORDERINFO* zi, ZORDERNODE* node)
+{
+    PMAINWIN pWin = (PMAINWIN)node->hwnd;
+
+    if (node->cli == __mg_client_id && pWin && pWin->surf) {
+        bind_surface_to_znode (pWin->surf,
+                context ? (int)(node - GET_ZORDERNODE(zi)) : 0);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Since 5.0.16: (un)bind the surfaces of the znodes of this client to
+ * the dirty map of the current layer. The surfaces must be unbound
+ * before the dirty map is detached when the client changes its layer.
+ */
+void __mg_bind_znode_surfaces (BOOL bind)
+{
+    if (__mg_zorder_info == NULL)
+        return;
+
+    lock_zi_for_read (__mg_zorder_info);
+    do_for_all_znodes (bind ? (void*)__mg_zorder_info : NULL,
+            __mg_zorder_info, _cb_bind_surface, ZT_ALL);
+    unlock_zi_for_read (__mg_zorder_info);
+}
+#endif /* defined _MGSCHEMA_COMPOSITING */
+
 /*********************** Client-side routines ********************************/
 
 void __mg_start_client_desktop (void)
@@ -364,6 +430,8 @@ static intptr_t cliAllocZOrderNode (PMAINWIN pWin, const COMPOSITINGINFO* ct_inf
         info.ct_arg = 0;
     }
 
+    info.dirty_notify = (__mg_zorder_dirty_map != NULL);
+
     if (ClientRequestEx2 (&req, caption, strlen(caption) + 1,
             pWin->surf->fd,
             &ret, sizeof (intptr_t), NULL) < 0)
@@ -1399,6 +1467,11 @@ intptr_t __mg_do_zorder_operation (int cli, const ZORDEROPINFO* info,
                         info->flags, &info->rc, caption,
                         info->surf_flags, info->surf_size, fd,
                         info->ct, info->ct_arg);
+
+            /* the client will not flag its dirty znodes; poll the layer */
+            if (ret > 0 && cli > 0 && !info->dirty_notify) {
+                ((ZORDERINFO*)get_zi_from_client (cli))->poll_dirty = TRUE;
+            }
 #else
             ret = srvAllocZOrderNode (cli, info->hwnd, info->main_win,
                         info->flags, &info->rc, caption,
@@ -1916,6 +1989,10 @@ static int dskAddNewMainWindow (PMAINWIN pWin, const COMPOSITINGINFO* ct_info)
     if (pWin->idx_znode <= 0)
         return -1;
 
+#ifdef _MGSCHEMA_COMPOSITING
+    bind_surface_to_znode (pWin->surf, pWin->idx_znode);
+#endif
+
     /* Since 5.0.0: handle window style if failed to allocate znode for fixed ones */
     if (pWin->dwExStyle & WS_EX_WINTYPE_MASK) {
         ZORDERNODE* nodes = GET_ZORDERNODE(__mg_zorder_info);
@@ -2019,6 +2096,10 @@ static void dskRemoveMainWindow (PMAINWIN pWin)
         cliFreeZOrderNode (pWin);
     }
 
+#ifdef _MGSCHEMA_COMPOSITING
+    bind_surface_to_znode (pWin->surf, 0);
+#endif
+
 #if 0   /* move to window.c since 5.0.0 */
     /* Handle main window hosting. */
     if (pWin->pHosting)
@@ -2207,6 +2288,8 @@ static int resize_window_surface (PMAINWIN pWin, const RECT* prcResult)
         GAL_BlitSurface (pWin->surf, NULL, new_surf, NULL);
         memcpy (new_surf->dirty_info, pWin->surf->dirty_info,
                 sizeof (GAL_DirtyInfo));
+        new_surf->dirty_word = pWin->surf->dirty_word;
+        new_surf->dirty_mask = pWin->surf->dirty_mask;
         GAL_FreeSurface (pWin->surf);
 
         pWin->surf = new_surf;
@@ -3528,6 +3611,10 @@ static int dskOnNewCtrlInstance (PCONTROL pParent, PCONTROL pNewCtrl)
         if (pNewCtrl->idx_znode <= 0)
             return -1;
 
+#ifdef _MGSCHEMA_COMPOSITING
+        bind_surface_to_znode (pNewCtrl->surf, pNewCtrl->idx_znode);
+#endif
+
         /* Init Global Clip Region info. */
         dskInitGCRInfo ((PMAINWIN)pNewCtrl);
     }
@@ -3594,6 +3681,10 @@ static int dskOnRemoveCtrlInstance (PCONTROL pParent, PCONTROL pCtrl)
             srvFreeZOrderNode (0, pCtrl->idx_znode);
         else
             cliFreeZOrderNode ((PMAINWIN)pCtrl);
+
+#ifdef _MGSCHEMA_COMPOSITING
+        bind_surface_to_znode (pCtrl->surf, 0);
+#endif
     }
 
     if ((HWND)pCtrl == __mg_captured_wnd) {
@@ -213,6 +213,10 @@ void mg_TerminateDesktop (void)
 
     __kernel_free_z_order_info (__mg_zorder_info);
     __mg_zorder_info = NULL;
+
+    /* give the rects back before destroying the heap */
+    EmptyClipRgn (&sg_ScrGCRInfo.crgn);
+    EmptyClipRgn (&sg_UpdateRgn);
     DestroyFreeClipRectList (&sg_FreeClipRectList);
     DestroyFreeClipRectList (&sg_FreeInvRectList);
 
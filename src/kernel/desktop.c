@@ -2364,6 +2364,8 @@ static int AllocZOrderNodeEx (ZORDERINFO* zi, int cli, HWND hwnd, HWND main_win,
     nodes [free_slot].dirty_age = 0;
     nodes [free_slot].nr_dirty_rcs = 0;
     nodes [free_slot].dirty_rcs = NULL;
+    /* the content of the surface has not been composited yet */
+    __mg_set_znode_dirty (zi->dirty_map, free_slot);
 #else
     nodes [free_slot].age = 1;
     nodes [free_slot].dirty_rc.left = 0;
@@ -3716,6 +3718,7 @@ static int dskMoveWindow (int cli, int idx_znode, HDC memdc, const RECT* rcWin)
         if (memdc != HDC_INVALID) {
             DeleteMemDC (nodes [idx_znode].mem_dc);
             nodes [idx_znode].mem_dc = memdc;
+            __mg_set_znode_dirty (zi->dirty_map, idx_znode);
         }
 
         unlock_zi_for_change (zi);
@@ -220,6 +220,9 @@ BOOL GUIAPI RegisterListenFD (int fd, int type, HWND hwnd, void* context)
                 msg_queue->maxfd = fd;
             }
 
+#ifdef _MGHAVE_TICKLESS_IDLE
+            __mg_update_epoll_listen_fd (msg_queue, fd);
+#endif
             return TRUE;
         }
     }
@@ -257,6 +260,10 @@ BOOL GUIAPI UnregisterListenFD (int fd)
 
                 mg_slice_delete (LISTEN_FD, msg_queue->fd_slots[i]);
                 msg_queue->fd_slots[i] = NULL;
+
+#ifdef _MGHAVE_TICKLESS_IDLE
+                __mg_update_epoll_listen_fd (msg_queue, fd);
+#endif
                 return TRUE;
             }
         }
@@ -72,6 +72,14 @@
 #include "mgsock.h"
 #endif
 
+#ifdef _MGHAVE_TICKLESS_IDLE
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
 #ifdef _MGRM_PROCESSES
 #include "sharedres.h"
 #endif
@@ -138,6 +146,492 @@
 #define GETWNDPROC(hWnd)    (((PMAINWIN)hWnd)->MainWindowProc)
 #define GETNOTIFPROC(hWnd)  (((PMAINWIN)hWnd)->NotifProc)
 
+/**************************** Message Coalescing ******************************/
+/*
+ * Since 5.0.16, the coalescable messages in the post message buffer are
+ * indexed by an open-addressing hash table, so that kernel_QueueMessage
+ * can find the queued message to merge into in constant time instead of
+ * walking the whole ring buffer.
+ *
+ * A bucket of the index holds the ring slot of an indexed message, and the
+ * key (window, identifier, and wParam) is always read from the ring slot.
+ * Only the window and identifier are hashed, so that the bucket of an indexed
+ * message does not depend on the coalescing policy which may be changed
+ * while the message is still in the queue.
+ */
+static BYTE coalescing_policies [MSG_FIRSTUSERMSG];
+
+static void reset_coalescing_policies (void)
+{
+    memset (coalescing_policies, MSG_COALESCE_NONE,
+            sizeof (coalescing_policies));
+
+    coalescing_policies [MSG_MOUSEMOVE] = MSG_COALESCE_SAMEWPARAM;
+    coalescing_policies [MSG_NCMOUSEMOVE] = MSG_COALESCE_SAMEWPARAM;
+    coalescing_policies [MSG_DT_MOUSEMOVE] = MSG_COALESCE_SAMEWPARAM;
+    coalescing_policies [MSG_TIMEOUT] = MSG_COALESCE_ANYWPARAM;
+    coalescing_policies [MSG_IDLE] = MSG_COALESCE_ANYWPARAM;
+    coalescing_policies [MSG_CARETBLINK] = MSG_COALESCE_ANYWPARAM;
+}
+
+int GUIAPI SetMsgCoalescingPolicy (UINT nMsg, int policy)
+{
+    int old_policy;
+
+    if (nMsg >= MSG_FIRSTUSERMSG || policy < MSG_COALESCE_NONE ||
+            policy > MSG_COALESCE_ANYWPARAM)
+        return -1;
+
+    old_policy = coalescing_policies [nMsg];
+    coalescing_policies [nMsg] = (BYTE)policy;
+    return old_policy;
+}
+
+static inline int get_coalescing_policy (UINT nMsg)
+{
+    if (nMsg >= MSG_FIRSTUSERMSG)
+        return MSG_COALESCE_NONE;
+
+    return coalescing_policies [nMsg];
+}
+
+int GUIAPI GetMsgCoalescingPolicy (UINT nMsg)
+{
+    return get_coalescing_policy (nMsg);
+}
+
+static inline int coalesce_hash (PMSGQUEUE msg_que, HWND hwnd, UINT message)
+{
+    DWORD_PTR h = (DWORD_PTR)hwnd;
+
+    h ^= h >> 7;
+    h = h * 31 + message;
+    h *= 0x9E3779B1UL;
+    return (int)((h >> 8) & msg_que->coalesce_mask);
+}
+
+static BOOL coalesce_index_init (PMSGQUEUE msg_que)
+{
+    int nr_buckets = 4;
+
+    /* keep the load factor not larger than 0.5 */
+    while (nr_buckets < (msg_que->len << 1))
+        nr_buckets <<= 1;
+
+    msg_que->coalesce_index = malloc (sizeof (int) * nr_buckets);
+    msg_que->coalesce_flags = calloc (msg_que->len, sizeof (BYTE));
+    if (msg_que->coalesce_index == NULL || msg_que->coalesce_flags == NULL) {
+        free (msg_que->coalesce_index);
+        free (msg_que->coalesce_flags);
+        msg_que->coalesce_index = NULL;
+        msg_que->coalesce_flags = NULL;
+        return FALSE;
+    }
+
+    msg_que->coalesce_mask = nr_buckets - 1;
+    memset (msg_que->coalesce_index, 0xFF, sizeof (int) * nr_buckets);
+    return TRUE;
+}
+
+static void coalesce_index_reset (PMSGQUEUE msg_que)
+{
+    memset (msg_que->coalesce_index, 0xFF,
+            sizeof (int) * (msg_que->coalesce_mask + 1));
+    memset (msg_que->coalesce_flags, 0, msg_que->len);
+}
+
+/* find the queued message to merge the new message into */
+static PMSG coalesce_index_lookup (PMSGQUEUE msg_que, const MSG* msg,
+        int policy)
+{
+    int bucket = coalesce_hash (msg_que, msg->hwnd, msg->message);
+    DWORD nr_probes = 1;
+    int slot;
+
+    while ((slot = msg_que->coalesce_index [bucket]) >= 0) {
+        PMSG a_msg = msg_que->msg + slot;
+
+        if (a_msg->message == msg->message && a_msg->hwnd == msg->hwnd &&
+                (policy == MSG_COALESCE_ANYWPARAM ||
+                    a_msg->wParam == msg->wParam)) {
+            break;
+        }
+
+        bucket = (bucket + 1) & msg_que->coalesce_mask;
+        nr_probes++;
+    }
+
+    if (nr_probes > msg_que->stats.max_probes)
+        msg_que->stats.max_probes = nr_probes;
+
+    return (slot >= 0) ? (msg_que->msg + slot) : NULL;
+}
+
+static void coalesce_index_insert (PMSGQUEUE msg_que, int slot)
+{
+    PMSG msg = msg_que->msg + slot;
+    int bucket = coalesce_hash (msg_que, msg->hwnd, msg->message);
+
+    while (msg_que->coalesce_index [bucket] >= 0)
+        bucket = (bucket + 1) & msg_que->coalesce_mask;
+
+    msg_que->coalesce_index [bucket] = slot;
+    msg_que->coalesce_flags [slot] = 1;
+}
+
+/* remove the ring slot from the index; use backward shift deletion */
+static void coalesce_index_remove (PMSGQUEUE msg_que, int slot)
+{
+    PMSG msg = msg_que->msg + slot;
+    int mask = msg_que->coalesce_mask;
+    int hole, bucket;
+
+    msg_que->coalesce_flags [slot] = 0;
+
+    hole = coalesce_hash (msg_que, msg->hwnd, msg->message);
+    while (msg_que->coalesce_index [hole] != slot) {
+        if (msg_que->coalesce_index [hole] < 0) {
+            _WRN_PRINTF ("ring slot %d is not in coalescing index\n", slot);
+            return;
+        }
+        hole = (hole + 1) & mask;
+    }
+
+    bucket = hole;
+    while (1) {
+        int home, moved;
+
+        bucket = (bucket + 1) & mask;
+        moved = msg_que->coalesce_index [bucket];
+        if (moved < 0)
+            break;
+
+        msg = msg_que->msg + moved;
+        home = coalesce_hash (msg_que, msg->hwnd, msg->message);
+
+        /* move the entry back if its home is not in (hole, bucket] */
+        if (((bucket - home) & mask) >= ((bucket - hole) & mask)) {
+            msg_que->coalesce_index [hole] = moved;
+            hole = bucket;
+        }
+    }
+
+    msg_que->coalesce_index [hole] = -1;
+}
+
+/* call this function before advancing the read position */
+static inline void coalesce_index_on_read (PMSGQUEUE msg_que)
+{
+    if (msg_que->coalesce_flags [msg_que->readpos])
+        coalesce_index_remove (msg_que, msg_que->readpos);
+}
+
+/* rebuild the index after the post messages moved */
+static void coalesce_index_rebuild (PMSGQUEUE msg_que)
+{
+    int readpos;
+
+    coalesce_index_reset (msg_que);
+
+    readpos = msg_que->readpos;
+    while (readpos != msg_que->writepos) {
+        PMSG msg = msg_que->msg + readpos;
+        int policy = get_coalescing_policy (msg->message);
+
+        if (policy != MSG_COALESCE_NONE &&
+                coalesce_index_lookup (msg_que, msg, policy) == NULL)
+            coalesce_index_insert (msg_que, readpos);
+
+        readpos++;
+        readpos %= msg_que->len;
+    }
+}
+
+BOOL GUIAPI GetMsgQueueStats (HWND hWnd, MSGQUEUESTATS* stats)
+{
+    PMSGQUEUE msg_que;
+
+    if (hWnd == HWND_NULL)
+        msg_que = getMsgQueueForThisThread ();
+    else
+        msg_que = getMsgQueue (hWnd);
+
+    if (msg_que == NULL || stats == NULL)
+        return FALSE;
+
+    LOCK_MSGQ (msg_que);
+    *stats = msg_que->stats;
+    UNLOCK_MSGQ (msg_que);
+    return TRUE;
+}
+
+/**************************** Post Message Buffer *****************************/
+/*
+ * Since 5.0.16, a message posted to a full post message buffer is spilled
+ * to the overflow list of the message queue instead of being dropped.
+ * The spilled messages are always newer than the ones in the buffer, and
+ * they are moved to the buffer in order when the buffer is read.
+ *
+ * When _MG_LOCKFREE_POSTMSG is defined, a thread posting a message to
+ * the message queue of another thread pushes the message to the lock-free
+ * inbox of the message queue without taking the lock of the message queue.
+ * The message thread moves the messages in the inbox to the buffer before
+ * it checks the buffer, and the posting thread of the message queue does
+ * the same before it appends a message. Therefore, the order of the posted
+ * messages is kept.
+ *
+ * The messages in the overflow list and in the inbox of a message queue are
+ * bounded by the runtime option `max_spilled_msgs`; when it is reached, the
+ * new message is dropped and the post fails, as a post to a full buffer did
+ * before 5.0.16. A message which can be merged into a queued one is merged
+ * before it is dropped, but the inbox can not be searched for that, so a
+ * post to the inbox of a queue over the limit is always dropped.
+ */
+#define ALLOCPOSTQMSG()         mg_slice_new (QMSG)
+
+static DWORD max_spilled_msgs = DEF_MAX_SPILLED_MSGS;
+
+#ifdef _MG_LOCKFREE_POSTMSG
+static BOOL lockfree_postmsg = TRUE;
+#endif
+
+static void init_post_message_options (void)
+{
+    char *env;
+    int max = DEF_MAX_SPILLED_MSGS;
+
+    if ((env = getenv ("MG_MAX_SPILLED_MSGS"))) {
+        max = atoi (env);
+    }
+    else if (GetMgEtcIntValue ("system", "max_spilled_msgs", &max) < 0) {
+        max = DEF_MAX_SPILLED_MSGS;
+    }
+
+    max_spilled_msgs = (max < 0) ? 0 : (DWORD)max;
+
+#ifdef _MG_LOCKFREE_POSTMSG
+    {
+        char buf [16];
+
+        if ((env = getenv ("MG_LOCKFREE_POSTMSG")) == NULL &&
+                GetMgEtcValue ("system", "lockfree_postmsg",
+                    buf, sizeof (buf)) == 0)
+            env = buf;
+
+        if (env)
+            lockfree_postmsg = !(strcasecmp (env, "no") == 0 ||
+                    strcasecmp (env, "false") == 0 || strcmp (env, "0") == 0);
+    }
+#endif
+}
+#define FREEPOSTQMSG(pqmsg)     mg_slice_delete (QMSG, pqmsg)
+
+static void free_post_qmsg_list (PQMSG head)
+{
+    while (head) {
+        PQMSG next = head->next;
+        FREEPOSTQMSG (head);
+        head = next;
+    }
+}
+
+/* merge the message into a queued one if it is possible */
+static BOOL coalesce_post_message (PMSGQUEUE msg_que, const MSG* msg,
+        int policy)
+{
+    PMSG a_msg;
+
+    if (policy == MSG_COALESCE_NONE)
+        return FALSE;
+
+    a_msg = coalesce_index_lookup (msg_que, msg, policy);
+    if (a_msg == NULL)
+        return FALSE;
+
+    if (policy == MSG_COALESCE_ANYWPARAM)
+        a_msg->wParam = msg->wParam;
+    a_msg->lParam = msg->lParam;
+    a_msg->time = msg->time;
+    msg_que->stats.nr_coalesced++;
+    return TRUE;
+}
+
+static inline BOOL is_post_buffer_full (PMSGQUEUE msg_que)
+{
+    return (msg_que->writepos + 1) % msg_que->len == msg_que->readpos;
+}
+
+/* write the message to the buffer; the buffer must not be full */
+static void write_post_message (PMSGQUEUE msg_que, const MSG* msg,
+        int policy)
+{
+    DWORD depth;
+
+    msg_que->msg [msg_que->writepos] = *msg;
+    if (policy != MSG_COALESCE_NONE)
+        coalesce_index_insert (msg_que, msg_que->writepos);
+    msg_que->writepos++;
+    msg_que->writepos %= msg_que->len;
+
+    msg_que->stats.nr_posted++;
+    depth = (msg_que->writepos + msg_que->len - msg_que->readpos)
+            % msg_que->len;
+    if (depth > msg_que->stats.max_depth)
+        msg_que->stats.max_depth = depth;
+}
+
+/*
+ * Append a message to the post messages; call with the lock held.
+ * If qmsg is not NULL, the message is held by qmsg, and qmsg will be
+ * reused for spilling or freed.
+ */
+static BOOL append_post_message (PMSGQUEUE msg_que, PQMSG qmsg,
+        const MSG* msg)
+{
+    int policy = get_coalescing_policy (msg->message);
+
+    if (coalesce_post_message (msg_que, msg, policy)) {
+        if (qmsg)
+            FREEPOSTQMSG (qmsg);
+        return TRUE;
+    }
+
+    if (msg_que->pFirstSpilledMsg == NULL && !is_post_buffer_full (msg_que)) {
+        write_post_message (msg_que, msg, policy);
+        if (qmsg)
+            FREEPOSTQMSG (qmsg);
+        return TRUE;
+    }
+
+    /* spill the message to the overflow list */
+    if (msg_que->nr_spilled >= max_spilled_msgs) {
+        if (qmsg)
+            FREEPOSTQMSG (qmsg);
+        msg_que->stats.nr_dropped++;
+        return FALSE;
+    }
+
+    if (qmsg == NULL) {
+        if ((qmsg = ALLOCPOSTQMSG ()) == NULL) {
+            msg_que->stats.nr_dropped++;
+            return FALSE;
+        }
+        qmsg->Msg = *msg;
+    }
+
+    qmsg->next = NULL;
+    if (msg_que->pLastSpilledMsg)
+        msg_que->pLastSpilledMsg->next = qmsg;
+    else
+        msg_que->pFirstSpilledMsg = qmsg;
+    msg_que->pLastSpilledMsg = qmsg;
+
+    msg_que->nr_spilled++;
+    msg_que->stats.nr_spilled++;
+    if (msg_que->nr_spilled > msg_que->stats.max_spilled)
+        msg_que->stats.max_spilled = msg_que->nr_spilled;
+    return TRUE;
+}
+
+/* move the spilled messages to the buffer; call with the lock held */
+static void refill_post_messages (PMSGQUEUE msg_que)
+{
+    while (msg_que->pFirstSpilledMsg && !is_post_buffer_full (msg_que)) {
+        PQMSG qmsg = msg_que->pFirstSpilledMsg;
+        int policy = get_coalescing_policy (qmsg->Msg.message);
+
+        msg_que->pFirstSpilledMsg = qmsg->next;
+        if (msg_que->pFirstSpilledMsg == NULL)
+            msg_que->pLastSpilledMsg = NULL;
+        msg_que->nr_spilled--;
+
+        if (!coalesce_post_message (msg_que, &qmsg->Msg, policy))
+            write_post_message (msg_que, &qmsg->Msg, policy);
+        FREEPOSTQMSG (qmsg);
+    }
+}
+
+/* remove the first message in the buffer; call with the lock held */
+static inline void remove_first_post_message (PMSGQUEUE msg_que)
+{
+    coalesce_index_on_read (msg_que);
+    msg_que->readpos++;
+    msg_que->readpos %= msg_que->len;
+
+    if (msg_que->pFirstSpilledMsg)
+        refill_post_messages (msg_que);
+}
+
+#ifdef _MG_LOCKFREE_POSTMSG
+static inline void push_inbox_message (PMSGQUEUE msg_que, PQMSG qmsg)
+{
+    PQMSG head = __atomic_load_n (&msg_que->pInboxMsgs, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch (&msg_que->nr_inbox_msgs, 1, __ATOMIC_RELAXED);
+    do {
+        qmsg->next = head;
+    } while (!__atomic_compare_exchange_n (&msg_que->pInboxMsgs, &head, qmsg,
+                TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* whether the messages waiting in the inbox and the overflow list reach
+   the limit; the counts may be stale, which only makes the limit soft */
+static inline BOOL is_inbox_full (PMSGQUEUE msg_que)
+{
+    return __atomic_load_n (&msg_que->nr_inbox_msgs, __ATOMIC_RELAXED) +
+        __atomic_load_n (&msg_que->nr_spilled, __ATOMIC_RELAXED) >=
+        max_spilled_msgs;
+}
+
+/* move the messages in the inbox to the buffer; call with the lock held */
+static void fetch_inbox_messages (PMSGQUEUE msg_que)
+{
+    PQMSG qmsg, next, fifo = NULL;
+    DWORD nr_msgs = 0;
+
+    if (__atomic_load_n (&msg_que->pInboxMsgs, __ATOMIC_RELAXED) == NULL)
+        return;
+
+    qmsg = __atomic_exchange_n (&msg_que->pInboxMsgs, NULL, __ATOMIC_ACQUIRE);
+
+    /* the inbox is in LIFO order */
+    while (qmsg) {
+        next = qmsg->next;
+        qmsg->next = fifo;
+        fifo = qmsg;
+        qmsg = next;
+        nr_msgs++;
+    }
+    __atomic_sub_fetch (&msg_que->nr_inbox_msgs, nr_msgs, __ATOMIC_RELAXED);
+
+    while (fifo) {
+        next = fifo->next;
+        append_post_message (msg_que, fifo, &fifo->Msg);
+        fifo = next;
+    }
+
+    msg_que->dwState |= QS_POSTMSG;
+}
+
+static inline void discard_inbox_messages (PMSGQUEUE msg_que)
+{
+    PQMSG qmsg = __atomic_exchange_n (&msg_que->pInboxMsgs, NULL,
+            __ATOMIC_ACQUIRE);
+    DWORD nr_msgs = 0;
+
+    while (qmsg) {
+        PQMSG next = qmsg->next;
+        FREEPOSTQMSG (qmsg);
+        qmsg = next;
+        nr_msgs++;
+    }
+    __atomic_sub_fetch (&msg_que->nr_inbox_msgs, nr_msgs, __ATOMIC_RELAXED);
+}
+#else   /* defined _MG_LOCKFREE_POSTMSG */
+#   define fetch_inbox_messages(msg_que)
+#   define discard_inbox_messages(msg_que)
+#endif  /* not defined _MG_LOCKFREE_POSTMSG */
+
 /****************************** Message Allocation ****************************/
 static BLOCKHEAP QMSGHeap;
 
@@ -145,6 +639,8 @@ static BLOCKHEAP QMSGHeap;
 BOOL mg_InitFreeQMSGList (void)
 {
     InitBlockDataHeap (&QMSGHeap, sizeof (QMSG), SIZE_QMSG_HEAP);
+    reset_coalescing_policies ();
+    init_post_message_options ();
     return TRUE;
 }
 
@@ -242,8 +738,10 @@ static BOOL std_idle_handler (MSGQUEUE* msg_queue, BOOL wait)
     struct timeval sel_timeout;
 
     if (wait) {
+        /* Since 5.0.16: sleep until the next timer expires if it is sooner */
         sel_timeout.tv_sec = 0;
-        sel_timeout.tv_usec = USEC_10MS;
+        sel_timeout.tv_usec =
+            __mg_get_timer_timeout (msg_queue, USEC_10MS / 1000) * 1000;
     }
     else {
         sel_timeout.tv_sec = 0;
@@ -273,16 +771,277 @@ static BOOL std_idle_handler (MSGQUEUE* msg_queue, BOOL wait)
         return FALSE;
     }
 
-    n += __mg_check_expired_timers (msg_queue,
-            __mg_tick_counter - msg_queue->old_tick_count);
-    msg_queue->old_tick_count = __mg_tick_counter;
+    n += __mg_check_expired_timers (msg_queue);
 
     if (rsetptr || wsetptr || esetptr) {
         n += __mg_kernel_check_listen_fds (msg_queue, rsetptr, wsetptr, esetptr);
     }
 
+    if (wait) {
+        msg_queue->stats.nr_idle_wakeups++;
+        if (retval == 0 && n == 0)
+            msg_queue->stats.nr_empty_wakeups++;
+    }
+
+    return n > 0;
+}
+
+#ifdef _MGHAVE_TICKLESS_IDLE
+/*
+ * Since 5.0.16, a message thread does not wake up every 10ms to poll
+ * the message queue. Instead, it sleeps in epoll until the timerfd armed
+ * for the next timer expires, a listening fd is ready, or the eventfd is
+ * written by a thread posting a message to the message queue.
+ */
+#define NR_IDLE_EPOLL_EVENTS    16
+
+static void close_tickless_idle (MSGQUEUE* msg_queue)
+{
+    if (msg_queue->epoll_fd >= 0)
+        close (msg_queue->epoll_fd);
+    if (msg_queue->wakeup_fd >= 0)
+        close (msg_queue->wakeup_fd);
+    if (msg_queue->timer_fd >= 0)
+        close (msg_queue->timer_fd);
+
+    msg_queue->epoll_fd = -1;
+    msg_queue->wakeup_fd = -1;
+    msg_queue->timer_fd = -1;
+    msg_queue->timer_fd_armed = FALSE;
+}
+
+static void disable_tickless_idle (MSGQUEUE* msg_queue)
+{
+    close_tickless_idle (msg_queue);
+    msg_queue->tickless_failed = TRUE;
+}
+
+/*
+ * Creates the fds on the first wait of the message thread, so the queues
+ * which never wait here (for example, the ones whose OnIdle is overridden)
+ * do not hold them.
+ */
+static BOOL init_tickless_idle (MSGQUEUE* msg_queue)
+{
+    struct epoll_event ev;
+    int i;
+
+    msg_queue->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    msg_queue->wakeup_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    msg_queue->timer_fd = timerfd_create (CLOCK_MONOTONIC,
+            TFD_NONBLOCK | TFD_CLOEXEC);
+    if (msg_queue->epoll_fd < 0 || msg_queue->wakeup_fd < 0 ||
+            msg_queue->timer_fd < 0)
+        goto failed;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = msg_queue->wakeup_fd;
+    if (epoll_ctl (msg_queue->epoll_fd, EPOLL_CTL_ADD,
+                msg_queue->wakeup_fd, &ev) < 0)
+        goto failed;
+
+    ev.data.fd = msg_queue->timer_fd;
+    if (epoll_ctl (msg_queue->epoll_fd, EPOLL_CTL_ADD,
+                msg_queue->timer_fd, &ev) < 0)
+        goto failed;
+
+    /* the fds registered before the first wait */
+    for (i = 0; i < msg_queue->nr_fd_slots; i++) {
+        if (msg_queue->fd_slots[i])
+            __mg_update_epoll_listen_fd (msg_queue,
+                    msg_queue->fd_slots[i]->fd);
+    }
+
+    return !msg_queue->tickless_failed;
+
+failed:
+    _WRN_PRINTF ("failed to initialize tickless idle: %m\n");
+    disable_tickless_idle (msg_queue);
+    return FALSE;
+}
+
+void __mg_wakeup_msg_queue (PMSGQUEUE msg_queue)
+{
+    uint64_t one = 1;
+
+    if (msg_queue->wakeup_fd >= 0 &&
+            write (msg_queue->wakeup_fd, &one, sizeof (one)) < 0 &&
+            errno != EAGAIN) {
+        _WRN_PRINTF ("failed to wake up message thread: %m\n");
+    }
+}
+
+/* synchronize the events of a listening fd to the epoll instance */
+void __mg_update_epoll_listen_fd (PMSGQUEUE msg_queue, int fd)
+{
+    int i;
+    struct epoll_event ev;
+
+    if (msg_queue->epoll_fd < 0)
+        return;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.data.fd = fd;
+    for (i = 0; i < msg_queue->nr_fd_slots; i++) {
+        LISTEN_FD* fd_slot = msg_queue->fd_slots[i];
+        if (fd_slot && fd_slot->fd == fd) {
+            if (fd_slot->type & POLLIN)
+                ev.events |= EPOLLIN;
+            if (fd_slot->type & POLLOUT)
+                ev.events |= EPOLLOUT;
+            if (fd_slot->type & POLLERR)
+                ev.events |= EPOLLPRI;
+        }
+    }
+
+    if (ev.events == 0) {
+        epoll_ctl (msg_queue->epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+    }
+    else if (epoll_ctl (msg_queue->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+            (errno != ENOENT ||
+             epoll_ctl (msg_queue->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)) {
+        /* for example, a regular file can not be polled by epoll */
+        _WRN_PRINTF ("can not poll fd %d by epoll (%m); "
+                "fall back to select\n", fd);
+        disable_tickless_idle (msg_queue);
+    }
+}
+
+/*
+ * The desktop thread blinks the caret, repeats the keys and so on when it
+ * handles MSG_TIMEOUT, which is generated by __mg_update_tick_count when
+ * the thread wakes up more than DESKTOP_TIMER_INERTVAL ticks after the last
+ * time. So it wakes up one tick later than that even if there is no timer.
+ */
+#define DESKTOP_IDLE_MS     ((DESKTOP_TIMER_INERTVAL + 1) * 10)
+
+/* arm the timerfd for the next timer; returns the timeout for epoll_wait */
+static int arm_idle_timer (MSGQUEUE* msg_queue)
+{
+    struct itimerspec its;
+    DWORD now, expected, timeout;
+    BOOL is_desktop = (msg_queue == __mg_dsk_msg_queue);
+
+    memset (&its, 0, sizeof (its));
+    if (msg_queue->nr_timers == 0 && !is_desktop) {
+        if (msg_queue->timer_fd_armed) {
+            timerfd_settime (msg_queue->timer_fd, 0, &its, NULL);
+            msg_queue->timer_fd_armed = FALSE;
+        }
+        return -1;
+    }
+
+    now = __mg_os_get_time_ms ();
+    if (msg_queue->nr_timers == 0)
+        expected = now + DESKTOP_IDLE_MS;
+    else {
+        expected = msg_queue->timer_heap[0]->ms_expected;
+        if (is_desktop && (LINT)(expected - now) > (LINT)DESKTOP_IDLE_MS)
+            expected = now + DESKTOP_IDLE_MS;
+    }
+
+    if ((LINT)(expected - now) <= 0)
+        return 0;
+
+    /* the armed deadline is not later; it will wake us up in time */
+    if (msg_queue->timer_fd_armed &&
+            (LINT)(msg_queue->timer_fd_expected - expected) <= 0)
+        return -1;
+
+    timeout = expected - now;
+    its.it_value.tv_sec = timeout / 1000;
+    its.it_value.tv_nsec = (timeout % 1000) * 1000000L;
+    if (timerfd_settime (msg_queue->timer_fd, 0, &its, NULL) < 0) {
+        _WRN_PRINTF ("failed to arm timerfd: %m\n");
+        return (int)MIN (timeout, 0x7FFFFFFF);
+    }
+
+    msg_queue->timer_fd_armed = TRUE;
+    msg_queue->timer_fd_expected = expected;
+    return -1;
+}
+
+static BOOL tickless_idle_handler (MSGQUEUE* msg_queue, BOOL wait)
+{
+    struct epoll_event events[NR_IDLE_EPOLL_EVENTS];
+    fd_set rset, wset, eset;
+    int i, nr_events, timeout = 0, n = 0;
+    BOOL woken = FALSE, got_fd = FALSE;
+
+    if (msg_queue->epoll_fd < 0) {
+        if (msg_queue->tickless_failed || !wait ||
+                !init_tickless_idle (msg_queue))
+            return std_idle_handler (msg_queue, wait);
+    }
+
+    if (wait) {
+        int sem_value;
+
+        timeout = arm_idle_timer (msg_queue);
+
+        /* announce the sleeping before checking the semaphore again;
+           a thread posting a message after this will wake us up. */
+        __atomic_store_n (&msg_queue->sleeping, 1, __ATOMIC_SEQ_CST);
+        sem_getvalue (&msg_queue->wait, &sem_value);
+        if (sem_value > 0)
+            timeout = 0;
+    }
+
+    nr_events = epoll_wait (msg_queue->epoll_fd, events,
+            NR_IDLE_EPOLL_EVENTS, timeout);
+    __atomic_store_n (&msg_queue->sleeping, 0, __ATOMIC_SEQ_CST);
+
+    if (nr_events < 0) {
+        if (errno != EINTR) {
+            _WRN_PRINTF ("unexpected error of epoll_wait(): %m\n");
+        }
+        return FALSE;
+    }
+
+    mg_fd_zero (&rset);
+    mg_fd_zero (&wset);
+    mg_fd_zero (&eset);
+    for (i = 0; i < nr_events; i++) {
+        int fd = events[i].data.fd;
+        uint64_t count;
+
+        if (fd == msg_queue->wakeup_fd) {
+            if (read (fd, &count, sizeof (count)) < 0 && errno != EAGAIN)
+                _WRN_PRINTF ("failed to read eventfd: %m\n");
+            woken = TRUE;
+        }
+        else if (fd == msg_queue->timer_fd) {
+            if (read (fd, &count, sizeof (count)) < 0 && errno != EAGAIN)
+                _WRN_PRINTF ("failed to read timerfd: %m\n");
+            msg_queue->timer_fd_armed = FALSE;
+        }
+        else {
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                mg_fd_set (fd, &rset);
+            if (events[i].events & (EPOLLOUT | EPOLLERR))
+                mg_fd_set (fd, &wset);
+            if (events[i].events & EPOLLPRI)
+                mg_fd_set (fd, &eset);
+            got_fd = TRUE;
+        }
+    }
+
+    n += __mg_check_expired_timers (msg_queue);
+
+    if (got_fd) {
+        n += __mg_kernel_check_listen_fds (msg_queue, &rset, &wset, &eset);
+    }
+
+    if (timeout != 0) {
+        msg_queue->stats.nr_idle_wakeups++;
+        if (n == 0 && !woken)
+            msg_queue->stats.nr_empty_wakeups++;
+    }
+
     return n > 0;
 }
+#endif  /* defined _MGHAVE_TICKLESS_IDLE */
 
 #else   /* defined HAVE_SELECT */
 
@@ -292,7 +1051,7 @@ static BOOL std_idle_handler (MSGQUEUE* msg_queue, BOOL wait)
     long timeout_ms;
 
     if (wait) {
-        timeout_ms = 10;
+        timeout_ms = __mg_get_timer_timeout (msg_queue, 10);
     }
     else {
         timeout_ms = 0;
@@ -301,9 +1060,7 @@ static BOOL std_idle_handler (MSGQUEUE* msg_queue, BOOL wait)
     if (timeout_ms > 0)
         __mg_os_time_delay (timeout_ms);
 
-    n = __mg_check_expired_timers (msg_queue,
-            __mg_tick_counter - msg_queue->old_tick_count);
-    msg_queue->old_tick_count = __mg_tick_counter;
+    n = __mg_check_expired_timers (msg_queue);
     return n > 0;
 }
 
@@ -351,13 +1108,31 @@ BOOL mg_InitMsgQueue (PMSGQUEUE pMsgQueue, int iBufferLen)
 
     pMsgQueue->len = iBufferLen;
 
+    if (!coalesce_index_init (pMsgQueue)) {
+        free (pMsgQueue->msg);
+        pMsgQueue->msg = NULL;
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+        pthread_mutex_destroy (&pMsgQueue->lock);
+        sem_destroy (&pMsgQueue->wait);
+#endif
+        return FALSE;
+    }
+
     pMsgQueue->OnIdle = std_idle_handler;
 
+#ifdef _MGHAVE_TICKLESS_IDLE
+    pMsgQueue->epoll_fd = -1;
+    pMsgQueue->wakeup_fd = -1;
+    pMsgQueue->timer_fd = -1;
+    pMsgQueue->OnIdle = tickless_idle_handler;
+#endif
+
     /* Since 5.0.0, MiniGUI provides support for timers per message thread */
-    // pMsgQueue->first_timer_slot = 0;
-    // pMsgQueue->expired_timer_mask = 0;
-    // memset (pMsgQueue->timer_slots, 0, sizeof (pMsgQueue->timer_slots));
-    pMsgQueue->old_tick_count = __mg_tick_counter;
+    // pMsgQueue->nr_timers = 0;
+    // pMsgQueue->max_timers = 0;
+    // pMsgQueue->timer_heap = NULL;
+    // pMsgQueue->first_expired_timer = NULL;
+    // pMsgQueue->last_expired_timer = NULL;
 
 #ifdef HAVE_SELECT
     /* Since 5.0.0, MiniGUI supports listening file descriptors
@@ -401,9 +1176,23 @@ void mg_DestroyMsgQueue (PMSGQUEUE pMsgQueue)
 
     __mg_remove_timers_by_msg_queue (pMsgQueue);
 
+#ifdef _MGHAVE_TICKLESS_IDLE
+    close_tickless_idle (pMsgQueue);
+#endif
+
     if (pMsgQueue->msg)
         free (pMsgQueue->msg);
     pMsgQueue->msg = NULL;
+
+    discard_inbox_messages (pMsgQueue);
+    free_post_qmsg_list (pMsgQueue->pFirstSpilledMsg);
+    pMsgQueue->pFirstSpilledMsg = NULL;
+    pMsgQueue->pLastSpilledMsg = NULL;
+
+    free (pMsgQueue->coalesce_index);
+    free (pMsgQueue->coalesce_flags);
+    pMsgQueue->coalesce_index = NULL;
+    pMsgQueue->coalesce_flags = NULL;
 }
 
 /* post a message to a message queue */
@@ -412,70 +1201,35 @@ BOOL kernel_QueueMessage (PMSGQUEUE msg_que, PMSG msg)
     if (msg_que == NULL || msg == NULL)
         return FALSE;
 
-    LOCK_MSGQ(msg_que);
-
     msg->time = __mg_tick_counter;
 
-    /* check for the duplicated messages */
-    if (msg->message == MSG_MOUSEMOVE
-            || msg->message == MSG_NCMOUSEMOVE
-            || msg->message == MSG_DT_MOUSEMOVE) {
-        int readpos = msg_que->readpos;
-        PMSG a_msg, last_msg = NULL;
-
-        while (readpos != msg_que->writepos) {
-            a_msg = msg_que->msg + readpos;
+#ifdef _MG_LOCKFREE_POSTMSG
+    if (lockfree_postmsg && msg_que != getMsgQueueForThisThread ()) {
+        PQMSG qmsg;
 
-            if (a_msg->message == msg->message
-                        && a_msg->wParam == msg->wParam
-                        && a_msg->hwnd == msg->hwnd) {
-                last_msg = a_msg;
-            }
-
-            readpos ++;
-            readpos %= msg_que->len;
+        if (is_inbox_full (msg_que) || (qmsg = ALLOCPOSTQMSG ()) == NULL) {
+            __atomic_add_fetch (&msg_que->stats.nr_dropped, 1,
+                    __ATOMIC_RELAXED);
+            return FALSE;
         }
 
-        if (last_msg) {
-            last_msg->lParam = msg->lParam;
-            last_msg->time = msg->time;
-            goto ret;
-        }
+        qmsg->Msg = *msg;
+        push_inbox_message (msg_que, qmsg);
+        POST_MSGQ (msg_que);
+        return TRUE;
     }
-    else if (msg->message == MSG_TIMEOUT
-                || msg->message == MSG_IDLE
-                || msg->message == MSG_CARETBLINK) {
-        int readpos = msg_que->readpos;
-        PMSG a_msg;
-
-        while (readpos != msg_que->writepos) {
-            a_msg = msg_que->msg + readpos;
-
-            if (a_msg->message == msg->message
-                    && a_msg->hwnd == msg->hwnd) {
-                a_msg->wParam = msg->wParam;
-                a_msg->lParam = msg->lParam;
-                a_msg->time = msg->time;
-                goto ret;
-            }
+#endif
 
-            readpos ++;
-            readpos %= msg_que->len;
-        }
-    }
+    LOCK_MSGQ (msg_que);
+
+    /* the messages in the inbox were posted before this one */
+    fetch_inbox_messages (msg_que);
 
-    if ((msg_que->writepos + 1) % msg_que->len == msg_que->readpos) {
-        // message queue is full.
-        UNLOCK_MSGQ(msg_que);
+    if (!append_post_message (msg_que, NULL, msg)) {
+        UNLOCK_MSGQ (msg_que);
         return FALSE;
     }
 
-    /* Write the data and advance write pointer */
-    msg_que->msg [msg_que->writepos] = *msg;
-    msg_que->writepos++;
-    msg_que->writepos %= msg_que->len;
-
-ret:
     msg_que->dwState |= QS_POSTMSG;
 
     UNLOCK_MSGQ (msg_que);
@@ -555,6 +1309,7 @@ BOOL GUIAPI HavePendingMessageEx (HWND hWnd, BOOL bNoDeskTimer)
     TEST_IF_QUIT(pMsgQueue, hWnd);
 
     LOCK_MSGQ (pMsgQueue);
+    fetch_inbox_messages (pMsgQueue);
 
 #ifdef _MGHAVE_VIRTUAL_WINDOW
     if (pMsgQueue->dwState & QS_SYNCMSG) {
@@ -574,7 +1329,7 @@ BOOL GUIAPI HavePendingMessageEx (HWND hWnd, BOOL bNoDeskTimer)
         goto retok;
     }
 
-    if (pMsgQueue->expired_timer_mask)
+    if (pMsgQueue->first_expired_timer)
         goto retok;
 
     /*
@@ -752,6 +1507,7 @@ checkagain:
     TEST_IF_QUIT(pMsgQueue, hWnd);
 
     LOCK_MSGQ (pMsgQueue);
+    fetch_inbox_messages (pMsgQueue);
 
     if ((pMsgQueue->dwState & QS_QUIT)) {
         pMsg->hwnd = hWnd;
@@ -820,8 +1576,7 @@ checkagain:
             if (IS_MSG_WANTED(pMsg->message)) {
                 CheckCapturedMouseMessage (pMsg);
                 if (uRemoveMsg == PM_REMOVE) {
-                    pMsgQueue->readpos++;
-                    pMsgQueue->readpos %= pMsgQueue->len;
+                    remove_first_post_message (pMsgQueue);
                 }
 
                 UNLOCK_MSGQ (pMsgQueue);
@@ -879,46 +1634,33 @@ checkagain:
     }
 
     /* handle general timer here */
-    if (pMsgQueue->expired_timer_mask && IS_MSG_WANTED(MSG_TIMER)) {
-        int slot;
+    if (pMsgQueue->first_expired_timer && IS_MSG_WANTED(MSG_TIMER)) {
         TIMER* timer;
 
-        /* get the first expired timer slot */
-        slot = pMsgQueue->first_timer_slot;
-        do {
-            if (pMsgQueue->expired_timer_mask & (0x01UL << slot))
-                break;
-
-            slot ++;
-            slot %= DEF_NR_TIMERS;
-            if (slot == pMsgQueue->first_timer_slot) {
-                slot = -1;
-                break;
-            }
-        } while (TRUE);
-
-        pMsgQueue->first_timer_slot ++;
-        pMsgQueue->first_timer_slot %= DEF_NR_TIMERS;
-
-        if ((timer = pMsgQueue->timer_slots[slot])) {
-            pMsgQueue->expired_timer_mask &= ~(0x01UL << slot);
-
+        /* get the first expired timer */
+        if ((timer = __mg_fetch_expired_timer (pMsgQueue))) {
             if (timer->proc) {
                 BOOL ret_timer_proc;
+                HWND timer_wnd = timer->hWnd;
+                LINT timer_id = timer->id;
+                DWORD timer_serial = timer->serial;
 
                 /* unlock the message queue when calling timer proc */
                 UNLOCK_MSGQ (pMsgQueue);
 
-                /* calling the timer callback procedure */
-                ret_timer_proc = timer->proc (timer->hWnd,
-                        timer->id, timer->ticks_fired);
+                /* calling the timer callback procedure;
+                   the timer may be killed in the callback */
+                ret_timer_proc = timer->proc (timer_wnd,
+                        timer_id, timer->ticks_fired);
 
                 /* lock the message queue again */
                 LOCK_MSGQ (pMsgQueue);
 
                 if (!ret_timer_proc) {
-                    /* remove the timer */
-                    __mg_remove_timer (pMsgQueue, slot);
+                    /* remove the timer, unless the callback killed it;
+                       do not touch a new timer with the same identifier */
+                    __mg_remove_timer (pMsgQueue, timer_wnd, timer_id,
+                            timer_serial);
                 }
                 UNLOCK_MSGQ (pMsgQueue);
                 goto checkagain;
@@ -1026,6 +1768,7 @@ checkagain:
     TEST_IF_QUIT(pMsgQueue, hWnd);
 
     LOCK_MSGQ (pMsgQueue);
+    fetch_inbox_messages (pMsgQueue);
 
     if ((pMsgQueue->dwState & QS_QUIT)) {
         goto getit;
@@ -1059,7 +1802,7 @@ checkagain:
         goto getit;
     }
 
-    if (pMsgQueue->expired_timer_mask) {
+    if (pMsgQueue->first_expired_timer) {
         goto getit;
     }
 
@@ -1106,6 +1849,7 @@ BOOL GUIAPI PeekPostMessage (PMSG pMsg, HWND hWnd, UINT nMsgFilterMin,
         return FALSE;
 
     LOCK_MSGQ (pMsgQueue);
+    fetch_inbox_messages (pMsgQueue);
     memset (pMsg, 0, sizeof(MSG));
 
     if (pMsgQueue->dwState & QS_POSTMSG) {
@@ -1126,8 +1870,7 @@ BOOL GUIAPI PeekPostMessage (PMSG pMsg, HWND hWnd, UINT nMsgFilterMin,
             SET_PADD (NULL);
 
             if (uRemoveMsg == PM_REMOVE) {
-                pMsgQueue->readpos++;
-                pMsgQueue->readpos %= pMsgQueue->len;
+                remove_first_post_message (pMsgQueue);
             }
 
             UNLOCK_MSGQ (pMsgQueue);
@@ -1437,9 +2180,10 @@ int __mg_throw_away_messages (PMSGQUEUE pMsgQueue, HWND hWnd)
     int         nCountS = 0;
     int         nCountP = 0;
     int         readpos;
-    int         slot;
+    TIMER*      timer;
 
     LOCK_MSGQ (pMsgQueue);
+    fetch_inbox_messages (pMsgQueue);
 
     if (pMsgQueue->pFirstNotifyMsg) {
         PQMSG pPrev = NULL, pNext;
@@ -1560,17 +2304,54 @@ int __mg_throw_away_messages (PMSGQUEUE pMsgQueue, HWND hWnd)
         }
     }
 
+    /* since 5.0.16, throw away the spilled messages */
+    if (pMsgQueue->pFirstSpilledMsg) {
+        PQMSG pPrev = NULL, pNext;
+        pQMsg = pMsgQueue->pFirstSpilledMsg;
+
+        while (pQMsg) {
+            pMsg = &pQMsg->Msg;
+            pNext = pQMsg->next;
+
+            if (pMsg->hwnd == hWnd ||
+                    checkAndGetMainWindowIfControl (pMsg->hwnd) == pMainWin) {
+                if (pPrev)
+                    pPrev->next = pNext;
+                else
+                    pMsgQueue->pFirstSpilledMsg = pNext;
+
+                if (pMsgQueue->pLastSpilledMsg == pQMsg)
+                    pMsgQueue->pLastSpilledMsg = pPrev;
+
+                FREEPOSTQMSG (pQMsg);
+                pMsgQueue->nr_spilled--;
+                nCountP++;
+            }
+            else {
+                pPrev = pQMsg;
+            }
+
+            pQMsg = pNext;
+        }
+    }
+
+    /* the remained post messages may have been moved */
+    if (nCountP > 0) {
+        coalesce_index_rebuild (pMsgQueue);
+        refill_post_messages (pMsgQueue);
+    }
+
     _DBG_PRINTF ("%d post messages thrown for window %p\n", nCountP, hWnd);
 
     /* clear timer message flags of this window */
-    for (slot = 0; slot < DEF_NR_TIMERS; slot++) {
-        if (pMsgQueue->expired_timer_mask & (0x01UL << slot)) {
-            HWND timer_wnd = pMsgQueue->timer_slots [slot]->hWnd;
-            if (timer_wnd == hWnd ||
-                     checkAndGetMainWindowIfControl (timer_wnd) == pMainWin) {
-                pMsgQueue->expired_timer_mask &= ~(0x01UL << slot);
-            }
+    timer = pMsgQueue->first_expired_timer;
+    while (timer) {
+        TIMER* next = timer->next_expired;
+        if (timer->hWnd == hWnd ||
+                checkAndGetMainWindowIfControl (timer->hWnd) == pMainWin) {
+            __mg_unmark_expired_timer (pMsgQueue, timer);
         }
+        timer = next;
     }
 
     UNLOCK_MSGQ (pMsgQueue);
@@ -1646,9 +2427,16 @@ BOOL GUIAPI EmptyMessageQueue (HWND hWnd)
 
     pMsgQueue->readpos = 0;
     pMsgQueue->writepos = 0;
+    coalesce_index_reset (pMsgQueue);
+
+    discard_inbox_messages (pMsgQueue);
+    free_post_qmsg_list (pMsgQueue->pFirstSpilledMsg);
+    pMsgQueue->pFirstSpilledMsg = NULL;
+    pMsgQueue->pLastSpilledMsg = NULL;
+    pMsgQueue->nr_spilled = 0;
 
     pMsgQueue->dwState = QS_EMPTY;
-    pMsgQueue->expired_timer_mask = 0;
+    __mg_clear_expired_timers (pMsgQueue);
 
     return TRUE;
 }
@@ -0,0 +1,227 @@
+/*
+** tiled-bench.c: compare the frame time of the tiled compositor
+** with the fallback compositor.
+**
+** This program runs as the server (mginit) of MiniGUI-Processes under
+** the compositing schema. It creates some overlapped opaque and
+** translucent main windows, then refreshes the whole screen repeatedly
+** with the fallback compositor and with the tiled compositor using
+** 1 to N threads, and reports the average time of a frame.
+**
+** It does the same for the frames of a layer transition, which
+** composite the topmost layer scaled (and moved) by composite_layers.
+** Note that the main windows of the server are shown on all layers, so
+** composite_layers neither scales nor moves them; only the wallpaper
+** and the windows of the clients are.
+**
+** The tiled compositor should produce the same pixels as the fallback
+** compositor; this program also checks it.
+**
+** The server of MiniGUI-Processes must be named `mginit`, so run it as:
+**
+**  $ ln -sf tiled-bench mginit
+**  $ ./mginit [max_threads] [frames]
+**
+** Note that the speedup depends on the number of online CPUs.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define NR_WINDOWS          8
+
+static HWND windows [NR_WINDOWS];
+
+static LRESULT BenchWinProc (HWND hWnd, UINT message, WPARAM wParam,
+        LPARAM lParam)
+{
+    switch (message) {
+    case MSG_PAINT: {
+        HDC hdc = BeginPaint (hWnd);
+        RECT rc;
+        int i;
+
+        GetClientRect (hWnd, &rc);
+        for (i = 0; i < RECTH (rc); i += 8) {
+            SetBrushColor (hdc, RGBA2Pixel (hdc, i * 4, 255 - i * 2,
+                        (int)(GetWindowAdditionalData (hWnd) * 32), 0xC0));
+            FillBox (hdc, 0, i, RECTW (rc), 8);
+        }
+        TextOut (hdc, 4, 4, GetWindowCaption (hWnd));
+        EndPaint (hWnd, hdc);
+        return 0;
+    }
+    }
+
+    return DefaultMainWinProc (hWnd, message, wParam, lParam);
+}
+
+static void create_windows (void)
+{
+    static const int ct_types [] = {
+        CT_OPAQUE, CT_ALPHACHANNEL, CT_OPAQUE, CT_COLORKEY,
+    };
+    static char captions [NR_WINDOWS][16];
+    RECT rc_scr = GetScreenRect ();
+    MAINWINCREATE CreateInfo;
+    int i;
+
+    memset (&CreateInfo, 0, sizeof (CreateInfo));
+    CreateInfo.dwStyle = WS_VISIBLE | WS_CAPTION | WS_BORDER;
+    CreateInfo.MainWindowProc = BenchWinProc;
+    CreateInfo.iBkColor = COLOR_lightwhite;
+    CreateInfo.hHosting = HWND_DESKTOP;
+
+    for (i = 0; i < NR_WINDOWS; i++) {
+        int ct = ct_types [i % TABLESIZE (ct_types)];
+
+        sprintf (captions [i], "win %d", i);
+        CreateInfo.spCaption = captions [i];
+        CreateInfo.dwAddData = i;
+        CreateInfo.lx = i * RECTW (rc_scr) / (NR_WINDOWS * 2);
+        CreateInfo.ty = i * RECTH (rc_scr) / (NR_WINDOWS * 2);
+        CreateInfo.rx = CreateInfo.lx + RECTW (rc_scr) / 2;
+        CreateInfo.by = CreateInfo.ty + RECTH (rc_scr) / 2;
+
+        windows [i] = CreateMainWindowEx2 (&CreateInfo, 0L, NULL, NULL,
+                (ct == CT_OPAQUE) ? ST_PIXEL_DEFAULT : ST_PIXEL_ARGB8888,
+                MakeRGBA (0xFF, 0xFF, 0xFF, 0x80),
+                ct, (ct == CT_COLORKEY) ? MakeRGBA (0xFF, 0xFF, 0xFF, 0xFF) :
+                    0x80);
+    }
+}
+
+typedef struct _FRAMEMODE {
+    const char* name;
+    /* NULL to refresh the screen */
+    const COMBPARAMS_FALLBACK* cp;
+} FRAMEMODE;
+
+static const COMBPARAMS_FALLBACK cp_scaled =
+        { FCM_HORIZONTAL | FCM_SCALE, 100.0f, 0.8f };
+static const COMBPARAMS_FALLBACK cp_moved =
+        { FCM_HORIZONTAL | FCM_SCALE, 60.0f, 0.7f };
+
+static const FRAMEMODE modes [] = {
+    { "refresh", NULL },
+    { "scaled", &cp_scaled },
+    { "moved", &cp_moved },
+};
+
+static void run_frame (const CompositorOps* ops, CompositorCtxt* ctxt,
+        const COMBPARAMS_FALLBACK* cp)
+{
+    if (cp) {
+        MG_Layer* layers [2] = { mgTopmostLayer, NULL };
+        COMBPARAMS_FALLBACK params = *cp;
+
+        ops->composite_layers (ctxt, layers, 2, &params);
+    }
+    else {
+        ops->refresh (ctxt);
+    }
+}
+
+static double run_frames (const char* name, const COMBPARAMS_FALLBACK* cp,
+        int frames, BITMAP* bmp)
+{
+    const CompositorOps* ops;
+    CompositorCtxt* ctxt;
+    struct timespec ts_start, ts_end;
+    RECT rc_scr = GetScreenRect ();
+    int i;
+
+    ops = ServerSelectCompositor (name, &ctxt);
+    if (ops == NULL) {
+        fprintf (stderr, "failed to select compositor: %s\n", name);
+        return -1.0;
+    }
+
+    // warm up
+    run_frame (ops, ctxt, cp);
+
+    clock_gettime (CLOCK_MONOTONIC, &ts_start);
+    for (i = 0; i < frames; i++) {
+        run_frame (ops, ctxt, cp);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &ts_end);
+
+    if (bmp) {
+        GetBitmapFromDC (HDC_SCREEN_SYS, 0, 0,
+                RECTW (rc_scr), RECTH (rc_scr), bmp);
+    }
+
+    return ((ts_end.tv_sec - ts_start.tv_sec) * 1000.0 +
+            (ts_end.tv_nsec - ts_start.tv_nsec) / 1000000.0) / frames;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    MSG msg;
+    BITMAP bmp_serial, bmp_tiled;
+    double ms_serial;
+    int max_threads = 8, frames = 100;
+    int nr_threads, i;
+
+    if (argc > 1)
+        max_threads = atoi (argv [1]);
+    if (argc > 2)
+        frames = atoi (argv [2]);
+    if (max_threads <= 0 || frames <= 0) {
+        fprintf (stderr, "usage: mginit [max_threads] [frames]\n");
+        return 1;
+    }
+
+    if (!ServerStartup (0, 0, 0)) {
+        fprintf (stderr, "failed to start the server\n");
+        return 1;
+    }
+
+    create_windows ();
+    while (PeekMessage (&msg, HWND_DESKTOP, 0, 0, PM_REMOVE))
+        DispatchMessage (&msg);
+
+    memset (&bmp_serial, 0, sizeof (bmp_serial));
+    memset (&bmp_tiled, 0, sizeof (bmp_tiled));
+
+    for (i = 0; i < (int)TABLESIZE (modes); i++) {
+        ServerSelectCompositor (COMPSOR_NAME_FALLBACK, NULL);
+        ms_serial = run_frames (COMPSOR_NAME_FALLBACK, modes [i].cp,
+                frames, &bmp_serial);
+        printf ("%-8s %-10s threads: -  %8.3f ms/frame\n", modes [i].name,
+                COMPSOR_NAME_FALLBACK, ms_serial);
+
+        for (nr_threads = 1; nr_threads <= max_threads; nr_threads++) {
+            char buff [16];
+            double ms;
+
+            sprintf (buff, "%d", nr_threads);
+            setenv ("MG_WORKER_THREADS", buff, 1);
+
+            // select the fallback compositor to re-create the tiled one
+            ServerSelectCompositor (COMPSOR_NAME_FALLBACK, NULL);
+            ms = run_frames (COMPSOR_NAME_TILED, modes [i].cp,
+                    frames, &bmp_tiled);
+            printf ("%-8s %-10s threads: %-2d %8.3f ms/frame (x%.2f)%s\n",
+                    modes [i].name, COMPSOR_NAME_TILED, nr_threads,
+                    ms, ms_serial / ms,
+                    memcmp (bmp_serial.bmBits, bmp_tiled.bmBits,
+                        bmp_serial.bmPitch * bmp_serial.bmHeight) ?
+                        " MISMATCHED" : "");
+
+            UnloadBitmap (&bmp_tiled);
+        }
+
+        UnloadBitmap (&bmp_serial);
+    }
+
+    ServerSelectCompositor (COMPSOR_NAME_FALLBACK, NULL);
+    return 0;
+}
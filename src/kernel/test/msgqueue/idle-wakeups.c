@@ -0,0 +1,182 @@
+/*
+** idle-wakeups.c: check the idle wakeups of a message thread.
+**
+** This program keeps the main thread idle for a while, then wakes it up
+** by a message posted from another thread, by a listening fd, and by
+** a 3ms high resolution timer. It reports the latencies and the idle
+** wakeup counters of the message queue.
+**
+** When MiniGUI is configured with --enable-tickless, the number of
+** empty wakeups should stay (nearly) zero; otherwise it increases
+** every 10ms.
+**
+** The desktop thread has no timer, but it still has to wake up about
+** every 110ms to generate MSG_TIMEOUT for the caret blinking and so on.
+** The program checks the number of idle wakeups of the desktop thread
+** in the meantime.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define IDLE_USEC           300000
+#define ID_HIRES_TIMER      1
+#define ID_QUIT_TIMER       2
+
+static HWND hMainWnd;
+static int nr_failed;
+static int pipe_fds [2];
+static int nr_hires_fired;
+static struct timespec ts_event;
+static struct timespec ts_start;
+static MSGQUEUESTATS desktop_stats;
+
+static double elapsed_ms (const struct timespec* ts)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - ts->tv_sec) * 1000.0 +
+        (now.tv_nsec - ts->tv_nsec) / 1000000.0;
+}
+
+static void report (const char* stage)
+{
+    MSGQUEUESTATS stats;
+
+    GetMsgQueueStats (HWND_NULL, &stats);
+    printf ("%-16s idle wakeups: %6lu; empty wakeups: %6lu\n", stage,
+            (unsigned long)stats.nr_idle_wakeups,
+            (unsigned long)stats.nr_empty_wakeups);
+}
+
+/* returns the number of failures */
+static int check_desktop (void)
+{
+    MSGQUEUESTATS stats;
+    double ms = elapsed_ms (&ts_start);
+    unsigned long nr_wakeups, nr_min, nr_max;
+
+    if (!GetMsgQueueStats (HWND_DESKTOP, &stats)) {
+        printf ("desktop: FAILED to get the statistics\n");
+        return 1;
+    }
+
+    /* the desktop thread wakes up every 110ms (or every 10ms without
+       tickless idle), and for the events of this program */
+    nr_wakeups = stats.nr_idle_wakeups - desktop_stats.nr_idle_wakeups;
+    nr_min = (unsigned long)(ms / 110) / 2;
+    nr_max = (unsigned long)(ms / 10) + 10;
+    printf ("desktop: %lu idle wakeups in %.0f ms\n", nr_wakeups, ms);
+    if (nr_wakeups < nr_min || nr_wakeups > nr_max) {
+        printf ("desktop: FAILED; expected %lu to %lu wakeups\n",
+                nr_min, nr_max);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void* waker (void* arg)
+{
+    usleep (IDLE_USEC);
+    clock_gettime (CLOCK_MONOTONIC, &ts_event);
+    PostMessage (hMainWnd, MSG_USER, 0, 0);
+
+    usleep (IDLE_USEC);
+    clock_gettime (CLOCK_MONOTONIC, &ts_event);
+    if (write (pipe_fds [1], "x", 1) < 0)
+        perror ("write");
+
+    return NULL;
+}
+
+static BOOL hires_timer_proc (HWND hWnd, LINT id, DWORD ticks)
+{
+    return ++nr_hires_fired < 100;
+}
+
+static LRESULT TestWinProc (HWND hWnd, UINT message, WPARAM wParam,
+        LPARAM lParam)
+{
+    switch (message) {
+    case MSG_USER:
+        printf ("message latency: %.3f ms\n", elapsed_ms (&ts_event));
+        report ("after message:");
+        return 0;
+
+    case MSG_FDEVENT: {
+        char c;
+
+        if (read (pipe_fds [0], &c, 1) < 0)
+            perror ("read");
+        printf ("fd event latency: %.3f ms\n", elapsed_ms (&ts_event));
+        report ("after fd event:");
+
+        SetHiResTimer (hWnd, ID_HIRES_TIMER, 3, hires_timer_proc);
+        SetTimer (hWnd, ID_QUIT_TIMER, 50);
+        return 0;
+    }
+
+    case MSG_TIMER:
+        printf ("3ms timer fired %d times in 500ms\n", nr_hires_fired);
+        report ("after timers:");
+        nr_failed += check_desktop ();
+        KillTimer (hWnd, ID_QUIT_TIMER);
+        PostQuitMessage (hWnd);
+        return 0;
+    }
+
+    return DefaultMainWinProc (hWnd, message, wParam, lParam);
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    MSG msg;
+    pthread_t th;
+    MAINWINCREATE CreateInfo;
+
+    memset (&CreateInfo, 0, sizeof (CreateInfo));
+    CreateInfo.dwStyle = WS_VISIBLE;
+    CreateInfo.spCaption = "idle-wakeups";
+    CreateInfo.MainWindowProc = TestWinProc;
+    CreateInfo.rx = 100;
+    CreateInfo.by = 100;
+    CreateInfo.hHosting = HWND_DESKTOP;
+
+    hMainWnd = CreateMainWindow (&CreateInfo);
+    if (hMainWnd == HWND_INVALID)
+        return 1;
+
+    if (pipe (pipe_fds) < 0 ||
+            !RegisterListenFD (pipe_fds [0], POLLIN, hMainWnd, NULL)) {
+        perror ("pipe");
+        return 1;
+    }
+
+    while (PeekMessage (&msg, hMainWnd, 0, 0, PM_REMOVE))
+        DispatchMessage (&msg);
+    report ("start:");
+    GetMsgQueueStats (HWND_DESKTOP, &desktop_stats);
+    clock_gettime (CLOCK_MONOTONIC, &ts_start);
+
+    pthread_create (&th, NULL, waker, NULL);
+    while (GetMessage (&msg, hMainWnd)) {
+        DispatchMessage (&msg);
+    }
+    pthread_join (th, NULL);
+
+    UnregisterListenFD (pipe_fds [0]);
+    close (pipe_fds [0]);
+    close (pipe_fds [1]);
+    DestroyMainWindowIndirect (hMainWnd);
+    return nr_failed ? 1 : 0;
+}
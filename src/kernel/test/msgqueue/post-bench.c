@@ -0,0 +1,266 @@
+/*
+** post-bench.c: benchmark for posting messages from multiple threads.
+**
+** Usage: post-bench [bench|flood]
+**
+** This program posts messages to a main window from 1 to 16 producer
+** threads, and reports the throughput of posting and the statistics
+** of the message queue. It also checks that the messages from one
+** producer are received in order.
+**
+** Without an argument, the program runs itself with the lock-free inbox
+** of the message queue and with the mutex of the message queue
+** (MG_LOCKFREE_POSTMSG=yes or no), so that the numbers of both ways come
+** from the same binary and library. The benchmark raises the limit of the
+** overflow list (MG_MAX_SPILLED_MSGS) above the number of posts, for the
+** producers would spin on the failed posts otherwise. Then, in both ways,
+** the program floods the message queue with a small limit and checks that
+** the posts beyond the limit fail and are counted as dropped, and that the
+** accepted ones are received in order.
+**
+** The option MG_LOCKFREE_POSTMSG is ignored by a library built with
+** CPPFLAGS=-D_MG_LOCKED_POSTMSG.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define MSG_BENCH_POST      (MSG_USER + 1)
+#define MAX_PRODUCERS       16
+#define NR_TOTAL_POSTS      (1024 * 1024)
+
+#define FLOOD_LIMIT         1000
+#define NR_FLOOD_POSTS      (FLOOD_LIMIT * 4)
+
+static HWND hMainWnd;
+static int nr_posts_per_producer;
+static int nr_received;
+static int nr_disordered;
+static LPARAM last_seq [MAX_PRODUCERS];
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void* producer (void* arg)
+{
+    WPARAM id = (WPARAM)(intptr_t)arg;
+    LPARAM seq;
+
+    for (seq = 1; seq <= nr_posts_per_producer; seq++) {
+        while (PostMessage (hMainWnd, MSG_BENCH_POST, id, seq) != ERR_OK)
+            sched_yield ();
+    }
+
+    return NULL;
+}
+
+/* posts without retrying; the sequence numbers of the accepted posts
+   are contiguous, for the receiver checks the order */
+static void* flooder (void* arg)
+{
+    int* nr_accepted = (int*)arg;
+    int i;
+
+    for (i = 0; i < NR_FLOOD_POSTS; i++) {
+        if (PostMessage (hMainWnd, MSG_BENCH_POST, 0,
+                    *nr_accepted + 1) == ERR_OK)
+            (*nr_accepted)++;
+    }
+
+    return NULL;
+}
+
+static LRESULT BenchWinProc (HWND hWnd, UINT message,
+        WPARAM wParam, LPARAM lParam)
+{
+    if (message == MSG_BENCH_POST) {
+        if (lParam != last_seq [wParam] + 1)
+            nr_disordered++;
+        last_seq [wParam] = lParam;
+        nr_received++;
+        return 0;
+    }
+
+    return DefaultMainWinProc (hWnd, message, wParam, lParam);
+}
+
+static void reset_receiver (void)
+{
+    nr_received = 0;
+    nr_disordered = 0;
+    memset (last_seq, 0, sizeof (last_seq));
+}
+
+static void run_bench (int nr_producers)
+{
+    static MSGQUEUESTATS last_stats;
+    pthread_t producers [MAX_PRODUCERS];
+    MSGQUEUESTATS stats;
+    MSG msg;
+    double t0, t1;
+    int i, nr_expected;
+
+    nr_posts_per_producer = NR_TOTAL_POSTS / nr_producers;
+    nr_expected = nr_posts_per_producer * nr_producers;
+    reset_receiver ();
+
+    t0 = now_ms ();
+    for (i = 0; i < nr_producers; i++)
+        pthread_create (producers + i, NULL, producer, (void*)(intptr_t)i);
+
+    while (nr_received < nr_expected && GetMessage (&msg, hMainWnd)) {
+        DispatchMessage (&msg);
+    }
+    t1 = now_ms ();
+
+    for (i = 0; i < nr_producers; i++)
+        pthread_join (producers [i], NULL);
+
+    GetMsgQueueStats (hMainWnd, &stats);
+    printf ("%2d producer(s): %8.0f msgs/ms; disordered: %d; "
+            "spilled: %lu; max spilled: %lu; dropped: %lu\n",
+            nr_producers, nr_expected / (t1 - t0), nr_disordered,
+            (unsigned long)(stats.nr_spilled - last_stats.nr_spilled),
+            (unsigned long)stats.max_spilled,
+            (unsigned long)(stats.nr_dropped - last_stats.nr_dropped));
+    last_stats = stats;
+}
+
+/* floods the queue while this thread does not read it */
+static int run_flood (void)
+{
+    pthread_t th;
+    MSGQUEUESTATS before, after;
+    MSG msg;
+    int nr_accepted = 0, nr_failed;
+
+    reset_receiver ();
+    GetMsgQueueStats (hMainWnd, &before);
+
+    pthread_create (&th, NULL, flooder, &nr_accepted);
+    pthread_join (th, NULL);
+
+    while (nr_received < nr_accepted &&
+            PeekMessage (&msg, hMainWnd, 0, 0, PM_REMOVE)) {
+        DispatchMessage (&msg);
+    }
+
+    GetMsgQueueStats (hMainWnd, &after);
+    nr_failed = NR_FLOOD_POSTS - nr_accepted;
+    printf ("flood: %d posts, %d accepted, %d received, %d disordered; "
+            "%d failed, %lu dropped; max spilled: %lu\n",
+            NR_FLOOD_POSTS, nr_accepted, nr_received, nr_disordered,
+            nr_failed, (unsigned long)(after.nr_dropped - before.nr_dropped),
+            (unsigned long)after.max_spilled);
+
+    if (nr_received != nr_accepted || nr_disordered ||
+            nr_failed == 0 || nr_accepted < FLOOD_LIMIT ||
+            after.max_spilled > FLOOD_LIMIT ||
+            after.nr_dropped - before.nr_dropped != (DWORD)nr_failed) {
+        printf ("flood: FAILED\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* runs this program for each way to post messages */
+static int run_modes (const char* path)
+{
+    static const struct {
+        const char* desc;
+        const char* lockfree;
+        const char* test;
+    } modes [] = {
+        { "lock-free inbox", "yes", "bench" },
+        { "mutex", "no", "bench" },
+        { "lock-free inbox", "yes", "flood" },
+        { "mutex", "no", "flood" },
+    };
+    char limit [16];
+    int i, bad = 0;
+
+    for (i = 0; i < (int)TABLESIZE (modes); i++) {
+        pid_t pid;
+        int status;
+
+        printf ("%s:\n", modes [i].desc);
+        fflush (stdout);
+
+        snprintf (limit, sizeof (limit), "%d",
+                strcmp (modes [i].test, "flood") ? NR_TOTAL_POSTS :
+                FLOOD_LIMIT);
+
+        pid = fork ();
+        if (pid == 0) {
+            setenv ("MG_LOCKFREE_POSTMSG", modes [i].lockfree, 1);
+            setenv ("MG_MAX_SPILLED_MSGS", limit, 1);
+            execl (path, path, modes [i].test, NULL);
+            _exit (127);
+        }
+
+        if (pid < 0 || waitpid (pid, &status, 0) != pid ||
+                !WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+            fprintf (stderr, "%s: %s failed\n", modes [i].desc,
+                    modes [i].test);
+            bad++;
+        }
+    }
+
+    return bad ? 1 : 0;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    MAINWINCREATE CreateInfo;
+    MSG msg;
+    int nr_producers, bad = 0;
+
+    if (argc < 2)
+        return run_modes (argv [0]);
+
+    memset (&CreateInfo, 0, sizeof (CreateInfo));
+    CreateInfo.dwStyle = WS_VISIBLE;
+    CreateInfo.spCaption = "post-bench";
+    CreateInfo.hCursor = GetSystemCursor (0);
+    CreateInfo.MainWindowProc = BenchWinProc;
+    CreateInfo.rx = 100;
+    CreateInfo.by = 100;
+    CreateInfo.iBkColor = COLOR_lightwhite;
+    CreateInfo.hHosting = HWND_DESKTOP;
+
+    hMainWnd = CreateMainWindow (&CreateInfo);
+    if (hMainWnd == HWND_INVALID)
+        return 1;
+
+    while (PeekMessage (&msg, hMainWnd, 0, 0, PM_REMOVE))
+        DispatchMessage (&msg);
+
+    if (strcmp (argv [1], "flood") == 0) {
+        bad = run_flood ();
+    }
+    else {
+        for (nr_producers = 1; nr_producers <= MAX_PRODUCERS;
+                nr_producers <<= 1)
+            run_bench (nr_producers);
+    }
+
+    DestroyMainWindow (hMainWnd);
+    MainWindowThreadCleanup (hMainWnd);
+    return bad;
+}
@@ -0,0 +1,157 @@
+/*
+** timer-check.c: check the timers of a message thread.
+**
+** This program installs many timers on a main window and checks that
+** they can be found, reset and killed individually; that the timers with
+** huge intervals do not expire at once; and that a timer callback which
+** kills its timer, sets a new timer with the same identifier and returns
+** FALSE only removes the old timer.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define NR_TIMERS           5000
+#define ID_RECREATED        (NR_TIMERS + 1)
+#define ID_HUGE_TICKS       (NR_TIMERS + 2)
+#define ID_HUGE_MS          (NR_TIMERS + 3)
+#define ID_QUIT             (NR_TIMERS + 4)
+
+static HWND hMainWnd;
+static int nr_failed;
+static int nr_fired_recreated;
+static int nr_fired_new;
+static int nr_fired_huge;
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            printf ("FAILED: %s (line %d)\n", #cond, __LINE__);     \
+            nr_failed++;                                            \
+        }                                                           \
+    } while (0)
+
+static double now_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static BOOL new_timer_proc (HWND hWnd, LINT id, DWORD ticks)
+{
+    nr_fired_new++;
+    return TRUE;
+}
+
+/* replaces itself by a new timer with the same identifier */
+static BOOL recreated_timer_proc (HWND hWnd, LINT id, DWORD ticks)
+{
+    nr_fired_recreated++;
+    KillTimer (hWnd, id);
+    SetHiResTimer (hWnd, id, 5, new_timer_proc);
+    return FALSE;
+}
+
+static BOOL huge_timer_proc (HWND hWnd, LINT id, DWORD ticks)
+{
+    nr_fired_huge++;
+    return TRUE;
+}
+
+static void check_many_timers (void)
+{
+    double t0, t1;
+    LINT id;
+    int nr_killed = 0;
+
+    t0 = now_ms ();
+    for (id = 1; id <= NR_TIMERS; id++)
+        CHECK (SetTimer (hMainWnd, id, 100000 + id));
+    t1 = now_ms ();
+    printf ("set %d timers: %.2f ms\n", NR_TIMERS, t1 - t0);
+
+    t0 = now_ms ();
+    for (id = 1; id <= NR_TIMERS; id++)
+        CHECK (IsTimerInstalled (hMainWnd, id));
+    for (id = 1; id <= NR_TIMERS; id += 2)
+        CHECK (ResetTimer (hMainWnd, id, 200000));
+    for (id = 2; id <= NR_TIMERS; id += 2)
+        nr_killed += KillTimer (hMainWnd, id);
+    t1 = now_ms ();
+    printf ("find, reset and kill: %.2f ms\n", t1 - t0);
+
+    CHECK (nr_killed == NR_TIMERS / 2);
+    CHECK (!IsTimerInstalled (hMainWnd, NR_TIMERS + 100));
+    for (id = 1; id <= NR_TIMERS; id++)
+        CHECK (IsTimerInstalled (hMainWnd, id) == (id & 1));
+
+    CHECK (KillTimer (hMainWnd, 0) == NR_TIMERS - nr_killed);
+    CHECK (!IsTimerInstalled (hMainWnd, 1));
+}
+
+static LRESULT CheckWinProc (HWND hWnd, UINT message,
+        WPARAM wParam, LPARAM lParam)
+{
+    if (message == MSG_TIMER && wParam == ID_QUIT) {
+        KillTimer (hWnd, ID_QUIT);
+        PostQuitMessage (hWnd);
+        return 0;
+    }
+
+    return DefaultMainWinProc (hWnd, message, wParam, lParam);
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    MAINWINCREATE CreateInfo;
+    MSG msg;
+
+    memset (&CreateInfo, 0, sizeof (CreateInfo));
+    CreateInfo.dwStyle = WS_VISIBLE;
+    CreateInfo.spCaption = "timer-check";
+    CreateInfo.hCursor = GetSystemCursor (0);
+    CreateInfo.MainWindowProc = CheckWinProc;
+    CreateInfo.rx = 100;
+    CreateInfo.by = 100;
+    CreateInfo.iBkColor = COLOR_lightwhite;
+    CreateInfo.hHosting = HWND_DESKTOP;
+
+    hMainWnd = CreateMainWindow (&CreateInfo);
+    if (hMainWnd == HWND_INVALID)
+        return 1;
+
+    check_many_timers ();
+
+    /* 0xFFFFFFFF ticks overflowed to a tiny interval in milliseconds */
+    CHECK (SetTimerEx (hMainWnd, ID_HUGE_TICKS, 0xFFFFFFFF, huge_timer_proc));
+    CHECK (SetHiResTimer (hMainWnd, ID_HUGE_MS, 0xFFFFFFFF, huge_timer_proc));
+    CHECK (SetHiResTimer (hMainWnd, ID_RECREATED, 5, recreated_timer_proc));
+    CHECK (SetTimer (hMainWnd, ID_QUIT, 20));
+
+    while (GetMessage (&msg, hMainWnd)) {
+        TranslateMessage (&msg);
+        DispatchMessage (&msg);
+    }
+
+    printf ("fired: recreated %d, new %d, huge %d\n",
+            nr_fired_recreated, nr_fired_new, nr_fired_huge);
+    CHECK (nr_fired_recreated == 1);
+    CHECK (nr_fired_new > 1);
+    CHECK (nr_fired_huge == 0);
+    CHECK (IsTimerInstalled (hMainWnd, ID_RECREATED));
+    CHECK (IsTimerInstalled (hMainWnd, ID_HUGE_TICKS));
+
+    DestroyMainWindow (hMainWnd);
+    MainWindowThreadCleanup (hMainWnd);
+
+    printf (nr_failed ? "timer-check: FAILED\n" : "timer-check: OK\n");
+    return nr_failed ? 1 : 0;
+}
@@ -197,36 +197,321 @@ void mg_TerminateTimer (void)
 }
 
 /************************* Functions run in message thread *******************/
-int __mg_check_expired_timers (MSGQUEUE* msg_queue, DWORD inter)
+
+/*
+ * Since 5.0.16, the timers of a message queue are organized in a binary
+ * min-heap ordered by the deadline in milliseconds, so checking the expired
+ * timers only touches the timers which are really expired, and there is
+ * no limit on the number of timers any more.
+ *
+ * The expired timers are linked in a FIFO list instead of the old bit mask,
+ * and the timers are hashed by the window handle and the identifier, so
+ * finding a timer does not scan the heap.
+ */
+#define MIN_TIMER_HEAP_SIZE     8
+#define MIN_TIMER_BUCKETS       16
+
+/* deadlines are compared by signed differences, so the interval of a timer
+   must be less than a half of the range of DWORD */
+#define MAX_TIMER_INTERV_MS     0x7FFFFFFFUL
+
+/* converts an interval in ticks (10ms) to milliseconds without overflow */
+static inline DWORD ticks_to_ms (DWORD ticks)
 {
-    int nr = 0;
+    if (ticks > MAX_TIMER_INTERV_MS / 10)
+        return MAX_TIMER_INTERV_MS;
 
-    if (inter == 0)
-        return 0;
+    return ticks * 10;
+}
+
+/* compare two deadlines in milliseconds; handle the overflow */
+#define IS_DEADLINE_BEFORE(a, b)    ((LINT)((a) - (b)) < 0)
+#define IS_DEADLINE_REACHED(a, now) ((LINT)((now) - (a)) >= 0)
+
+static inline void set_heap_node (TIMER** heap, int idx, TIMER* timer)
+{
+    heap[idx] = timer;
+    timer->heap_idx = idx;
+}
+
+static void sift_up_timer (TIMER** heap, int idx)
+{
+    TIMER* timer = heap[idx];
+
+    while (idx > 0) {
+        int parent = (idx - 1) >> 1;
+        if (!IS_DEADLINE_BEFORE (timer->ms_expected, heap[parent]->ms_expected))
+            break;
+
+        set_heap_node (heap, idx, heap[parent]);
+        idx = parent;
+    }
+
+    set_heap_node (heap, idx, timer);
+}
+
+static void sift_down_timer (TIMER** heap, int nr, int idx)
+{
+    TIMER* timer = heap[idx];
+
+    while (TRUE) {
+        int child = (idx << 1) + 1;
+        if (child >= nr)
+            break;
+
+        if (child + 1 < nr && IS_DEADLINE_BEFORE (heap[child + 1]->ms_expected,
+                    heap[child]->ms_expected))
+            child++;
+
+        if (!IS_DEADLINE_BEFORE (heap[child]->ms_expected, timer->ms_expected))
+            break;
+
+        set_heap_node (heap, idx, heap[child]);
+        idx = child;
+    }
+
+    set_heap_node (heap, idx, timer);
+}
+
+/* called after the deadline of the timer changed */
+static inline void update_timer_in_heap (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    int idx = timer->heap_idx;
+
+    if (idx > 0 && IS_DEADLINE_BEFORE (timer->ms_expected,
+                msg_queue->timer_heap[(idx - 1) >> 1]->ms_expected))
+        sift_up_timer (msg_queue->timer_heap, idx);
+    else
+        sift_down_timer (msg_queue->timer_heap, msg_queue->nr_timers, idx);
+}
+
+static BOOL push_timer_to_heap (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    if (msg_queue->nr_timers >= msg_queue->max_timers) {
+        int new_size;
+        TIMER** new_heap;
+
+        new_size = msg_queue->max_timers ?
+            msg_queue->max_timers << 1 : MIN_TIMER_HEAP_SIZE;
+        new_heap = realloc (msg_queue->timer_heap, sizeof (TIMER*) * new_size);
+        if (new_heap == NULL)
+            return FALSE;
+
+        msg_queue->timer_heap = new_heap;
+        msg_queue->max_timers = new_size;
+    }
+
+    msg_queue->timer_heap[msg_queue->nr_timers] = timer;
+    timer->heap_idx = msg_queue->nr_timers;
+    msg_queue->nr_timers++;
+    sift_up_timer (msg_queue->timer_heap, timer->heap_idx);
+    return TRUE;
+}
+
+static void remove_timer_from_heap (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    int idx = timer->heap_idx;
+    TIMER* last;
+
+    msg_queue->nr_timers--;
+    last = msg_queue->timer_heap[msg_queue->nr_timers];
+    if (last != timer) {
+        set_heap_node (msg_queue->timer_heap, idx, last);
+        update_timer_in_heap (msg_queue, last);
+    }
+
+    timer->heap_idx = -1;
+}
+
+static inline TIMER** get_timer_bucket (TIMER** buckets, int nr_buckets,
+        HWND hWnd, LINT id)
+{
+    unsigned long key = (unsigned long)hWnd ^ ((unsigned long)id * 31);
+
+    /* Fibonacci hashing; the number of buckets is a power of 2 */
+    key *= 2654435761UL;
+    return buckets + ((key ^ (key >> 16)) & (nr_buckets - 1));
+}
+
+static BOOL grow_timer_buckets (MSGQUEUE* msg_queue)
+{
+    int i, new_size;
+    TIMER** new_buckets;
+
+    new_size = msg_queue->nr_timer_buckets ?
+        msg_queue->nr_timer_buckets << 1 : MIN_TIMER_BUCKETS;
+    new_buckets = calloc (new_size, sizeof (TIMER*));
+    if (new_buckets == NULL)
+        return FALSE;
+
+    for (i = 0; i < msg_queue->nr_timer_buckets; i++) {
+        TIMER* timer = msg_queue->timer_buckets[i];
+
+        while (timer) {
+            TIMER* next = timer->next_hashed;
+            TIMER** bucket = get_timer_bucket (new_buckets, new_size,
+                    timer->hWnd, timer->id);
+
+            timer->next_hashed = *bucket;
+            *bucket = timer;
+            timer = next;
+        }
+    }
+
+    free (msg_queue->timer_buckets);
+    msg_queue->timer_buckets = new_buckets;
+    msg_queue->nr_timer_buckets = new_size;
+    return TRUE;
+}
+
+static BOOL hash_timer (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    TIMER** bucket;
+
+    /* keep the load factor under 1; longer chains still work if
+       the hash table can not grow */
+    if (msg_queue->nr_timers >= msg_queue->nr_timer_buckets &&
+            !grow_timer_buckets (msg_queue) &&
+            msg_queue->nr_timer_buckets == 0)
+        return FALSE;
+
+    bucket = get_timer_bucket (msg_queue->timer_buckets,
+            msg_queue->nr_timer_buckets, timer->hWnd, timer->id);
+    timer->next_hashed = *bucket;
+    *bucket = timer;
+    return TRUE;
+}
+
+static void unhash_timer (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    TIMER** link = get_timer_bucket (msg_queue->timer_buckets,
+            msg_queue->nr_timer_buckets, timer->hWnd, timer->id);
+
+    while (*link) {
+        if (*link == timer) {
+            *link = timer->next_hashed;
+            break;
+        }
+        link = &(*link)->next_hashed;
+    }
+
+    timer->next_hashed = NULL;
+}
+
+static TIMER* find_timer (MSGQUEUE* msg_queue, HWND hWnd, LINT id)
+{
+    TIMER* timer;
+
+    if (msg_queue->nr_timers == 0)
+        return NULL;
+
+    timer = *get_timer_bucket (msg_queue->timer_buckets,
+            msg_queue->nr_timer_buckets, hWnd, id);
+    while (timer) {
+        if (timer->hWnd == hWnd && timer->id == id)
+            return timer;
+        timer = timer->next_hashed;
+    }
+
+    return NULL;
+}
+
+static void mark_expired_timer (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    if (timer->expired)
+        return;
+
+    timer->expired = TRUE;
+    timer->next_expired = NULL;
+    timer->prev_expired = msg_queue->last_expired_timer;
+    if (msg_queue->last_expired_timer)
+        msg_queue->last_expired_timer->next_expired = timer;
+    else
+        msg_queue->first_expired_timer = timer;
+    msg_queue->last_expired_timer = timer;
+}
+
+void __mg_unmark_expired_timer (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    if (!timer->expired)
+        return;
+
+    if (timer->prev_expired)
+        timer->prev_expired->next_expired = timer->next_expired;
+    else
+        msg_queue->first_expired_timer = timer->next_expired;
+
+    if (timer->next_expired)
+        timer->next_expired->prev_expired = timer->prev_expired;
+    else
+        msg_queue->last_expired_timer = timer->prev_expired;
+
+    timer->expired = FALSE;
+    timer->prev_expired = NULL;
+    timer->next_expired = NULL;
+}
+
+TIMER* __mg_fetch_expired_timer (MSGQUEUE* msg_queue)
+{
+    TIMER* timer = msg_queue->first_expired_timer;
+
+    if (timer)
+        __mg_unmark_expired_timer (msg_queue, timer);
+
+    return timer;
+}
+
+void __mg_clear_expired_timers (MSGQUEUE* msg_queue)
+{
+    while (msg_queue->first_expired_timer)
+        __mg_unmark_expired_timer (msg_queue, msg_queue->first_expired_timer);
+}
+
+static void delete_timer (MSGQUEUE* msg_queue, TIMER* timer)
+{
+    __mg_unmark_expired_timer (msg_queue, timer);
+    unhash_timer (msg_queue, timer);
+    remove_timer_from_heap (msg_queue, timer);
+    mg_slice_delete (TIMER, timer);
+}
+
+int __mg_check_expired_timers (MSGQUEUE* msg_queue)
+{
+    int nr = 0;
 
     if (msg_queue == NULL) {
         msg_queue = getMsgQueueForThisThread ();
     }
 
     if (msg_queue) {
-        int i;
-        TIMER** timer_slots = msg_queue->timer_slots;
+        DWORD now;
+        TIMER** timer_heap = msg_queue->timer_heap;
 
         __mg_update_tick_count (msg_queue);
-
-        for (i = 0; i < DEF_NR_TIMERS; i++) {
-            if (timer_slots[i]) {
-                if (msg_queue->last_ticks >= timer_slots[i]->ticks_expected) {
-                    /* setting timer flag is simple, we do not need to lock
-                       msgq, or else we may encounter dead lock here */
-                    msg_queue->expired_timer_mask |= (0x01UL << i);
-                    POST_MSGQ (msg_queue);
-                    timer_slots[i]->ticks_expected += timer_slots[i]->interv;
-                    timer_slots[i]->ticks_fired = msg_queue->last_ticks;
-                    nr++;
-                }
-            }
+        if (msg_queue->nr_timers == 0)
+            return 0;
+
+        now = __mg_os_get_time_ms ();
+        while (msg_queue->nr_timers > 0 &&
+                IS_DEADLINE_REACHED (timer_heap[0]->ms_expected, now)) {
+            TIMER* timer = timer_heap[0];
+
+            /* setting timer flag is simple, we do not need to lock
+               msgq, or else we may encounter dead lock here */
+            mark_expired_timer (msg_queue, timer);
+            timer->ticks_fired = msg_queue->last_ticks;
+
+            /* skip the missed periods if the message thread is too busy */
+            timer->ms_expected += timer->ms_interv;
+            if (IS_DEADLINE_REACHED (timer->ms_expected, now))
+                timer->ms_expected = now + timer->ms_interv;
+
+            sift_down_timer (timer_heap, msg_queue->nr_timers, 0);
+            nr++;
         }
+
+        if (nr > 0)
+            POST_MSGQ (msg_queue);
     }
     else {
         _WRN_PRINTF ("called for non message thread\n");
@@ -235,12 +520,28 @@ int __mg_check_expired_timers (MSGQUEUE* msg_queue, DWORD inter)
     return nr;
 }
 
-BOOL GUIAPI SetTimerEx (HWND hWnd, LINT id, DWORD interv,
+DWORD __mg_get_timer_timeout (MSGQUEUE* msg_queue, DWORD max_ms)
+{
+    DWORD now, expected;
+
+    if (msg_queue->nr_timers == 0)
+        return max_ms;
+
+    now = __mg_os_get_time_ms ();
+    expected = msg_queue->timer_heap[0]->ms_expected;
+    if (IS_DEADLINE_REACHED (expected, now))
+        return 0;
+
+    if (expected - now < max_ms)
+        return expected - now;
+
+    return max_ms;
+}
+
+static BOOL set_timer (HWND hWnd, LINT id, DWORD ms_interv,
                 TIMERPROC timer_proc)
 {
-    int i;
-    int slot = -1;
-    TIMER** timer_slots;
+    TIMER* timer;
     PMSGQUEUE msg_queue;
 
     if (id == 0) {
@@ -248,12 +549,15 @@ BOOL GUIAPI SetTimerEx (HWND hWnd, LINT id, DWORD interv,
         return FALSE;
     }
 
-    if (interv == 0) {
-        interv = 1;
+    if (ms_interv == 0) {
+        ms_interv = 1;
+    }
+    else if (ms_interv > MAX_TIMER_INTERV_MS) {
+        ms_interv = MAX_TIMER_INTERV_MS;
     }
 
-    timer_slots = getTimerSlotsForThisThread (&msg_queue);
-    if (MG_UNLIKELY (timer_slots == NULL)) {
+    msg_queue = getMsgQueueForThisThread ();
+    if (MG_UNLIKELY (msg_queue == NULL)) {
         _WRN_PRINTF ("called for non message thread\n");
         goto badret;
     }
@@ -268,41 +572,48 @@ BOOL GUIAPI SetTimerEx (HWND hWnd, LINT id, DWORD interv,
         goto badret;
     }
 
-    /* Is there an empty timer slot? */
-    for (i = 0; i < DEF_NR_TIMERS; i++) {
-        if (timer_slots[i] == NULL) {
-            if (slot < 0)
-                slot = i;
-        }
-        else if (timer_slots[i]->hWnd == hWnd && timer_slots[i]->id == id) {
-            /* Since 5.0.0: we reset timer parameters for duplicated call of
-               this function */
-            timer_slots[i]->interv = interv;
-            timer_slots[i]->ticks_expected = msg_queue->last_ticks + interv;
-            timer_slots[i]->ticks_fired = 0;
-            timer_slots[i]->proc = timer_proc;
-            return TRUE;
-        }
+    if ((timer = find_timer (msg_queue, hWnd, id))) {
+        /* Since 5.0.0: we reset timer parameters for duplicated call of
+           this function */
+        timer->ms_interv = ms_interv;
+        timer->ms_expected = __mg_os_get_time_ms () + ms_interv;
+        timer->ticks_fired = 0;
+        timer->proc = timer_proc;
+        timer->serial = ++msg_queue->last_timer_serial;
+        update_timer_in_heap (msg_queue, timer);
+        return TRUE;
     }
 
-    if (slot < 0 || slot == DEF_NR_TIMERS) {
-        _WRN_PRINTF ("no more slot for new timer (total: %d)\n", DEF_NR_TIMERS);
+    timer = mg_slice_new0 (TIMER);
+    if (timer == NULL) {
+        _WRN_PRINTF ("failed to allocate a new timer\n");
         goto badret;
     }
 
-    timer_slots[slot] = mg_slice_new (TIMER);
-
-    timer_slots[slot]->hWnd = hWnd;
-    timer_slots[slot]->id = id;
-    timer_slots[slot]->interv = interv;
-    timer_slots[slot]->ticks_expected = msg_queue->last_ticks + interv;
-    timer_slots[slot]->ticks_fired = 0;
-    timer_slots[slot]->proc = timer_proc;
+    timer->hWnd = hWnd;
+    timer->id = id;
+    timer->ms_interv = ms_interv;
+    timer->ms_expected = __mg_os_get_time_ms () + ms_interv;
+    timer->ticks_fired = 0;
+    timer->proc = timer_proc;
+    timer->serial = ++msg_queue->last_timer_serial;
+
+    if (!hash_timer (msg_queue, timer)) {
+        _WRN_PRINTF ("failed to allocate the timer hash table\n");
+        mg_slice_delete (TIMER, timer);
+        goto badret;
+    }
 
-    _DBG_PRINTF ("ticks_expected (%d): %lu, tick_counter: %lu\n",
-            slot, timer_slots[slot]->ticks_expected, msg_queue->last_ticks);
+    if (!push_timer_to_heap (msg_queue, timer)) {
+        _WRN_PRINTF ("failed to enlarge the timer heap (total: %d)\n",
+                msg_queue->nr_timers);
+        unhash_timer (msg_queue, timer);
+        mg_slice_delete (TIMER, timer);
+        goto badret;
+    }
 
-    msg_queue->nr_timers++;
+    _DBG_PRINTF ("ms_expected (%d): %lu, tick_counter: %lu\n",
+            timer->heap_idx, timer->ms_expected, msg_queue->last_ticks);
 
     return TRUE;
 
@@ -310,37 +621,45 @@ badret:
     return FALSE;
 }
 
-void __mg_remove_timer (MSGQUEUE* msg_queue, int slot)
+BOOL GUIAPI SetTimerEx (HWND hWnd, LINT id, DWORD interv,
+                TIMERPROC timer_proc)
 {
-    TIMER** timer_slots;
+    return set_timer (hWnd, id, ticks_to_ms (interv), timer_proc);
+}
 
-    if (slot < 0 || slot >= DEF_NR_TIMERS)
-        return;
+BOOL GUIAPI SetHiResTimer (HWND hWnd, LINT id, DWORD interv_ms,
+                TIMERPROC timer_proc)
+{
+    return set_timer (hWnd, id, interv_ms, timer_proc);
+}
 
-    timer_slots = msg_queue->timer_slots;
-    if (MG_LIKELY (timer_slots[slot])) {
-        /* The following code is already moved to message.c...
-         * timer->msg_queue->expired_timer_mask &= ~(0x01UL << slot);
-         */
-        mg_slice_delete (TIMER, timer_slots[slot]);
-        timer_slots [slot] = NULL;
-        msg_queue->nr_timers--;
+void __mg_remove_timer (MSGQUEUE* msg_queue, HWND hWnd, LINT id,
+        DWORD serial)
+{
+    TIMER* timer = find_timer (msg_queue, hWnd, id);
+
+    if (MG_LIKELY (timer && timer->serial == serial)) {
+        delete_timer (msg_queue, timer);
     }
 }
 
 void __mg_remove_timers_by_msg_queue (MSGQUEUE* msg_queue)
 {
     int i;
-    TIMER** timer_slots = msg_queue->timer_slots;
 
-    for (i = 0; i < DEF_NR_TIMERS; i++) {
-        if (timer_slots [i]) {
-            mg_slice_delete (TIMER, timer_slots[i]);
-            timer_slots [i] = NULL;
-        }
+    for (i = 0; i < msg_queue->nr_timers; i++) {
+        mg_slice_delete (TIMER, msg_queue->timer_heap[i]);
     }
 
-    msg_queue->nr_timers--;
+    free (msg_queue->timer_heap);
+    msg_queue->timer_heap = NULL;
+    msg_queue->max_timers = 0;
+    free (msg_queue->timer_buckets);
+    msg_queue->timer_buckets = NULL;
+    msg_queue->nr_timer_buckets = 0;
+    msg_queue->nr_timers = 0;
+    msg_queue->first_expired_timer = NULL;
+    msg_queue->last_expired_timer = NULL;
 }
 
 /* If id == 0, clear all timers of the window */
@@ -357,19 +676,36 @@ int GUIAPI KillTimer (HWND hWnd, LINT id)
 
     msg_queue = getMsgQueueForThisThread ();
     if (msg_queue) {
+        TIMER* timer;
 
-        TIMER** timer_slots =  msg_queue->timer_slots;
-        for (i = 0; i < DEF_NR_TIMERS; i++) {
-            if ((timer_slots [i] && timer_slots [i]->hWnd == hWnd) &&
-                    (id == 0 || timer_slots [i]->id == id)) {
-                msg_queue->expired_timer_mask &= ~(0x01UL << i);
-                mg_slice_delete (TIMER, timer_slots[i]);
-                timer_slots [i] = NULL;
-                msg_queue->nr_timers--;
-                killed ++;
-
-                if (id)
-                    break;
+        if (id) {
+            if ((timer = find_timer (msg_queue, hWnd, id))) {
+                delete_timer (msg_queue, timer);
+                killed++;
+            }
+        }
+        else {
+            int nr = 0;
+            TIMER** timer_heap = msg_queue->timer_heap;
+
+            /* remove all timers of the window, then rebuild the heap */
+            for (i = 0; i < msg_queue->nr_timers; i++) {
+                timer = timer_heap[i];
+                if (timer->hWnd == hWnd) {
+                    __mg_unmark_expired_timer (msg_queue, timer);
+                    unhash_timer (msg_queue, timer);
+                    mg_slice_delete (TIMER, timer);
+                    killed++;
+                }
+                else {
+                    set_heap_node (timer_heap, nr++, timer);
+                }
+            }
+
+            msg_queue->nr_timers = nr;
+            if (killed) {
+                for (i = (nr >> 1) - 1; i >= 0; i--)
+                    sift_down_timer (timer_heap, nr, i);
             }
         }
     }
@@ -384,7 +720,7 @@ int GUIAPI KillTimer (HWND hWnd, LINT id)
 BOOL GUIAPI ResetTimerEx (HWND hWnd, LINT id, DWORD interv,
                 TIMERPROC timer_proc)
 {
-    int i;
+    TIMER* timer;
     MSGQUEUE* msg_queue;
 
 #ifndef _MGRM_THREADS
@@ -395,24 +731,23 @@ BOOL GUIAPI ResetTimerEx (HWND hWnd, LINT id, DWORD interv,
     if (id == 0)
         return FALSE;
 
+    if (interv == 0)
+        interv = 1;
+
     msg_queue = getMsgQueueForThisThread ();
     if (MG_LIKELY (msg_queue)) {
-        TIMER** timer_slots = msg_queue->timer_slots;
-
         __mg_update_tick_count (msg_queue);
-        for (i = 0; i < DEF_NR_TIMERS; i++) {
-            if (timer_slots[i] &&
-                    timer_slots[i]->hWnd == hWnd && timer_slots[i]->id == id) {
-                /* Should clear old timer flags */
-                msg_queue->expired_timer_mask &= ~(0x01UL << i);
-                timer_slots[i]->interv = interv;
-                timer_slots[i]->ticks_expected = msg_queue->last_ticks + interv;
-                timer_slots[i]->ticks_fired = 0;
-                if (timer_proc != (TIMERPROC)INV_PTR)
-                    timer_slots[i]->proc = timer_proc;
-
-                return TRUE;
-            }
+        if ((timer = find_timer (msg_queue, hWnd, id))) {
+            /* Should clear old timer flags */
+            __mg_unmark_expired_timer (msg_queue, timer);
+            timer->ms_interv = ticks_to_ms (interv);
+            timer->ms_expected = __mg_os_get_time_ms () + timer->ms_interv;
+            timer->ticks_fired = 0;
+            if (timer_proc != (TIMERPROC)INV_PTR)
+                timer->proc = timer_proc;
+
+            update_timer_in_heap (msg_queue, timer);
+            return TRUE;
         }
     }
     else {
@@ -424,8 +759,7 @@ BOOL GUIAPI ResetTimerEx (HWND hWnd, LINT id, DWORD interv,
 
 BOOL GUIAPI IsTimerInstalled (HWND hWnd, LINT id)
 {
-    int i;
-    TIMER** timer_slots;
+    MSGQUEUE* msg_queue;
 
 #ifndef _MGRM_THREADS
     /* Force to update tick count */
@@ -435,15 +769,9 @@ BOOL GUIAPI IsTimerInstalled (HWND hWnd, LINT id)
     if (id == 0)
         return FALSE;
 
-    timer_slots = getTimerSlotsForThisThread (NULL);
-    if (timer_slots) {
-        for (i = 0; i < DEF_NR_TIMERS; i++) {
-            if (timer_slots[i] &&
-                    timer_slots[i]->hWnd == hWnd &&
-                    timer_slots[i]->id == id) {
-                return TRUE;
-            }
-        }
+    msg_queue = getMsgQueueForThisThread ();
+    if (msg_queue) {
+        return find_timer (msg_queue, hWnd, id) != NULL;
     }
     else {
         _WRN_PRINTF ("called for non message thread\n");
@@ -452,27 +780,18 @@ BOOL GUIAPI IsTimerInstalled (HWND hWnd, LINT id)
     return FALSE;
 }
 
+/* Since 5.0.16, there is no limit on the number of timers */
 BOOL GUIAPI HaveFreeTimer (void)
 {
-    int i;
-    TIMER** timer_slots;
-
 #ifndef _MGRM_THREADS
     /* Force to update tick count */
     GetTickCount();
 #endif
 
-    timer_slots = getTimerSlotsForThisThread (NULL);
-    if (timer_slots) {
-        for (i = 0; i < DEF_NR_TIMERS; i++) {
-            if (timer_slots[i] == NULL)
-                return TRUE;
-        }
-    }
-    else {
-        _WRN_PRINTF ("called for non message thread\n");
-    }
+    if (getMsgQueueForThisThread ())
+        return TRUE;
 
+    _WRN_PRINTF ("called for non message thread\n");
     return FALSE;
 }
 
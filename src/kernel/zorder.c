@@ -265,9 +265,65 @@ int __kernel_alloc_z_order_info (int nr_topmosts, int nr_normals, BOOL with_mask
 #endif
 }
 
+#ifdef _MGSCHEMA_COMPOSITING
+BOOL __kernel_alloc_znode_dirty_map (ZORDERINFO* zi)
+{
+    ZNODEDIRTYMAP* map;
+    size_t size = SIZE_ZNODE_DIRTY_MAP (NR_ZNODE_DIRTY_BITS (zi));
+
+    zi->dirty_map = NULL;
+    zi->poll_dirty = TRUE;
+    zi->dirty_shmid = shmget (IPC_PRIVATE, size,
+            SHM_PARAM | IPC_CREAT);
+    if (zi->dirty_shmid == -1) {
+        _WRN_PRINTF ("Failed to create the dirty map of layer: %m\n");
+        return FALSE;
+    }
+
+    map = shmat (zi->dirty_shmid, 0, 0);
+    shmctl (zi->dirty_shmid, IPC_RMID, NULL);
+    if (map == (void*)-1) {
+        _WRN_PRINTF ("Failed to attach the dirty map of layer: %m\n");
+        zi->dirty_shmid = -1;
+        return FALSE;
+    }
+
+    memset (map, 0, size);
+    map->nr_bits = NR_ZNODE_DIRTY_BITS (zi);
+    zi->dirty_map = map;
+    zi->poll_dirty = FALSE;
+    return TRUE;
+}
+
+ZNODEDIRTYMAP* __kernel_attach_znode_dirty_map (const ZORDERINFO* zi)
+{
+    ZNODEDIRTYMAP* map;
+
+    if (zi->dirty_shmid == -1)
+        return NULL;
+
+    map = shmat (zi->dirty_shmid, 0, 0);
+    if (map == (void*)-1) {
+        _WRN_PRINTF ("Failed to attach the dirty map of layer: %m\n");
+        return NULL;
+    }
+
+    return map;
+}
+
+void __kernel_detach_znode_dirty_map (ZNODEDIRTYMAP* map)
+{
+    if (map && shmdt (map) < 0)
+        perror ("Detaches the dirty map of layer");
+}
+#endif  /* defined _MGSCHEMA_COMPOSITING */
+
 void __kernel_free_z_order_info (ZORDERINFO* zi)
 {
 #if defined(_MGRM_PROCESSES)
+#ifdef _MGSCHEMA_COMPOSITING
+    __kernel_detach_znode_dirty_map (zi->dirty_map);
+#endif
     if (shmdt (zi) < 0)
         perror ("Detaches shared zorder nodes");
 #else
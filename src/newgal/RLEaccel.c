@@ -96,17 +96,24 @@
  *   the alpha value occupying the highest 8 bits. The <skip> and <run>
  *   counts are 16 bit.
  *
- *   For 16-bit targets, each pixel has the target RGB format, but with
- *   the middle component (usually green) shifted 16 steps to the left,
- *   and the hole filled with the 5 most significant bits of the alpha value.
- *   i.e. if the target has the format         rrrrrggggggbbbbb,
- *   the encoded pixel will be 00000gggggg00000rrrrr0aaaaabbbbb.
+ *   For 16-bit targets, each pixel is an 8888 pixel with the alpha value
+ *   in the highest 8 bits, and the components in the order of the target,
+ *   i.e. if the target has the format                 rrrrrggggggbbbbb,
+ *   the encoded pixel will be aaaaaaaarrrrrrrrggggggggbbbbbbbb,
+ *   which is blended by the same kernels as the blits without RLE.
  *   The <skip> and <run> counts are 8 bit for the opaque lines, 16 bit
  *   for the translucent lines. Two padding bytes may be inserted
  *   before each translucent line to keep them 32-bit aligned.
  *
  *   The end of the sequence is marked by a zero <skip>,<run> pair at the
  *   beginning of an opaque line.
+ *
+ * Since 5.0.16, the encoding does not replace the pixels of the surface,
+ * and the encodings are kept in a small cache of the surface, so that
+ * the surface can be blitted to destinations of different formats in turn
+ * without encoding it again, or decoding it. The cache is dropped when the
+ * surface is drawn to. Large surfaces are encoded by bands of scan lines
+ * in parallel.
  */
 
 #include <stdio.h>
@@ -114,10 +121,12 @@
 #include <string.h>
 
 #include "common.h"
+#include "minigui.h"
 #include "newgal.h"
 #include "sysvideo.h"
 #include "blit.h"
 #include "memops.h"
+#include "pixels_c.h"
 #include "RLEaccel_c.h"
 
 #define PIXEL_COPY(to, from, len, bpp)                        \
@@ -567,7 +576,8 @@ done:
 
 /*
  * For 32bpp pixels, we have made sure the alpha is stored in the top
- * 8 bits, so proceed as usual
+ * 8 bits, so proceed as usual; the alpha of the destination is kept,
+ * like the blits without RLE do.
  */
 #define BLIT_TRANSL_888(src, dst)                                \
     do {                                                        \
@@ -576,41 +586,61 @@ done:
         unsigned alpha = s >> 24;                                \
         Uint32 s1 = s & 0xff00ff;                                \
         Uint32 d1 = d & 0xff00ff;                                \
+        Uint32 da = d & 0xff000000;                                \
         d1 = (d1 + ((s1 - d1) * alpha >> 8)) & 0xff00ff;        \
         s &= 0xff00;                                                \
         d &= 0xff00;                                                \
         d = (d + ((s - d) * alpha >> 8)) & 0xff00;                \
-        dst = d1 | d;                                                \
+        dst = d1 | d | da;                                        \
     } while(0)
 
 /*
- * For 16bpp pixels, we have stored the 5 most significant alpha bits in
- * bits 5-10. As before, we can process all 3 RGB components at the same time.
+ * For 16bpp pixels, we use the 5 most significant alpha bits, and
+ * convert the source and the destination to G0RAB to process all 3 RGB
+ * components at the same time, as the blits without RLE do.
  */
-#define BLIT_TRANSL_565(src, dst)                \
-    do {                                        \
-        Uint32 s = src;                                \
-        Uint32 d = dst;                                \
-        unsigned alpha = (s & 0x3e0) >> 5;        \
-        s &= 0x07e0f81f;                        \
-        d = (d | d << 16) & 0x07e0f81f;                \
-        d += (s - d) * alpha >> 5;                \
-        d &= 0x07e0f81f;                        \
-        dst = d | d >> 16;                        \
+#define BLIT_TRANSL_565(src, dst)                                \
+    do {                                                        \
+        Uint32 s = src;                                                \
+        Uint32 d = dst;                                                \
+        unsigned alpha = s >> 27;                                \
+        if(alpha == (GAL_ALPHA_OPAQUE >> 3)) {                        \
+            dst = (s >> 8 & 0xf800) + (s >> 5 & 0x7e0)                \
+                + (s >> 3 & 0x1f);                                \
+        } else {                                                \
+            s = ((s & 0xfc00) << 11) + (s >> 8 & 0xf800)        \
+              + (s >> 3 & 0x1f);                                \
+            d = (d | d << 16) & 0x07e0f81f;                        \
+            d += (s - d) * alpha >> 5;                                \
+            d &= 0x07e0f81f;                                        \
+            dst = d | d >> 16;                                        \
+        }                                                        \
     } while(0)
 
-#define BLIT_TRANSL_555(src, dst)                \
-    do {                                        \
-        Uint32 s = src;                                \
-        Uint32 d = dst;                                \
-        unsigned alpha = (s & 0x3e0) >> 5;        \
-        s &= 0x03e07c1f;                        \
-        d = (d | d << 16) & 0x03e07c1f;                \
-        d += (s - d) * alpha >> 5;                \
-        d &= 0x03e07c1f;                        \
-        dst = d | d >> 16;                        \
+#define BLIT_TRANSL_555(src, dst)                                \
+    do {                                                        \
+        Uint32 s = src;                                                \
+        Uint32 d = dst;                                                \
+        unsigned alpha = s >> 27;                                \
+        if(alpha == (GAL_ALPHA_OPAQUE >> 3)) {                        \
+            dst = (s >> 9 & 0x7c00) + (s >> 6 & 0x3e0)                \
+                + (s >> 3 & 0x1f);                                \
+        } else {                                                \
+            s = ((s & 0xf800) << 10) + (s >> 9 & 0x7c00)        \
+              + (s >> 3 & 0x1f);                                \
+            d = (d | d << 16) & 0x03e07c1f;                        \
+            d += (s - d) * alpha >> 5;                                \
+            d &= 0x03e07c1f;                                        \
+            dst = d | d >> 16;                                        \
+        }                                                        \
     } while(0)
 
+/*
+ * The translucent runs at least this long are blended by the SIMD kernels
+ * of the blits without RLE, which give the same results as the macros above.
+ */
+#define MIN_SIMD_RUN        4
+
 /* used to save the destination format in the encoding. Designed to be
    macro-compatible with GAL_PixelFormat but without the unneeded fields */
 typedef struct {
@@ -633,12 +663,13 @@ static void RLEAlphaClipBlit(int w, Uint8 *srcbuf, GAL_Surface *dst,
                              Uint8 *dstbuf, GAL_Rect *srcrect)
 {
     GAL_PixelFormat *df = dst->format;
+    const GAL_AlphaBlitKernels *kernels = GAL_GetAlphaBlitKernels();
     /*
      * clipped blitter: Ptype is the destination pixel type,
-     * Ctype the translucent count type, and do_blend the macro
-     * to blend one pixel.
+     * Ctype the translucent count type, do_blend the macro
+     * to blend one pixel, and blend_run the kernel to blend a run.
      */
-#define RLEALPHACLIPBLIT(Ptype, Ctype, do_blend)                          \
+#define RLEALPHACLIPBLIT(Ptype, Ctype, do_blend, blend_run)                  \
     do {                                                                  \
         int linecount = srcrect->h;                                          \
         int left = srcrect->x;                                                  \
@@ -691,7 +722,10 @@ static void RLEAlphaClipBlit(int w, Uint8 *srcbuf, GAL_Surface *dst,
                     }                                                          \
                     if(crun > right - cofs)                                  \
                         crun = right - cofs;                                  \
-                    if(crun > 0) {                                          \
+                    if(crun >= MIN_SIMD_RUN && blend_run) {                  \
+                        blend_run((Ptype *)dstbuf + cofs,                  \
+                                  (Uint32 *)srcbuf + (cofs - ofs), crun); \
+                    } else if(crun > 0) {                                  \
                         Ptype *dst = (Ptype *)dstbuf + cofs;                  \
                         Uint32 *src = (Uint32 *)srcbuf + (cofs - ofs);          \
                         int i;                                                  \
@@ -709,15 +743,22 @@ static void RLEAlphaClipBlit(int w, Uint8 *srcbuf, GAL_Surface *dst,
     switch(df->BytesPerPixel) {
     case 2:
         if(df->Gmask == 0x07e0 || df->Rmask == 0x07e0
-           || df->Bmask == 0x07e0)
-            RLEALPHACLIPBLIT(Uint16, Uint8, BLIT_TRANSL_565);
-        else
-            RLEALPHACLIPBLIT(Uint16, Uint8, BLIT_TRANSL_555);
+           || df->Bmask == 0x07e0) {
+            void (*blend_565)(Uint16 *, const Uint32 *, int) =
+                kernels ? kernels->argb_to_565 : NULL;
+            RLEALPHACLIPBLIT(Uint16, Uint8, BLIT_TRANSL_565, blend_565);
+        } else {
+            void (*blend_555)(Uint16 *, const Uint32 *, int) = NULL;
+            RLEALPHACLIPBLIT(Uint16, Uint8, BLIT_TRANSL_555, blend_555);
+        }
         break;
-    case 4:
-        RLEALPHACLIPBLIT(Uint32, Uint16, BLIT_TRANSL_888);
+    case 4: {
+        void (*blend_888)(Uint32 *, const Uint32 *, int) =
+            kernels ? kernels->argb_to_rgb : NULL;
+        RLEALPHACLIPBLIT(Uint32, Uint16, BLIT_TRANSL_888, blend_888);
         break;
     }
+    }
 }
 
 /* blit a pixel-alpha RLE surface */
@@ -801,10 +842,10 @@ int GAL_RLEAlphaBlit(GAL_VideoDevice *video,
 
         /*
          * non-clipped blitter. Ptype is the destination pixel type,
-         * Ctype the translucent count type, and do_blend the
-         * macro to blend one pixel.
+         * Ctype the translucent count type, do_blend the macro
+         * to blend one pixel, and blend_run the kernel to blend a run.
          */
-#define RLEALPHABLIT(Ptype, Ctype, do_blend)                                 \
+#define RLEALPHABLIT(Ptype, Ctype, do_blend, blend_run)                         \
         do {                                                                 \
             int linecount = srcrect->h;                                         \
             do {                                                         \
@@ -833,7 +874,12 @@ int GAL_RLEAlphaBlit(GAL_VideoDevice *video,
                     ofs += ((Uint16 *)srcbuf)[0];                         \
                     run = ((Uint16 *)srcbuf)[1];                         \
                     srcbuf += 4;                                         \
-                    if(run) {                                                 \
+                    if(run >= MIN_SIMD_RUN && blend_run) {                 \
+                        blend_run((Ptype *)dstbuf + ofs,                 \
+                                  (Uint32 *)srcbuf, run);                 \
+                        srcbuf += 4 * run;                                 \
+                        ofs += run;                                         \
+                    } else if(run) {                                         \
                         Ptype *dst = (Ptype *)dstbuf + ofs;                 \
                         unsigned i;                                         \
                         for(i = 0; i < run; i++) {                         \
@@ -849,18 +895,27 @@ int GAL_RLEAlphaBlit(GAL_VideoDevice *video,
             } while(--linecount);                                         \
         } while(0)
 
+        const GAL_AlphaBlitKernels *kernels = GAL_GetAlphaBlitKernels();
+
         switch(df->BytesPerPixel) {
         case 2:
             if(df->Gmask == 0x07e0 || df->Rmask == 0x07e0
-               || df->Bmask == 0x07e0)
-                RLEALPHABLIT(Uint16, Uint8, BLIT_TRANSL_565);
-            else
-                RLEALPHABLIT(Uint16, Uint8, BLIT_TRANSL_555);
+               || df->Bmask == 0x07e0) {
+                void (*blend_565)(Uint16 *, const Uint32 *, int) =
+                    kernels ? kernels->argb_to_565 : NULL;
+                RLEALPHABLIT(Uint16, Uint8, BLIT_TRANSL_565, blend_565);
+            } else {
+                void (*blend_555)(Uint16 *, const Uint32 *, int) = NULL;
+                RLEALPHABLIT(Uint16, Uint8, BLIT_TRANSL_555, blend_555);
+            }
             break;
-        case 4:
-            RLEALPHABLIT(Uint32, Uint16, BLIT_TRANSL_888);
+        case 4: {
+            void (*blend_888)(Uint32 *, const Uint32 *, int) =
+                kernels ? kernels->argb_to_rgb : NULL;
+            RLEALPHABLIT(Uint32, Uint16, BLIT_TRANSL_888, blend_888);
             break;
         }
+        }
     }
 
  done:
@@ -871,9 +926,7 @@ int GAL_RLEAlphaBlit(GAL_VideoDevice *video,
  * Auxiliary functions:
  * The encoding functions take 32bpp rgb + a, and
  * return the number of bytes copied to the destination.
- * The decoding functions copy to 32bpp rgb + a, and
- * return the number of bytes copied from the source.
- * These are only used in the encoder and un-RLE code and are therefore not
+ * These are only used in the encoder and are therefore not
  * highly optimised.
  */
 
@@ -893,79 +946,30 @@ static int copy_opaque_16(void *dst, Uint32 *src, int n,
     return n * 2;
 }
 
-/* decode opaque pixels from 16bpp to 32bpp rgb + a */
-static int uncopy_opaque_16(Uint32 *dst, void *src, int n,
-                            RLEDestFormat *sfmt, GAL_PixelFormat *dfmt)
-{
-    int i;
-    Uint16 *s = src;
-    unsigned alpha = dfmt->Amask ? 255 : 0;
-    for(i = 0; i < n; i++) {
-        unsigned r, g, b;
-        RGB_FROM_PIXEL(*s, sfmt, r, g, b);
-        PIXEL_FROM_RGBA(*dst, dfmt, r, g, b, alpha);
-        s++;
-        dst++;
-    }
-    return n * 2;
-}
-
-
-
-/* encode 32bpp rgb + a into 32bpp G0RAB format for blitting into 565 */
-static int copy_transl_565(void *dst, Uint32 *src, int n,
-                           GAL_PixelFormat *sfmt, GAL_PixelFormat *dfmt)
-{
-    int i;
-    Uint32 *d = dst;
-    for(i = 0; i < n; i++) {
-        unsigned r, g, b, a;
-        Uint16 pix;
-        RGBA_FROM_8888(*src, sfmt, r, g, b, a);
-        PIXEL_FROM_RGB(pix, dfmt, r, g, b);
-        *d = ((pix & 0x7e0) << 16) | (pix & 0xf81f) | ((a << 2) & 0x7e0);
-        src++;
-        d++;
-    }
-    return n * 4;
-}
+/* the shift of a component in the 8888 pixels ordered like the target */
+#define SHIFT_8888(mask, fmt)                                        \
+    (8 * (((mask) > (fmt)->Rmask) + ((mask) > (fmt)->Gmask)        \
+          + ((mask) > (fmt)->Bmask)))
 
-/* encode 32bpp rgb + a into 32bpp G0RAB format for blitting into 555 */
-static int copy_transl_555(void *dst, Uint32 *src, int n,
-                           GAL_PixelFormat *sfmt, GAL_PixelFormat *dfmt)
+/* encode 32bpp rgb + a into 32bpp argb ordered like the 16bpp target */
+static int copy_transl_16(void *dst, Uint32 *src, int n,
+                          GAL_PixelFormat *sfmt, GAL_PixelFormat *dfmt)
 {
     int i;
     Uint32 *d = dst;
+    int rshift = SHIFT_8888(dfmt->Rmask, dfmt);
+    int gshift = SHIFT_8888(dfmt->Gmask, dfmt);
+    int bshift = SHIFT_8888(dfmt->Bmask, dfmt);
     for(i = 0; i < n; i++) {
         unsigned r, g, b, a;
-        Uint16 pix;
         RGBA_FROM_8888(*src, sfmt, r, g, b, a);
-        PIXEL_FROM_RGB(pix, dfmt, r, g, b);
-        *d = ((pix & 0x3e0) << 16) | (pix & 0xfc1f) | ((a << 2) & 0x3e0);
+        *d = a << 24 | r << rshift | g << gshift | b << bshift;
         src++;
         d++;
     }
     return n * 4;
 }
 
-/* decode translucent pixels from 32bpp GORAB to 32bpp rgb + a */
-static int uncopy_transl_16(Uint32 *dst, void *src, int n,
-                            RLEDestFormat *sfmt, GAL_PixelFormat *dfmt)
-{
-    int i;
-    Uint32 *s = src;
-    for(i = 0; i < n; i++) {
-        unsigned r, g, b, a;
-        Uint32 pix = *s++;
-        a = (pix & 0x3e0) >> 2;
-        pix = (pix & ~0x3e0) | pix >> 16;
-        RGB_FROM_PIXEL(pix, sfmt, r, g, b);
-        PIXEL_FROM_RGBA(*dst, dfmt, r, g, b, a);
-        dst++;
-    }
-    return n * 4;
-}
-
 /* encode 32bpp rgba into 32bpp rgba, keeping alpha (dual purpose) */
 static int copy_32(void *dst, Uint32 *src, int n,
                    GAL_PixelFormat *sfmt, GAL_PixelFormat *dfmt)
@@ -983,20 +987,13 @@ static int copy_32(void *dst, Uint32 *src, int n,
     return n * 4;
 }
 
-/* decode 32bpp rgba into 32bpp rgba, keeping alpha (dual purpose) */
-static int uncopy_32(Uint32 *dst, void *src, int n,
-                     RLEDestFormat *sfmt, GAL_PixelFormat *dfmt)
+/* copy_32() for ARGB8888 pixels with the RGB masks of the target */
+static int copy_32_same(void *dst, Uint32 *src, int n,
+                        GAL_PixelFormat *sfmt, GAL_PixelFormat *dfmt)
 {
-    int i;
-    Uint32 *s = src;
-    for(i = 0; i < n; i++) {
-        unsigned r, g, b, a;
-        Uint32 pixel = *s++;
-        RGB_FROM_PIXEL(pixel, sfmt, r, g, b);
-        a = pixel >> 24;
-        PIXEL_FROM_RGBA(*dst, dfmt, r, g, b, a);
-        dst++;
-    }
+    (void)sfmt;
+    (void)dfmt;
+    memcpy(dst, src, n * 4);
     return n * 4;
 }
 
@@ -1005,30 +1002,233 @@ static int uncopy_32(Uint32 *dst, void *src, int n,
 #define ISTRANSL(pixel, fmt)        \
     ((unsigned)((((pixel) & fmt->Amask) >> fmt->Ashift) - 1U) < 254U)
 
-/* convert surface to be quickly alpha-blittable onto dest, if possible */
-static int RLEAlphaSurface(GAL_Surface *surface)
-{
-    GAL_Surface *dest;
-    GAL_PixelFormat *df;
-    int maxsize = 0;
-    int max_opaque_run;
-    int max_transl_run = 65535;
-    unsigned masksum;
-    Uint8 *rlebuf, *dst;
+/*
+ * The surfaces are encoded by bands of scan lines: every band is encoded
+ * at the place of its worst case in one buffer, by the worker threads of
+ * GAL for large surfaces, and then the bands are moved together. The
+ * encoding does not depend on the bands.
+ */
+#define MAX_RLE_BANDS           8
+#define MIN_THREADED_PIXELS     (256 * 256)
+#define MIN_BAND_LINES          32
+
+typedef struct _RLEEncoder RLEEncoder;
+
+typedef struct _RLEBand {
+    RLEEncoder *enc;
+    int y, h;                   /* the scan lines of the band */
+    Uint8 *buf;                 /* where the band is encoded */
+    int size;                   /* the number of bytes encoded */
+    int lastline;               /* the end of the last non-blank line, or 0 */
+} RLEBand;
+
+struct _RLEEncoder {
+    GAL_Surface *surface;
+    GAL_PixelFormat *df;        /* the target format of the alpha encoding */
+    int line_max;               /* the worst case size of a line, aligned */
     int (*copy_opaque)(void *, Uint32 *, int,
                        GAL_PixelFormat *, GAL_PixelFormat *);
     int (*copy_transl)(void *, Uint32 *, int,
                        GAL_PixelFormat *, GAL_PixelFormat *);
+    void (*encode_band)(RLEBand *band);
+};
 
-    dest = surface->map->dst;
-    if(!dest)
-        return -1;
-    df = dest->format;
-    if(surface->format->BitsPerPixel != 32)
-        return -1;                /* only 32bpp source supported */
+static void encode_band_part(void *context, int part)
+{
+    RLEBand *bands = context;
+
+    bands[part].enc->encode_band(bands + part);
+}
+
+static int get_nr_bands(GAL_Surface *surface)
+{
+    int nr_bands;
+
+    if (surface->w * surface->h < MIN_THREADED_PIXELS)
+        return 1;
+
+    nr_bands = MIN(surface->h / MIN_BAND_LINES,
+            MIN(GAL_GetNrWorkerThreads(), MAX_RLE_BANDS));
+    return nr_bands > 0 ? nr_bands : 1;
+}
+
+/*
+ * Encode the surface after a header of header_size bytes, and append
+ * the end marker of end_size bytes. Returns the realloc'ed buffer.
+ */
+static Uint8 *RLEEncodeBands(RLEEncoder *enc, int header_size, int end_size)
+{
+    GAL_Surface *surface = enc->surface;
+    RLEBand bands[MAX_RLE_BANDS];
+    int nr_bands = get_nr_bands(surface);
+    Uint8 *rlebuf, *dst, *lastline, *p;
+    int i;
+
+    rlebuf = (Uint8 *)malloc(header_size
+            + (size_t)surface->h * enc->line_max + end_size);
+    if(!rlebuf) {
+        GAL_OutOfMemory();
+        return NULL;
+    }
+
+    for(i = 0; i < nr_bands; i++) {
+        bands[i].enc = enc;
+        bands[i].y = surface->h * i / nr_bands;
+        bands[i].h = surface->h * (i + 1) / nr_bands - bands[i].y;
+        bands[i].buf = rlebuf + header_size
+            + (size_t)bands[i].y * enc->line_max;
+    }
+
+    GAL_RunWorkerJob(encode_band_part, bands, nr_bands);
+
+    /* move the bands together, and back up past trailing blank lines */
+    dst = lastline = rlebuf + header_size;
+    for(i = 0; i < nr_bands; i++) {
+        if(bands[i].buf != dst)
+            memmove(dst, bands[i].buf, bands[i].size);
+        if(bands[i].lastline)
+            lastline = dst + bands[i].lastline;
+        dst += bands[i].size;
+    }
+
+    /* the end marker is a zero <skip>,<run> pair */
+    memset(lastline, 0, end_size);
+    dst = lastline + end_size;
+
+    /* realloc the buffer to release unused memory */
+    p = realloc(rlebuf, dst - rlebuf);
+    return p ? p : rlebuf;
+}
+
+/* encode a band of a surface with pixel alpha */
+static void RLEAlphaBand(RLEBand *band)
+{
+    RLEEncoder *enc = band->enc;
+    GAL_Surface *surface = enc->surface;
+    GAL_PixelFormat *sf = surface->format;
+    GAL_PixelFormat *df = enc->df;
+    int max_opaque_run = 255;
+    int max_transl_run = 65535;
+    int x, y;
+    int h = band->h, w = surface->w;
+    Uint32 *src = (Uint32 *)((Uint8 *)surface->pixels
+                             + band->y * surface->pitch);
+    Uint8 *dst = band->buf;
+    Uint8 *lastline = dst;        /* end of last non-blank line */
+
+    /* opaque counts are 8 or 16 bits, depending on target depth */
+#define ADD_OPAQUE_COUNTS(n, m)                        \
+    if(df->BytesPerPixel == 4) {                \
+        ((Uint16 *)dst)[0] = n;                \
+        ((Uint16 *)dst)[1] = m;                \
+        dst += 4;                                \
+    } else {                                        \
+        dst[0] = n;                                \
+        dst[1] = m;                                \
+        dst += 2;                                \
+    }
+
+    /* translucent counts are always 16 bit */
+#define ADD_TRANSL_COUNTS(n, m)                \
+    (((Uint16 *)dst)[0] = n, ((Uint16 *)dst)[1] = m, dst += 4)
+
+    for(y = 0; y < h; y++) {
+        int runstart, skipstart;
+        int blankline = 0;
+        /* First encode all opaque pixels of a scan line */
+        x = 0;
+        do {
+            int run, skip, len;
+            skipstart = x;
+            while(x < w && !ISOPAQUE(src[x], sf))
+                x++;
+            runstart = x;
+            while(x < w && ISOPAQUE(src[x], sf))
+                x++;
+            skip = runstart - skipstart;
+            if(skip == w)
+                blankline = 1;
+            run = x - runstart;
+            while(skip > max_opaque_run) {
+                ADD_OPAQUE_COUNTS(max_opaque_run, 0);
+                skip -= max_opaque_run;
+            }
+            len = MIN(run, max_opaque_run);
+            ADD_OPAQUE_COUNTS(skip, len);
+            dst += enc->copy_opaque(dst, src + runstart, len, sf, df);
+            runstart += len;
+            run -= len;
+            while(run) {
+                len = MIN(run, max_opaque_run);
+                ADD_OPAQUE_COUNTS(0, len);
+                dst += enc->copy_opaque(dst, src + runstart, len, sf, df);
+                runstart += len;
+                run -= len;
+            }
+        } while(x < w);
+
+        /* Make sure the next output address is 32-bit aligned */
+        dst += (unsigned long)dst & 2;
+
+        /* Next, encode all translucent pixels of the same scan line */
+        x = 0;
+        do {
+            int run, skip, len;
+            skipstart = x;
+            while(x < w && !ISTRANSL(src[x], sf))
+                x++;
+            runstart = x;
+            while(x < w && ISTRANSL(src[x], sf))
+                x++;
+            skip = runstart - skipstart;
+            blankline &= (skip == w);
+            run = x - runstart;
+            while(skip > max_transl_run) {
+                ADD_TRANSL_COUNTS(max_transl_run, 0);
+                skip -= max_transl_run;
+            }
+            len = MIN(run, max_transl_run);
+            ADD_TRANSL_COUNTS(skip, len);
+            dst += enc->copy_transl(dst, src + runstart, len, sf, df);
+            runstart += len;
+            run -= len;
+            while(run) {
+                len = MIN(run, max_transl_run);
+                ADD_TRANSL_COUNTS(0, len);
+                dst += enc->copy_transl(dst, src + runstart, len, sf, df);
+                runstart += len;
+                run -= len;
+            }
+            if(!blankline)
+                lastline = dst;
+        } while(x < w);
+
+        src += surface->pitch >> 2;
+    }
+
+#undef ADD_OPAQUE_COUNTS
+#undef ADD_TRANSL_COUNTS
+
+    band->size = dst - band->buf;
+    band->lastline = lastline - band->buf;
+}
+
+/* encode a surface to be quickly alpha-blittable onto df, if possible */
+static Uint8 *RLEAlphaSurface(GAL_Surface *surface, GAL_PixelFormat *df)
+{
+    RLEEncoder enc;
+    GAL_PixelFormat *sf = surface->format;
+    unsigned masksum;
+    Uint8 *rlebuf;
+
+    if(sf->BitsPerPixel != 32)
+        return NULL;                /* only 32bpp source supported */
 
     /* find out whether the destination is one we support,
-       and determine the max size of the encoded result */
+       and determine the max size of an encoded line */
+    enc.surface = surface;
+    enc.df = df;
+    enc.encode_band = RLEAlphaBand;
     masksum = df->Rmask | df->Gmask | df->Bmask;
     switch(df->BytesPerPixel) {
     case 2:
@@ -1037,50 +1237,51 @@ static int RLEAlphaSurface(GAL_Surface *surface)
         case 0xffff:
             if(df->Gmask == 0x07e0
                || df->Rmask == 0x07e0 || df->Bmask == 0x07e0) {
-                copy_opaque = copy_opaque_16;
-                copy_transl = copy_transl_565;
+                enc.copy_opaque = copy_opaque_16;
+                enc.copy_transl = copy_transl_16;
             } else
-                return -1;
+                return NULL;
             break;
         case 0x7fff:
             if(df->Gmask == 0x03e0
                || df->Rmask == 0x03e0 || df->Bmask == 0x03e0) {
-                copy_opaque = copy_opaque_16;
-                copy_transl = copy_transl_555;
+                enc.copy_opaque = copy_opaque_16;
+                enc.copy_transl = copy_transl_16;
             } else
-                return -1;
+                return NULL;
             break;
         default:
-            return -1;
+            return NULL;
         }
-        max_opaque_run = 255;        /* runs stored as bytes */
 
         /* worst case is alternating opaque and translucent pixels,
            with room for alignment padding between lines */
-        maxsize = surface->h * (2 + (4 + 2) * (surface->w + 1)) + 2;
+        enc.line_max = 2 + (4 + 2) * (surface->w + 1);
         break;
     case 4:
         if(masksum != 0x00ffffff)
-            return -1;                /* requires unused high byte */
-        copy_opaque = copy_32;
-        copy_transl = copy_32;
-        max_opaque_run = 255;        /* runs stored as short ints */
+            return NULL;                /* requires unused high byte */
+        if(sf->Amask == 0xff000000 && sf->Rmask == df->Rmask
+           && sf->Gmask == df->Gmask && sf->Bmask == df->Bmask) {
+            enc.copy_opaque = copy_32_same;
+            enc.copy_transl = copy_32_same;
+        } else {
+            enc.copy_opaque = copy_32;
+            enc.copy_transl = copy_32;
+        }
 
         /* worst case is alternating opaque and translucent pixels */
-        maxsize = surface->h * 2 * 4 * (surface->w + 1) + 4;
+        enc.line_max = 2 * 4 * (surface->w + 1);
         break;
     default:
-        return -1;                /* anything else unsupported right now */
+        return NULL;                /* anything else unsupported right now */
     }
+    /* keep the bands 32-bit aligned */
+    enc.line_max = (enc.line_max + 3) & ~3;
 
-    maxsize += sizeof(RLEDestFormat);
-    rlebuf = (Uint8 *)malloc(maxsize);
-    if(!rlebuf) {
-        GAL_OutOfMemory();
-        return -1;
-    }
-    {
-        /* save the destination format so we can undo the encoding later */
+    rlebuf = RLEEncodeBands(&enc, sizeof(RLEDestFormat), 4);
+    if(rlebuf) {
+        /* save the destination format */
         RLEDestFormat *r = (RLEDestFormat *)rlebuf;
         r->BytesPerPixel = df->BytesPerPixel;
         r->Rloss = df->Rloss;
@@ -1095,128 +1296,8 @@ static int RLEAlphaSurface(GAL_Surface *surface)
         r->Bmask = df->Bmask;
         r->Amask = df->Amask;
     }
-    dst = rlebuf + sizeof(RLEDestFormat);
-
-    /* Do the actual encoding */
-    {
-        int x, y;
-        int h = surface->h, w = surface->w;
-        GAL_PixelFormat *sf = surface->format;
-        Uint32 *src = (Uint32 *)((Uint8 *)surface->pixels);
-        Uint8 *lastline = dst;        /* end of last non-blank line */
-
-        /* opaque counts are 8 or 16 bits, depending on target depth */
-#define ADD_OPAQUE_COUNTS(n, m)                        \
-        if(df->BytesPerPixel == 4) {                \
-            ((Uint16 *)dst)[0] = n;                \
-            ((Uint16 *)dst)[1] = m;                \
-            dst += 4;                                \
-        } else {                                \
-            dst[0] = n;                                \
-            dst[1] = m;                                \
-            dst += 2;                                \
-        }
 
-        /* translucent counts are always 16 bit */
-#define ADD_TRANSL_COUNTS(n, m)                \
-        (((Uint16 *)dst)[0] = n, ((Uint16 *)dst)[1] = m, dst += 4)
-
-        for(y = 0; y < h; y++) {
-            int runstart, skipstart;
-            int blankline = 0;
-            /* First encode all opaque pixels of a scan line */
-            x = 0;
-            do {
-                int run, skip, len;
-                skipstart = x;
-                while(x < w && !ISOPAQUE(src[x], sf))
-                    x++;
-                runstart = x;
-                while(x < w && ISOPAQUE(src[x], sf))
-                    x++;
-                skip = runstart - skipstart;
-                if(skip == w)
-                    blankline = 1;
-                run = x - runstart;
-                while(skip > max_opaque_run) {
-                    ADD_OPAQUE_COUNTS(max_opaque_run, 0);
-                    skip -= max_opaque_run;
-                }
-                len = MIN(run, max_opaque_run);
-                ADD_OPAQUE_COUNTS(skip, len);
-                dst += copy_opaque(dst, src + runstart, len, sf, df);
-                runstart += len;
-                run -= len;
-                while(run) {
-                    len = MIN(run, max_opaque_run);
-                    ADD_OPAQUE_COUNTS(0, len);
-                    dst += copy_opaque(dst, src + runstart, len, sf, df);
-                    runstart += len;
-                    run -= len;
-                }
-            } while(x < w);
-
-            /* Make sure the next output address is 32-bit aligned */
-            dst += (unsigned long)dst & 2;
-
-            /* Next, encode all translucent pixels of the same scan line */
-            x = 0;
-            do {
-                int run, skip, len;
-                skipstart = x;
-                while(x < w && !ISTRANSL(src[x], sf))
-                    x++;
-                runstart = x;
-                while(x < w && ISTRANSL(src[x], sf))
-                    x++;
-                skip = runstart - skipstart;
-                blankline &= (skip == w);
-                run = x - runstart;
-                while(skip > max_transl_run) {
-                    ADD_TRANSL_COUNTS(max_transl_run, 0);
-                    skip -= max_transl_run;
-                }
-                len = MIN(run, max_transl_run);
-                ADD_TRANSL_COUNTS(skip, len);
-                dst += copy_transl(dst, src + runstart, len, sf, df);
-                runstart += len;
-                run -= len;
-                while(run) {
-                    len = MIN(run, max_transl_run);
-                    ADD_TRANSL_COUNTS(0, len);
-                    dst += copy_transl(dst, src + runstart, len, sf, df);
-                    runstart += len;
-                    run -= len;
-                }
-                if(!blankline)
-                    lastline = dst;
-            } while(x < w);
-
-            src += surface->pitch >> 2;
-        }
-        dst = lastline;                /* back up past trailing blank lines */
-        ADD_OPAQUE_COUNTS(0, 0);
-    }
-
-#undef ADD_OPAQUE_COUNTS
-#undef ADD_TRANSL_COUNTS
-
-    /* Now that we have it encoded, release the original pixels */
-    if((surface->flags & GAL_PREALLOC) != GAL_PREALLOC
-       && (surface->flags & GAL_HWSURFACE) != GAL_HWSURFACE) {
-        free( surface->pixels );
-        surface->pixels = NULL;
-    }
-
-    /* realloc the buffer to release unused memory */
-    {
-        Uint8 *p = realloc(rlebuf, dst - rlebuf);
-        if(!p)
-            p = rlebuf;
-        surface->map->sw_data->aux_data = p;
-    }
-
-    return 0;
+    return rlebuf;
 }
 
 static Uint32 getpix_8(Uint8 *srcbuf)
@@ -1248,54 +1329,28 @@ static getpix_func getpixes[4] = {
     getpix_8, getpix_16, getpix_24, getpix_32
 };
 
-static int RLEColorkeySurface(GAL_Surface *surface)
+/* encode a band of a colorkeyed surface */
+static void RLEColorkeyBand(RLEBand *band)
 {
-        Uint8 *rlebuf, *dst;
+        GAL_Surface *surface = band->enc->surface;
+        Uint8 *dst, *srcbuf, *lastline;
         int maxn;
         int y;
-        Uint8 *srcbuf, *lastline;
-        int maxsize = 0;
         int bpp = surface->format->BytesPerPixel;
         getpix_func getpix;
         Uint32 ckey, rgbmask;
         int w, h;
 
-        /* calculate the worst case size for the compressed surface */
-        switch(bpp) {
-        case 1:
-            /* worst case is alternating opaque and transparent pixels,
-               starting with an opaque pixel */
-            maxsize = surface->h * 3 * (surface->w / 2 + 1) + 2;
-            break;
-        case 2:
-        case 3:
-            /* worst case is solid runs, at most 255 pixels wide */
-            maxsize = surface->h * (2 * (surface->w / 255 + 1)
-                                    + surface->w * bpp) + 2;
-            break;
-        case 4:
-            /* worst case is solid runs, at most 65535 pixels wide */
-            maxsize = surface->h * (4 * (surface->w / 65535 + 1)
-                                    + surface->w * 4) + 4;
-            break;
-        }
-
-        rlebuf = (Uint8 *)malloc(maxsize);
-        if ( rlebuf == NULL ) {
-                GAL_OutOfMemory();
-                return(-1);
-        }
-
         /* Set up the conversion */
-        srcbuf = (Uint8 *)surface->pixels;
+        srcbuf = (Uint8 *)surface->pixels + band->y * surface->pitch;
         maxn = bpp == 4 ? 65535 : 255;
-        dst = rlebuf;
+        dst = band->buf;
         rgbmask = ~surface->format->Amask;
         ckey = surface->format->colorkey & rgbmask;
         lastline = dst;
         getpix = getpixes[bpp - 1];
         w = surface->w;
-        h = surface->h;
+        h = band->h;
 
 #define ADD_COUNTS(n, m)                        \
         if(bpp == 4) {                                \
@@ -1352,33 +1407,150 @@ static int RLEColorkeySurface(GAL_Surface *surface)
 
             srcbuf += surface->pitch;
         }
-        dst = lastline;                /* back up bast trailing blank lines */
-        ADD_COUNTS(0, 0);
 
 #undef ADD_COUNTS
 
-        /* Now that we have it encoded, release the original pixels */
-        if((surface->flags & GAL_PREALLOC) != GAL_PREALLOC
-           && (surface->flags & GAL_HWSURFACE) != GAL_HWSURFACE) {
-            free( surface->pixels );
-            surface->pixels = NULL;
+        band->size = dst - band->buf;
+        band->lastline = lastline - band->buf;
+}
+
+static Uint8 *RLEColorkeySurface(GAL_Surface *surface)
+{
+        RLEEncoder enc;
+        int bpp = surface->format->BytesPerPixel;
+
+        enc.surface = surface;
+        enc.df = NULL;
+        enc.copy_opaque = enc.copy_transl = NULL;
+        enc.encode_band = RLEColorkeyBand;
+
+        /* calculate the worst case size for a compressed line */
+        switch(bpp) {
+        case 1:
+            /* worst case is alternating opaque and transparent pixels,
+               starting with an opaque pixel */
+            enc.line_max = 3 * (surface->w / 2 + 1);
+            break;
+        case 2:
+        case 3:
+            /* worst case is solid runs, at most 255 pixels wide */
+            enc.line_max = 2 * (surface->w / 255 + 1)
+                                    + surface->w * bpp;
+            break;
+        case 4:
+            /* worst case is solid runs, at most 65535 pixels wide */
+            enc.line_max = 4 * (surface->w / 65535 + 1)
+                                    + surface->w * 4;
+            break;
+        default:
+            return NULL;
+        }
+        /* keep the bands aligned for the 16 and 32 bit pixels */
+        enc.line_max = (enc.line_max + 3) & ~3;
+
+        return RLEEncodeBands(&enc, 0, bpp == 4 ? 4 : 2);
+}
+
+/*
+ * The encodings kept for a surface, most recently used first. The
+ * colorkeyed encodings are in the format of the surface, and the pixel
+ * alpha encodings depend on the format of the destination.
+ */
+#define MAX_RLE_ENCODINGS       4
+
+#define RLE_COLORKEY            1
+#define RLE_PIXELALPHA          2
+
+typedef struct _RLEEncoding {
+    struct _RLEEncoding *next;
+    Uint8 *data;
+
+    int kind;
+    Uint32 colorkey;            /* the colorkey for RLE_COLORKEY */
+    int bpp;                    /* the target format for RLE_PIXELALPHA */
+    Uint32 Rmask, Gmask, Bmask;
+} RLEEncoding;
+
+static int same_encoding(const RLEEncoding *a, const RLEEncoding *b)
+{
+    if(a->kind != b->kind)
+        return 0;
+    if(a->kind == RLE_COLORKEY)
+        return a->colorkey == b->colorkey;
+    return a->bpp == b->bpp && a->Rmask == b->Rmask
+        && a->Gmask == b->Gmask && a->Bmask == b->Bmask;
+}
+
+static Uint8 *find_encoding(struct private_swaccel *sw,
+        const RLEEncoding *key)
+{
+    RLEEncoding *enc, *prev = NULL;
+
+    for(enc = sw->rle_encodings; enc; prev = enc, enc = enc->next) {
+        if(same_encoding(enc, key)) {
+            /* move it to the front */
+            if(prev) {
+                prev->next = enc->next;
+                enc->next = sw->rle_encodings;
+                sw->rle_encodings = enc;
+            }
+            return enc->data;
         }
+    }
 
-        /* realloc the buffer to release unused memory */
-        {
-            /* If realloc returns NULL, the original block is left intact */
-            Uint8 *p = realloc(rlebuf, dst - rlebuf);
-            if(!p)
-                p = rlebuf;
-            surface->map->sw_data->aux_data = p;
+    return NULL;
+}
+
+static void keep_encoding(struct private_swaccel *sw,
+        const RLEEncoding *key, Uint8 *data)
+{
+    RLEEncoding *enc, **last;
+    int n = 0;
+
+    /* free the least recently used one if the cache is full */
+    for(last = (RLEEncoding **)&sw->rle_encodings; *last;
+            last = &(*last)->next) {
+        if(++n == MAX_RLE_ENCODINGS) {
+            free((*last)->data);
+            free(*last);
+            *last = NULL;
+            break;
         }
+    }
 
-        return(0);
+    enc = (RLEEncoding *)malloc(sizeof(RLEEncoding));
+    if(enc == NULL) {
+        /* the surface owns the encoding through the cache only */
+        free(data);
+        return;
+    }
+
+    *enc = *key;
+    enc->data = data;
+    enc->next = sw->rle_encodings;
+    sw->rle_encodings = enc;
+}
+
+void GAL_FreeRLEEncodings(GAL_BlitMap *map)
+{
+    RLEEncoding *enc, *next;
+
+    if(map == NULL || map->sw_data == NULL)
+        return;
+
+    for(enc = map->sw_data->rle_encodings; enc; enc = next) {
+        next = enc->next;
+        free(enc->data);
+        free(enc);
+    }
+    map->sw_data->rle_encodings = NULL;
 }
 
 int GAL_RLESurface(GAL_Surface *surface)
 {
-        int retcode;
+        RLEEncoding key;
+        struct private_swaccel *sw;
+        Uint8 *data;
 
         /* Clear any previous RLE conversion */
         if ( (surface->flags & GAL_RLEACCEL) == GAL_RLEACCEL ) {
@@ -1390,133 +1562,82 @@ int GAL_RLESurface(GAL_Surface *surface)
                 return(-1);
         }
 
-        /* Encode */
+        memset(&key, 0, sizeof(key));
         if((surface->flags & GAL_SRCCOLORKEY) == GAL_SRCCOLORKEY) {
-            retcode = RLEColorkeySurface(surface);
-        } else {
-            if((surface->flags & GAL_SRCALPHA) == GAL_SRCALPHA
-               && surface->format->Amask != 0)
-                retcode = RLEAlphaSurface(surface);
+            key.kind = RLE_COLORKEY;
+            key.colorkey = surface->format->colorkey
+                & ~surface->format->Amask;
+        } else if((surface->flags & (GAL_SRCALPHA | GAL_SRCPIXELALPHA))
+                  == GAL_SRCPIXELALPHA
+               && !(surface->flags & GAL_PREMULTIPLIED)
+               && surface->format->Amask != 0 && surface->map->dst) {
+            GAL_PixelFormat *df = surface->map->dst->format;
+
+            key.kind = RLE_PIXELALPHA;
+            key.bpp = df->BytesPerPixel;
+            key.Rmask = df->Rmask;
+            key.Gmask = df->Gmask;
+            key.Bmask = df->Bmask;
+        } else
+            return -1;        /* no RLE for per-surface alpha sans ckey */
+
+        /* Encode, unless we have encoded it for the same target */
+        sw = surface->map->sw_data;
+        data = find_encoding(sw, &key);
+        if(data == NULL) {
+            if(key.kind == RLE_COLORKEY)
+                data = RLEColorkeySurface(surface);
             else
-                retcode = -1;        /* no RLE for per-surface alpha sans ckey */
-        }
+                data = RLEAlphaSurface(surface, surface->map->dst->format);
+            if(data == NULL)
+                return -1;
 
-        if(retcode < 0)
-            return -1;
+            keep_encoding(sw, &key, data);
+            if(sw->rle_encodings == NULL
+               || ((RLEEncoding *)sw->rle_encodings)->data != data)
+                return -1;
+        }
 
         /* The surface is now accelerated */
+        sw->aux_data = data;
         surface->flags |= GAL_RLEACCEL;
 
         return(0);
 }
 
 /*
- * Un-RLE a surface with pixel alpha
- * This may not give back exactly the image before RLE-encoding; all
- * completely transparent pixels will be lost, and colour and alpha depth
- * may have been reduced (when encoding for 16bpp targets).
+ * Stop using the RLE encoding of a surface. The encoding does not replace
+ * the pixels of the surface, so there is nothing to decode; if keep is
+ * non-zero, the encodings are kept to be used again, otherwise they are
+ * freed, for the surface is to be changed or freed.
  */
-static void UnRLEAlpha(GAL_Surface *surface)
-{
-    Uint8 *srcbuf;
-    Uint32 *dst;
-    GAL_PixelFormat *sf = surface->format;
-    RLEDestFormat *df = surface->map->sw_data->aux_data;
-    int (*uncopy_opaque)(Uint32 *, void *, int,
-                         RLEDestFormat *, GAL_PixelFormat *);
-    int (*uncopy_transl)(Uint32 *, void *, int,
-                         RLEDestFormat *, GAL_PixelFormat *);
-    int w = surface->w;
-    int bpp = df->BytesPerPixel;
-
-    if(bpp == 2) {
-        uncopy_opaque = uncopy_opaque_16;
-        uncopy_transl = uncopy_transl_16;
-    } else {
-        uncopy_opaque = uncopy_transl = uncopy_32;
-    }
-
-    surface->pixels = malloc(surface->h * surface->pitch);
-    /* fill background with transparent pixels */
-    memset(surface->pixels, 0, surface->h * surface->pitch);
-
-    dst = surface->pixels;
-    srcbuf = (Uint8 *)(df + 1);
-    for(;;) {
-        /* copy opaque pixels */
-        int ofs = 0;
-        do {
-            unsigned run;
-            if(bpp == 2) {
-                ofs += srcbuf[0];
-                run = srcbuf[1];
-                srcbuf += 2;
-            } else {
-                ofs += ((Uint16 *)srcbuf)[0];
-                run = ((Uint16 *)srcbuf)[1];
-                srcbuf += 4;
-            }
-            if(run) {
-                srcbuf += uncopy_opaque(dst + ofs, srcbuf, run, df, sf);
-                ofs += run;
-            } else if(!ofs)
-                return;
-        } while(ofs < w);
-
-        /* skip padding if needed */
-        if(bpp == 2)
-            srcbuf += (unsigned long)srcbuf & 2;
-
-        /* copy translucent pixels */
-        ofs = 0;
-        do {
-            unsigned run;
-            ofs += ((Uint16 *)srcbuf)[0];
-            run = ((Uint16 *)srcbuf)[1];
-            srcbuf += 4;
-            if(run) {
-                srcbuf += uncopy_transl(dst + ofs, srcbuf, run, df, sf);
-                ofs += run;
-            }
-        } while(ofs < w);
-        dst += surface->pitch >> 2;
-    }
-}
-
-void GAL_UnRLESurface(GAL_Surface *surface, int recode)
+void GAL_UnRLESurface(GAL_Surface *surface, int keep)
 {
     if ( (surface->flags & GAL_RLEACCEL) == GAL_RLEACCEL ) {
         surface->flags &= ~GAL_RLEACCEL;
 
-        if(recode && (surface->flags & GAL_PREALLOC) != GAL_PREALLOC
-           && (surface->flags & GAL_HWSURFACE) != GAL_HWSURFACE) {
-            if((surface->flags & GAL_SRCCOLORKEY) == GAL_SRCCOLORKEY) {
-                GAL_Rect full;
-                unsigned alpha_flag;
-
-                /* re-create the original surface */
-                surface->pixels = malloc(surface->h * surface->pitch);
-
-                /* fill it with the background colour */
-                GAL_FillRect(surface, NULL, surface->format->colorkey);
-
-                /* now render the encoded surface */
-                full.x = full.y = 0;
-                full.w = surface->w;
-                full.h = surface->h;
-                alpha_flag = surface->flags & GAL_SRCALPHA;
-                surface->flags &= ~GAL_SRCALPHA; /* opaque blit */
-                GAL_RLEBlit(NULL, surface, &full, surface, &full);
-                surface->flags |= alpha_flag;
-            } else
-                UnRLEAlpha(surface);
-        }
-
-        if ( surface->map && surface->map->sw_data->aux_data ) {
-            free(surface->map->sw_data->aux_data);
+        if ( surface->map ) {
             surface->map->sw_data->aux_data = NULL;
         }
     }
+
+    if ( !keep ) {
+        GAL_FreeRLEEncodings(surface->map);
+    }
 }
 
+void GAL_DropRLESurface(GAL_Surface *surface)
+{
+    if ( surface->map == NULL ) {
+        return;
+    }
 
+    if ( (surface->flags & GAL_RLEACCEL) == GAL_RLEACCEL ) {
+        /* the blit will be set up and encoded again */
+        GAL_UnRLESurface(surface, 0);
+        GAL_InvalidateMap(surface->map);
+    }
+    else {
+        GAL_FreeRLEEncodings(surface->map);
+    }
+}
@@ -53,5 +53,6 @@ extern int GAL_RLEBlit(GAL_VideoDevice *video,
 extern int GAL_RLEAlphaBlit(GAL_VideoDevice *video,
         GAL_Surface *src, GAL_Rect *srcrect,
         GAL_Surface *dst, GAL_Rect *dstrect);
-extern void GAL_UnRLESurface(GAL_Surface *surface, int recode);
+extern void GAL_UnRLESurface(GAL_Surface *surface, int keep);
+extern void GAL_FreeRLEEncodings(GAL_BlitMap *map);
 
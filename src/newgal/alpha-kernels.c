@@ -0,0 +1,486 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** alpha-kernels.c: the SIMD kernels for the per-pixel alpha blits.
+**
+** Create date: 2026/10/18
+**
+** The kernels blend a line of ARGB8888 pixels onto a line of (A)RGB8888
+** or RGB565 pixels. They give the same results as the scalar blits in
+** blit_A.c, which compute every channel as
+**
+**      d + (((s - d) * alpha) >> 8)
+**
+** with an arithmetic shift (5 bits of alpha for RGB565), and copy an
+** opaque source pixel. This is the same as
+**
+**      (d * (256 - w) + s * w) >> 8
+**
+** where w is the alpha, or 256 for an opaque pixel; the products fit in
+** 16 bits, so the channels are handled as 16-bit lanes.
+**
+** The kernels for premultiplied pixels compute every channel, alpha
+** included, as
+**
+**      s + (d * (255 - alpha) + 127) / 255
+**
+** with a saturated addition, as premul_blend_8888 in blit.h does.
+**
+** The SSE2 kernels are always used on x86-64; the AVX2 kernels are picked
+** at runtime by the features of the CPU (see simd.h).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "minigui.h"
+#include "newgal.h"
+#include "blit.h"
+
+#include "simd.h"
+
+#ifdef _MG_HAVE_X86_KERNELS
+#   include <immintrin.h>
+#endif
+
+/* the scalar blending of blit_A.c, for the pixels left by the kernels */
+static inline Uint32 blend_argb_to_rgb (Uint32 s, Uint32 d)
+{
+    Uint32 alpha = s >> 24;
+    Uint32 dalpha = d >> 24;
+    Uint32 s1, d1;
+
+    if (alpha == GAL_ALPHA_OPAQUE)
+        return s;
+
+    s1 = s & 0xff00ff;
+    d1 = d & 0xff00ff;
+    d1 = (d1 + (((s1 - d1) * alpha) >> 8)) & 0xff00ff;
+    s &= 0xff00;
+    d &= 0xff00;
+    d = (d + (((s - d) * alpha) >> 8)) & 0xff00;
+    return d1 | d | (dalpha << 24);
+}
+
+static inline Uint16 blend_argb_to_565 (Uint32 s, Uint16 d16)
+{
+    unsigned alpha = s >> 27;
+    Uint32 d = d16;
+
+    if (alpha == (GAL_ALPHA_OPAQUE >> 3))
+        return (s >> 8 & 0xf800) + (s >> 5 & 0x7e0) + (s >> 3 & 0x1f);
+
+    s = ((s & 0xfc00) << 11) + (s >> 8 & 0xf800) + (s >> 3 & 0x1f);
+    d = (d | d << 16) & 0x07e0f81f;
+    d += (s - d) * alpha >> 5;
+    d &= 0x07e0f81f;
+    return (Uint16)(d | d >> 16);
+}
+
+#ifdef _MG_HAVE_X86_KERNELS
+/* blends two ARGB8888 pixels expanded to 16-bit lanes */
+static inline __m128i SSE2_TARGET blend_argb_sse2 (__m128i s, __m128i d)
+{
+    const __m128i opaque = _mm_set1_epi16 (0xff);
+    const __m128i one = _mm_set1_epi16 (0x100);
+    const __m128i rgb_lanes = _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alpha_lanes = _mm_set_epi16 (0x100, 0, 0, 0, 0x100, 0, 0, 0);
+    __m128i a, eq, w;
+
+    a = _mm_shufflelo_epi16 (s, _MM_SHUFFLE (3, 3, 3, 3));
+    a = _mm_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+
+    /* w = 256 for an opaque pixel, which also takes the source alpha;
+       otherwise the destination alpha is kept */
+    eq = _mm_cmpeq_epi16 (a, opaque);
+    w = _mm_sub_epi16 (a, eq);
+    w = _mm_or_si128 (_mm_and_si128 (w, rgb_lanes),
+            _mm_and_si128 (eq, alpha_lanes));
+
+    return _mm_srli_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (s, w),
+                _mm_mullo_epi16 (d, _mm_sub_epi16 (one, w))), 8);
+}
+
+static void SSE2_TARGET argb_to_rgb_sse2 (Uint32* dst, const Uint32* src,
+        int n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i alpha_mask = _mm_set1_epi32 (0xff000000);
+
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        __m128i s = _mm_loadu_si128 ((const __m128i*)src);
+        __m128i d, a;
+        int opaque;
+
+        a = _mm_and_si128 (s, alpha_mask);
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (a, zero)) == 0xffff)
+            continue;
+
+        opaque = _mm_movemask_epi8 (_mm_cmpeq_epi32 (a, alpha_mask));
+        if (opaque == 0xffff) {
+            _mm_storeu_si128 ((__m128i*)dst, s);
+            continue;
+        }
+
+        d = _mm_loadu_si128 ((const __m128i*)dst);
+        d = _mm_packus_epi16 (
+                blend_argb_sse2 (_mm_unpacklo_epi8 (s, zero),
+                    _mm_unpacklo_epi8 (d, zero)),
+                blend_argb_sse2 (_mm_unpackhi_epi8 (s, zero),
+                    _mm_unpackhi_epi8 (d, zero)));
+        _mm_storeu_si128 ((__m128i*)dst, d);
+    }
+
+    for (; n > 0; n--, src++, dst++)
+        *dst = blend_argb_to_rgb (*src, *dst);
+}
+
+/* blends four ARGB8888 pixels onto four RGB565 pixels in 32-bit lanes,
+   and returns the RGB565 pixels sign-extended for _mm_packs_epi32 */
+static inline __m128i SSE2_TARGET blend_565_sse2 (__m128i s, __m128i d)
+{
+    const __m128i mask5 = _mm_set1_epi32 (0x1f);
+    const __m128i mask6 = _mm_set1_epi32 (0x3f);
+    const __m128i one = _mm_set1_epi32 (32);
+    __m128i a, w, iw, r, g, b;
+
+    /* w = 32 for an opaque pixel */
+    a = _mm_srli_epi32 (s, 27);
+    w = _mm_sub_epi32 (a, _mm_cmpeq_epi32 (a, mask5));
+    iw = _mm_sub_epi32 (one, w);
+
+    r = _mm_add_epi16 (
+            _mm_mullo_epi16 (_mm_and_si128 (_mm_srli_epi32 (s, 19), mask5), w),
+            _mm_mullo_epi16 (_mm_srli_epi32 (d, 11), iw));
+    g = _mm_add_epi16 (
+            _mm_mullo_epi16 (_mm_and_si128 (_mm_srli_epi32 (s, 10), mask6), w),
+            _mm_mullo_epi16 (_mm_and_si128 (_mm_srli_epi32 (d, 5), mask6), iw));
+    b = _mm_add_epi16 (
+            _mm_mullo_epi16 (_mm_and_si128 (_mm_srli_epi32 (s, 3), mask5), w),
+            _mm_mullo_epi16 (_mm_and_si128 (d, mask5), iw));
+
+    r = _mm_slli_epi32 (_mm_srli_epi32 (r, 5), 11);
+    g = _mm_slli_epi32 (_mm_srli_epi32 (g, 5), 5);
+    b = _mm_srli_epi32 (b, 5);
+    r = _mm_or_si128 (r, _mm_or_si128 (g, b));
+    return _mm_srai_epi32 (_mm_slli_epi32 (r, 16), 16);
+}
+
+static void SSE2_TARGET argb_to_565_sse2 (Uint16* dst, const Uint32* src,
+        int n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i alpha_mask = _mm_set1_epi32 (0xf8000000);
+
+    for (; n >= 8; n -= 8, src += 8, dst += 8) {
+        __m128i s0 = _mm_loadu_si128 ((const __m128i*)src);
+        __m128i s1 = _mm_loadu_si128 ((const __m128i*)(src + 4));
+        __m128i d;
+
+        /* the pixels with less than 8 of alpha are skipped as well */
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (
+                    _mm_and_si128 (_mm_or_si128 (s0, s1), alpha_mask),
+                    zero)) == 0xffff)
+            continue;
+
+        d = _mm_loadu_si128 ((const __m128i*)dst);
+        d = _mm_packs_epi32 (
+                blend_565_sse2 (s0, _mm_unpacklo_epi16 (d, zero)),
+                blend_565_sse2 (s1, _mm_unpackhi_epi16 (d, zero)));
+        _mm_storeu_si128 ((__m128i*)dst, d);
+    }
+
+    for (; n > 0; n--, src++, dst++)
+        *dst = blend_argb_to_565 (*src, *dst);
+}
+
+/* d * (255 - alpha) / 255 rounded for two premultiplied pixels expanded
+   to 16-bit lanes */
+static inline __m128i SSE2_TARGET premul_scale_sse2 (__m128i s, __m128i d)
+{
+    const __m128i full = _mm_set1_epi16 (0xff);
+    const __m128i bias = _mm_set1_epi16 (128);
+    __m128i ia;
+
+    ia = _mm_shufflelo_epi16 (s, _MM_SHUFFLE (3, 3, 3, 3));
+    ia = _mm_shufflehi_epi16 (ia, _MM_SHUFFLE (3, 3, 3, 3));
+    ia = _mm_sub_epi16 (full, ia);
+
+    /* x / 255 rounded: (x + 128 + ((x + 128) >> 8)) >> 8 */
+    d = _mm_add_epi16 (_mm_mullo_epi16 (d, ia), bias);
+    return _mm_srli_epi16 (_mm_add_epi16 (d, _mm_srli_epi16 (d, 8)), 8);
+}
+
+static void SSE2_TARGET pargb_to_rgb_sse2 (Uint32* dst, const Uint32* src,
+        int n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i alpha_mask = _mm_set1_epi32 (0xff000000);
+
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        __m128i s = _mm_loadu_si128 ((const __m128i*)src);
+        __m128i d;
+
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (s, zero)) == 0xffff)
+            continue;
+
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (
+                        _mm_and_si128 (s, alpha_mask), alpha_mask)) == 0xffff) {
+            _mm_storeu_si128 ((__m128i*)dst, s);
+            continue;
+        }
+
+        d = _mm_loadu_si128 ((const __m128i*)dst);
+        d = _mm_packus_epi16 (
+                premul_scale_sse2 (_mm_unpacklo_epi8 (s, zero),
+                    _mm_unpacklo_epi8 (d, zero)),
+                premul_scale_sse2 (_mm_unpackhi_epi8 (s, zero),
+                    _mm_unpackhi_epi8 (d, zero)));
+        _mm_storeu_si128 ((__m128i*)dst, _mm_adds_epu8 (s, d));
+    }
+
+    for (; n > 0; n--, src++, dst++) {
+        if (*src)
+            *dst = premul_blend_8888 (*src, *dst);
+    }
+}
+
+static const GAL_AlphaBlitKernels sse2_kernels = {
+    "sse2", argb_to_rgb_sse2, argb_to_565_sse2, pargb_to_rgb_sse2
+};
+#endif  /* defined _MG_HAVE_X86_KERNELS */
+
+#ifdef _MG_HAVE_X86_KERNELS
+static inline __m256i AVX2_TARGET blend_argb_avx2 (__m256i s, __m256i d)
+{
+    const __m256i opaque = _mm256_set1_epi16 (0xff);
+    const __m256i one = _mm256_set1_epi16 (0x100);
+    const __m256i rgb_lanes = _mm256_set1_epi64x (0x0000ffffffffffffLL);
+    const __m256i alpha_lanes = _mm256_set1_epi64x (0x0100000000000000LL);
+    __m256i a, eq, w;
+
+    a = _mm256_shufflelo_epi16 (s, _MM_SHUFFLE (3, 3, 3, 3));
+    a = _mm256_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+
+    eq = _mm256_cmpeq_epi16 (a, opaque);
+    w = _mm256_sub_epi16 (a, eq);
+    w = _mm256_or_si256 (_mm256_and_si256 (w, rgb_lanes),
+            _mm256_and_si256 (eq, alpha_lanes));
+
+    return _mm256_srli_epi16 (_mm256_add_epi16 (_mm256_mullo_epi16 (s, w),
+                _mm256_mullo_epi16 (d, _mm256_sub_epi16 (one, w))), 8);
+}
+
+static void AVX2_TARGET argb_to_rgb_avx2 (Uint32* dst, const Uint32* src,
+        int n)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    const __m256i alpha_mask = _mm256_set1_epi32 (0xff000000);
+
+    for (; n >= 8; n -= 8, src += 8, dst += 8) {
+        __m256i s = _mm256_loadu_si256 ((const __m256i*)src);
+        __m256i d, a;
+
+        a = _mm256_and_si256 (s, alpha_mask);
+        if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (a, zero)) == -1)
+            continue;
+
+        if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (a, alpha_mask)) == -1) {
+            _mm256_storeu_si256 ((__m256i*)dst, s);
+            continue;
+        }
+
+        /* the unpacking and the packing are both within 128-bit lanes */
+        d = _mm256_loadu_si256 ((const __m256i*)dst);
+        d = _mm256_packus_epi16 (
+                blend_argb_avx2 (_mm256_unpacklo_epi8 (s, zero),
+                    _mm256_unpacklo_epi8 (d, zero)),
+                blend_argb_avx2 (_mm256_unpackhi_epi8 (s, zero),
+                    _mm256_unpackhi_epi8 (d, zero)));
+        _mm256_storeu_si256 ((__m256i*)dst, d);
+    }
+
+    for (; n > 0; n--, src++, dst++)
+        *dst = blend_argb_to_rgb (*src, *dst);
+}
+
+static void AVX2_TARGET argb_to_565_avx2 (Uint16* dst, const Uint32* src,
+        int n)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    const __m256i alpha_mask = _mm256_set1_epi32 (0xf8000000);
+    const __m256i mask5 = _mm256_set1_epi32 (0x1f);
+    const __m256i mask6 = _mm256_set1_epi32 (0x3f);
+    const __m256i one = _mm256_set1_epi32 (32);
+
+    for (; n >= 8; n -= 8, src += 8, dst += 8) {
+        __m256i s = _mm256_loadu_si256 ((const __m256i*)src);
+        __m256i d, a, w, iw, r, g, b;
+
+        if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (
+                    _mm256_and_si256 (s, alpha_mask), zero)) == -1)
+            continue;
+
+        d = _mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i*)dst));
+
+        a = _mm256_srli_epi32 (s, 27);
+        w = _mm256_sub_epi32 (a, _mm256_cmpeq_epi32 (a, mask5));
+        iw = _mm256_sub_epi32 (one, w);
+
+        r = _mm256_add_epi16 (_mm256_mullo_epi16 (
+                    _mm256_and_si256 (_mm256_srli_epi32 (s, 19), mask5), w),
+                _mm256_mullo_epi16 (_mm256_srli_epi32 (d, 11), iw));
+        g = _mm256_add_epi16 (_mm256_mullo_epi16 (
+                    _mm256_and_si256 (_mm256_srli_epi32 (s, 10), mask6), w),
+                _mm256_mullo_epi16 (
+                    _mm256_and_si256 (_mm256_srli_epi32 (d, 5), mask6), iw));
+        b = _mm256_add_epi16 (_mm256_mullo_epi16 (
+                    _mm256_and_si256 (_mm256_srli_epi32 (s, 3), mask5), w),
+                _mm256_mullo_epi16 (_mm256_and_si256 (d, mask5), iw));
+
+        r = _mm256_slli_epi32 (_mm256_srli_epi32 (r, 5), 11);
+        g = _mm256_slli_epi32 (_mm256_srli_epi32 (g, 5), 5);
+        b = _mm256_srli_epi32 (b, 5);
+        r = _mm256_or_si256 (r, _mm256_or_si256 (g, b));
+
+        /* pack the low halves of the 32-bit lanes: 0-3 4-7 0-3 4-7 */
+        r = _mm256_packus_epi32 (r, r);
+        r = _mm256_permute4x64_epi64 (r, _MM_SHUFFLE (3, 1, 2, 0));
+        _mm_storeu_si128 ((__m128i*)dst, _mm256_castsi256_si128 (r));
+    }
+
+    for (; n > 0; n--, src++, dst++)
+        *dst = blend_argb_to_565 (*src, *dst);
+}
+
+static inline __m256i AVX2_TARGET premul_scale_avx2 (__m256i s, __m256i d)
+{
+    const __m256i full = _mm256_set1_epi16 (0xff);
+    const __m256i bias = _mm256_set1_epi16 (128);
+    __m256i ia;
+
+    ia = _mm256_shufflelo_epi16 (s, _MM_SHUFFLE (3, 3, 3, 3));
+    ia = _mm256_shufflehi_epi16 (ia, _MM_SHUFFLE (3, 3, 3, 3));
+    ia = _mm256_sub_epi16 (full, ia);
+
+    d = _mm256_add_epi16 (_mm256_mullo_epi16 (d, ia), bias);
+    return _mm256_srli_epi16 (
+            _mm256_add_epi16 (d, _mm256_srli_epi16 (d, 8)), 8);
+}
+
+static void AVX2_TARGET pargb_to_rgb_avx2 (Uint32* dst, const Uint32* src,
+        int n)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    const __m256i alpha_mask = _mm256_set1_epi32 (0xff000000);
+
+    for (; n >= 8; n -= 8, src += 8, dst += 8) {
+        __m256i s = _mm256_loadu_si256 ((const __m256i*)src);
+        __m256i d;
+
+        if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (s, zero)) == -1)
+            continue;
+
+        if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (
+                    _mm256_and_si256 (s, alpha_mask), alpha_mask)) == -1) {
+            _mm256_storeu_si256 ((__m256i*)dst, s);
+            continue;
+        }
+
+        d = _mm256_loadu_si256 ((const __m256i*)dst);
+        d = _mm256_packus_epi16 (
+                premul_scale_avx2 (_mm256_unpacklo_epi8 (s, zero),
+                    _mm256_unpacklo_epi8 (d, zero)),
+                premul_scale_avx2 (_mm256_unpackhi_epi8 (s, zero),
+                    _mm256_unpackhi_epi8 (d, zero)));
+        _mm256_storeu_si256 ((__m256i*)dst, _mm256_adds_epu8 (s, d));
+    }
+
+    for (; n > 0; n--, src++, dst++) {
+        if (*src)
+            *dst = premul_blend_8888 (*src, *dst);
+    }
+}
+
+static const GAL_AlphaBlitKernels avx2_kernels = {
+    "avx2", argb_to_rgb_avx2, argb_to_565_avx2, pargb_to_rgb_avx2
+};
+#endif  /* defined _MG_HAVE_X86_KERNELS */
+
+static const GAL_AlphaBlitKernels* alpha_kernels;
+static BOOL alpha_kernels_selected;
+
+const GAL_AlphaBlitKernels* GAL_GetAlphaBlitKernels (void)
+{
+    /* the selection is idempotent, so a race here is harmless */
+    if (MG_UNLIKELY (!alpha_kernels_selected)) {
+        const GAL_AlphaBlitKernels* kernels = NULL;
+
+#ifdef _MG_HAVE_X86_KERNELS
+        Uint32 features = GAL_GetSIMDFeatures ();
+
+        if (features & GAL_SIMD_AVX2)
+            kernels = &avx2_kernels;
+        else if (features & GAL_SIMD_SSE2)
+            kernels = &sse2_kernels;
+#endif
+
+        alpha_kernels = kernels;
+        alpha_kernels_selected = TRUE;
+    }
+
+    return alpha_kernels;
+}
+
+const char* GAL_GetAlphaBlitKernelsName (void)
+{
+    const GAL_AlphaBlitKernels* kernels = GAL_GetAlphaBlitKernels ();
+
+    return kernels ? kernels->name : "c";
+}
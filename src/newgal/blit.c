@@ -47,8 +47,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "common.h"
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+#   include <pthread.h>
+#endif
 #include "newgal.h"
 #include "sysvideo.h"
 #include "blit.h"
@@ -70,7 +75,8 @@ static int GAL_SoftBlit(GAL_VideoDevice *video,
 
     /* Unencode the destination if it's RLE encoded */
     if ( dst->flags & GAL_RLEACCEL ) {
-        GAL_UnRLESurface(dst, 1);
+        /* the destination is to be changed, so drop its encodings */
+        GAL_UnRLESurface(dst, 0);
         dst->flags |= GAL_RLEACCEL;    /* save accel'd state */
     }
 
@@ -174,12 +180,227 @@ static int GAL_PixmanBlit(GAL_VideoDevice *video,
         struct GAL_Surface *dst, GAL_Rect *dstrect);
 #endif
 
+/*
+ * Since 5.0.16: the cache of the blit selections.
+ *
+ * A blit map is calculated again when the source is blitted to another
+ * destination, and every mapping to a destination bumps its format version,
+ * so the surfaces blitted in turn to the screen redo the selection on
+ * almost every blit. The software selections only depend on the formats,
+ * the modes of the surfaces, and the video devices; they are kept in
+ * a small direct-mapped cache. The selections involving a hardware check
+ * or RLE encoding have side effects on the surface, and are not cached.
+ */
+#define NR_BLIT_CACHE_SLOTS     64
+
+/* one of so many hits runs the full selection to sample its time */
+#define BLIT_CACHE_SAMPLE_PERIOD    256
+
+/* the flags of the source surface which affect the selection */
+#define BLIT_KEY_SRC_FLAGS      (GAL_HWSURFACE | GAL_SRCCOLORKEY | \
+                                 GAL_SRCALPHA | GAL_SRCPIXELALPHA | \
+                                 GAL_PREMULTIPLIED)
+
+typedef struct _BlitCacheKey {
+    const void* src_video;
+    const void* dst_video;
+    Uint32      src_masks[4];
+    Uint32      dst_masks[4];
+    Uint32      src_flags;
+    Uint32      dst_flags;
+    Uint8       src_bpp;
+    Uint8       dst_bpp;
+    Uint8       blit_index;
+    Uint8       identity;
+    Uint8       has_table;
+    Uint8       overlap;
+    Uint8       pixman;
+    Uint8       pad;
+} BlitCacheKey;
+
+typedef struct _BlitCacheSlot {
+    BlitCacheKey    key;
+    BOOL            used;
+    GAL_loblit      blit;
+    void*           aux_data;
+    GAL_blit        sw_blit;
+} BlitCacheSlot;
+
+static struct {
+    BlitCacheSlot   slots[NR_BLIT_CACHE_SLOTS];
+    int             nr_used;
+    unsigned long   nr_hits;
+    unsigned long   nr_misses;
+    unsigned long   nr_bypasses;
+    unsigned long   nr_flushes;
+    unsigned long   nr_samples;
+    Uint64          miss_nsecs;
+    Uint64          sample_nsecs;
+} blit_cache;
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+static pthread_mutex_t blit_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define LOCK_BLIT_CACHE()    pthread_mutex_lock(&blit_cache_lock)
+#   define UNLOCK_BLIT_CACHE()  pthread_mutex_unlock(&blit_cache_lock)
+#else
+#   define LOCK_BLIT_CACHE()
+#   define UNLOCK_BLIT_CACHE()
+#endif
+
+static void make_blit_key (const GAL_Surface *surface, int blit_index,
+        BlitCacheKey *key)
+{
+    const GAL_Surface *dst = surface->map->dst;
+    const GAL_PixelFormat *sf = surface->format;
+    const GAL_PixelFormat *df = dst->format;
+
+    /* clear the paddings for the comparison by memcmp */
+    memset (key, 0, sizeof (*key));
+
+    key->src_video = surface->video;
+    key->dst_video = dst->video;
+    key->src_masks[0] = sf->Rmask;
+    key->src_masks[1] = sf->Gmask;
+    key->src_masks[2] = sf->Bmask;
+    key->src_masks[3] = sf->Amask;
+    key->dst_masks[0] = df->Rmask;
+    key->dst_masks[1] = df->Gmask;
+    key->dst_masks[2] = df->Bmask;
+    key->dst_masks[3] = df->Amask;
+    key->src_flags = surface->flags & BLIT_KEY_SRC_FLAGS;
+    key->dst_flags = dst->flags & GAL_HWSURFACE;
+    key->src_bpp = sf->BitsPerPixel;
+    key->dst_bpp = df->BitsPerPixel;
+    key->blit_index = (Uint8)blit_index;
+    key->identity = (Uint8)surface->map->identity;
+    key->has_table = (surface->map->table != NULL);
+    key->overlap = (surface == dst);
+#ifdef _MGUSE_PIXMAN
+    key->pixman = (surface->pix_img != NULL) | ((dst->pix_img != NULL) << 1);
+#endif
+}
+
+static unsigned int hash_blit_key (const BlitCacheKey *key)
+{
+    const Uint8 *p = (const Uint8 *)key;
+    unsigned int h = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < sizeof (*key); i++) {
+        h ^= p[i];
+        h *= 16777619U;
+    }
+
+    return (h ^ (h >> 16)) & (NR_BLIT_CACHE_SLOTS - 1);
+}
+
+static BOOL lookup_blit_cache (const BlitCacheKey *key, GAL_BlitMap *map,
+        BOOL *sample)
+{
+    BlitCacheSlot *slot = blit_cache.slots + hash_blit_key (key);
+    BOOL found = FALSE;
+
+    *sample = FALSE;
+    LOCK_BLIT_CACHE ();
+    if (slot->used && memcmp (&slot->key, key, sizeof (*key)) == 0) {
+        /* the time of the cold misses is not that of a warm selection */
+        if ((blit_cache.nr_samples + 1) * BLIT_CACHE_SAMPLE_PERIOD <=
+                blit_cache.nr_hits + 1) {
+            *sample = TRUE;
+            goto done;
+        }
+
+        map->sw_data->blit = slot->blit;
+        map->sw_data->aux_data = slot->aux_data;
+        map->sw_blit = slot->sw_blit;
+        blit_cache.nr_hits++;
+        found = TRUE;
+    }
+
+done:
+    UNLOCK_BLIT_CACHE ();
+    return found;
+}
+
+static inline Uint64 get_blit_nsecs (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (Uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void store_blit_cache (const BlitCacheKey *key, const GAL_BlitMap *map,
+        BOOL sample, Uint64 nsecs)
+{
+    BlitCacheSlot *slot = blit_cache.slots + hash_blit_key (key);
+
+    LOCK_BLIT_CACHE ();
+    if (!slot->used) {
+        slot->used = TRUE;
+        blit_cache.nr_used++;
+    }
+    slot->key = *key;
+    slot->blit = map->sw_data->blit;
+    slot->aux_data = map->sw_data->aux_data;
+    slot->sw_blit = map->sw_blit;
+    if (sample) {
+        blit_cache.nr_samples++;
+        blit_cache.sample_nsecs += nsecs;
+    }
+    else {
+        blit_cache.nr_misses++;
+        blit_cache.miss_nsecs += nsecs;
+    }
+    UNLOCK_BLIT_CACHE ();
+}
+
+void GAL_FlushBlitCache (void)
+{
+    int i;
+
+    LOCK_BLIT_CACHE ();
+    if (blit_cache.nr_used > 0) {
+        for (i = 0; i < NR_BLIT_CACHE_SLOTS; i++)
+            blit_cache.slots[i].used = FALSE;
+        blit_cache.nr_used = 0;
+        blit_cache.nr_flushes++;
+    }
+    UNLOCK_BLIT_CACHE ();
+}
+
+BOOL GUIAPI GetBlitCacheStats (BLITCACHESTATS* stats)
+{
+    if (stats == NULL)
+        return FALSE;
+
+    LOCK_BLIT_CACHE ();
+    stats->nr_slots = NR_BLIT_CACHE_SLOTS;
+    stats->nr_used = blit_cache.nr_used;
+    stats->nr_hits = blit_cache.nr_hits;
+    stats->nr_misses = blit_cache.nr_misses;
+    stats->nr_bypasses = blit_cache.nr_bypasses;
+    stats->nr_flushes = blit_cache.nr_flushes;
+    stats->nr_samples = blit_cache.nr_samples;
+    stats->miss_nsecs = blit_cache.miss_nsecs;
+    stats->sample_nsecs = blit_cache.sample_nsecs;
+    stats->saved_nsecs = 0;
+    if (blit_cache.nr_samples > 0)
+        stats->saved_nsecs = blit_cache.sample_nsecs * blit_cache.nr_hits /
+            blit_cache.nr_samples;
+    UNLOCK_BLIT_CACHE ();
+    return TRUE;
+}
+
 /* Figure out which of many blit routines to set up on a surface */
 int GAL_CalculateBlit(GAL_Surface *surface, const GAL_Rect *srcrc,
         const GAL_Rect *dstrc, DWORD op)
 {
     int blit_index;
     GAL_VideoDevice *src_video, *dst_video, *cur_video = NULL;
+    BlitCacheKey key;
+    BOOL cacheable, sample = FALSE;
+    Uint64 nsecs = 0;
 
     src_video = (GAL_VideoDevice *) surface->video;
     dst_video = (GAL_VideoDevice *) surface->map->dst->video;
@@ -189,9 +410,29 @@ int GAL_CalculateBlit(GAL_Surface *surface, const GAL_Rect *srcrc,
         GAL_UnRLESurface(surface, 1);
     }
     surface->map->sw_blit = NULL;
+    surface->flags &= ~GAL_HWACCEL;
+
+    /* Get the blit function index, based on surface mode */
+    /* { 0 = nothing, 1 = colorkey, 2 = alpha, 3 = colorkey+alpha } */
+    blit_index = 0;
+    blit_index |= (!!(surface->flags & GAL_SRCCOLORKEY)) << 0;
+    if (((surface->flags & GAL_SRCALPHA) && surface->format->alpha != GAL_ALPHA_OPAQUE)
+         ||((surface->flags & GAL_SRCPIXELALPHA) && surface->format->Amask)) {
+        if(surface != surface->map->dst){
+            blit_index |= 2;
+        }
+    }
+
+    /* Try the cached selection; RLE encoding is done for each surface */
+    cacheable = !(surface->flags & GAL_RLEACCELOK);
+    if (cacheable) {
+        make_blit_key(surface, blit_index, &key);
+        if (lookup_blit_cache(&key, surface->map, &sample))
+            return(0);
+        nsecs = get_blit_nsecs();
+    }
 
     /* Figure out if an accelerated hardware blit is possible */
-    surface->flags &= ~GAL_HWACCEL;
     if ( surface->map->identity ) {
         int hw_blit_ok;
 
@@ -249,17 +490,8 @@ int GAL_CalculateBlit(GAL_Surface *surface, const GAL_Rect *srcrc,
             GAL_VideoDevice *this  = cur_video;
             video->CheckHWBlit (this, surface, srcrc,
                     surface->map->dst, dstrc, op);
-        }
-    }
-
-    /* Get the blit function index, based on surface mode */
-    /* { 0 = nothing, 1 = colorkey, 2 = alpha, 3 = colorkey+alpha } */
-    blit_index = 0;
-    blit_index |= (!!(surface->flags & GAL_SRCCOLORKEY)) << 0;
-    if (((surface->flags & GAL_SRCALPHA) && surface->format->alpha != GAL_ALPHA_OPAQUE)
-         ||((surface->flags & GAL_SRCPIXELALPHA) && surface->format->Amask)) {
-        if(surface != surface->map->dst){
-            blit_index |= 2;
+            /* the check depends on the surfaces and the rectangles */
+            cacheable = FALSE;
         }
     }
 
@@ -308,7 +540,9 @@ int GAL_CalculateBlit(GAL_Surface *surface, const GAL_Rect *srcrc,
                || (blit_index == 3 && !surface->format->Amask))) {
                 if ( GAL_RLESurface(surface) == 0 )
                     surface->map->sw_blit = GAL_RLEBlit;
-        } else if(blit_index == 2 && surface->format->Amask) {
+        } else if(blit_index == 2 && surface->format->Amask
+                && !(surface->flags & GAL_PREMULTIPLIED)) {
+                /* the RLE alpha blits take straight alpha */
                 if ( GAL_RLESurface(surface) == 0 )
                     surface->map->sw_blit = GAL_RLEAlphaBlit;
         }
@@ -331,9 +565,81 @@ int GAL_CalculateBlit(GAL_Surface *surface, const GAL_Rect *srcrc,
         surface->map->sw_blit = GAL_SoftBlit;
 #endif
     }
+
+    if (cacheable) {
+        store_blit_cache(&key, surface->map, sample,
+                get_blit_nsecs() - nsecs);
+    }
+    else {
+        LOCK_BLIT_CACHE();
+        blit_cache.nr_bypasses++;
+        UNLOCK_BLIT_CACHE();
+    }
     return(0);
 }
 
+/* Since 5.0.16 */
+int GAL_PrepareSoftBlit (GAL_Surface* src, GAL_Surface* dst, DWORD op,
+        GAL_PreparedBlit* pb)
+{
+    if ((src->flags & GAL_RLEACCEL) || (dst->flags & GAL_RLEACCEL))
+        return -1;
+
+    /* Check to make sure the blit mapping is valid */
+    if ((src->map->dst != dst) ||
+             (src->map->dst->format_version != src->map->format_version)) {
+        GAL_Rect srcrc = { 0, 0, src->w, src->h };
+        GAL_Rect dstrc = { 0, 0, dst->w, dst->h };
+
+        if (GAL_MapSurface (src, &srcrc, dst, &dstrc, op) < 0) {
+            return -1;
+        }
+    }
+
+    if ((src->flags & GAL_HWACCEL) == GAL_HWACCEL ||
+            src->map->sw_blit != GAL_SoftBlit ||
+            src->map->sw_data->blit == NULL)
+        return -1;
+
+    pb->src = src;
+    pb->dst = dst;
+    pb->blit = src->map->sw_data->blit;
+    pb->aux_data = src->map->sw_data->aux_data;
+    pb->table = src->map->table;
+    return 0;
+}
+
+void GAL_RunSoftBlit (const GAL_PreparedBlit* pb,
+        const GAL_Rect* srcrect, const GAL_Rect* dstrect)
+{
+    GAL_Surface* src = pb->src;
+    GAL_Surface* dst = pb->dst;
+    GAL_BlitInfo info;
+
+    if (srcrect->w <= 0 || srcrect->h <= 0)
+        return;
+
+    /* the same as GAL_SoftBlit, but without the blit map */
+    info.s_pixels = (Uint8 *)src->pixels +
+            (Uint16)srcrect->y*src->pitch +
+            (Uint16)srcrect->x*src->format->BytesPerPixel;
+    info.s_width = srcrect->w;
+    info.s_height = srcrect->h;
+    info.s_skip = src->pitch - info.s_width*src->format->BytesPerPixel;
+    info.d_pixels = (Uint8 *)dst->pixels +
+            (Uint16)dstrect->y*dst->pitch +
+            (Uint16)dstrect->x*dst->format->BytesPerPixel;
+    info.d_width = dstrect->w;
+    info.d_height = dstrect->h;
+    info.d_skip = dst->pitch - info.d_width*dst->format->BytesPerPixel;
+    info.aux_data = pb->aux_data;
+    info.src = src->format;
+    info.table = pb->table;
+    info.dst = dst->format;
+
+    ((GAL_loblit)pb->blit) (&info);
+}
+
 #ifdef _MGUSE_PIXMAN
 
 int GAL_SetupBlitting (GAL_Surface *src, GAL_Surface *dst, DWORD ops)
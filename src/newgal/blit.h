@@ -72,6 +72,8 @@ typedef void (*GAL_loblit)(GAL_BlitInfo *info);
 struct private_swaccel {
     GAL_loblit blit;
     void *aux_data;
+    /* Since 5.0.16: the RLE encodings kept for the surface */
+    void *rle_encodings;
 };
 
 /* Blit mapping definition */
@@ -100,6 +102,8 @@ typedef struct GAL_BlitMap {
 /* Functions found in GAL_blit.c */
 extern int GAL_CalculateBlit(GAL_Surface *surface, const GAL_Rect *srcrc,
         const GAL_Rect *dstrc, DWORD op);
+/* Since 5.0.16: flush the cache of the blit selections */
+extern void GAL_FlushBlitCache(void);
 
 /* Functions found in GAL_blit_{0,1,N,A}.c */
 extern GAL_loblit GAL_CalculateBlit0(GAL_Surface *surface, int complex);
@@ -107,6 +111,23 @@ extern GAL_loblit GAL_CalculateBlit1(GAL_Surface *surface, int complex);
 extern GAL_loblit GAL_CalculateBlitN(GAL_Surface *surface, int complex);
 extern GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int complex);
 
+/* The kernels blending a line of ARGB8888 pixels with pixel alpha */
+typedef struct _GAL_AlphaBlitKernels {
+    const char *name;
+
+    /* ARGB8888->(A)RGB8888 with the same RGB masks */
+    void (*argb_to_rgb)(Uint32 *dst, const Uint32 *src, int n);
+
+    /* ARGB8888->RGB565, or ABGR8888->BGR565 */
+    void (*argb_to_565)(Uint16 *dst, const Uint32 *src, int n);
+
+    /* premultiplied ARGB8888->(A)RGB8888 with the same RGB masks */
+    void (*pargb_to_rgb)(Uint32 *dst, const Uint32 *src, int n);
+} GAL_AlphaBlitKernels;
+
+/* Functions found in alpha-kernels.c; returns NULL if no SIMD kernels */
+extern const GAL_AlphaBlitKernels *GAL_GetAlphaBlitKernels(void);
+
 /*
  * Useful macros for blitting routines
  */
@@ -437,6 +458,47 @@ do {                                                            \
     dB = (((sB-dB)*(A))>>8)+dB;                                 \
 } while(0)
 
+/* x / 255 rounded, for 0 <= x <= 255 * 255 */
+#define DIV255(x)   ((((x) + 128) + (((x) + 128) >> 8)) >> 8)
+
+/* Blend premultiplied colors with one multiply per channel:
+   d = s + d * (255 - A) / 255, for the alpha channel as well */
+#define PREMUL_ALPHA_BLEND(sR, sG, sB, sA, dR, dG, dB, dA)      \
+do {                                                            \
+    unsigned ia = 255 - (sA);                                   \
+    dR = (sR) + DIV255(dR * ia);                                \
+    dG = (sG) + DIV255(dG * ia);                                \
+    dB = (sB) + DIV255(dB * ia);                                \
+    dA = (sA) + DIV255(dA * ia);                                \
+    if (dR > 255) dR = 255;                                     \
+    if (dG > 255) dG = 255;                                     \
+    if (dB > 255) dB = 255;                                     \
+    if (dA > 255) dA = 255;                                     \
+} while(0)
+
+/* Blend a premultiplied ARGB8888 pixel onto an (A)RGB8888 pixel, two
+   channels at a time; the sums are saturated for invalid pixels of
+   which a color channel is greater than the alpha */
+static inline Uint32 premul_blend_8888(Uint32 s, Uint32 d)
+{
+    Uint32 ia = 255 - (s >> 24);
+    Uint32 rb, ag, o;
+
+    rb = (d & 0xff00ff) * ia + 0x800080;
+    rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+    rb += s & 0xff00ff;
+    o = rb & 0x1000100;
+    rb = (rb | (o - (o >> 8))) & 0xff00ff;
+
+    ag = ((d >> 8) & 0xff00ff) * ia + 0x800080;
+    ag = ((ag + ((ag >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+    ag += (s >> 8) & 0xff00ff;
+    o = ag & 0x1000100;
+    ag = (ag | (o - (o >> 8))) & 0xff00ff;
+
+    return rb | (ag << 8);
+}
+
 /* This is a very useful loop for optimizing blitters */
 #define USE_DUFFS_LOOP
 #ifdef USE_DUFFS_LOOP
@@ -506,6 +506,87 @@ static void Blit555to555SurfaceAlpha(GAL_BlitInfo *info)
         }
 }
 
+/* ARGB888->(A)RGB888 blending with pixel alpha by the SIMD kernels */
+static void BlitRGBtoRGBPixelAlphaSIMD(GAL_BlitInfo *info)
+{
+        const GAL_AlphaBlitKernels *kernels = GAL_GetAlphaBlitKernels();
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *srcp = info->s_pixels;
+        int srcpitch = (width << 2) + info->s_skip;
+        Uint8 *dstp = info->d_pixels;
+        int dstpitch = (width << 2) + info->d_skip;
+
+        while(height--) {
+            kernels->argb_to_rgb((Uint32 *)dstp, (const Uint32 *)srcp, width);
+            srcp += srcpitch;
+            dstp += dstpitch;
+        }
+}
+
+/* premultiplied ARGB8888->(A)RGB8888 blending with pixel alpha */
+static void BlitPARGBtoRGBPixelAlpha(GAL_BlitInfo *info)
+{
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint32 *srcp = (Uint32 *)info->s_pixels;
+        int srcskip = info->s_skip >> 2;
+        Uint32 *dstp = (Uint32 *)info->d_pixels;
+        int dstskip = info->d_skip >> 2;
+
+        while(height--) {
+            DUFFS_LOOP4({
+                Uint32 s = *srcp;
+                Uint32 alpha = s >> 24;
+                if (alpha == GAL_ALPHA_OPAQUE) {
+                    *dstp = s;
+                } else if (s) {
+                    *dstp = premul_blend_8888(s, *dstp);
+                }
+                ++srcp;
+                ++dstp;
+            }, width);
+            srcp += srcskip;
+            dstp += dstskip;
+        }
+}
+
+/* premultiplied ARGB8888->(A)RGB8888 blending by the SIMD kernels */
+static void BlitPARGBtoRGBPixelAlphaSIMD(GAL_BlitInfo *info)
+{
+        const GAL_AlphaBlitKernels *kernels = GAL_GetAlphaBlitKernels();
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *srcp = info->s_pixels;
+        int srcpitch = (width << 2) + info->s_skip;
+        Uint8 *dstp = info->d_pixels;
+        int dstpitch = (width << 2) + info->d_skip;
+
+        while(height--) {
+            kernels->pargb_to_rgb((Uint32 *)dstp, (const Uint32 *)srcp, width);
+            srcp += srcpitch;
+            dstp += dstpitch;
+        }
+}
+
+/* ARGB8888->RGB565 blending with pixel alpha by the SIMD kernels */
+static void BlitARGBto565PixelAlphaSIMD(GAL_BlitInfo *info)
+{
+        const GAL_AlphaBlitKernels *kernels = GAL_GetAlphaBlitKernels();
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *srcp = info->s_pixels;
+        int srcpitch = (width << 2) + info->s_skip;
+        Uint8 *dstp = info->d_pixels;
+        int dstpitch = (width << 1) + info->d_skip;
+
+        while(height--) {
+            kernels->argb_to_565((Uint16 *)dstp, (const Uint32 *)srcp, width);
+            srcp += srcpitch;
+            dstp += dstpitch;
+        }
+}
+
 /* fast ARGB8888->RGB565 blending with pixel alpha */
 static void BlitARGBto565PixelAlpha(GAL_BlitInfo *info)
 {
@@ -750,6 +831,48 @@ static void BlitNtoNPixelAlpha(GAL_BlitInfo *info)
         }
 }
 
+/* General N->N blending with premultiplied pixel alpha */
+static void BlitNtoNPixelAlphaPremul(GAL_BlitInfo *info)
+{
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *src = info->s_pixels;
+        int srcskip = info->s_skip;
+        Uint8 *dst = info->d_pixels;
+        int dstskip = info->d_skip;
+        GAL_PixelFormat *srcfmt = info->src;
+        GAL_PixelFormat *dstfmt = info->dst;
+        int srcbpp = srcfmt->BytesPerPixel;
+        int dstbpp = dstfmt->BytesPerPixel;
+
+        /* the destination alpha is blended in the same way, so the
+           result stays premultiplied; no branch for opaque pixels */
+        while ( height-- ) {
+                DUFFS_LOOP4(
+                {
+                Uint32 pixel;
+                unsigned sR;
+                unsigned sG;
+                unsigned sB;
+                unsigned sA;
+                unsigned dR;
+                unsigned dG;
+                unsigned dB;
+                unsigned dA;
+                DISEMBLE_RGBA(src, srcbpp, srcfmt, pixel, sR, sG, sB, sA);
+                if (sA | sR | sG | sB) {
+                    DISEMBLE_RGBA(dst, dstbpp, dstfmt, pixel, dR, dG, dB, dA);
+                    PREMUL_ALPHA_BLEND(sR, sG, sB, sA, dR, dG, dB, dA);
+                    ASSEMBLE_RGBA(dst, dstbpp, dstfmt, dR, dG, dB, dA);
+                }
+                src += srcbpp;
+                dst += dstbpp;
+                },
+                width);
+                src += srcskip;
+                dst += dstskip;
+        }
+}
 
 GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
 {
@@ -808,6 +931,19 @@ GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
                 return BlitNtoNSurfaceAlpha;
         }
 
+        /* Per-pixel alpha blits of premultiplied pixels */
+        if (surface->flags & GAL_PREMULTIPLIED) {
+            if(df->BytesPerPixel == 4 && sf->BytesPerPixel == 4
+               && sf->Amask == 0xff000000
+               && sf->Rmask == df->Rmask
+               && sf->Gmask == df->Gmask
+               && sf->Bmask == df->Bmask)
+                return GAL_GetAlphaBlitKernels() ?
+                    BlitPARGBtoRGBPixelAlphaSIMD : BlitPARGBtoRGBPixelAlpha;
+            if(df->BytesPerPixel > 1)
+                return BlitNtoNPixelAlphaPremul;
+        }
+
         /* Per-pixel alpha blits */
         switch(df->BytesPerPixel) {
         case 1:
@@ -819,7 +955,8 @@ GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
                && ((sf->Rmask == 0xff && df->Rmask == 0x1f)
                    || (sf->Bmask == 0xff && df->Bmask == 0x1f))) {
                 if(df->Gmask == 0x7e0)
-                    return BlitARGBto565PixelAlpha;
+                    return GAL_GetAlphaBlitKernels() ?
+                        BlitARGBto565PixelAlphaSIMD : BlitARGBto565PixelAlpha;
                 else if(df->Gmask == 0x3e0 && df->Amask != 0x8000)
                     return BlitARGBto555PixelAlpha;
             }
@@ -831,7 +968,8 @@ GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
                && sf->Gmask == df->Gmask
                && sf->Bmask == df->Bmask
                && sf->BytesPerPixel == 4)
-                return BlitRGBtoRGBPixelAlpha;
+                return GAL_GetAlphaBlitKernels() ?
+                    BlitRGBtoRGBPixelAlphaSIMD : BlitRGBtoRGBPixelAlpha;
             return BlitNtoNPixelAlpha;
 
         case 3:
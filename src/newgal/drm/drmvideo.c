@@ -62,6 +62,9 @@
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
+#ifdef _MGGAL_DRM_PAGE_FLIP
+#include <poll.h>
+#endif
 #include <drm/drm.h>
 #include <drm/drm_fourcc.h>
 #include <xf86drm.h>
@@ -837,6 +840,11 @@ static DrmSurfaceBuffer *drm_create_dumb_buffer(DrmVideoData* vdata,
 
 static void drm_destroy_dumb_buffer(DrmVideoData* vdata,
         DrmSurfaceBuffer *surface_buffer);
+
+#ifdef _MGGAL_DRM_PAGE_FLIP
+static void drm_free_flip_buffers(DrmVideoData* vdata);
+#endif
+
 /*
  * The following helpers derived from DRM HOWTO by David Herrmann.
  *
@@ -909,6 +917,10 @@ static void drm_cleanup(DrmVideoData* vdata)
     }
 #endif  /* _MGSCHEMA_COMPOSITING */
 
+#ifdef _MGGAL_DRM_PAGE_FLIP
+    drm_free_flip_buffers(vdata);
+#endif
+
     if (vdata->scanout_buff_id) {
         /* remove frame buffer */
         drmModeRmFB(vdata->dev_fd, vdata->scanout_buff_id);
@@ -1287,6 +1299,34 @@ static GAL_VideoDevice *DRM_CreateDevice(int devindex)
             device->hidden->min_pixels_using_hwaccl = 4096;
         }
 
+        if (GetMgEtcIntValue("drm", "flip_buffers",
+                    &device->hidden->nr_flip_buffs) < 0) {
+            device->hidden->nr_flip_buffs = 0;
+        }
+        else if (device->hidden->nr_flip_buffs < 2) {
+            device->hidden->nr_flip_buffs = 0;
+        }
+        else if (device->hidden->nr_flip_buffs > DRM_MAX_FLIP_BUFFERS) {
+            device->hidden->nr_flip_buffs = DRM_MAX_FLIP_BUFFERS;
+        }
+
+#ifndef _MGGAL_DRM_PAGE_FLIP
+        if (device->hidden->nr_flip_buffs) {
+            _WRN_PRINTF("Page flipping is not enabled; "
+                    "configure MiniGUI with --enable-drmpageflip\n");
+            device->hidden->nr_flip_buffs = 0;
+        }
+#endif
+
+#if IS_SHAREDFB_SCHEMA_PROCS
+        /* the clients update the real screen directly */
+        if (device->hidden->nr_flip_buffs) {
+            _WRN_PRINTF("Page flipping is not supported by "
+                    "the shared frame buffer schema\n");
+            device->hidden->nr_flip_buffs = 0;
+        }
+#endif
+
 #if IS_COMPOSITING_SCHEMA
         device->hidden->dbl_buff = 1;
 #else
@@ -1756,11 +1796,17 @@ static int DRM_Resume(_THIS)
     _DBG_PRINTF ("%s called\n", __FUNCTION__);
 
     if (vdata->saved_info) {
+        uint32_t fb_id = vdata->scanout_buff_id;
+#ifdef _MGGAL_DRM_PAGE_FLIP
+        if (vdata->nr_flip_buffs)
+            fb_id = vdata->flip_buffs[vdata->front_buff_idx].fb_id;
+#endif
+
         vdata->saved_crtc = drmModeGetCrtc(vdata->dev_fd,
                 vdata->saved_info->crtc);
         ret = drmModeSetCrtc(vdata->dev_fd,
                 vdata->saved_info->crtc,
-                vdata->scanout_buff_id, 0, 0,
+                fb_id, 0, 0,
                 &vdata->saved_info->conn, 1,
                 &vdata->saved_info->mode);
     }
@@ -1869,9 +1915,10 @@ done:
 }
 
 
-static int drm_setup_scanout_buffer (DrmVideoData* vdata,
+static int drm_add_frame_buffer (DrmVideoData* vdata,
         uint32_t handle, uint32_t drm_format,
-        uint32_t width, uint32_t height, uint32_t pitch, uint32_t offset)
+        uint32_t width, uint32_t height, uint32_t pitch, uint32_t offset,
+        uint32_t *fb_id)
 {
     uint32_t handles[4], pitches[4], offsets[4];
     int ret;
@@ -1881,11 +1928,25 @@ static int drm_setup_scanout_buffer (DrmVideoData* vdata,
     offsets[0] = offset;
 
     ret = drmModeAddFB2(vdata->dev_fd, width, height, drm_format,
-            handles, pitches, offsets, &vdata->scanout_buff_id, 0);
+            handles, pitches, offsets, fb_id, 0);
     if (ret) {
         _DBG_PRINTF ("drmModeAddFB2 failed: "
                 "handle(%u), pitch(%u), offset(%u), w(%u), h(%u), f(%x): %m\n",
                 handle, pitch, offset, width, height, drm_format);
+    }
+
+    return ret;
+}
+
+static int drm_setup_scanout_buffer (DrmVideoData* vdata,
+        uint32_t handle, uint32_t drm_format,
+        uint32_t width, uint32_t height, uint32_t pitch, uint32_t offset)
+{
+    int ret;
+
+    ret = drm_add_frame_buffer(vdata, handle, drm_format,
+            width, height, pitch, offset, &vdata->scanout_buff_id);
+    if (ret) {
         return ret;
     }
 
@@ -2393,10 +2454,11 @@ static double get_elapsed_seconds(const struct timespec *ts_from,
 }
 #endif
 
-static void update_real_screen_memcpy(_THIS, const GAL_Rect *dirty_rect)
+static void update_real_screen_memcpy(_THIS, GAL_Surface *real_screen,
+        const GAL_Rect *dirty_rect)
 {
     DrmSurfaceBuffer *real_buff, *shadow_buff;
-    real_buff = (DrmSurfaceBuffer *)this->hidden->real_screen->hwdata;
+    real_buff = (DrmSurfaceBuffer *)real_screen->hwdata;
     shadow_buff = (DrmSurfaceBuffer *)this->hidden->shadow_screen->hwdata;
 
     uint32_t i;
@@ -2478,7 +2540,8 @@ static inline int boxtop (_THIS)
     return this->hidden->csr_y - this->hidden->hot_y;
 }
 
-static void refresh_cursor(_THIS, const GAL_Rect *dirty_rect)
+static void refresh_cursor(_THIS, GAL_Surface *real_screen,
+        const GAL_Rect *dirty_rect)
 {
     if (this->hidden->cursor && this->hidden->cursor->pixels &&
             !this->hidden->cursor_buff) {
@@ -2502,28 +2565,30 @@ static void refresh_cursor(_THIS, const GAL_Rect *dirty_rect)
             dst_rect.y = eff_rc.top;
             dst_rect.w = src_rect.w;
             dst_rect.h = src_rect.h;
-            GAL_SetupBlitting(this->hidden->cursor,
-                    this->hidden->real_screen, 0);
+            GAL_SetupBlitting(this->hidden->cursor, real_screen, 0);
             GAL_BlitSurface(this->hidden->cursor, &src_rect,
-                    this->hidden->real_screen, &dst_rect);
-            GAL_CleanupBlitting(this->hidden->cursor,
-                    this->hidden->real_screen);
+                    real_screen, &dst_rect);
+            GAL_CleanupBlitting(this->hidden->cursor, real_screen);
         }
     }
 }
 #else
-static inline void refresh_cursor(_THIS, const GAL_Rect *dirty_rect) {
+static inline void refresh_cursor(_THIS, GAL_Surface *real_screen,
+        const GAL_Rect *dirty_rect) {
     (void)this;
+    (void)real_screen;
     (void)dirty_rect;
 }
 #endif  /* _MGSCHEMA_COMPOSITING */
 
-static void update_real_screen_helper(_THIS, const GAL_Rect *dirty_rect)
+/* Returns the number of bytes copied to the real screen. */
+static size_t update_real_screen_helper(_THIS, GAL_Surface *real_screen,
+        const GAL_Rect *dirty_rect)
 {
     DrmVideoData* vdata = this->hidden;
     DrmSurfaceBuffer *real_buff, *shadow_buff;
 
-    real_buff = (DrmSurfaceBuffer *)vdata->real_screen->hwdata;
+    real_buff = (DrmSurfaceBuffer *)real_screen->hwdata;
     shadow_buff = (DrmSurfaceBuffer *)vdata->shadow_screen->hwdata;
 
 #if 0 // def _DEBUG
@@ -2547,15 +2612,17 @@ static void update_real_screen_helper(_THIS, const GAL_Rect *dirty_rect)
     }
 
     if (!hw_ok) {
-        update_real_screen_memcpy(this, dirty_rect);
+        update_real_screen_memcpy(this, real_screen, dirty_rect);
     }
 
-    refresh_cursor(this, dirty_rect);
+    refresh_cursor(this, real_screen, dirty_rect);
 
 #if 0 // def _DEBUG
     double elapsed = get_elapsed_seconds(&ts_start, NULL);
     _MG_PRINTF("Cosumed time to update real screen: %f (seconds)\n", elapsed);
 #endif
+
+    return (size_t)real_buff->cpp * dirty_rect->w * dirty_rect->h;
 }
 
 #define retry_syscall_for_eintr(expression)             \
@@ -2565,6 +2632,231 @@ static void update_real_screen_helper(_THIS, const GAL_Rect *dirty_rect)
         while (__result == -1L && errno == EINTR);      \
         __result; }))
 
+static void merge_dirty_rects(GAL_DirtyRects *dst, const GAL_DirtyRects *src)
+{
+    int i;
+
+    for (i = 0; i < src->nr_rcs; i++) {
+        GAL_AddToDirtyRects(dst, src->rcs + i);
+    }
+}
+
+/* Copies the dirty rectangles from the shadow screen to a real screen. */
+static size_t update_rects_to_screen(_THIS, GAL_Surface *real_screen,
+        const GAL_DirtyRects *dirty_rcs)
+{
+    size_t bytes = 0;
+    int i;
+
+    for (i = 0; i < dirty_rcs->nr_rcs; i++) {
+        const RECT *rc = dirty_rcs->rcs + i;
+        GAL_Rect dirty_rect = { rc->left, rc->top, RECTWP(rc), RECTHP(rc) };
+        bytes += update_real_screen_helper(this, real_screen, &dirty_rect);
+    }
+
+    return bytes;
+}
+
+/* Flushes the dirty rectangles; fb_id is zero for a flipped buffer. */
+static void flush_dirty_rects(_THIS, GAL_Surface *real_screen, uint32_t fb_id,
+        const GAL_DirtyRects *dirty_rcs)
+{
+    DrmVideoData* vdata = this->hidden;
+    int i;
+
+    if (vdata->driver && vdata->driver_ops->flush) {
+        DrmSurfaceBuffer *real_buff;
+        real_buff = (DrmSurfaceBuffer *)real_screen->hwdata;
+        for (i = 0; i < dirty_rcs->nr_rcs; i++) {
+            const RECT *rc = dirty_rcs->rcs + i;
+            GAL_Rect dirty_rect = {
+                rc->left, rc->top, RECTWP(rc), RECTHP(rc) };
+            vdata->driver_ops->flush(vdata->driver, real_buff, &dirty_rect);
+        }
+    }
+    else if (vdata->dirty_fb_ok && fb_id) {
+        drmModeClip clips[NR_DIRTY_RECTS];
+        for (i = 0; i < dirty_rcs->nr_rcs; i++) {
+            clips[i].x1 = dirty_rcs->rcs[i].left;
+            clips[i].y1 = dirty_rcs->rcs[i].top;
+            clips[i].x2 = dirty_rcs->rcs[i].right;
+            clips[i].y2 = dirty_rcs->rcs[i].bottom;
+        }
+        drmModeDirtyFB(vdata->dev_fd, fb_id, clips, dirty_rcs->nr_rcs);
+    }
+}
+
+static void account_frame(_THIS, int nr_rects, size_t bytes)
+{
+    DrmFrameStats *stats = &this->hidden->frame_stats;
+
+    GAL_AccountUpdate(this, nr_rects, bytes);
+
+    stats->nr_frames++;
+    stats->bytes_copied += bytes;
+    stats->last_frame_bytes = (uint32_t)bytes;
+    if (stats->last_frame_bytes > stats->max_frame_bytes)
+        stats->max_frame_bytes = stats->last_frame_bytes;
+}
+
+static void account_vblank(DrmVideoData* vdata, uint32_t from, uint32_t seq)
+{
+    if (from && seq > from + 1)
+        vdata->frame_stats.nr_missed_vblanks += seq - from - 1;
+    vdata->last_vbl_seq = seq;
+}
+
+#ifdef _MGGAL_DRM_PAGE_FLIP
+static uint32_t get_vblank_sequence(DrmVideoData* vdata)
+{
+    drmVBlank vbl;
+
+    if (vdata->crtc_idx < 0)
+        return 0;
+
+    memset(&vbl, 0, sizeof(vbl));
+    vbl.request.type = DRM_VBLANK_RELATIVE;
+    if (vdata->cap_vblank_high_crtc)
+        vbl.request.type |= (vdata->crtc_idx << DRM_VBLANK_HIGH_CRTC_SHIFT);
+    vbl.request.sequence = 0;
+    if (drmWaitVBlank(vdata->dev_fd, &vbl))
+        return 0;
+
+    return vbl.reply.sequence;
+}
+
+/*
+ * Renders the pending dirty rectangles to a buffer which is neither on the
+ * screen nor waiting for flipping. Every buffer records the dirty rectangles
+ * of the frame, and the buffer rendered copies the ones accumulated in its
+ * age only.
+ * Called with the update lock held.
+ */
+static void render_flip_buffer(_THIS)
+{
+    DrmVideoData* vdata = this->hidden;
+    DrmFlipBuffer *buff;
+    int i, idx = vdata->ready_buff_idx;
+    size_t bytes;
+
+    if (vdata->update_rcs.nr_rcs == 0)
+        return;
+
+    for (i = 0; idx < 0 && i < vdata->nr_flip_buffs; i++) {
+        if (i != vdata->front_buff_idx && i != vdata->pending_buff_idx)
+            idx = i;
+    }
+
+    if (idx < 0)
+        return;
+
+    for (i = 0; i < vdata->nr_flip_buffs; i++) {
+        merge_dirty_rects(&vdata->flip_buffs[i].dirty_rcs, &vdata->update_rcs);
+    }
+    vdata->update_rcs.nr_rcs = 0;
+
+    buff = vdata->flip_buffs + idx;
+    bytes = update_rects_to_screen(this, buff->surface, &buff->dirty_rcs);
+    flush_dirty_rects(this, buff->surface, 0, &buff->dirty_rcs);
+    account_frame(this, buff->dirty_rcs.nr_rcs, bytes);
+    buff->dirty_rcs.nr_rcs = 0;
+
+    vdata->ready_buff_idx = idx;
+}
+
+/* Called with the update lock held. */
+static void submit_page_flip(_THIS)
+{
+    DrmVideoData* vdata = this->hidden;
+    DrmFlipBuffer *buff = vdata->flip_buffs + vdata->ready_buff_idx;
+
+    vdata->flip_submit_seq = get_vblank_sequence(vdata);
+    if (drmModePageFlip(vdata->dev_fd, vdata->saved_info->crtc,
+                buff->fb_id, DRM_MODE_PAGE_FLIP_EVENT, buff) == 0) {
+        vdata->pending_buff_idx = vdata->ready_buff_idx;
+        vdata->ready_buff_idx = -1;
+        return;
+    }
+
+    _WRN_PRINTF("Failed drmModePageFlip: %m; setting CRTC instead\n");
+    if (drmModeSetCrtc(vdata->dev_fd, vdata->saved_info->crtc,
+                buff->fb_id, 0, 0, &vdata->saved_info->conn, 1,
+                &vdata->saved_info->mode) == 0) {
+        vdata->front_buff_idx = vdata->ready_buff_idx;
+        vdata->ready_buff_idx = -1;
+    }
+}
+
+/*
+ * The user data of a flip event is the buffer flipped. An event which does
+ * not match the pending flip is the late event of a flip given up by
+ * wait_page_flip(); it is dropped. The kernel completes the flips of
+ * a CRTC in order, and refuses a new flip while one is pending, so the late
+ * event always comes before the event of the next flip.
+ */
+static void on_page_flip(int fd, unsigned int sequence,
+        unsigned int tv_sec, unsigned int tv_usec, void *user_data)
+{
+    DrmFlipBuffer *buff = user_data;
+    _THIS = buff->video;
+    DrmVideoData* vdata = this->hidden;
+
+    (void)fd;
+    (void)tv_sec;
+    (void)tv_usec;
+
+    retry_syscall_for_eintr(sem_wait(vdata->update_lock));
+    if (vdata->pending_buff_idx < 0 ||
+            buff != vdata->flip_buffs + vdata->pending_buff_idx) {
+        _DBG_PRINTF("Dropped the late event of flipping buffer %d\n",
+                (int)(buff - vdata->flip_buffs));
+        sem_post(vdata->update_lock);
+        return;
+    }
+
+    vdata->front_buff_idx = vdata->pending_buff_idx;
+    vdata->pending_buff_idx = -1;
+    vdata->frame_stats.nr_flips++;
+    account_vblank(vdata, vdata->flip_submit_seq, sequence);
+    sem_post(vdata->update_lock);
+}
+
+#define FLIP_TIMEOUT_MS     100
+
+static void wait_page_flip(_THIS)
+{
+    DrmVideoData* vdata = this->hidden;
+    drmEventContext evctx;
+    struct pollfd pfd;
+    int ret;
+
+    memset(&evctx, 0, sizeof(evctx));
+    evctx.version = 2;
+    evctx.page_flip_handler = on_page_flip;
+
+    pfd.fd = vdata->dev_fd;
+    pfd.events = POLLIN;
+    while (vdata->pending_buff_idx >= 0) {
+        ret = poll(&pfd, 1, FLIP_TIMEOUT_MS);
+        if (ret < 0 && errno == EINTR)
+            continue;
+
+        if (ret <= 0) {
+            _WRN_PRINTF("Failed to wait for page flip: %d\n", ret);
+            /* assume the flip has been done; on_page_flip() will drop
+               the event if it comes later */
+            retry_syscall_for_eintr(sem_wait(vdata->update_lock));
+            vdata->front_buff_idx = vdata->pending_buff_idx;
+            vdata->pending_buff_idx = -1;
+            sem_post(vdata->update_lock);
+            break;
+        }
+
+        drmHandleEvent(vdata->dev_fd, &evctx);
+    }
+}
+#endif  /* _MGGAL_DRM_PAGE_FLIP */
+
 static void* task_do_update(void *data)
 {
     _THIS = data;
@@ -2589,6 +2881,7 @@ static void* task_do_update(void *data)
         }
         else {
             vbl_ok = TRUE;
+            vdata->last_vbl_seq = vbl.reply.sequence;
         }
     }
 
@@ -2601,6 +2894,21 @@ static void* task_do_update(void *data)
 
     do {
 
+#ifdef _MGGAL_DRM_PAGE_FLIP
+        if (vdata->nr_flip_buffs) {
+            /* With triple buffering, render the spare buffer before
+               the pending flip completes. */
+            if (vdata->pending_buff_idx >= 0) {
+                retry_syscall_for_eintr(sem_wait(vdata->update_lock));
+                render_flip_buffer(this);
+                sem_post(vdata->update_lock);
+
+                wait_page_flip(this);
+                goto flip;
+            }
+        }
+#endif
+
         if (vbl_ok) {
             vbl.request.type = DRM_VBLANK_RELATIVE | DRM_VBLANK_NEXTONMISS;
             if (vdata->cap_vblank_high_crtc)
@@ -2608,42 +2916,41 @@ static void* task_do_update(void *data)
                     (vdata->crtc_idx << DRM_VBLANK_HIGH_CRTC_SHIFT);
             vbl.request.sequence = 1;
             vbl.request.signal = 0;
-            drmWaitVBlank(vdata->dev_fd, &vbl);
+            if (drmWaitVBlank(vdata->dev_fd, &vbl) == 0) {
+                retry_syscall_for_eintr(sem_wait(vdata->update_lock));
+                account_vblank(vdata, vdata->last_vbl_seq, vbl.reply.sequence);
+                sem_post(vdata->update_lock);
+            }
         }
         else {
             usleep(vdata->update_interval * 1000);
         }
 
+#ifdef _MGGAL_DRM_PAGE_FLIP
+flip:
+#endif
 #ifdef _DEBUG
         vdata->frames++;
 #endif
 
         retry_syscall_for_eintr(sem_wait(vdata->update_lock));
-        if (RECTH(vdata->update_rect)) {
-            GAL_Rect dirty_rect = {
-                vdata->update_rect.left,
-                vdata->update_rect.top,
-                RECTW(vdata->update_rect),
-                RECTH(vdata->update_rect) };
-            update_real_screen_helper(this, &dirty_rect);
-
-            if (vdata->driver && vdata->driver_ops->flush) {
-                DrmSurfaceBuffer *real_buff;
-                real_buff = (DrmSurfaceBuffer *)vdata->real_screen->hwdata;
-                vdata->driver_ops->flush(vdata->driver,
-                        real_buff, &dirty_rect);
-            }
-            else if (vdata->dirty_fb_ok) {
-                drmModeClip clip = {
-                    vdata->update_rect.left,
-                    vdata->update_rect.top,
-                    vdata->update_rect.right,
-                    vdata->update_rect.bottom };
-                drmModeDirtyFB(vdata->dev_fd,
-                        vdata->scanout_buff_id, &clip, 1);
-            }
-
-            SetRectEmpty(&vdata->update_rect);
+#ifdef _MGGAL_DRM_PAGE_FLIP
+        if (vdata->nr_flip_buffs) {
+            render_flip_buffer(this);
+            if (vdata->ready_buff_idx >= 0 && vdata->pending_buff_idx < 0)
+                submit_page_flip(this);
+        }
+        else
+#endif
+        if (vdata->update_rcs.nr_rcs) {
+            size_t bytes;
+
+            bytes = update_rects_to_screen(this, vdata->real_screen,
+                    &vdata->update_rcs);
+            flush_dirty_rects(this, vdata->real_screen, vdata->scanout_buff_id,
+                    &vdata->update_rcs);
+            account_frame(this, vdata->update_rcs.nr_rcs, bytes);
+            vdata->update_rcs.nr_rcs = 0;
         }
         sem_post(vdata->update_lock);
 
@@ -2719,6 +3026,132 @@ static void DRM_UnlockHWSurface(_THIS, GAL_Surface *surface)
     }
 }
 
+static DrmSurfaceBuffer *drm_create_scanout_buffer(DrmVideoData* vdata,
+        uint32_t drm_format, int width, int height)
+{
+    DrmSurfaceBuffer *scanout_buffer = NULL;
+
+    if (vdata->driver) {
+        assert (vdata->driver_ops->create_buffer);
+        scanout_buffer = vdata->driver_ops->create_buffer(vdata->driver,
+                drm_format, 0, width, height, DRM_SURBUF_TYPE_SCANOUT);
+        if (scanout_buffer && scanout_buffer->dma_buf &&
+                drm_map_buffer_via_dmabuf(vdata, scanout_buffer)) {
+            _WRN_PRINTF("Cannot map scanout buffer via DMA-BUF\n");
+        }
+
+        if (scanout_buffer && scanout_buffer->vaddr == NULL) {
+            _WRN_PRINTF("calling driver_ops->map_buffer()\n");
+            vdata->driver_ops->map_buffer(vdata->driver, scanout_buffer);
+        }
+    }
+    else {
+        scanout_buffer = drm_create_dumb_buffer (vdata, drm_format, 0,
+                width, height);
+    }
+
+    return scanout_buffer;
+}
+
+static void drm_destroy_scanout_buffer(DrmVideoData* vdata,
+        DrmSurfaceBuffer *scanout_buffer)
+{
+    if (vdata->driver) {
+        if (scanout_buffer->vaddr)
+            vdata->driver_ops->unmap_buffer(vdata->driver, scanout_buffer);
+        vdata->driver_ops->destroy_buffer(vdata->driver, scanout_buffer);
+    }
+    else {
+        drm_destroy_dumb_buffer (vdata, scanout_buffer);
+    }
+}
+
+#ifdef _MGGAL_DRM_PAGE_FLIP
+/*
+ * Creates the scan-out buffers for page flipping. The first one is
+ * the real screen; the others are allocated here.
+ */
+static int drm_setup_flip_buffers(_THIS, uint32_t drm_format, int bpp,
+        Uint32 *RGBAmasks)
+{
+    DrmVideoData* vdata = this->hidden;
+    RECT rc_screen = { 0, 0, vdata->real_screen->w, vdata->real_screen->h };
+    int i;
+
+    for (i = 0; i < vdata->nr_flip_buffs; i++)
+        vdata->flip_buffs[i].video = this;
+
+    vdata->flip_buffs[0].surface = vdata->real_screen;
+    vdata->flip_buffs[0].fb_id = vdata->scanout_buff_id;
+    vdata->flip_buffs[0].dirty_rcs.nr_rcs = 0;
+
+    for (i = 1; i < vdata->nr_flip_buffs; i++) {
+        DrmFlipBuffer *buff = vdata->flip_buffs + i;
+        DrmSurfaceBuffer *scanout_buffer;
+
+        scanout_buffer = drm_create_scanout_buffer(vdata, drm_format,
+                vdata->real_screen->w, vdata->real_screen->h);
+        if (scanout_buffer == NULL || scanout_buffer->vaddr == NULL) {
+            if (scanout_buffer)
+                drm_destroy_scanout_buffer(vdata, scanout_buffer);
+            goto error;
+        }
+
+        if (drm_add_frame_buffer(vdata, scanout_buffer->handle,
+                scanout_buffer->drm_format,
+                scanout_buffer->width, scanout_buffer->height,
+                scanout_buffer->pitch, scanout_buffer->offset,
+                &buff->fb_id)) {
+            drm_destroy_scanout_buffer(vdata, scanout_buffer);
+            goto error;
+        }
+
+        buff->surface = create_surface_from_buffer(this, scanout_buffer,
+                bpp, RGBAmasks);
+        if (buff->surface == NULL) {
+            drm_destroy_scanout_buffer(vdata, scanout_buffer);
+            goto error;
+        }
+
+        /* the content of a new buffer is undefined */
+        buff->dirty_rcs.nr_rcs = 0;
+        GAL_AddToDirtyRects(&buff->dirty_rcs, &rc_screen);
+    }
+
+    vdata->front_buff_idx = 0;
+    vdata->pending_buff_idx = -1;
+    vdata->ready_buff_idx = -1;
+    return 0;
+
+error:
+    _WRN_PRINTF("NEWGAL>DRM: failed to create buffers for page flipping\n");
+    drm_free_flip_buffers(vdata);
+    return -1;
+}
+
+static void drm_free_flip_buffers(DrmVideoData* vdata)
+{
+    int i;
+
+    /* the first one is the real screen */
+    for (i = 1; i < DRM_MAX_FLIP_BUFFERS; i++) {
+        DrmFlipBuffer *buff = vdata->flip_buffs + i;
+
+        if (buff->fb_id) {
+            drmModeRmFB(vdata->dev_fd, buff->fb_id);
+            buff->fb_id = 0;
+        }
+
+        if (buff->surface) {
+            GAL_FreeSurface(buff->surface);
+            buff->surface = NULL;
+        }
+    }
+
+    vdata->nr_flip_buffs = 0;
+}
+#endif  /* _MGGAL_DRM_PAGE_FLIP */
+
 /* DRM engine methods for dumb buffers */
 static GAL_Surface *DRM_SetVideoMode(_THIS, GAL_Surface *current,
                 int width, int height, int bpp, Uint32 flags)
@@ -2752,25 +3185,8 @@ static GAL_Surface *DRM_SetVideoMode(_THIS, GAL_Surface *current,
     _DBG_PRINTF("going setting video mode: %dx%d-%dbpp\n",
             info->width, info->height, bpp);
 
-    if (vdata->driver) {
-        assert (vdata->driver_ops->create_buffer);
-        real_buffer = vdata->driver_ops->create_buffer(vdata->driver,
-                drm_format, 0, info->width, info->height,
-                DRM_SURBUF_TYPE_SCANOUT);
-        if (real_buffer && real_buffer->dma_buf &&
-                drm_map_buffer_via_dmabuf(vdata, real_buffer)) {
-            _WRN_PRINTF("Cannot map real screen buffer via DMA-BUF\n");
-        }
-
-        if (real_buffer->vaddr == NULL) {
-            _WRN_PRINTF("calling driver_ops->map_buffer()\n");
-            vdata->driver_ops->map_buffer(vdata->driver, real_buffer);
-        }
-    }
-    else {
-        real_buffer = drm_create_dumb_buffer (vdata, drm_format, 0,
-                info->width, info->height);
-    }
+    real_buffer = drm_create_scanout_buffer(vdata, drm_format,
+            info->width, info->height);
 
     if (real_buffer == NULL || real_buffer->vaddr == NULL) {
         _ERR_PRINTF("NEWGAL>DRM: "
@@ -2821,13 +3237,13 @@ static GAL_Surface *DRM_SetVideoMode(_THIS, GAL_Surface *current,
             hdr = (GAL_ShadowSurfaceHeader *)
                 ((uint8_t*)vdata->shadow_screen->pixels -
                  vdata->shadow_screen->pixels_off);
-            SetRectEmpty (&hdr->dirty_rc);
+            hdr->dirty_rcs.nr_rcs = 0;
 #else
             vdata->shadow_screen = GAL_CreateRGBSurface (GAL_HWSURFACE,
                     real_buffer->width, real_buffer->height, real_buffer->bpp,
                     RGBAmasks[0], RGBAmasks[1], RGBAmasks[2], RGBAmasks[3]);
 
-            SetRectEmpty (&vdata->dirty_rc);
+            vdata->dirty_rcs.nr_rcs = 0;
 #endif
         }
         else {
@@ -2835,7 +3251,7 @@ static GAL_Surface *DRM_SetVideoMode(_THIS, GAL_Surface *current,
                     shadow_buffer, bpp, RGBAmasks);
 
             hdr = (GAL_ShadowSurfaceHeader*)shadow_buffer->vaddr;
-            SetRectEmpty (&hdr->dirty_rc);
+            hdr->dirty_rcs.nr_rcs = 0;
         }
 
         if (vdata->shadow_screen == NULL) {
@@ -2888,12 +3304,24 @@ static GAL_Surface *DRM_SetVideoMode(_THIS, GAL_Surface *current,
     }
 
     if (vdata->shadow_screen) {
+#ifdef _MGGAL_DRM_PAGE_FLIP
+        if (vdata->nr_flip_buffs) {
+            drm_setup_flip_buffers(this, drm_format, bpp, RGBAmasks);
+        }
+#endif
+
         if (create_async_updater(this) == 0) {
             vdata->shadow_screen->flags |= GAL_ASYNCBLIT;
             this->LockHWSurface = DRM_LockHWSurface;
             this->UnlockHWSurface = DRM_UnlockHWSurface;
             this->SyncUpdate = DRM_SyncUpdateAsync;
         }
+#ifdef _MGGAL_DRM_PAGE_FLIP
+        else {
+            /* page flipping needs the async. updater */
+            drm_free_flip_buffers(vdata);
+        }
+#endif
 
         return vdata->shadow_screen;
     }
@@ -3727,16 +4155,8 @@ static int DRM_CopyHWSurface_Accl(_THIS,
             dst_buf, dstrc, op);
 }
 
-static void DRM_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
+static GAL_DirtyRects* get_dirty_rects(_THIS)
 {
-    int i;
-    RECT* dirty_rc;
-    RECT bound;
-
-    if (this->hidden->dbl_buff && this->hidden->update_lock != SEM_FAILED) {
-        retry_syscall_for_eintr(sem_wait(this->hidden->update_lock));
-    }
-
 #if IS_SHAREDFB_SCHEMA_PROCS
     GAL_ShadowSurfaceHeader* hdr;
     if (this->hidden->shadow_screen->flags & GAL_HWSURFACE) {
@@ -3748,24 +4168,30 @@ static void DRM_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
             ((uint8_t*)this->hidden->shadow_screen->pixels -
             this->hidden->shadow_screen->pixels_off);
     }
-    dirty_rc = &hdr->dirty_rc;
+    return &hdr->dirty_rcs;
 #else
-    dirty_rc = &this->hidden->dirty_rc;
+    return &this->hidden->dirty_rcs;
 #endif
+}
+
+static void DRM_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
+{
+    int i;
+    GAL_DirtyRects* dirty_rcs;
+
+    if (this->hidden->dbl_buff && this->hidden->update_lock != SEM_FAILED) {
+        retry_syscall_for_eintr(sem_wait(this->hidden->update_lock));
+    }
 
-    bound = *dirty_rc;
+    dirty_rcs = get_dirty_rects(this);
     for (i = 0; i < numrects; i++) {
         RECT rc;
 
         SetRect (&rc, rects[i].x, rects[i].y,
                 rects[i].x + rects[i].w, rects[i].y + rects[i].h);
-        if (IsRectEmpty (&bound))
-            bound = rc;
-        else
-            GetBoundRect (&bound, &bound, &rc);
+        GAL_AddToDirtyRects(dirty_rcs, &rc);
     }
 
-    *dirty_rc = bound;
     if (this->hidden->dbl_buff && this->hidden->update_lock != SEM_FAILED) {
         sem_post (this->hidden->update_lock);
     }
@@ -3788,62 +4214,57 @@ static BOOL DRM_WaitVBlank(_THIS)
     return TRUE;
 }
 
+/* Moves the dirty rectangles clipped by the screen to a list. */
+static void take_dirty_rects(_THIS, GAL_DirtyRects* rcs)
+{
+    GAL_DirtyRects* dirty_rcs = get_dirty_rects(this);
+    RECT real_scrrc = { 0, 0, this->hidden->real_screen->w,
+        this->hidden->real_screen->h };
+    RECT clipped;
+    int i;
+
+    for (i = 0; i < dirty_rcs->nr_rcs; i++) {
+        if (IntersectRect(&clipped, dirty_rcs->rcs + i, &real_scrrc)) {
+            GAL_AddToDirtyRects(rcs, &clipped);
+        }
+    }
+
+    dirty_rcs->nr_rcs = 0;
+}
+
 static BOOL DRM_SyncUpdate(_THIS)
 {
     DrmVideoData *vdata = this->hidden;
     BOOL retval = FALSE;
-    RECT* dirty_rc;
+    GAL_DirtyRects dirty_rcs;
+    size_t bytes = 0;
+    int i;
 
     if (vdata->dbl_buff && vdata->update_lock != SEM_FAILED) {
         retry_syscall_for_eintr(sem_wait(vdata->update_lock));
     }
 
-#if IS_SHAREDFB_SCHEMA_PROCS
-    GAL_ShadowSurfaceHeader* hdr;
-    if (vdata->shadow_screen->flags & GAL_HWSURFACE) {
-        hdr = (GAL_ShadowSurfaceHeader *)
-            ((DrmSurfaceBuffer*)vdata->shadow_screen->hwdata)->vaddr;
-    }
-    else {
-        hdr = (GAL_ShadowSurfaceHeader *)
-            ((uint8_t*)vdata->shadow_screen->pixels -
-            vdata->shadow_screen->pixels_off);
-    }
-    dirty_rc = &hdr->dirty_rc;
-#else
-    dirty_rc = &vdata->dirty_rc;
-#endif
-
-    if (IsRectEmpty(dirty_rc))
+    dirty_rcs.nr_rcs = 0;
+    take_dirty_rects(this, &dirty_rcs);
+    if (dirty_rcs.nr_rcs == 0)
         goto ret;
 
-    RECT real_scrrc = { 0, 0, this->hidden->real_screen->w,
-        this->hidden->real_screen->h };
-    RECT clipped = *dirty_rc;
-    SetRectEmpty(dirty_rc);
-    if (!IntersectRect(&clipped, &clipped, &real_scrrc))
-        goto ret;
+    for (i = 0; i < dirty_rcs.nr_rcs; i++) {
+        const RECT *rc = dirty_rcs.rcs + i;
+        GAL_Rect dirty_rect = { rc->left, rc->top, RECTWP(rc), RECTHP(rc) };
 
-    GAL_Rect dirty_rect = { clipped.left, clipped.top,
-        RECTW(clipped), RECTH(clipped) };
+        if (vdata->shadow_screen) {
+            bytes += update_real_screen_helper(this, vdata->real_screen,
+                    &dirty_rect);
+        }
 
-    if (vdata->shadow_screen) {
-        update_real_screen_helper(this, &dirty_rect);
+        refresh_cursor(this, vdata->real_screen, &dirty_rect);
     }
 
-    refresh_cursor(this, &dirty_rect);
-
-    if (vdata->driver && vdata->driver_ops->flush) {
-        DrmSurfaceBuffer *real_buff;
-        real_buff = (DrmSurfaceBuffer *)vdata->real_screen->hwdata;
-        vdata->driver_ops->flush(vdata->driver,
-                real_buff, &dirty_rect);
-    }
-    else if (vdata->dirty_fb_ok) {
-        drmModeClip clip = { clipped.left, clipped.top,
-            clipped.right, clipped.bottom };
-        drmModeDirtyFB(vdata->dev_fd,
-                vdata->scanout_buff_id, &clip, 1);
+    flush_dirty_rects(this, vdata->real_screen, vdata->scanout_buff_id,
+            &dirty_rcs);
+    if (bytes > 0) {
+        account_frame(this, dirty_rcs.nr_rcs, bytes);
     }
 
 ret:
@@ -3857,42 +4278,16 @@ ret:
 static BOOL DRM_SyncUpdateAsync(_THIS)
 {
     BOOL retval = FALSE;
-    RECT* dirty_rc;
-    RECT bound;
 
     if (this->hidden->dbl_buff && this->hidden->update_lock != SEM_FAILED) {
         retry_syscall_for_eintr(sem_wait(this->hidden->update_lock));
     }
 
-#if IS_SHAREDFB_SCHEMA_PROCS
-    GAL_ShadowSurfaceHeader* hdr;
-    if (this->hidden->shadow_screen->flags & GAL_HWSURFACE) {
-        hdr = (GAL_ShadowSurfaceHeader*)
-            ((DrmSurfaceBuffer*)this->hidden->shadow_screen->hwdata)->vaddr;
+    if (get_dirty_rects(this)->nr_rcs) {
+        take_dirty_rects(this, &this->hidden->update_rcs);
+        retval = TRUE;
     }
-    else {
-        hdr = (GAL_ShadowSurfaceHeader*)
-            ((uint8_t*)this->hidden->shadow_screen->pixels -
-            this->hidden->shadow_screen->pixels_off);
-    }
-    dirty_rc = &hdr->dirty_rc;
-#else
-    dirty_rc = &this->hidden->dirty_rc;
-#endif
-
-    if (IsRectEmpty(dirty_rc))
-        goto ret;
 
-    bound = *dirty_rc;
-    RECT *update_rect = &this->hidden->update_rect;
-    GetBoundRect(update_rect, &bound, update_rect);
-    RECT real_scrrc = { 0, 0, this->hidden->real_screen->w,
-        this->hidden->real_screen->h };
-    IntersectRect(update_rect, update_rect, &real_scrrc);
-    retval = TRUE;
-    SetRectEmpty(dirty_rc);
-
-ret:
     if (this->hidden->dbl_buff && this->hidden->update_lock != SEM_FAILED) {
         sem_post (this->hidden->update_lock);
     }
@@ -3910,6 +4305,24 @@ MG_EXPORT int drmGetDeviceFD (GHANDLE video)
     return -1;
 }
 
+MG_EXPORT BOOL drmGetFrameStats (GHANDLE video, DrmFrameStats* stats)
+{
+    GAL_VideoDevice *this = (GAL_VideoDevice *)video;
+    if (this && this->VideoInit == DRM_VideoInit &&
+            this->hidden->updater_ready) {
+        DrmVideoData* vdata = this->hidden;
+
+        retry_syscall_for_eintr(sem_wait(vdata->update_lock));
+        *stats = vdata->frame_stats;
+        sem_post(vdata->update_lock);
+
+        stats->nr_buffers = vdata->nr_flip_buffs ? vdata->nr_flip_buffs : 1;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 /* called by drmGetSurfaceInfo */
 BOOL __drm_get_surface_info (GAL_Surface *surface, DrmSurfaceInfo* info)
 {
@@ -4174,7 +4587,7 @@ static BOOL DRM_SyncUpdateDMA (_THIS)
                 "failed drmDMA: %s\n", strerror(errno));
     }
 
-    SetRectEmpty(&this->hidden->dirty_rc);
+    this->hidden->dirty_rcs.nr_rcs = 0;
     return TRUE;
 }
 
@@ -67,6 +67,21 @@
 
 typedef struct drm_mode_info DrmModeInfo;
 
+/* The maximal number of scan-out buffers used for page flipping */
+#define DRM_MAX_FLIP_BUFFERS    3
+
+/* A scan-out buffer used for page flipping. */
+typedef struct _DrmFlipBuffer {
+    /* The video device; the buffer is the user data of the flip event. */
+    GAL_VideoDevice* video;
+    GAL_Surface*    surface;
+    uint32_t        fb_id;
+
+    /* The dirty rectangles accumulated since the last time this buffer was
+       rendered, i.e., the dirty rectangles of the frames in its age. */
+    GAL_DirtyRects  dirty_rcs;
+} DrmFlipBuffer;
+
 typedef struct GAL_PrivateVideoData {
     /* For compositing schema, we force to use double buffering */
 #ifdef _MGSCHEMA_COMPOSITING
@@ -92,7 +107,7 @@ typedef struct GAL_PrivateVideoData {
     sem_t *update_lock;
 
 #if !IS_SHAREDFB_SCHEMA_PROCS
-    RECT dirty_rc;
+    GAL_DirtyRects dirty_rcs;
 #endif
 
     char*           dev_name;
@@ -124,10 +139,22 @@ typedef struct GAL_PrivateVideoData {
     /* async updater */
     int             updater_ready;
     int             update_interval;
-    RECT            update_rect;
+    GAL_DirtyRects  update_rcs;
     pthread_t       update_thd;
     sem_t           sync_sem;
 
+    /* page flipping; nr_flip_buffs is 0 if page flipping is disabled. */
+    int             nr_flip_buffs;
+    int             front_buff_idx;
+    int             pending_buff_idx;
+    int             ready_buff_idx;
+    uint32_t        flip_submit_seq;
+    DrmFlipBuffer   flip_buffs[DRM_MAX_FLIP_BUFFERS];
+
+    /* frame pacing statistics */
+    uint32_t        last_vbl_seq;
+    DrmFrameStats   frame_stats;
+
 #ifdef _DEBUG
     struct timespec ts_start;
     unsigned        frames;
@@ -172,24 +172,35 @@ static BOOL FB_WaitVBlank(_THIS)
     return TRUE;
 }
 
-static BOOL FB_SyncUpdate (_THIS)
+#if defined(__TARGET_R818__)
+static void sync_cache_for_rects (_THIS, const GAL_DirtyRects *dirty_rcs)
 {
-    if (IsRectEmpty(&this->hidden->dirty_rc))
-        return FALSE;
+    int i;
 
-    if (shadowScreen_BlitToReal(this, NULL) == 0) {
-#if defined(__TARGET_R818__)
+    for (i = 0; i < dirty_rcs->nr_rcs; i++) {
         uintptr_t args[2];
         args[0] = (uintptr_t)this->hidden->real_screen->pixels;
         args[0] += this->hidden->real_screen->pitch *
-            this->hidden->dirty_rc.top;
+            dirty_rcs->rcs[i].top;
         args[1] = this->hidden->real_screen->pitch *
-            RECTH(this->hidden->dirty_rc);
+            RECTH(dirty_rcs->rcs[i]);
         if (ioctl (console_fd, FBIO_CACHE_SYNC, args) < 0) {
             _WRN_PRINTF("failed to flush cache for R818\n");
         }
+    }
+}
 #endif
-        SetRectEmpty(&this->hidden->dirty_rc);
+
+static BOOL FB_SyncUpdate (_THIS)
+{
+    if (this->hidden->dirty_rcs.nr_rcs == 0)
+        return FALSE;
+
+    if (shadowScreen_BlitToReal(this, NULL) == 0) {
+#if defined(__TARGET_R818__)
+        sync_cache_for_rects(this, &this->hidden->dirty_rcs);
+#endif
+        this->hidden->dirty_rcs.nr_rcs = 0;
         return TRUE;
     }
 
@@ -623,26 +634,18 @@ static void* task_do_update(void *data)
 #endif
 
         pthread_mutex_lock(&this->hidden->update_lock);
-        if (RECTH(this->hidden->update_rect)) {
+        if (this->hidden->update_rcs.nr_rcs) {
             if (shadowScreen_BlitToReal(this,
-                        &this->hidden->update_rect) == 0) {
+                        &this->hidden->update_rcs) == 0) {
 #if defined(__TARGET_R818__)
-                uintptr_t args[2];
-                args[0] = (uintptr_t)this->hidden->real_screen->pixels;
-                args[0] += this->hidden->real_screen->pitch *
-                    this->hidden->update_rect.top;
-                args[1] = this->hidden->real_screen->pitch *
-                    RECTH(this->hidden->update_rect);
-                if (ioctl(console_fd, FBIO_CACHE_SYNC, args) < 0) {
-                    _WRN_PRINTF("failed to flush cache for R818\n");
-                }
+                sync_cache_for_rects(this, &this->hidden->update_rcs);
 #endif
             }
             else {
                 _ERR_PRINTF("failed shadowScreen_BlitToReal()\n");
             }
 
-            SetRectEmpty(&this->hidden->update_rect);
+            this->hidden->update_rcs.nr_rcs = 0;
         }
         pthread_mutex_unlock(&this->hidden->update_lock);
 
@@ -721,22 +724,23 @@ static void FB_UnlockHWSurface(_THIS, GAL_Surface *surface)
 static BOOL FB_SyncUpdateAsync(_THIS)
 {
     BOOL retval = FALSE;
-    RECT* dirty_rc;
+    GAL_DirtyRects* dirty_rcs;
+    int i;
 
     if (this->hidden->updater_ready) {
         if (pthread_mutex_lock(&this->hidden->update_lock))
             _ERR_PRINTF("Failed pthread_mutex_lock(): %m\n");
     }
 
-    dirty_rc = &this->hidden->dirty_rc;
-    if (IsRectEmpty(dirty_rc))
+    dirty_rcs = &this->hidden->dirty_rcs;
+    if (dirty_rcs->nr_rcs == 0)
         goto ret;
 
-    RECT bound = *dirty_rc;
-    RECT *update_rect = &this->hidden->update_rect;
-    GetBoundRect(update_rect, &bound, update_rect);
+    for (i = 0; i < dirty_rcs->nr_rcs; i++) {
+        GAL_AddToDirtyRects(&this->hidden->update_rcs, dirty_rcs->rcs + i);
+    }
     retval = TRUE;
-    SetRectEmpty(dirty_rc);
+    dirty_rcs->nr_rcs = 0;
 
 ret:
     if (this->hidden->updater_ready) {
@@ -1017,7 +1021,7 @@ static GAL_Surface *FB_SetVideoMode(_THIS, GAL_Surface *current,
             GAL_SetClipRect (this->hidden->real_screen, NULL);
             GAL_SetColorKey (this->hidden->shadow_screen, 0, 0);
             GAL_SetAlpha (this->hidden->shadow_screen, 0, 0);
-            SetRectEmpty (&this->hidden->dirty_rc);
+            this->hidden->dirty_rcs.nr_rcs = 0;
         }
         else {
             this->hidden->real_screen = NULL;
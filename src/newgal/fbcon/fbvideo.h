@@ -81,7 +81,7 @@ struct GAL_PrivateVideoData {
     /* start of header for shadow screen */
     int magic, version;
     GAL_Surface *real_screen, *shadow_screen;
-    RECT dirty_rc;
+    GAL_DirtyRects dirty_rcs;
 
 #ifdef _MGSCHEMA_COMPOSITING
     /* Used to simulate the hardware cursor. */
@@ -100,7 +100,7 @@ struct GAL_PrivateVideoData {
     /* Since 5.0.13, async updater */
     int             updater_ready;
     int             update_interval;
-    RECT            update_rect;
+    GAL_DirtyRects  update_rcs;
     pthread_t       update_thd;
     pthread_mutex_t update_lock;
     sem_t           sync_sem;
@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+
+/*
+** fill-kernels.c: the SIMD kernels for the solid fills and the raster
+** operations on spans.
+**
+** Create date: 2026/10/18
+**
+** A span of 16, 24, or 32-bit pixels is handled as a span of bytes, which
+** are set to, or ANDed, ORed, or XORed with, a pattern repeating the bytes
+** of the pixel. The pattern has a period of 96 bytes, which is a multiple
+** of the pixel sizes and of the vector sizes, so the kernels load it into
+** registers once per span, at the phase of the first aligned byte.
+**
+** The SET kernel also has a variant with non-temporal stores for the fills
+** larger than the last level cache, which would otherwise evict the cache
+** and read every destination line before writing it.
+**
+** The SSE2 kernels are always used on x86-64; the AVX2 kernels are picked
+** at runtime by the features of the CPU (see simd.h).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef __NOUNIX__
+#   include <unistd.h>
+#endif
+
+#include "common.h"
+#include "minigui.h"
+#include "newgal.h"
+
+#include "simd.h"
+
+#ifdef _MG_HAVE_X86_KERNELS
+#   include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#   define FILL_INLINE          inline __attribute__ ((always_inline))
+#else
+#   define FILL_INLINE          inline
+#endif
+
+#define FILL_PATTERN_PERIOD     96
+#define FILL_PATTERN_SIZE       (FILL_PATTERN_PERIOD * 2)
+
+/* the kernel for GAL_FILLOP_SET | GAL_FILLOP_STREAM */
+#define FILL_STREAM             4
+#define NR_FILL_KERNELS         5
+
+/* the size of the last level cache if the system does not tell it */
+#define DEF_LLC_SIZE            (8 << 20)
+
+typedef void (*CB_FILL_SPAN) (Uint8* dst, const Uint8* pattern, int n);
+
+typedef struct _FILLKERNELS {
+    const char* name;
+
+    /* indexed by GAL_FILLOP_SET, _AND, _OR, _XOR, and FILL_STREAM */
+    CB_FILL_SPAN ops [NR_FILL_KERNELS];
+} FILLKERNELS;
+
+/* the bytes before the first aligned vector and after the last one,
+   combined by 32-bit words as far as possible */
+#define COMBINE_BYTES(dst, pattern, n, expr)                    \
+    do {                                                        \
+        Uint32 d, p;                                            \
+        for (; n >= 4; n -= 4, dst += 4, pattern += 4) {        \
+            memcpy (&d, dst, 4);                                \
+            memcpy (&p, pattern, 4);                            \
+            d = (expr);                                         \
+            memcpy (dst, &d, 4);                                \
+        }                                                       \
+        for (; n > 0; n--, dst++, pattern++) {                  \
+            d = *dst;                                           \
+            p = *pattern;                                       \
+            *dst = (Uint8)(expr);                               \
+        }                                                       \
+    } while (0)
+
+static FILL_INLINE void combine_bytes (Uint8* dst, const Uint8* pattern,
+        int n, int op)
+{
+    switch (op) {
+    case GAL_FILLOP_AND:
+        COMBINE_BYTES (dst, pattern, n, d & p);
+        break;
+    case GAL_FILLOP_OR:
+        COMBINE_BYTES (dst, pattern, n, d | p);
+        break;
+    case GAL_FILLOP_XOR:
+        COMBINE_BYTES (dst, pattern, n, d ^ p);
+        break;
+    default:
+        memcpy (dst, pattern, n);
+        break;
+    }
+}
+
+#ifdef _MG_HAVE_X86_KERNELS
+static FILL_INLINE __m128i SSE2_TARGET combine_sse2 (__m128i d, __m128i p,
+        int op)
+{
+    switch (op) {
+    case GAL_FILLOP_AND:
+        return _mm_and_si128 (d, p);
+    case GAL_FILLOP_OR:
+        return _mm_or_si128 (d, p);
+    default:
+        return _mm_xor_si128 (d, p);
+    }
+}
+
+static FILL_INLINE void SSE2_TARGET apply_sse2 (Uint8* dst, __m128i p,
+        int op)
+{
+    __m128i* d = (__m128i*)dst;
+
+    if (op == GAL_FILLOP_SET)
+        _mm_store_si128 (d, p);
+    else if (op == FILL_STREAM)
+        _mm_stream_si128 (d, p);
+    else
+        _mm_store_si128 (d, combine_sse2 (_mm_load_si128 (d), p, op));
+}
+
+static FILL_INLINE void SSE2_TARGET fill_sse2 (Uint8* dst,
+        const Uint8* pattern, int n, int op)
+{
+    int head = (int)(-(UINT_PTR)dst & 15);
+    __m128i p0, p1, p2;
+
+    if (head > n)
+        head = n;
+    combine_bytes (dst, pattern, head, op);
+    dst += head;
+    pattern += head;
+    n -= head;
+
+    /* 48 bytes are a multiple of the pixel sizes */
+    p0 = _mm_loadu_si128 ((const __m128i*)pattern);
+    p1 = _mm_loadu_si128 ((const __m128i*)(pattern + 16));
+    p2 = _mm_loadu_si128 ((const __m128i*)(pattern + 32));
+
+    for (; n >= 48; n -= 48, dst += 48) {
+        apply_sse2 (dst, p0, op);
+        apply_sse2 (dst + 16, p1, op);
+        apply_sse2 (dst + 32, p2, op);
+    }
+
+    if (n >= 16) {
+        apply_sse2 (dst, p0, op);
+        dst += 16;
+        pattern += 16;
+        n -= 16;
+        if (n >= 16) {
+            apply_sse2 (dst, p1, op);
+            dst += 16;
+            pattern += 16;
+            n -= 16;
+        }
+    }
+
+    if (op == FILL_STREAM)
+        _mm_sfence ();
+
+    combine_bytes (dst, pattern, n, op);
+}
+
+static void SSE2_TARGET set_sse2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_sse2 (dst, pattern, n, GAL_FILLOP_SET);
+}
+
+static void SSE2_TARGET and_sse2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_sse2 (dst, pattern, n, GAL_FILLOP_AND);
+}
+
+static void SSE2_TARGET or_sse2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_sse2 (dst, pattern, n, GAL_FILLOP_OR);
+}
+
+static void SSE2_TARGET xor_sse2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_sse2 (dst, pattern, n, GAL_FILLOP_XOR);
+}
+
+static void SSE2_TARGET stream_sse2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_sse2 (dst, pattern, n, FILL_STREAM);
+}
+
+static const FILLKERNELS sse2_kernels = {
+    "sse2", { set_sse2, and_sse2, or_sse2, xor_sse2, stream_sse2 }
+};
+#endif  /* defined _MG_HAVE_X86_KERNELS */
+
+#ifdef _MG_HAVE_X86_KERNELS
+static FILL_INLINE __m256i AVX2_TARGET combine_avx2 (__m256i d, __m256i p,
+        int op)
+{
+    switch (op) {
+    case GAL_FILLOP_AND:
+        return _mm256_and_si256 (d, p);
+    case GAL_FILLOP_OR:
+        return _mm256_or_si256 (d, p);
+    default:
+        return _mm256_xor_si256 (d, p);
+    }
+}
+
+static FILL_INLINE void AVX2_TARGET apply_avx2 (Uint8* dst, __m256i p,
+        int op)
+{
+    __m256i* d = (__m256i*)dst;
+
+    if (op == GAL_FILLOP_SET)
+        _mm256_store_si256 (d, p);
+    else if (op == FILL_STREAM)
+        _mm256_stream_si256 (d, p);
+    else
+        _mm256_store_si256 (d, combine_avx2 (_mm256_load_si256 (d), p, op));
+}
+
+static FILL_INLINE void AVX2_TARGET fill_avx2 (Uint8* dst,
+        const Uint8* pattern, int n, int op)
+{
+    int head = (int)(-(UINT_PTR)dst & 31);
+    __m256i p0, p1, p2;
+
+    if (head > n)
+        head = n;
+    combine_bytes (dst, pattern, head, op);
+    dst += head;
+    pattern += head;
+    n -= head;
+
+    /* 96 bytes are a multiple of the pixel sizes */
+    p0 = _mm256_loadu_si256 ((const __m256i*)pattern);
+    p1 = _mm256_loadu_si256 ((const __m256i*)(pattern + 32));
+    p2 = _mm256_loadu_si256 ((const __m256i*)(pattern + 64));
+
+    for (; n >= 96; n -= 96, dst += 96) {
+        apply_avx2 (dst, p0, op);
+        apply_avx2 (dst + 32, p1, op);
+        apply_avx2 (dst + 64, p2, op);
+    }
+
+    if (n >= 32) {
+        apply_avx2 (dst, p0, op);
+        dst += 32;
+        pattern += 32;
+        n -= 32;
+        if (n >= 32) {
+            apply_avx2 (dst, p1, op);
+            dst += 32;
+            pattern += 32;
+            n -= 32;
+        }
+    }
+
+    if (op == FILL_STREAM)
+        _mm_sfence ();
+
+    combine_bytes (dst, pattern, n, op);
+}
+
+static void AVX2_TARGET set_avx2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_avx2 (dst, pattern, n, GAL_FILLOP_SET);
+}
+
+static void AVX2_TARGET and_avx2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_avx2 (dst, pattern, n, GAL_FILLOP_AND);
+}
+
+static void AVX2_TARGET or_avx2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_avx2 (dst, pattern, n, GAL_FILLOP_OR);
+}
+
+static void AVX2_TARGET xor_avx2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_avx2 (dst, pattern, n, GAL_FILLOP_XOR);
+}
+
+static void AVX2_TARGET stream_avx2 (Uint8* dst, const Uint8* pattern, int n)
+{
+    fill_avx2 (dst, pattern, n, FILL_STREAM);
+}
+
+static const FILLKERNELS avx2_kernels = {
+    "avx2", { set_avx2, and_avx2, or_avx2, xor_avx2, stream_avx2 }
+};
+#endif  /* defined _MG_HAVE_X86_KERNELS */
+
+static const FILLKERNELS* fill_kernels;
+static BOOL fill_kernels_selected;
+
+static const FILLKERNELS* get_fill_kernels (void)
+{
+    /* the selection is idempotent, so a race here is harmless */
+    if (MG_UNLIKELY (!fill_kernels_selected)) {
+        const FILLKERNELS* kernels = NULL;
+
+#ifdef _MG_HAVE_X86_KERNELS
+        Uint32 features = GAL_GetSIMDFeatures ();
+
+        if (features & GAL_SIMD_AVX2)
+            kernels = &avx2_kernels;
+        else if (features & GAL_SIMD_SSE2)
+            kernels = &sse2_kernels;
+#endif
+
+        fill_kernels = kernels;
+        fill_kernels_selected = TRUE;
+    }
+
+    return fill_kernels;
+}
+
+const char* GAL_GetFillKernelsName (void)
+{
+    const FILLKERNELS* kernels = get_fill_kernels ();
+
+    return kernels ? kernels->name : "c";
+}
+
+BOOL GAL_FillSpans (Uint8* dst, int pitch, int bpp, Uint32 pixel,
+        int op, int w, int h)
+{
+    const FILLKERNELS* kernels = get_fill_kernels ();
+    CB_FILL_SPAN fill;
+    Uint32 pattern [FILL_PATTERN_SIZE / 4];
+    Uint32 words [3];
+    int i;
+
+    if (kernels == NULL || bpp < 2 || bpp > 4)
+        return FALSE;
+
+    if (op == (GAL_FILLOP_SET | GAL_FILLOP_STREAM))
+        fill = kernels->ops [FILL_STREAM];
+    else
+        fill = kernels->ops [op & ~GAL_FILLOP_STREAM];
+
+    /* the 12 bytes of the pixels in memory, by words; the pattern
+       is stored by words too, or loading it would stall */
+    if (bpp == 2) {
+        words [0] = (Uint16)pixel * 0x00010001U;
+        words [1] = words [2] = words [0];
+    }
+    else if (bpp == 4) {
+        words [0] = words [1] = words [2] = pixel;
+    }
+    else if (GAL_BYTEORDER == GAL_LIL_ENDIAN) {
+        pixel &= 0xFFFFFF;
+        words [0] = pixel | pixel << 24;
+        words [1] = pixel >> 8 | pixel << 16;
+        words [2] = pixel >> 16 | pixel << 8;
+    }
+    else {
+        Uint8 bytes [12];
+
+        pixel <<= 8;
+        memcpy (bytes, &pixel, 3);
+        memcpy (bytes + 3, bytes, 3);
+        memcpy (bytes + 6, bytes, 6);
+        memcpy (words, bytes, 12);
+    }
+
+    for (i = 0; i < FILL_PATTERN_SIZE / 4; i += 3) {
+        pattern [i] = words [0];
+        pattern [i + 1] = words [1];
+        pattern [i + 2] = words [2];
+    }
+
+    for (; h > 0; h--, dst += pitch)
+        fill (dst, (const Uint8*)pattern, w * bpp);
+
+    return TRUE;
+}
+
+BOOL GAL_IsLargeFill (size_t bytes)
+{
+    static size_t llc_size;     /* zero for not decided yet */
+
+    /* the decision is idempotent, so a race here is harmless */
+    if (MG_UNLIKELY (llc_size == 0)) {
+        long size = 0;
+
+#if defined(_SC_LEVEL3_CACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+        size = sysconf (_SC_LEVEL3_CACHE_SIZE);
+        if (size <= 0)
+            size = sysconf (_SC_LEVEL2_CACHE_SIZE);
+#endif
+        llc_size = (size > 0) ? (size_t)size : DEF_LLC_SIZE;
+    }
+
+    return bytes > llc_size;
+}
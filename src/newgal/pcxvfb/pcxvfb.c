@@ -265,8 +265,9 @@ static void PCXVFB_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
 static BOOL PCXVFB_SyncUpdate (_THIS)
 {
     RECT dirty_rc;
+    int i;
 
-    if (IsRectEmpty(&this->hidden->dirty_rc))
+    if (this->hidden->dirty_rcs.nr_rcs == 0)
         return FALSE;
 
 #ifdef WIN32
@@ -282,18 +283,20 @@ static BOOL PCXVFB_SyncUpdate (_THIS)
     if (dirty_rc.right == -1) dirty_rc.right = 0;
     if (dirty_rc.bottom == -1) dirty_rc.bottom = 0;
 
-    GetBoundRect(&this->hidden->dirty_rc, &dirty_rc,
-            &this->hidden->dirty_rc);
-
     shadowScreen_BlitToReal(this, NULL);
 
-    this->hidden->hdr->dirty_rc_l = this->hidden->dirty_rc.left;
-    this->hidden->hdr->dirty_rc_t = this->hidden->dirty_rc.top;
-    this->hidden->hdr->dirty_rc_r = this->hidden->dirty_rc.right;
-    this->hidden->hdr->dirty_rc_b = this->hidden->dirty_rc.bottom;
+    /* XVFB only knows the bounding rectangle of the dirty content */
+    for (i = 0; i < this->hidden->dirty_rcs.nr_rcs; i++) {
+        GetBoundRect(&dirty_rc, &dirty_rc, this->hidden->dirty_rcs.rcs + i);
+    }
+
+    this->hidden->hdr->dirty_rc_l = dirty_rc.left;
+    this->hidden->hdr->dirty_rc_t = dirty_rc.top;
+    this->hidden->hdr->dirty_rc_r = dirty_rc.right;
+    this->hidden->hdr->dirty_rc_b = dirty_rc.bottom;
     this->hidden->hdr->dirty = TRUE;
 
-    SetRectEmpty(&this->hidden->dirty_rc);
+    this->hidden->dirty_rcs.nr_rcs = 0;
 
 #ifdef WIN32
     win_PCXVFbUnlock();
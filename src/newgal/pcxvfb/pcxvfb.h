@@ -105,7 +105,7 @@ struct GAL_PrivateVideoData {
     int magic, version;
     GAL_Surface *real_screen, *shadow_screen;
 
-    RECT dirty_rc;
+    GAL_DirtyRects dirty_rcs;
 
 #ifdef _MGSCHEMA_COMPOSITING
     /* Since 5.0.0: support for hardware cursor. */
@@ -279,6 +279,7 @@ void GAL_FormatChanged(GAL_Surface *surface)
 {
     surface->format_version++;
     GAL_InvalidateMap(surface->map);
+    GAL_FlushBlitCache();
 }
 /*
  * Free a previously allocated format structure
@@ -707,6 +708,7 @@ void GAL_FreeBlitMap(GAL_BlitMap *map)
     if ( map ) {
         GAL_InvalidateMap(map);
         if ( map->sw_data != NULL ) {
+            GAL_FreeRLEEncodings(map);
             free(map->sw_data);
         }
         free(map);
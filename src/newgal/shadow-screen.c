@@ -96,7 +96,7 @@ struct GAL_PrivateVideoData {
      */
     GAL_Surface *real_screen, *shadow_screen;
 
-    RECT dirty_rc;
+    GAL_DirtyRects dirty_rcs;
 
 #ifdef _MGSCHEMA_COMPOSITING
     /* Used to simulate the hardware cursor. */
@@ -210,79 +210,82 @@ int shadowScreen_MoveCursor (_THIS, int x, int y)
 void shadowScreen_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
 {
     int i;
-    RECT bound;
 
     CHECK_VERSION_NORETVAL (this);
 
-    bound = this->hidden->dirty_rc;
-
     for (i = 0; i < numrects; i++) {
         RECT rc;
 
         SetRect (&rc, rects[i].x, rects[i].y,
                 rects[i].x + rects[i].w, rects[i].y + rects[i].h);
-        if (IsRectEmpty (&bound))
-            bound = rc;
-        else
-            GetBoundRect (&bound, &bound, &rc);
+        GAL_AddToDirtyRects (&this->hidden->dirty_rcs, &rc);
     }
+}
 
-    this->hidden->dirty_rc = bound;
+static size_t blit_rect_to_real (_THIS, const RECT *dirty_rc)
+{
+    GAL_Rect src_rect, dst_rect;
+    src_rect.x = dirty_rc->left;
+    src_rect.y = dirty_rc->top;
+    src_rect.w = RECTWP (dirty_rc);
+    src_rect.h = RECTHP (dirty_rc);
+    dst_rect = src_rect;
+
+    GAL_SetupBlitting (this->hidden->shadow_screen,
+            this->hidden->real_screen, 0);
+    GAL_BlitSurface (this->hidden->shadow_screen, &src_rect,
+            this->hidden->real_screen, &dst_rect);
+    GAL_CleanupBlitting (this->hidden->shadow_screen,
+            this->hidden->real_screen);
+#ifdef _MGSCHEMA_COMPOSITING
+    if (this->hidden->cursor) {
+        RECT csr_rc, eff_rc;
+        csr_rc.left = boxleft (this);
+        csr_rc.top = boxtop (this);
+        csr_rc.right = csr_rc.left + CURSORWIDTH;
+        csr_rc.bottom = csr_rc.top + CURSORHEIGHT;
+
+        if (IntersectRect (&eff_rc, &csr_rc, dirty_rc)) {
+            src_rect.x = eff_rc.left - csr_rc.left;
+            src_rect.y = eff_rc.top - csr_rc.top;
+            src_rect.w = RECTW (eff_rc);
+            src_rect.h = RECTH (eff_rc);
+
+            dst_rect.x = eff_rc.left;
+            dst_rect.y = eff_rc.top;
+            dst_rect.w = src_rect.w;
+            dst_rect.h = src_rect.h;
+            GAL_SetupBlitting (this->hidden->cursor,
+                    this->hidden->real_screen, 0);
+            GAL_BlitSurface (this->hidden->cursor, &src_rect,
+                    this->hidden->real_screen, &dst_rect);
+            GAL_CleanupBlitting (this->hidden->cursor,
+                    this->hidden->real_screen);
+        }
+    }
+#endif  /* _MGSCHEMA_COMPOSITING */
+
+    return (size_t)this->hidden->real_screen->format->BytesPerPixel *
+        RECTWP (dirty_rc) * RECTHP (dirty_rc);
 }
 
 /* Blit dirty content from shadow surface to ultimate surface */
-int shadowScreen_BlitToReal (_THIS, const RECT *dirty_rc)
+int shadowScreen_BlitToReal (_THIS, const GAL_DirtyRects *dirty_rcs)
 {
-    RECT bound;
-
     CHECK_VERSION_RETVAL (this, -1);
 
-    if (dirty_rc == NULL)
-        bound = this->hidden->dirty_rc;
-    else
-        bound = *dirty_rc;
-
-    if (this->hidden->real_screen) {
-        GAL_Rect src_rect, dst_rect;
-        src_rect.x = bound.left;
-        src_rect.y = bound.top;
-        src_rect.w = RECTW (bound);
-        src_rect.h = RECTH (bound);
-        dst_rect = src_rect;
-
-        GAL_SetupBlitting (this->hidden->shadow_screen,
-                this->hidden->real_screen, 0);
-        GAL_BlitSurface (this->hidden->shadow_screen, &src_rect,
-                this->hidden->real_screen, &dst_rect);
-        GAL_CleanupBlitting (this->hidden->shadow_screen,
-                this->hidden->real_screen);
-#ifdef _MGSCHEMA_COMPOSITING
-        if (this->hidden->cursor) {
-            RECT csr_rc, eff_rc;
-            csr_rc.left = boxleft (this);
-            csr_rc.top = boxtop (this);
-            csr_rc.right = csr_rc.left + CURSORWIDTH;
-            csr_rc.bottom = csr_rc.top + CURSORHEIGHT;
-
-            if (IntersectRect (&eff_rc, &csr_rc, &bound)) {
-                src_rect.x = eff_rc.left - csr_rc.left;
-                src_rect.y = eff_rc.top - csr_rc.top;
-                src_rect.w = RECTW (eff_rc);
-                src_rect.h = RECTH (eff_rc);
-
-                dst_rect.x = eff_rc.left;
-                dst_rect.y = eff_rc.top;
-                dst_rect.w = src_rect.w;
-                dst_rect.h = src_rect.h;
-                GAL_SetupBlitting (this->hidden->cursor,
-                        this->hidden->real_screen, 0);
-                GAL_BlitSurface (this->hidden->cursor, &src_rect,
-                        this->hidden->real_screen, &dst_rect);
-                GAL_CleanupBlitting (this->hidden->cursor,
-                        this->hidden->real_screen);
-            }
+    if (dirty_rcs == NULL)
+        dirty_rcs = &this->hidden->dirty_rcs;
+
+    if (this->hidden->real_screen && dirty_rcs->nr_rcs > 0) {
+        size_t bytes = 0;
+        int i;
+
+        for (i = 0; i < dirty_rcs->nr_rcs; i++) {
+            bytes += blit_rect_to_real (this, dirty_rcs->rcs + i);
         }
-#endif  /* _MGSCHEMA_COMPOSITING */
+
+        GAL_AccountUpdate (this, dirty_rcs->nr_rcs, bytes);
     }
 
     return 0;
@@ -714,6 +714,9 @@ update_helper(_THIS, GAL_VideoDevice *real_device, RECT *update_rect)
                 this->hidden->realfb_info, update_rect);
     }
 
+    GAL_AccountUpdate(this, 1, (size_t)dst_rc.w * dst_rc.h *
+            real_device->screen->format->BytesPerPixel);
+
     if (real_device->UpdateRects)
         real_device->UpdateRects(real_device, 1, &dst_rc);
     if (real_device->SyncUpdate)
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** simd.c: detect the SIMD instruction sets for the kernels of GAL.
+**
+** Create date: 2026/10/18
+*/
+
+#include "common.h"
+#include "simd.h"
+
+static Uint32 simd_features;
+static BOOL simd_features_detected;
+
+Uint32 GAL_GetSIMDFeatures (void)
+{
+    /* the detection is idempotent, so a race here is harmless */
+    if (MG_UNLIKELY (!simd_features_detected)) {
+        Uint32 features = 0;
+
+#ifdef _MG_HAVE_X86_KERNELS
+        __builtin_cpu_init ();
+#   ifdef __SSE2__
+        features |= GAL_SIMD_SSE2;
+#   else
+        if (__builtin_cpu_supports ("sse2"))
+            features |= GAL_SIMD_SSE2;
+#   endif
+        if (__builtin_cpu_supports ("avx2"))
+            features |= GAL_SIMD_AVX2;
+#endif
+
+        simd_features = features;
+        simd_features_detected = TRUE;
+    }
+
+    return simd_features;
+}
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** simd.h: the SIMD instruction sets for the kernels of GAL.
+**
+** Create date: 2026/10/18
+**
+** The fill, stretch and alpha blit kernels are compiled for x86 with the
+** target attributes of GCC and clang, and picked at runtime by the features
+** of the CPU, which are detected once here.
+*/
+
+#ifndef _GAL_simd_h
+#define _GAL_simd_h
+
+#include "common.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) \
+        && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) \
+            || defined(__clang__))
+#   define _MG_HAVE_X86_KERNELS 1
+#   define SSE2_TARGET          __attribute__ ((target ("sse2")))
+#   define AVX2_TARGET          __attribute__ ((target ("avx2")))
+#endif
+
+#define GAL_SIMD_SSE2           0x01
+#define GAL_SIMD_AVX2           0x02
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the SIMD instruction sets supported by both the kernels and
+   the CPU: a combination of GAL_SIMD_SSE2 and GAL_SIMD_AVX2. */
+Uint32 GAL_GetSIMDFeatures (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GAL_simd_h */
@@ -0,0 +1,709 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** stretch-engine.c: the software stretch engine.
+**
+** Create date: 2026/10/18
+**
+** The engine scales a source rectangle line by line. The bilinear filter
+** is separable: every source line is scaled horizontally once and cached,
+** then two scaled lines are blended vertically for a destination line.
+** The box filter accumulates the source pixels covered by a destination
+** pixel and averages them.
+**
+** All the channels are handled as bytes: the pixels of 32-bit formats are
+** processed in place, and the pixels of 16-bit and 24-bit formats are
+** expanded to four bytes before being processed.
+**
+** The inner loops are implemented as kernels, and the SSE2 kernels are
+** used when the CPU supports them (see simd.h).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "minigui.h"
+#include "newgal.h"
+
+#include "simd.h"
+
+#ifdef _MG_HAVE_X86_KERNELS
+#   include <emmintrin.h>
+#endif
+
+#define WEIGHT_BITS         8
+#define WEIGHT_ONE          (1 << WEIGHT_BITS)
+
+typedef struct _STRETCH_KERNELS {
+    const char* name;
+
+    /* dst [i] = lerp (src [xs [i]], src [xs [i] + 1], xw [i]) */
+    void (*lerp_h) (Uint32* dst, const Uint32* src,
+            const int* xs, const Uint16* xw, int n);
+
+    /* dst [i] = lerp (line0 [i], line1 [i], w) for n bytes */
+    void (*lerp_v) (Uint8* dst, const Uint8* line0, const Uint8* line1,
+            int w, int n);
+
+    /* acc [i * 4 + c] += byte c of src [xs [i]] ... src [xe [i] - 1] */
+    void (*box_h) (Uint32* acc, const Uint32* src,
+            const int* xs, const int* xe, int n);
+} STRETCH_KERNELS;
+
+static void lerp_h_c (Uint32* dst, const Uint32* src,
+        const int* xs, const Uint16* xw, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        Uint32 a = src [xs [i]], b = src [xs [i] + 1];
+        Uint32 w = xw [i];
+        Uint32 rb, ga;
+
+        /* two channels at a time; every channel has 16 bits of room */
+        rb = ((a & 0x00FF00FF) * (WEIGHT_ONE - w) +
+                (b & 0x00FF00FF) * w) >> WEIGHT_BITS;
+        ga = ((a >> 8) & 0x00FF00FF) * (WEIGHT_ONE - w) +
+                ((b >> 8) & 0x00FF00FF) * w;
+        dst [i] = (rb & 0x00FF00FF) | (ga & 0xFF00FF00);
+    }
+}
+
+static void lerp_v_c (Uint8* dst, const Uint8* line0, const Uint8* line1,
+        int w, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        dst [i] = (line0 [i] * (WEIGHT_ONE - w) + line1 [i] * w)
+                >> WEIGHT_BITS;
+    }
+}
+
+static void box_h_c (Uint32* acc, const Uint32* src,
+        const int* xs, const int* xe, int n)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        Uint32 s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+        for (j = xs [i]; j < xe [i]; j++) {
+            Uint32 p = src [j];
+            s0 += p & 0xFF;
+            s1 += (p >> 8) & 0xFF;
+            s2 += (p >> 16) & 0xFF;
+            s3 += p >> 24;
+        }
+
+        acc [0] += s0; acc [1] += s1; acc [2] += s2; acc [3] += s3;
+        acc += 4;
+    }
+}
+
+static const STRETCH_KERNELS c_kernels = {
+    "c", lerp_h_c, lerp_v_c, box_h_c
+};
+
+#ifdef _MG_HAVE_X86_KERNELS
+SSE2_TARGET
+static void lerp_h_sse2 (Uint32* dst, const Uint32* src,
+        const int* xs, const Uint16* xw, int n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    int i;
+
+    for (i = 0; i < n; i++) {
+        /* the two pixels a and b as eight 16-bit lanes */
+        __m128i ab = _mm_unpacklo_epi8 (
+                _mm_loadl_epi64 ((const __m128i*)(src + xs [i])), zero);
+        __m128i wv = _mm_unpacklo_epi64 (
+                _mm_set1_epi16 (WEIGHT_ONE - xw [i]), _mm_set1_epi16 (xw [i]));
+
+        ab = _mm_mullo_epi16 (ab, wv);
+        ab = _mm_add_epi16 (ab, _mm_srli_si128 (ab, 8));
+        ab = _mm_srli_epi16 (ab, WEIGHT_BITS);
+        dst [i] = _mm_cvtsi128_si32 (_mm_packus_epi16 (ab, ab));
+    }
+}
+
+SSE2_TARGET
+static void lerp_v_sse2 (Uint8* dst, const Uint8* line0, const Uint8* line1,
+        int w, int n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i w0 = _mm_set1_epi16 (WEIGHT_ONE - w);
+    const __m128i w1 = _mm_set1_epi16 (w);
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128 ((const __m128i*)(line0 + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i*)(line1 + i));
+        __m128i lo, hi;
+
+        lo = _mm_add_epi16 (
+                _mm_mullo_epi16 (_mm_unpacklo_epi8 (a, zero), w0),
+                _mm_mullo_epi16 (_mm_unpacklo_epi8 (b, zero), w1));
+        hi = _mm_add_epi16 (
+                _mm_mullo_epi16 (_mm_unpackhi_epi8 (a, zero), w0),
+                _mm_mullo_epi16 (_mm_unpackhi_epi8 (b, zero), w1));
+        lo = _mm_srli_epi16 (lo, WEIGHT_BITS);
+        hi = _mm_srli_epi16 (hi, WEIGHT_BITS);
+        _mm_storeu_si128 ((__m128i*)(dst + i), _mm_packus_epi16 (lo, hi));
+    }
+
+    if (i < n)
+        lerp_v_c (dst + i, line0 + i, line1 + i, w, n - i);
+}
+
+SSE2_TARGET
+static void box_h_sse2 (Uint32* acc, const Uint32* src,
+        const int* xs, const int* xe, int n)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        __m128i sum = _mm_loadu_si128 ((const __m128i*)acc);
+
+        for (j = xs [i]; j < xe [i]; j++) {
+            __m128i p = _mm_cvtsi32_si128 (src [j]);
+            p = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (p, zero), zero);
+            sum = _mm_add_epi32 (sum, p);
+        }
+
+        _mm_storeu_si128 ((__m128i*)acc, sum);
+        acc += 4;
+    }
+}
+
+static const STRETCH_KERNELS sse2_kernels = {
+    "sse2", lerp_h_sse2, lerp_v_sse2, box_h_sse2
+};
+#endif  /* defined _MG_HAVE_X86_KERNELS */
+
+static const STRETCH_KERNELS* stretch_kernels;
+
+static const STRETCH_KERNELS* get_kernels (void)
+{
+    /* the selection is idempotent, so a race here is harmless */
+    if (MG_UNLIKELY (stretch_kernels == NULL)) {
+        const STRETCH_KERNELS* kernels = &c_kernels;
+
+#ifdef _MG_HAVE_X86_KERNELS
+        if (GAL_GetSIMDFeatures () & GAL_SIMD_SSE2)
+            kernels = &sse2_kernels;
+#endif
+
+        stretch_kernels = kernels;
+    }
+
+    return stretch_kernels;
+}
+
+const char* GAL_GetStretchKernelsName (void)
+{
+    return get_kernels ()->name;
+}
+
+struct _GAL_StretchContext {
+    const STRETCH_KERNELS* kernels;
+
+    int filter;
+    int bpp;
+
+    const Uint8* src;
+    int src_pitch;
+    int src_w, src_h;
+    int dst_w, dst_h;
+
+    /* for the pixels of 16-bit formats */
+    Uint32 masks [4];
+    Uint8 shifts [4];
+    Uint8 picks [4];
+    Uint32 bits [4];
+    Uint8 expand [4][256];
+
+    /* the first (and the last for box filter) source pixels of columns */
+    int* xs;
+    int* xe;
+    /* the weights of columns for bilinear filter */
+    Uint16* xw;
+
+    /* the expanded source line; one more pixel for the padding */
+    Uint32* line;
+
+    /* the horizontally scaled lines for bilinear filter */
+    Uint32* hlines [2];
+    int hline_y [2];
+    int hline_x0 [2];
+    int hline_n [2];
+
+    /* the accumulators for box filter */
+    Uint32* acc;
+
+    /* the scaled line before being packed */
+    Uint32* out;
+};
+
+static void init_pixel_conversion (GAL_StretchContext* ctxt,
+        const GAL_PixelFormat* format)
+{
+    Uint32 masks [4] = { format->Rmask, format->Gmask,
+        format->Bmask, format->Amask };
+    Uint8 shifts [4] = { format->Rshift, format->Gshift,
+        format->Bshift, format->Ashift };
+    int c, v;
+
+    for (c = 0; c < 4; c++) {
+        int max, loss;
+
+        ctxt->masks [c] = masks [c];
+        ctxt->shifts [c] = shifts [c];
+        if (masks [c] == 0) {
+            memset (ctxt->expand [c], (c == 3) ? 0xFF : 0x00, 256);
+            continue;
+        }
+
+        max = masks [c] >> shifts [c];
+        for (loss = 8; max >> (8 - loss); loss--);
+        for (v = 0; v <= max && v < 256; v++)
+            ctxt->expand [c][v] = (v * 255 + max / 2) / max;
+
+        /* to get the bits of the channel from a 32-bit pixel */
+        ctxt->picks [c] = c * 8 + loss;
+        ctxt->bits [c] = max;
+    }
+}
+
+static inline Uint32 expand_pixel16 (const GAL_StretchContext* ctxt, Uint32 p)
+{
+    return ctxt->expand [0][(p & ctxt->masks [0]) >> ctxt->shifts [0]]
+        | (ctxt->expand [1][(p & ctxt->masks [1]) >> ctxt->shifts [1]] << 8)
+        | (ctxt->expand [2][(p & ctxt->masks [2]) >> ctxt->shifts [2]] << 16)
+        | ((Uint32)ctxt->expand [3][(p & ctxt->masks [3]) >> ctxt->shifts [3]]
+                << 24);
+}
+
+static inline Uint16 pack_pixel16 (const GAL_StretchContext* ctxt, Uint32 p)
+{
+    return (((p >> ctxt->picks [0]) & ctxt->bits [0]) << ctxt->shifts [0])
+        | (((p >> ctxt->picks [1]) & ctxt->bits [1]) << ctxt->shifts [1])
+        | (((p >> ctxt->picks [2]) & ctxt->bits [2]) << ctxt->shifts [2])
+        | (((p >> ctxt->picks [3]) & ctxt->bits [3]) << ctxt->shifts [3]);
+}
+
+/* returns the source line y as 32-bit pixels, padded by one pixel */
+static const Uint32* get_src_line (GAL_StretchContext* ctxt, int y)
+{
+    const Uint8* src = ctxt->src + ctxt->src_pitch * y;
+    Uint32* line = ctxt->line;
+    int x;
+
+    switch (ctxt->bpp) {
+    case 2:
+        for (x = 0; x < ctxt->src_w; x++)
+            line [x] = expand_pixel16 (ctxt, ((const Uint16*)src) [x]);
+        break;
+
+    case 3:
+        for (x = 0; x < ctxt->src_w; x++) {
+            line [x] = src [0] | (src [1] << 8) | (src [2] << 16);
+            src += 3;
+        }
+        break;
+
+    case 4:
+        /* the kernels never read the pixel after the last one unless
+           the source line has only one pixel */
+        if (ctxt->src_w > 1)
+            return (const Uint32*)src;
+        memcpy (line, src, ctxt->src_w * 4);
+        break;
+    }
+
+    line [ctxt->src_w] = line [ctxt->src_w - 1];
+    return line;
+}
+
+static void put_dst_line (GAL_StretchContext* ctxt, const Uint32* line,
+        int n, Uint8* dst)
+{
+    int x;
+
+    switch (ctxt->bpp) {
+    case 2:
+        for (x = 0; x < n; x++)
+            ((Uint16*)dst) [x] = pack_pixel16 (ctxt, line [x]);
+        break;
+
+    case 3:
+        for (x = 0; x < n; x++) {
+            *dst++ = line [x];
+            *dst++ = line [x] >> 8;
+            *dst++ = line [x] >> 16;
+        }
+        break;
+
+    case 4:
+        if ((Uint8*)line != dst)
+            memcpy (dst, line, n * 4);
+        break;
+    }
+}
+
+/* maps the center of the destination pixel to the source in 16.16 */
+static inline Sint64 map_center (int d, int src_len, int dst_len)
+{
+    return ((((Sint64)d << 1) + 1) * src_len << 16) / (dst_len << 1) - 0x8000;
+}
+
+static inline void map_linear (int d, int src_len, int dst_len,
+        int* s, int* w)
+{
+    Sint64 pos = map_center (d, src_len, dst_len);
+
+    if (pos < 0)
+        pos = 0;
+
+    *s = (int)(pos >> 16);
+    *w = (int)((pos & 0xFFFF) >> (16 - WEIGHT_BITS));
+
+    /* keep the second pixel in the source */
+    if (*s >= src_len - 1) {
+        if (src_len > 1) {
+            *s = src_len - 2;
+            *w = WEIGHT_ONE;
+        }
+        else {
+            *s = 0;
+            *w = 0;
+        }
+    }
+}
+
+static inline int map_nearest (int d, int src_len, int dst_len)
+{
+    int s = (int)((((Sint64)d << 1) + 1) * src_len / (dst_len << 1));
+    return (s < src_len) ? s : (src_len - 1);
+}
+
+static inline void map_box (int d, int src_len, int dst_len, int* s, int* e)
+{
+    *s = (int)((Sint64)d * src_len / dst_len);
+    *e = (int)((Sint64)(d + 1) * src_len / dst_len);
+    if (*e <= *s)
+        *e = *s + 1;
+}
+
+GAL_StretchContext* GAL_CreateStretchContext (const GAL_PixelFormat* format,
+        int filter, const Uint8* src, int src_pitch, int src_w, int src_h,
+        int dst_w, int dst_h)
+{
+    GAL_StretchContext* ctxt;
+    int bpp = format->BytesPerPixel;
+    int x;
+
+    if (src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0 ||
+            bpp < 1 || bpp > 4)
+        return NULL;
+
+    if (bpp == 1 || filter < GAL_STRETCH_NEAREST || filter > GAL_STRETCH_BOX)
+        filter = GAL_STRETCH_NEAREST;
+
+    /* the box filter is the nearest filter when enlarging */
+    if (filter == GAL_STRETCH_BOX && dst_w >= src_w && dst_h >= src_h)
+        filter = GAL_STRETCH_BILINEAR;
+
+    if ((ctxt = calloc (1, sizeof (GAL_StretchContext))) == NULL)
+        return NULL;
+
+    ctxt->kernels = get_kernels ();
+    ctxt->filter = filter;
+    ctxt->bpp = bpp;
+    ctxt->src = src;
+    ctxt->src_pitch = src_pitch;
+    ctxt->src_w = src_w;
+    ctxt->src_h = src_h;
+    ctxt->dst_w = dst_w;
+    ctxt->dst_h = dst_h;
+    ctxt->hline_y [0] = ctxt->hline_y [1] = -1;
+
+    if ((ctxt->xs = malloc (sizeof (int) * dst_w)) == NULL)
+        goto failed;
+
+    switch (filter) {
+    case GAL_STRETCH_NEAREST:
+        for (x = 0; x < dst_w; x++)
+            ctxt->xs [x] = map_nearest (x, src_w, dst_w);
+        return ctxt;
+
+    case GAL_STRETCH_BILINEAR:
+        ctxt->xw = malloc (sizeof (Uint16) * dst_w);
+        ctxt->hlines [0] = malloc (sizeof (Uint32) * dst_w);
+        ctxt->hlines [1] = malloc (sizeof (Uint32) * dst_w);
+        if (ctxt->xw == NULL || ctxt->hlines [0] == NULL ||
+                ctxt->hlines [1] == NULL)
+            goto failed;
+
+        for (x = 0; x < dst_w; x++) {
+            int w;
+            map_linear (x, src_w, dst_w, ctxt->xs + x, &w);
+            ctxt->xw [x] = w;
+        }
+        break;
+
+    case GAL_STRETCH_BOX:
+        ctxt->xe = malloc (sizeof (int) * dst_w);
+        ctxt->acc = malloc (sizeof (Uint32) * 4 * dst_w);
+        if (ctxt->xe == NULL || ctxt->acc == NULL)
+            goto failed;
+
+        for (x = 0; x < dst_w; x++)
+            map_box (x, src_w, dst_w, ctxt->xs + x, ctxt->xe + x);
+        break;
+    }
+
+    ctxt->line = malloc (sizeof (Uint32) * (src_w + 1));
+    ctxt->out = malloc (sizeof (Uint32) * dst_w);
+    if (ctxt->line == NULL || ctxt->out == NULL)
+        goto failed;
+
+    if (bpp == 2)
+        init_pixel_conversion (ctxt, format);
+
+    return ctxt;
+
+failed:
+    GAL_DestroyStretchContext (ctxt);
+    return NULL;
+}
+
+void GAL_DestroyStretchContext (GAL_StretchContext* ctxt)
+{
+    free (ctxt->xs);
+    free (ctxt->xe);
+    free (ctxt->xw);
+    free (ctxt->line);
+    free (ctxt->hlines [0]);
+    free (ctxt->hlines [1]);
+    free (ctxt->acc);
+    free (ctxt->out);
+    free (ctxt);
+}
+
+static void stretch_line_nearest (GAL_StretchContext* ctxt, int y,
+        int x0, int n, Uint8* dst)
+{
+    const Uint8* src = ctxt->src +
+        ctxt->src_pitch * map_nearest (y, ctxt->src_h, ctxt->dst_h);
+    const int* xs = ctxt->xs + x0;
+    int x;
+
+    switch (ctxt->bpp) {
+    case 1:
+        for (x = 0; x < n; x++)
+            dst [x] = src [xs [x]];
+        break;
+
+    case 2:
+        for (x = 0; x < n; x++)
+            ((Uint16*)dst) [x] = ((const Uint16*)src) [xs [x]];
+        break;
+
+    case 3:
+        for (x = 0; x < n; x++) {
+            const Uint8* p = src + xs [x] * 3;
+            *dst++ = p [0];
+            *dst++ = p [1];
+            *dst++ = p [2];
+        }
+        break;
+
+    case 4:
+        for (x = 0; x < n; x++)
+            ((Uint32*)dst) [x] = ((const Uint32*)src) [xs [x]];
+        break;
+    }
+}
+
+/* returns the source line y scaled horizontally; two lines are cached */
+static const Uint32* get_hline (GAL_StretchContext* ctxt, int y, int other_y,
+        int x0, int n)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (ctxt->hline_y [i] == y && ctxt->hline_x0 [i] == x0 &&
+                ctxt->hline_n [i] == n)
+            return ctxt->hlines [i];
+    }
+
+    /* do not evict the other line in use */
+    i = (ctxt->hline_y [0] == other_y && ctxt->hline_x0 [0] == x0 &&
+            ctxt->hline_n [0] == n) ? 1 : 0;
+
+    ctxt->kernels->lerp_h (ctxt->hlines [i], get_src_line (ctxt, y),
+            ctxt->xs + x0, ctxt->xw + x0, n);
+    ctxt->hline_y [i] = y;
+    ctxt->hline_x0 [i] = x0;
+    ctxt->hline_n [i] = n;
+    return ctxt->hlines [i];
+}
+
+static void stretch_line_bilinear (GAL_StretchContext* ctxt, int y,
+        int x0, int n, Uint8* dst)
+{
+    const Uint32* line0;
+    const Uint32* line1;
+    Uint32* out = (ctxt->bpp == 4) ? (Uint32*)dst : ctxt->out;
+    int sy, w;
+
+    map_linear (y, ctxt->src_h, ctxt->dst_h, &sy, &w);
+
+    if (w == 0) {
+        line0 = get_hline (ctxt, sy, -1, x0, n);
+        put_dst_line (ctxt, line0, n, dst);
+    }
+    else if (w == WEIGHT_ONE) {
+        line1 = get_hline (ctxt, sy + 1, -1, x0, n);
+        put_dst_line (ctxt, line1, n, dst);
+    }
+    else {
+        line0 = get_hline (ctxt, sy, sy + 1, x0, n);
+        line1 = get_hline (ctxt, sy + 1, sy, x0, n);
+        ctxt->kernels->lerp_v ((Uint8*)out,
+                (const Uint8*)line0, (const Uint8*)line1, w, n * 4);
+        put_dst_line (ctxt, out, n, dst);
+    }
+}
+
+static void stretch_line_box (GAL_StretchContext* ctxt, int y,
+        int x0, int n, Uint8* dst)
+{
+    const int* xs = ctxt->xs + x0;
+    const int* xe = ctxt->xe + x0;
+    Uint32* out = (ctxt->bpp == 4) ? (Uint32*)dst : ctxt->out;
+    Uint32* acc = ctxt->acc;
+    int sy, ey, j, x;
+
+    map_box (y, ctxt->src_h, ctxt->dst_h, &sy, &ey);
+
+    memset (acc, 0, sizeof (Uint32) * 4 * n);
+    for (j = sy; j < ey; j++)
+        ctxt->kernels->box_h (acc, get_src_line (ctxt, j), xs, xe, n);
+
+    for (x = 0; x < n; x++) {
+        Uint32 count = (xe [x] - xs [x]) * (ey - sy);
+        Uint32 half = count >> 1;
+
+        out [x] = ((acc [0] + half) / count)
+            | (((acc [1] + half) / count) << 8)
+            | (((acc [2] + half) / count) << 16)
+            | (((acc [3] + half) / count) << 24);
+        acc += 4;
+    }
+
+    put_dst_line (ctxt, out, n, dst);
+}
+
+void GAL_StretchLine (GAL_StretchContext* ctxt, int y, int x0, int x1,
+        Uint8* dst)
+{
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 > ctxt->dst_w)
+        x1 = ctxt->dst_w;
+    if (y < 0 || y >= ctxt->dst_h || x0 >= x1)
+        return;
+
+    switch (ctxt->filter) {
+    case GAL_STRETCH_BILINEAR:
+        stretch_line_bilinear (ctxt, y, x0, x1 - x0, dst);
+        break;
+
+    case GAL_STRETCH_BOX:
+        stretch_line_box (ctxt, y, x0, x1 - x0, dst);
+        break;
+
+    default:
+        stretch_line_nearest (ctxt, y, x0, x1 - x0, dst);
+        break;
+    }
+}
+
+int GAL_StretchPixels (const GAL_PixelFormat* format, int filter,
+        const Uint8* src, int src_pitch, int src_w, int src_h,
+        Uint8* dst, int dst_pitch, int dst_w, int dst_h,
+        const GAL_Rect* clip)
+{
+    GAL_StretchContext* ctxt;
+    GAL_Rect rc = { 0, 0, dst_w, dst_h };
+    int y;
+
+    if (clip) {
+        GAL_Rect full = rc;
+        if (!GAL_IntersectRect (&full, clip, &rc))
+            return 0;
+    }
+
+    ctxt = GAL_CreateStretchContext (format, filter,
+            src, src_pitch, src_w, src_h, dst_w, dst_h);
+    if (ctxt == NULL)
+        return -1;
+
+    dst += dst_pitch * rc.y + format->BytesPerPixel * rc.x;
+    for (y = rc.y; y < rc.y + rc.h; y++) {
+        GAL_StretchLine (ctxt, y, rc.x, rc.x + rc.w, dst);
+        dst += dst_pitch;
+    }
+
+    GAL_DestroyStretchContext (ctxt);
+    return 0;
+}
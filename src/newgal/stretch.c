@@ -50,66 +50,40 @@
 #include "newgal.h"
 #include "blit.h"
 
-#define DEFINE_COPY_ROW(name, type)                             \
-static void name(type *src, int src_w, type *dst, int dst_w)    \
-{                                                               \
-    int i;                                                      \
-    int pos, inc;                                               \
-    type pixel = 0;                                             \
-                                                                \
-    pos = 0x10000;                                              \
-    inc = (src_w << 16) / dst_w;                                \
-    for ( i=dst_w; i>0; --i ) {                                 \
-        while ( pos >= 0x10000L ) {                             \
-            pixel = *src++;                                     \
-            pos -= 0x10000L;                                    \
-        }                                                       \
-        *dst++ = pixel;                                         \
-        pos += inc;                                             \
-    }                                                           \
-}
-
-DEFINE_COPY_ROW(copy_row1, Uint8)
-DEFINE_COPY_ROW(copy_row2, Uint16)
-DEFINE_COPY_ROW(copy_row4, Uint32)
-
-/* The ASM code doesn't handle 24-bpp stretch blits */
-static void copy_row3(Uint8 *src, int src_w, Uint8 *dst, int dst_w)
+/* Get the filter of the software stretch engine from the blit operations */
+static int get_stretch_filter (GAL_Surface *src, DWORD ops)
 {
-    int i;
-    int pos, inc;
-    Uint8 pixel[3] = {};
-
-    pos = 0x10000;
-    inc = (src_w << 16) / dst_w;
-    for ( i=dst_w; i>0; --i ) {
-        while ( pos >= 0x10000L ) {
-            pixel[0] = *src++;
-            pixel[1] = *src++;
-            pixel[2] = *src++;
-            pos -= 0x10000L;
-        }
-        *dst++ = pixel[0];
-        *dst++ = pixel[1];
-        *dst++ = pixel[2];
-        pos += inc;
+    /* do not mix the colorkey with other pixels */
+    if (src->flags & GAL_SRCCOLORKEY)
+        return GAL_STRETCH_NEAREST;
+
+    switch (ops & SCALING_FILTER_MASK) {
+    case SCALING_FILTER_GOOD:
+    case SCALING_FILTER_BILINEAR:
+        return GAL_STRETCH_BILINEAR;
+
+    case SCALING_FILTER_BEST:
+    case SCALING_FILTER_CONVOLUTION:
+        return GAL_STRETCH_BOX;
     }
+
+    return GAL_STRETCH_NEAREST;
 }
 
 /* Perform a stretch blit between two surfaces of the same format.
-   NOTE:  This function is not safe to call from multiple threads!
+   Only the pixels in clip (in the destination surface) will be changed
+   if clip is not NULL.
+
+   Since 5.0.16, this function uses the software stretch engine,
+   and it is re-entrant.
 */
 static int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
-                    GAL_Surface *dst, GAL_Rect *dstrect)
+                    GAL_Surface *dst, GAL_Rect *dstrect,
+                    const GAL_Rect *clip, int filter)
 {
-    int pos, inc;
-    int dst_maxrow;
-    int src_row, dst_row;
-    Uint8 *srcp = NULL;
-    Uint8 *dstp;
     GAL_Rect full_src;
     GAL_Rect full_dst;
-    const int bpp = dst->format->BytesPerPixel;
+    GAL_Rect rel_clip;
 
     if ( src->format->BitsPerPixel != dst->format->BitsPerPixel ) {
         GAL_SetError("NEWGAL: Only works with same format surfaces.\n");
@@ -147,59 +121,35 @@ static int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
         dstrect = &full_dst;
     }
 
-    /* Set up the data... */
-    pos = 0x10000;
-    inc = (srcrect->h << 16) / dstrect->h;
-    src_row = srcrect->y;
-    dst_row = dstrect->y;
-
-    /* Perform the stretch blit */
-    for ( dst_maxrow = dst_row+dstrect->h; dst_row<dst_maxrow; ++dst_row ) {
-        dstp = (Uint8 *)dst->pixels + (dst_row*dst->pitch)
-                                    + (dstrect->x*bpp);
-        while ( pos >= 0x10000L ) {
-            srcp = (Uint8 *)src->pixels + (src_row*src->pitch)
-                                        + (srcrect->x*bpp);
-            ++src_row;
-            pos -= 0x10000L;
-        }
-        switch (bpp) {
-            case 1:
-            copy_row1(srcp, srcrect->w, dstp, dstrect->w);
-            break;
-            case 2:
-            copy_row2((Uint16 *)srcp, srcrect->w,
-                      (Uint16 *)dstp, dstrect->w);
-            break;
-            case 3:
-            copy_row3(srcp, srcrect->w, dstp, dstrect->w);
-            break;
-            case 4:
-            copy_row4((Uint32 *)srcp, srcrect->w,
-                      (Uint32 *)dstp, dstrect->w);
-            break;
-        }
-        pos += inc;
+    if (clip) {
+        rel_clip.x = clip->x - dstrect->x;
+        rel_clip.y = clip->y - dstrect->y;
+        rel_clip.w = clip->w;
+        rel_clip.h = clip->h;
+        clip = &rel_clip;
     }
-    return(0);
+
+    return GAL_StretchPixels (dst->format, filter,
+            (Uint8 *)src->pixels + srcrect->y * src->pitch
+                + srcrect->x * src->format->BytesPerPixel,
+            src->pitch, srcrect->w, srcrect->h,
+            (Uint8 *)dst->pixels + dstrect->y * dst->pitch
+                + dstrect->x * dst->format->BytesPerPixel,
+            dst->pitch, dstrect->w, dstrect->h, clip);
 }
 
-static void GAL_SoftStretchHelper (GAL_Surface *src, GAL_Rect *srcrect,
-        GAL_Surface *dst, GAL_Rect *dstrect, DWORD op)
+GAL_Surface* GAL_CreateScaledSurface (GAL_Surface *src, int w, int h)
 {
     GAL_Surface *new_surf;
-    GAL_Rect new_rc = { 0, 0, dstrect->w, dstrect->h };
 
-    new_surf = GAL_CreateRGBSurface (GAL_SWSURFACE, dstrect->w, dstrect->h,
+    new_surf = GAL_CreateRGBSurface (GAL_SWSURFACE, w, h,
             GAL_BitsPerPixel(src),
             GAL_RMask(src), GAL_GMask(src), GAL_BMask(src), GAL_AMask(src));
     if (new_surf == NULL) {
         _WRN_PRINTF ("Failed to create a software surface\n");
-        return;
+        return NULL;
     }
 
-    GAL_SoftStretch (src, srcrect, new_surf, &new_rc);
-
     if ((src->flags & GAL_SRCALPHA) == GAL_SRCALPHA) {
         new_surf->flags |= GAL_SRCALPHA;
         new_surf->format->alpha = src->format->alpha;
@@ -211,52 +161,74 @@ static void GAL_SoftStretchHelper (GAL_Surface *src, GAL_Rect *srcrect,
         new_surf->flags |= GAL_SRCCOLORKEY;
         new_surf->format->colorkey = src->format->colorkey;
     }
-    GAL_UpperBlit (new_surf, &new_rc, dst, dstrect, op);
-    GAL_FreeSurface (new_surf);
+
+    return new_surf;
 }
 
-static int GAL_StretchBltLegacy (GAL_Surface *src, GAL_Rect *srcrect,
-        GAL_Surface *dst, GAL_Rect *dstrect, DWORD op)
+/* Since 5.0.16, scale the whole rectangle but only blit the pixels in
+   the clipping rectangle, so the result does not depend on the clipping
+   rectangles, like the stretch blits between the same formats. */
+static void GAL_SoftStretchHelper (GAL_Surface *src, GAL_Rect *srcrect,
+        GAL_Surface *dst, GAL_Rect *dstrect, GAL_Rect *clip, DWORD op)
 {
-    GAL_Rect clipped_srcrect, clipped_dstrect;
-
-    if (dstrect->x >= dst->clip_rect.x &&
-            dstrect->y >= dst->clip_rect.y &&
-            dstrect->x + dstrect->w <= dst->clip_rect.x + dst->clip_rect.w &&
-            dstrect->y + dstrect->h <= dst->clip_rect.y + dst->clip_rect.h) {
-        clipped_srcrect = *srcrect;
-        clipped_dstrect = *dstrect;
+    GAL_Surface *new_surf;
+    GAL_StretchContext *ctxt;
+    GAL_Rect new_rc = { 0, 0, clip->w, clip->h };
+    int y;
+
+    ctxt = GAL_CreateStretchContext (src->format, get_stretch_filter (src, op),
+            (Uint8 *)src->pixels + srcrect->y * src->pitch
+                + srcrect->x * src->format->BytesPerPixel,
+            src->pitch, srcrect->w, srcrect->h, dstrect->w, dstrect->h);
+    if (ctxt == NULL)
+        return;
+
+    new_surf = GAL_CreateScaledSurface (src, clip->w, clip->h);
+    if (new_surf == NULL) {
+        GAL_DestroyStretchContext (ctxt);
+        return;
     }
-    else if (GAL_IntersectRect (dstrect, &dst->clip_rect, &clipped_dstrect)) {
-        float ratio_x = (dstrect->x + dstrect->w - clipped_dstrect.x) * 1.0f / dstrect->w;
-        float ratio_y = (dstrect->y + dstrect->h - clipped_dstrect.y) * 1.0f / dstrect->h;
 
-        clipped_srcrect.x = srcrect->x + srcrect->w * (1.0f - ratio_x);
-        clipped_srcrect.y = srcrect->y + srcrect->h * (1.0f - ratio_y);
+    for (y = 0; y < clip->h; y++) {
+        GAL_StretchLine (ctxt, clip->y - dstrect->y + y,
+                clip->x - dstrect->x, clip->x - dstrect->x + clip->w,
+                (Uint8 *)new_surf->pixels + y * new_surf->pitch);
+    }
+    GAL_DestroyStretchContext (ctxt);
 
-        ratio_x = (clipped_dstrect.w) * 1.0f / dstrect->w;
-        ratio_y = (clipped_dstrect.h) * 1.0f / dstrect->h;
-        clipped_srcrect.w = (srcrect->w * ratio_x);
-        clipped_srcrect.h = (srcrect->h * ratio_y);
+    GAL_UpperBlit (new_surf, &new_rc, dst, clip, op);
+    GAL_FreeSurface (new_surf);
+}
 
-        if (clipped_srcrect.w <= 0 || clipped_srcrect.h <= 0 ||
-                clipped_dstrect.w <= 0 || clipped_dstrect.h <= 0)
-            return -1;
-    }
-    else {
+static int GAL_StretchBltLegacy (GAL_Surface *src, GAL_Rect *srcrect,
+        GAL_Surface *dst, GAL_Rect *dstrect, DWORD op)
+{
+    GAL_Rect clipped_dstrect;
+
+    if (!GAL_IntersectRect (dstrect, &dst->clip_rect, &clipped_dstrect))
         return -1;
-    }
 
     if (GAL_RMask (src) != GAL_RMask (dst)
             || GAL_GMask (src) != GAL_GMask (dst)
             || GAL_BMask (src) != GAL_BMask (dst)
             || GAL_AMask (src) != GAL_AMask (dst)) {
-        GAL_SoftStretchHelper (src, &clipped_srcrect, dst, &clipped_dstrect, op);
+        if (srcrect->x < 0 || srcrect->y < 0 ||
+                srcrect->w <= 0 || srcrect->h <= 0 ||
+                srcrect->x + srcrect->w > src->w ||
+                srcrect->y + srcrect->h > src->h ||
+                dstrect->w <= 0 || dstrect->h <= 0)
+            return -1;
+
+        GAL_SoftStretchHelper (src, srcrect, dst, dstrect,
+                &clipped_dstrect, op);
         return 0;
     }
 
-    GAL_SoftStretch (src, &clipped_srcrect, dst, &clipped_dstrect);
-    return 0;
+    /* Since 5.0.16, scale the whole rectangle but only output the pixels
+       in the clipping rectangle, so the result does not depend on
+       the clipping rectangles. */
+    return GAL_SoftStretch (src, srcrect, dst, dstrect, &clipped_dstrect,
+            get_stretch_filter (src, op));
 }
 
 #ifdef _MGUSE_PIXMAN
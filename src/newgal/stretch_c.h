@@ -45,8 +45,9 @@
  */
 
 /* Perform a stretch blit between two surfaces of the same format.
-   NOTE:  This function is not safe to call from multiple threads!
+   Only the pixels in clip will be changed if clip is not NULL.
 */
 extern int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
-                           GAL_Surface *dst, GAL_Rect *dstrect);
+                           GAL_Surface *dst, GAL_Rect *dstrect,
+                           const GAL_Rect *clip, int filter);
 
@@ -109,6 +109,7 @@ GAL_Surface * GAL_CreateCursorSurface (GAL_VideoDevice *video,
 #endif
     surface->shared_header = NULL;
     surface->dirty_info = NULL;
+    surface->dirty_word = NULL;
     GAL_SetClipRect (surface, NULL);
 
 #ifdef _MGUSE_UPDATE_REGION
@@ -143,6 +143,7 @@ GAL_Surface *GAL_CreateSharedRGBSurface (GAL_VideoDevice *video,
 #endif
     surface->shared_header = NULL;
     surface->dirty_info = NULL;
+    surface->dirty_word = NULL;
     surface->fd = -1;
     GAL_SetClipRect (surface, NULL);
 
@@ -374,6 +375,7 @@ GAL_Surface * GAL_AttachSharedRGBSurface (GAL_VideoDevice *video,
     surface->flags = flags & ~GAL_FORMAT_CHECKED;
 
     surface->shared_header = NULL;
+    surface->dirty_word = NULL;
     surface->hwdata = NULL;
     surface->fd = fd;
 
@@ -411,6 +413,7 @@ GAL_Surface * GAL_AttachSharedRGBSurface (GAL_VideoDevice *video,
 
     surface->dirty_info = &hdr->dirty_info;
     surface->pixels = (uint8_t*)hdr + hdr->pixels_off;
+    surface->flags |= hdr->shared_flags & GAL_PREMULTIPLIED;
     surface->format = GAL_AllocFormat (hdr->depth,
             hdr->Rmask, hdr->Gmask, hdr->Bmask, hdr->Amask);
     if (surface->format == NULL) {
@@ -496,7 +499,8 @@ void GAL_DetachSharedSurfaceData (GAL_Surface *surface)
 static inline
 GAL_Surface *create_surface_for_znode (GAL_VideoDevice* video,
         int width, int height, int bpp,
-        Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask)
+        Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask,
+        BOOL premultiplied)
 {
     GAL_Surface * surface;
 
@@ -515,12 +519,20 @@ GAL_Surface *create_surface_for_znode (GAL_VideoDevice* video,
                 return (NULL);
             }
         }
+    }
+    else {
+        surface = GAL_CreateSharedRGBSurface (video, GAL_HWSURFACE, 0600,
+                width, height, bpp, Rmask, Gmask, Bmask, Amask);
+    }
 
-        return surface;
+    if (surface && premultiplied && Amask) {
+        surface->flags |= GAL_PREMULTIPLIED;
+        /* tell the compositor how to blend the surface */
+        if (surface->shared_header)
+            surface->shared_header->shared_flags |= GAL_PREMULTIPLIED;
     }
 
-    return GAL_CreateSharedRGBSurface (video,
-        GAL_HWSURFACE, 0600, width, height, bpp, Rmask, Gmask, Bmask, Amask);
+    return surface;
 }
 
 GAL_Surface *GAL_CreateSurfaceForZNodeAs (const GAL_Surface* ref_surf,
@@ -529,7 +541,8 @@ GAL_Surface *GAL_CreateSurfaceForZNodeAs (const GAL_Surface* ref_surf,
     return create_surface_for_znode (__gal_screen->video,
             width, height, ref_surf->format->BitsPerPixel,
             ref_surf->format->Rmask, ref_surf->format->Gmask,
-            ref_surf->format->Bmask, ref_surf->format->Amask);
+            ref_surf->format->Bmask, ref_surf->format->Amask,
+            ref_surf->flags & GAL_PREMULTIPLIED);
 }
 
 GAL_Surface *GAL_CreateSurfaceForZNode (unsigned surf_flag, int width, int height)
@@ -582,7 +595,8 @@ GAL_Surface *GAL_CreateSurfaceForZNode (unsigned surf_flag, int width, int heigh
     }
 
     return create_surface_for_znode (__gal_screen->video,
-            width, height, bpp, Rmask, Gmask, Bmask, Amask);
+            width, height, bpp, Rmask, Gmask, Bmask, Amask,
+            surf_flag & ST_PREMULTIPLIED);
 }
 
 #endif /* IS_COMPOSITING_SCHEMA */
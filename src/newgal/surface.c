@@ -49,6 +49,7 @@
 #include <string.h>
 
 #include "common.h"
+#include "minigui.h"
 #include "newgal.h"
 #include "sysvideo.h"
 #include "blit.h"
@@ -61,6 +62,14 @@
 #include <sys/mman.h>   /* for munmap */
 #endif  /* _MGRM_PROCESSES */
 
+#ifndef __NOUNIX__
+#   include <unistd.h>
+#   include <pthread.h>
+#   ifdef _SC_NPROCESSORS_ONLN
+#       define _MG_GAL_WORKERS  1
+#   endif
+#endif
+
 /* Public routines */
 /*
  * Create an empty RGB surface of the appropriate depth
@@ -149,6 +158,7 @@ GAL_Surface * GAL_CreateRGBSurface (Uint32 flags,
 #if IS_COMPOSITING_SCHEMA
     surface->shared_header = NULL;
     surface->dirty_info = NULL;
+    surface->dirty_word = NULL;
 #endif
     GAL_SetClipRect(surface, NULL);
 
@@ -661,7 +671,8 @@ done:
     return 0;
 }
 
-static void GAL_SoftFillRect (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
+static void soft_fill_rect (GAL_Surface *dst, const GAL_Rect *dstrect,
+        Uint32 color, int fillop)
 {
     int x, y;
     Uint8 *row;
@@ -669,6 +680,12 @@ static void GAL_SoftFillRect (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32
     row = (Uint8 *)dst->pixels + dst->pixels_off + dstrect->y * dst->pitch +
             dstrect->x * dst->format->BytesPerPixel;
 
+    /* Since 5.0.16, use the SIMD fill kernels if there are */
+    if (!dst->format->palette && GAL_FillSpans (row, dst->pitch,
+                dst->format->BytesPerPixel, color, fillop,
+                dstrect->w, dstrect->h))
+        return;
+
     if (dst->format->palette || (color == 0)) {
         x = dstrect->w*dst->format->BytesPerPixel;
         if (!color && !((long)row&3) && !(x&3) && !(dst->pitch&3)) {
@@ -728,6 +745,251 @@ static void GAL_SoftFillRect (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32
     }
 }
 
+static int get_fill_op (GAL_Surface *dst, const GAL_Rect *dstrect)
+{
+    size_t bytes = (size_t)dstrect->w * dstrect->h
+        * dst->format->BytesPerPixel;
+
+    return GAL_IsLargeFill (bytes) ?
+        (GAL_FILLOP_SET | GAL_FILLOP_STREAM) : GAL_FILLOP_SET;
+}
+
+/* Since 5.0.16, this function is also used by the tiled compositor. */
+void GAL_SoftFillRect (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
+{
+    soft_fill_rect (dst, dstrect, color, get_fill_op (dst, dstrect));
+}
+
+/*
+ * Since 5.0.16, the large jobs of the graphics engine are split into parts
+ * done by a pool of persistent worker threads and the caller, for a single
+ * core may not use the whole memory bandwidth.
+ */
+#define MAX_GAL_WORKERS         8
+
+/* It is only called for the large jobs, so the knob is not cached. */
+int GAL_GetNrWorkerThreads (void)
+{
+    char *env;
+    int nr_threads = 0;
+
+    if ((env = getenv ("MG_WORKER_THREADS"))) {
+        nr_threads = atoi (env);
+    }
+    else if (GetMgEtcIntValue ("system", "worker_threads", &nr_threads) < 0) {
+        nr_threads = 0;
+    }
+
+#ifdef _MG_GAL_WORKERS
+    if (nr_threads <= 0)
+        nr_threads = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+    return (nr_threads > 0) ? nr_threads : 1;
+}
+
+#ifdef _MG_GAL_WORKERS
+
+typedef struct _GALWORKERS {
+    /* held by the thread using the pool; others do their jobs by themselves */
+    pthread_mutex_t busy;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond_start;
+    pthread_cond_t  cond_done;
+    unsigned int    job;
+    int             nr_running; /* the number of workers still running */
+
+    /* the number of worker threads, and -1 if none could be started */
+    int             nr_workers;
+    pid_t           pid;        /* the process which started the pool */
+
+    /* the current job; the parts are taken in order */
+    CB_GAL_WORKER_JOB cb;
+    void*           context;
+    int             nr_parts;
+    int             next_part;
+} GALWORKERS;
+
+static GALWORKERS gal_workers = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+};
+
+/* Called with gal_workers.lock held; returns with it held. */
+static void do_worker_parts (void)
+{
+    while (gal_workers.next_part < gal_workers.nr_parts) {
+        int part = gal_workers.next_part++;
+
+        pthread_mutex_unlock (&gal_workers.lock);
+        gal_workers.cb (gal_workers.context, part);
+        pthread_mutex_lock (&gal_workers.lock);
+    }
+}
+
+static void* gal_worker_entry (void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    /* the workers are started before the first job */
+    unsigned int job = 0;
+
+    pthread_mutex_lock (&gal_workers.lock);
+    while (1) {
+        while (gal_workers.job == job)
+            pthread_cond_wait (&gal_workers.cond_start, &gal_workers.lock);
+
+        job = gal_workers.job;
+        /* the caller takes a part too */
+        if (index >= gal_workers.nr_parts - 1)
+            continue;
+
+        do_worker_parts ();
+        if (--gal_workers.nr_running == 0)
+            pthread_cond_signal (&gal_workers.cond_done);
+    }
+
+    return NULL;
+}
+
+/* Called with gal_workers.busy held; the workers live with the process. */
+static void start_gal_workers (void)
+{
+    pthread_attr_t attr;
+    int i, nr_threads = GAL_GetNrWorkerThreads () - 1;
+
+    if (nr_threads > MAX_GAL_WORKERS)
+        nr_threads = MAX_GAL_WORKERS;
+
+    gal_workers.pid = getpid ();
+    gal_workers.nr_workers = 0;
+
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < nr_threads; i++) {
+        pthread_t th;
+
+        if (pthread_create (&th, &attr, gal_worker_entry,
+                    (void *)(intptr_t)i)) {
+            _WRN_PRINTF ("failed to create GAL worker: %d\n", i);
+            break;
+        }
+
+        gal_workers.nr_workers++;
+    }
+    pthread_attr_destroy (&attr);
+
+    if (gal_workers.nr_workers == 0)
+        gal_workers.nr_workers = -1;
+
+    _DBG_PRINTF ("large jobs use %d worker threads\n", gal_workers.nr_workers);
+}
+
+#endif /* _MG_GAL_WORKERS */
+
+void GAL_RunWorkerJob (CB_GAL_WORKER_JOB cb, void *context, int nr_parts)
+{
+    int i;
+
+#ifdef _MG_GAL_WORKERS
+    if (nr_parts > 1 && pthread_mutex_trylock (&gal_workers.busy) == 0) {
+        if (gal_workers.nr_workers == 0)
+            start_gal_workers ();
+
+        /* the workers are not inherited by a child process */
+        if (gal_workers.nr_workers > 0 && gal_workers.pid == getpid ()) {
+            pthread_mutex_lock (&gal_workers.lock);
+            gal_workers.cb = cb;
+            gal_workers.context = context;
+            gal_workers.nr_parts = nr_parts;
+            gal_workers.next_part = 0;
+            gal_workers.nr_running = MIN (nr_parts - 1,
+                    gal_workers.nr_workers);
+            gal_workers.job++;
+            pthread_cond_broadcast (&gal_workers.cond_start);
+
+            do_worker_parts ();
+            while (gal_workers.nr_running > 0)
+                pthread_cond_wait (&gal_workers.cond_done, &gal_workers.lock);
+            pthread_mutex_unlock (&gal_workers.lock);
+
+            pthread_mutex_unlock (&gal_workers.busy);
+            return;
+        }
+
+        pthread_mutex_unlock (&gal_workers.busy);
+    }
+#endif /* _MG_GAL_WORKERS */
+
+    for (i = 0; i < nr_parts; i++)
+        cb (context, i);
+}
+
+/*
+ * Since 5.0.16, a very large fill is done by bands of lines in the
+ * worker threads; see GAL_RunWorkerJob.
+ */
+#define MAX_FILL_BANDS          4
+#define MIN_THREADED_FILL_BYTES (4 << 20)
+#define MIN_FILL_BAND_LINES     64
+
+typedef struct _FILLJOB {
+    GAL_Surface *dst;
+    const GAL_Rect *rect;
+    Uint32 color;
+    int fillop;
+    int nr_bands;
+} FILLJOB;
+
+static void fill_band (void *context, int part)
+{
+    FILLJOB *job = context;
+    GAL_Rect band;
+    int y = job->rect->h * part / job->nr_bands;
+
+    band.x = job->rect->x;
+    band.y = job->rect->y + y;
+    band.w = job->rect->w;
+    band.h = job->rect->h * (part + 1) / job->nr_bands - y;
+    soft_fill_rect (job->dst, &band, job->color, job->fillop);
+}
+
+/* Returns FALSE if the rectangle is not worth filling in threads. */
+static BOOL threaded_fill_rect (GAL_Surface *dst, const GAL_Rect *dstrect,
+        Uint32 color)
+{
+    FILLJOB job;
+    size_t bytes;
+
+    bytes = (size_t)dstrect->w * dstrect->h * dst->format->BytesPerPixel;
+    if (bytes < MIN_THREADED_FILL_BYTES)
+        return FALSE;
+
+    job.nr_bands = MIN (dstrect->h / MIN_FILL_BAND_LINES,
+            MIN (GAL_GetNrWorkerThreads (), MAX_FILL_BANDS));
+    if (job.nr_bands < 2)
+        return FALSE;
+
+    job.dst = dst;
+    job.rect = dstrect;
+    job.color = color;
+    /* whether to bypass the caches depends on the whole fill */
+    job.fillop = get_fill_op (dst, dstrect);
+    GAL_RunWorkerJob (fill_band, &job, job.nr_bands);
+    return TRUE;
+}
+
+static inline void fill_rect_by_software (GAL_Surface *dst,
+        const GAL_Rect *dstrect, Uint32 color)
+{
+    if (threaded_fill_rect (dst, dstrect, color))
+        return;
+
+    GAL_SoftFillRect (dst, dstrect, color);
+}
+
 #ifdef _MGUSE_PIXMAN
 #include <pixman.h>
 
@@ -906,10 +1168,10 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
         return 0;
     }
     else {
-        GAL_SoftFillRect (dst, &my_dstrect, color);
+        fill_rect_by_software (dst, &my_dstrect, color);
     }
 #else
-    GAL_SoftFillRect (dst, &my_dstrect, color);
+    fill_rect_by_software (dst, &my_dstrect, color);
 #endif /* _MGUSE_PIXMAN */
 
     /* We're done! */
@@ -271,10 +271,32 @@ struct GAL_VideoDevice {
     /* Since 4.0.0; used for VT switching */
     int (*Suspend) (_THIS);
     int (*Resume) (_THIS);
+
+    /* Since 5.0.16; the statistics of updating the real screen */
+    VIDEOUPDATESTATS update_stats;
+    /* the bytes copied but not counted in update_stats.total_kbytes */
+    DWORD update_bytes;
 };
 
 #undef _THIS
 
+/* Accounts a frame copied from the shadow screen to the real screen. */
+static inline void GAL_AccountUpdate (GAL_VideoDevice *video,
+        int nr_rects, size_t bytes)
+{
+    VIDEOUPDATESTATS *stats = &video->update_stats;
+
+    stats->nr_frames++;
+    stats->nr_rects += nr_rects;
+    stats->last_frame_bytes = (DWORD)bytes;
+    if (stats->last_frame_bytes > stats->max_frame_bytes)
+        stats->max_frame_bytes = stats->last_frame_bytes;
+
+    bytes += video->update_bytes;
+    stats->total_kbytes += (DWORD)(bytes >> 10);
+    video->update_bytes = (DWORD)(bytes & 1023);
+}
+
 typedef struct VideoBootStrap {
     const char *name;
     const char *desc;
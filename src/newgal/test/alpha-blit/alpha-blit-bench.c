@@ -0,0 +1,241 @@
+/*
+** alpha-blit-bench.c: regression test and benchmark for the per-pixel
+** alpha blits.
+**
+** Usage: alpha-blit-bench [width] [height] [rounds]
+**
+** This program blits an ARGB8888 memory DC with per-pixel alpha onto
+** ARGB8888, XRGB8888, and RGB565 memory DCs. The alpha values are mixed
+** as in anti-aliased icons: transparent, opaque, and translucent pixels.
+**
+** Every blit is first checked pixel by pixel against the scalar blending
+** of src/newgal/blit_A.c, for the given size and for the widths 1 to 33
+** at odd offsets, to cover the pixels left by the SIMD kernels. Then the
+** program reports the throughput in MPixels/s for every pair of formats
+** (640x480 and 200 rounds by default).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+/* exported by the library: c, sse2, or avx2 */
+extern const char* GAL_GetAlphaBlitKernelsName (void);
+
+#define DEF_WIDTH       640
+#define DEF_HEIGHT      480
+#define DEF_ROUNDS      200
+
+typedef struct {
+    const char* name;
+    int depth;
+    Uint32 rmask, gmask, bmask, amask;
+} DSTFORMAT;
+
+static const DSTFORMAT dst_formats [] = {
+    { "ARGB8888", 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 },
+    { "XRGB8888", 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000 },
+    { "RGB565",   16, 0xF800, 0x07E0, 0x001F, 0x0000 },
+};
+
+static Uint32 seed = 20201018;
+
+static Uint32 next_random (void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) | (seed << 24);
+}
+
+static Uint32 random_argb (void)
+{
+    Uint32 pixel = next_random () & 0x00FFFFFF;
+
+    switch (next_random () % 10) {
+    case 0: case 1: case 2:
+        return pixel;
+    case 3: case 4: case 5:
+        return pixel | 0xFF000000;
+    default:
+        return pixel | (next_random () << 24);
+    }
+}
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* the scalar blending of BlitRGBtoRGBPixelAlpha */
+static Uint32 ref_blend_rgb (Uint32 s, Uint32 d)
+{
+    Uint32 alpha = s >> 24;
+    Uint32 dalpha = d >> 24;
+    Uint32 s1, d1;
+
+    if (alpha == 0xFF)
+        return s;
+
+    s1 = s & 0xff00ff;
+    d1 = d & 0xff00ff;
+    d1 = (d1 + (((s1 - d1) * alpha) >> 8)) & 0xff00ff;
+    s &= 0xff00;
+    d &= 0xff00;
+    d = (d + (((s - d) * alpha) >> 8)) & 0xff00;
+    return d1 | d | (dalpha << 24);
+}
+
+/* the scalar blending of BlitARGBto565PixelAlpha */
+static Uint16 ref_blend_565 (Uint32 s, Uint16 d16)
+{
+    unsigned alpha = s >> 27;
+    Uint32 d = d16;
+
+    if (alpha == 0x1F)
+        return (s >> 8 & 0xf800) + (s >> 5 & 0x7e0) + (s >> 3 & 0x1f);
+
+    s = ((s & 0xfc00) << 11) + (s >> 8 & 0xf800) + (s >> 3 & 0x1f);
+    d = (d | d << 16) & 0x07e0f81f;
+    d += (s - d) * alpha >> 5;
+    d &= 0x07e0f81f;
+    return (Uint16)(d | d >> 16);
+}
+
+static void fill_random (HDC hdc, int depth, BOOL is_src)
+{
+    int w, h, pitch, x, y;
+    Uint8* bits = LockDC (hdc, NULL, &w, &h, &pitch);
+
+    if (bits == NULL)
+        return;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            if (is_src)
+                ((Uint32*)(bits + pitch * y)) [x] = random_argb ();
+            else if (depth == 32)
+                ((Uint32*)(bits + pitch * y)) [x] = next_random ();
+            else
+                ((Uint16*)(bits + pitch * y)) [x] = (Uint16)next_random ();
+        }
+    }
+
+    UnlockDC (hdc);
+}
+
+/* blits (0, 0, w, h) of src to (x, y) of dst and checks the result */
+static int check_blit (HDC src, HDC dst, const DSTFORMAT* fmt,
+        int x, int y, int w, int h)
+{
+    int sw, sh, spitch, dw, dh, dpitch, i, j, bad = 0;
+    Uint8 *sbits, *dbits, *expected;
+    int bpp = fmt->depth / 8;
+
+    dbits = LockDC (dst, NULL, &dw, &dh, &dpitch);
+    expected = malloc (dpitch * dh);
+    memcpy (expected, dbits, dpitch * dh);
+    UnlockDC (dst);
+
+    sbits = LockDC (src, NULL, &sw, &sh, &spitch);
+    for (j = 0; j < h; j++) {
+        const Uint32* s = (const Uint32*)(sbits + spitch * j);
+        Uint8* d = expected + dpitch * (y + j) + x * bpp;
+
+        for (i = 0; i < w; i++) {
+            if (bpp == 4)
+                ((Uint32*)d) [i] = ref_blend_rgb (s [i], ((Uint32*)d) [i]);
+            else
+                ((Uint16*)d) [i] = ref_blend_565 (s [i], ((Uint16*)d) [i]);
+        }
+    }
+    UnlockDC (src);
+
+    BitBlt (src, 0, 0, w, h, dst, x, y, 0);
+
+    dbits = LockDC (dst, NULL, &dw, &dh, &dpitch);
+    for (j = 0; j < dh && bad < 5; j++) {
+        for (i = 0; i < dw * bpp; i += bpp) {
+            if (memcmp (dbits + dpitch * j + i,
+                        expected + dpitch * j + i, bpp)) {
+                printf ("  %s %dx%d at (%d, %d): pixel (%d, %d) differs\n",
+                        fmt->name, w, h, x, y, i / bpp, j);
+                if (++bad >= 5)
+                    break;
+            }
+        }
+    }
+    UnlockDC (dst);
+
+    free (expected);
+    return bad;
+}
+
+static HDC create_dst_dc (const DSTFORMAT* fmt, int w, int h)
+{
+    return CreateMemDC (w, h, fmt->depth, MEMDC_FLAG_SWSURFACE,
+            fmt->rmask, fmt->gmask, fmt->bmask, fmt->amask);
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    int width = DEF_WIDTH, height = DEF_HEIGHT, rounds = DEF_ROUNDS;
+    int i, n, w, bad = 0;
+    HDC src;
+
+    if (argc > 1 && atoi (argv [1]) > 0)
+        width = atoi (argv [1]);
+    if (argc > 2 && atoi (argv [2]) > 0)
+        height = atoi (argv [2]);
+    if (argc > 3 && atoi (argv [3]) > 0)
+        rounds = atoi (argv [3]);
+
+    printf ("alpha blit kernels: %s\n", GAL_GetAlphaBlitKernelsName ());
+
+    src = CreateMemDC (width, height, 32,
+            MEMDC_FLAG_SWSURFACE | MEMDC_FLAG_SRCPIXELALPHA,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    if (src == HDC_INVALID) {
+        fprintf (stderr, "Failed to create the source memory DC\n");
+        return 1;
+    }
+    fill_random (src, 32, TRUE);
+
+    for (i = 0; i < (int)TABLESIZE (dst_formats); i++) {
+        const DSTFORMAT* fmt = dst_formats + i;
+        HDC dst = create_dst_dc (fmt, width + 8, height);
+        double t;
+
+        if (dst == HDC_INVALID) {
+            fprintf (stderr, "Failed to create the %s memory DC\n", fmt->name);
+            continue;
+        }
+
+        fill_random (dst, fmt->depth, FALSE);
+        bad += check_blit (src, dst, fmt, 0, 0, width, height);
+        for (w = 1; w <= 33; w++) {
+            fill_random (dst, fmt->depth, FALSE);
+            bad += check_blit (src, dst, fmt, w % 4 + 1, w % 3, w, 3);
+        }
+
+        t = now_ms ();
+        for (n = 0; n < rounds; n++) {
+            BitBlt (src, 0, 0, width, height, dst, 0, 0, 0);
+        }
+        t = now_ms () - t;
+
+        printf ("ARGB8888 -> %-8s: %9.1f MPixels/s\n", fmt->name,
+                (double)width * height * rounds / t / 1000.0);
+        DeleteMemDC (dst);
+    }
+
+    DeleteMemDC (src);
+    printf ("%s\n", bad ? "MISMATCH" : "all blits match the scalar blending");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+** blit-select-bench.c: benchmark for the cache of the blit selections.
+**
+** Usage: blit-select-bench [icon size] [rounds]
+**
+** This program blits small icons in turn onto a memory DC, as a
+** list view or a tool bar does when painting its items: an ARGB8888 icon
+** with per-pixel alpha, an RGB565 icon with a color key, an XRGB8888 icon
+** with a constant alpha, and an icon in the format of the destination.
+** Because every blit maps another source to the destination, the blit
+** routine is selected again for every blit.
+**
+** The program reports the time per blit and the statistics of the blit
+** selection cache: the hits, the misses, the average time of the missed
+** and the sampled selections, and the estimated time saved per blit (16x16 icons and
+** 100000 rounds by default).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+#define DEF_SIZE        16
+#define DEF_ROUNDS      100000
+
+#define NR_ICONS        4
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static HDC create_icon (int size, int depth,
+        Uint32 rmask, Uint32 gmask, Uint32 bmask, Uint32 amask)
+{
+    HDC hdc = CreateMemDC (size, size, depth, MEMDC_FLAG_SWSURFACE,
+            rmask, gmask, bmask, amask);
+
+    if (hdc != HDC_INVALID) {
+        SetBrushColor (hdc, RGBA2Pixel (hdc, 0x40, 0x80, 0xC0, 0x80));
+        FillBox (hdc, 0, 0, size, size);
+        SetBrushColor (hdc, RGBA2Pixel (hdc, 0xFF, 0x00, 0xFF, 0xFF));
+        FillBox (hdc, size / 4, size / 4, size / 2, size / 2);
+    }
+
+    return hdc;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    int size = DEF_SIZE, rounds = DEF_ROUNDS;
+    int i, r, x, y;
+    HDC dst, icons [NR_ICONS];
+    BLITCACHESTATS stats0, stats1;
+    unsigned long nr_hits, nr_misses;
+    double t0, t1;
+
+    if (argc > 1)
+        size = atoi (argv [1]);
+    if (argc > 2)
+        rounds = atoi (argv [2]);
+    if (size <= 0 || rounds <= 0) {
+        fprintf (stderr, "Usage: %s [icon size] [rounds]\n", argv [0]);
+        return 1;
+    }
+
+    dst = CreateMemDC (640, 480, 32, MEMDC_FLAG_SWSURFACE,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000);
+    icons [0] = create_icon (size, 32,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    icons [1] = create_icon (size, 16, 0xF800, 0x07E0, 0x001F, 0x0000);
+    icons [2] = create_icon (size, 32,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000);
+    icons [3] = create_icon (size, 32,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000);
+    if (dst == HDC_INVALID || icons [0] == HDC_INVALID ||
+            icons [1] == HDC_INVALID || icons [2] == HDC_INVALID ||
+            icons [3] == HDC_INVALID) {
+        fprintf (stderr, "Failed to create the memory DCs\n");
+        return 1;
+    }
+
+    SetMemDCColorKey (icons [1], MEMDC_FLAG_SRCCOLORKEY,
+            RGB2Pixel (icons [1], 0xFF, 0x00, 0xFF));
+    SetMemDCAlpha (icons [2], MEMDC_FLAG_SRCALPHA, 0x80);
+
+    GetBlitCacheStats (&stats0);
+
+    t0 = now_ms ();
+    for (r = 0; r < rounds; r++) {
+        x = (r * size) % (640 - size);
+        y = ((r * size) / (640 - size) * size) % (480 - size);
+        for (i = 0; i < NR_ICONS; i++)
+            BitBlt (icons [i], 0, 0, size, size, dst, x, y, 0);
+    }
+    t1 = now_ms ();
+
+    GetBlitCacheStats (&stats1);
+
+    nr_hits = stats1.nr_hits - stats0.nr_hits;
+    nr_misses = stats1.nr_misses - stats0.nr_misses;
+
+    printf ("%d blits of %dx%d icons: %.1f ns per blit\n",
+            rounds * NR_ICONS, size, size,
+            (t1 - t0) * 1000000.0 / (rounds * NR_ICONS));
+    printf ("selections: %lu hits, %lu misses, %lu samples, %lu bypasses, "
+            "%d/%d slots used\n",
+            nr_hits, nr_misses, stats1.nr_samples - stats0.nr_samples,
+            stats1.nr_bypasses - stats0.nr_bypasses,
+            stats1.nr_used, stats1.nr_slots);
+    if (stats1.nr_misses > 0)
+        printf ("missed selection: %.1f ns on average\n",
+                (double)stats1.miss_nsecs / stats1.nr_misses);
+    if (stats1.nr_samples > 0) {
+        printf ("sampled selection: %.1f ns on average\n",
+                (double)stats1.sample_nsecs / stats1.nr_samples);
+        printf ("estimated time saved: %.1f ns per blit\n",
+                (double)(stats1.saved_nsecs - stats0.saved_nsecs) /
+                (rounds * NR_ICONS));
+    }
+
+    for (i = 0; i < NR_ICONS; i++)
+        DeleteMemDC (icons [i]);
+    DeleteMemDC (dst);
+    return 0;
+}
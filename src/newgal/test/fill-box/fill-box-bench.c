@@ -0,0 +1,276 @@
+/*
+** fill-box-bench.c: regression test and benchmark for the solid fills
+** and the raster operations on spans.
+**
+** Usage: fill-box-bench [rounds]
+**
+** This program fills boxes of RGB565, RGB888, and XRGB8888 memory DCs
+** with FillBox, under the raster operations ROP_SET, ROP_AND, ROP_OR, and
+** ROP_XOR.
+**
+** Every fill is first checked byte by byte against a plain loop, for the
+** widths 1 to 160 at the offsets 0 to 7, to cover the bytes left by the
+** SIMD kernels, and for a whole 1920x1080 DC, which is large enough to
+** be filled in threads (set MG_WORKER_THREADS to a number other than 1
+** to check the threads). Then the program reports the time per fill and
+** the throughput in GB/s for the surface sizes from 64x64 to 3840x2160
+** (the rounds are scaled by the size, 2000 for 64x64 by default).
+**
+** The checks assume a little endian host.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+/* exported by the library: c, sse2, or avx2 */
+extern const char* GAL_GetFillKernelsName (void);
+
+#define DEF_ROUNDS      2000
+
+#define CHECK_WIDTH     192
+#define CHECK_HEIGHT    4
+
+typedef struct {
+    const char* name;
+    int depth;
+    Uint32 rmask, gmask, bmask;
+} FORMAT;
+
+static const FORMAT formats [] = {
+    { "RGB565",   16, 0xF800, 0x07E0, 0x001F },
+    { "RGB888",   24, 0xFF0000, 0x00FF00, 0x0000FF },
+    { "XRGB8888", 32, 0x00FF0000, 0x0000FF00, 0x000000FF },
+};
+
+static const struct {
+    const char* name;
+    int rop;
+} rops [] = {
+    { "SET", ROP_SET },
+    { "AND", ROP_AND },
+    { "OR",  ROP_OR },
+    { "XOR", ROP_XOR },
+};
+
+static const struct {
+    int w, h;
+} sizes [] = {
+    { 64, 64 },
+    { 256, 256 },
+    { 640, 480 },
+    { 1280, 720 },
+    { 1920, 1080 },
+    { 3840, 2160 },
+};
+
+static Uint32 seed = 20201018;
+
+static Uint32 next_random (void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) | (seed << 24);
+}
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static HDC create_dc (const FORMAT* fmt, int w, int h)
+{
+    return CreateMemDC (w, h, fmt->depth, MEMDC_FLAG_SWSURFACE,
+            fmt->rmask, fmt->gmask, fmt->bmask, 0);
+}
+
+/* fills the DC with random bytes, and returns a copy of them */
+static Uint8* fill_random (HDC hdc, int* pitch)
+{
+    int w, h, i;
+    Uint8* bits = LockDC (hdc, NULL, &w, &h, pitch);
+    Uint8* copy;
+
+    if (bits == NULL)
+        return NULL;
+
+    for (i = 0; i < *pitch * h; i++)
+        bits [i] = (Uint8)next_random ();
+
+    copy = malloc (*pitch * h);
+    memcpy (copy, bits, *pitch * h);
+    UnlockDC (hdc);
+    return copy;
+}
+
+/* combines the bytes of a box of the copy as the raster operation does */
+static void ref_fill (Uint8* bits, int pitch, int bpp, Uint32 pixel,
+        int rop, int x, int y, int w, int h)
+{
+    int i, j;
+
+    for (j = y; j < y + h; j++) {
+        Uint8* d = bits + pitch * j + x * bpp;
+
+        for (i = 0; i < w * bpp; i++) {
+            Uint8 b = (Uint8)(pixel >> (8 * (i % bpp)));
+
+            switch (rop) {
+            case ROP_AND:
+                d [i] &= b;
+                break;
+            case ROP_OR:
+                d [i] |= b;
+                break;
+            case ROP_XOR:
+                d [i] ^= b;
+                break;
+            default:
+                d [i] = b;
+                break;
+            }
+        }
+    }
+}
+
+/* fills a box of the DC and checks the whole DC against the copy */
+static int check_fill (HDC hdc, const FORMAT* fmt, int rop,
+        int x, int y, int w, int h)
+{
+    int pitch, dw, dh, j, bad = 0;
+    int bpp = fmt->depth / 8;
+    Uint32 pixel = RGB2Pixel (hdc, next_random () & 0xFF,
+            next_random () & 0xFF, next_random () & 0xFF);
+    Uint8 *expected = fill_random (hdc, &pitch);
+    Uint8 *bits;
+
+    if (expected == NULL)
+        return 1;
+
+    ref_fill (expected, pitch, bpp, pixel, rop, x, y, w, h);
+
+    SetRasterOperation (hdc, rop);
+    SetBrushColor (hdc, pixel);
+    FillBox (hdc, x, y, w, h);
+
+    bits = LockDC (hdc, NULL, &dw, &dh, &pitch);
+    for (j = 0; j < dh; j++) {
+        if (memcmp (bits + pitch * j, expected + pitch * j, dw * bpp)) {
+            printf ("  %s %dx%d at (%d, %d) with rop %d: line %d differs\n",
+                    fmt->name, w, h, x, y, rop, j);
+            bad++;
+            break;
+        }
+    }
+    UnlockDC (hdc);
+
+    free (expected);
+    return bad;
+}
+
+static int check_format (const FORMAT* fmt)
+{
+    HDC hdc = create_dc (fmt, CHECK_WIDTH, CHECK_HEIGHT);
+    int r, x, w, bad = 0;
+
+    if (hdc == HDC_INVALID) {
+        fprintf (stderr, "Failed to create the %s memory DC\n", fmt->name);
+        return 1;
+    }
+
+    for (r = 0; r < (int)TABLESIZE (rops); r++) {
+        for (w = 1; w <= 160; w++) {
+            for (x = 0; x < 8; x++) {
+                bad += check_fill (hdc, fmt, rops [r].rop, x, 1, w, 2);
+            }
+        }
+    }
+    DeleteMemDC (hdc);
+
+    /* large enough to be filled in threads, and to bypass the caches */
+    hdc = create_dc (fmt, 1920, 1080);
+    if (hdc == HDC_INVALID) {
+        fprintf (stderr, "Failed to create the %s memory DC\n", fmt->name);
+        return bad + 1;
+    }
+
+    for (r = 0; r < (int)TABLESIZE (rops); r++) {
+        bad += check_fill (hdc, fmt, rops [r].rop, 0, 0, 1920, 1080);
+        bad += check_fill (hdc, fmt, rops [r].rop, 3, 5, 1911, 1070);
+    }
+    DeleteMemDC (hdc);
+
+    return bad;
+}
+
+static void bench_format (const FORMAT* fmt, int rounds)
+{
+    int i, r, n;
+
+    for (i = 0; i < (int)TABLESIZE (sizes); i++) {
+        int w = sizes [i].w, h = sizes [i].h;
+        int nr_fills = (int)((double)rounds * 64 * 64 / w / h);
+        HDC hdc = create_dc (fmt, w, h);
+
+        if (hdc == HDC_INVALID) {
+            fprintf (stderr, "Failed to create the %s memory DC\n",
+                    fmt->name);
+            continue;
+        }
+
+        if (nr_fills < 10)
+            nr_fills = 10;
+
+        printf ("%-8s %4dx%-4d", fmt->name, w, h);
+        for (r = 0; r < (int)TABLESIZE (rops); r += 3) {
+            double t;
+
+            SetRasterOperation (hdc, rops [r].rop);
+            SetBrushColor (hdc, RGB2Pixel (hdc, 0x12, 0x34, 0x56));
+
+            /* warm up */
+            FillBox (hdc, 0, 0, w, h);
+
+            t = now_ms ();
+            for (n = 0; n < nr_fills; n++) {
+                FillBox (hdc, 0, 0, w, h);
+            }
+            t = (now_ms () - t) / nr_fills;
+
+            printf ("  %s %8.3f ms %6.2f GB/s", rops [r].name, t,
+                    (double)w * h * fmt->depth / 8 / t / 1e6);
+        }
+        printf ("\n");
+
+        DeleteMemDC (hdc);
+    }
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    int rounds = DEF_ROUNDS;
+    int i, bad = 0;
+
+    if (argc > 1 && atoi (argv [1]) > 0)
+        rounds = atoi (argv [1]);
+
+    printf ("fill kernels: %s\n", GAL_GetFillKernelsName ());
+
+    for (i = 0; i < (int)TABLESIZE (formats); i++) {
+        bad += check_format (formats + i);
+    }
+    printf ("%s\n", bad ? "MISMATCH" : "all fills match the plain loops");
+
+    for (i = 0; i < (int)TABLESIZE (formats); i++) {
+        bench_format (formats + i, rounds);
+    }
+
+    return bad ? 1 : 0;
+}
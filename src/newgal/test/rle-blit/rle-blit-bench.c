@@ -0,0 +1,478 @@
+/*
+** rle-blit-bench.c: regression test and benchmark for the RLE accelerated
+** blits.
+**
+** Usage: rle-blit-bench [rounds] [directory of src/sysres/bmp]
+**
+** This program loads the bitmaps of the skin renderer from the C sources
+** in src/sysres/bmp, and makes two sprites of every bitmap: one with
+** a color key (the color of the top-left pixel), and one with per-pixel
+** alpha, where the keyed pixels are transparent and their neighbors are
+** translucent, as anti-aliased edges. Both are RLE accelerated.
+**
+** It first checks that blitting the RLE accelerated sprites to XRGB8888
+** and RGB565 memory DCs gives the same pixels as blitting the sprites
+** without RLE acceleration. Then it reports:
+**
+**  - the time to blit all sprites to one destination, which runs the
+**    RLE blits only;
+**  - the time to blit all sprites to two destinations in turn, which
+**    also sets up the blits again for every blit;
+**  - the time of the first blit of a 1920x1080 sprite tiled from the
+**    background of the skin, which encodes the sprite, and the time of
+**    the blits after it. Set MG_WORKER_THREADS to change the number
+**    of threads encoding large sprites.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+#define DEF_ROUNDS      200
+#define DEF_BMP_DIR     "../../../sysres/bmp"
+
+#define ARGB_MASKS      0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000
+#define XRGB_MASKS      0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000
+#define RGB565_MASKS    0xF800, 0x07E0, 0x001F, 0x0000
+
+#define DST_WIDTH       800
+#define DST_HEIGHT      600
+
+#define BIG_WIDTH       1920
+#define BIG_HEIGHT      1080
+
+static const char* skin_files [] = {
+    "skin_bkgnd.bmp.c",
+    "skin_arrows_shell.bmp.c",
+    "skin_checkbtn.bmp.c",
+    "skin_header.bmp.c",
+    "skin_sb_arrows.bmp.c",
+    "skin_sb_hshaft.bmp.c",
+    "skin_sb_hthumb.bmp.c",
+    "skin_sb_vshaft.bmp.c",
+    "skin_sb_vthumb.bmp.c",
+    "skin_tree.bmp.c",
+    "skin_caption.gif.c",
+    "skin_cpn_btn.gif.c",
+    "skin_pushbtn.gif.c",
+    "skin_radiobtn.gif.c",
+    "skin_tab.gif.c",
+    "skin_tb_horz.gif.c",
+};
+
+#define NR_SKINS    (int)(sizeof (skin_files) / sizeof (skin_files [0]))
+
+typedef struct {
+    int w, h;
+    HDC ckey;       /* RLE accelerated sprite with a color key */
+    HDC alpha;      /* RLE accelerated sprite with per-pixel alpha */
+    HDC ckey_ref;   /* the same sprites without RLE acceleration */
+    HDC alpha_ref;
+} SPRITE;
+
+static SPRITE sprites [NR_SKINS];
+static int nr_sprites;
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* reads the bytes of the image defined in a C source of src/sysres/bmp */
+static unsigned char* read_image_source (const char* path, size_t* size)
+{
+    FILE* fp;
+    unsigned char* data = NULL;
+    size_t len = 0, max = 0;
+    int c, in_data = 0;
+    unsigned int byte;
+
+    if ((fp = fopen (path, "r")) == NULL)
+        return NULL;
+
+    while ((c = fgetc (fp)) != EOF) {
+        if (!in_data) {
+            in_data = (c == '{');
+            continue;
+        }
+        if (c == '}')
+            break;
+        if (c != '0')
+            continue;
+        if (fscanf (fp, "x%x", &byte) != 1)
+            continue;
+
+        if (len == max) {
+            max = max ? max * 2 : 4096;
+            data = realloc (data, max);
+        }
+        data [len++] = (unsigned char)byte;
+    }
+
+    fclose (fp);
+    *size = len;
+    return data;
+}
+
+static HDC create_sprite (int w, int h, const Uint32* pixels)
+{
+    HDC hdc;
+    Uint8* bits;
+    int y, pitch;
+
+    hdc = CreateMemDC (w, h, 32, MEMDC_FLAG_SWSURFACE, ARGB_MASKS);
+    if (hdc == HDC_INVALID)
+        return hdc;
+
+    bits = LockDC (hdc, NULL, NULL, NULL, &pitch);
+    for (y = 0; y < h; y++)
+        memcpy (bits + y * pitch, pixels + y * w, w * 4);
+    UnlockDC (hdc);
+    return hdc;
+}
+
+/* makes the keyed pixels transparent, and their neighbors translucent */
+static void make_alpha (Uint32* pixels, int w, int h, Uint32 key)
+{
+    Uint8* keyed = calloc (w, h);
+    int x, y;
+
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w; x++)
+            keyed [y * w + x] =
+                ((pixels [y * w + x] & 0x00FFFFFF) == (key & 0x00FFFFFF));
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            Uint32* p = pixels + y * w + x;
+            int edge = (x > 0 && keyed [y * w + x - 1]) ||
+                (x < w - 1 && keyed [y * w + x + 1]) ||
+                (y > 0 && keyed [(y - 1) * w + x]) ||
+                (y < h - 1 && keyed [(y + 1) * w + x]);
+
+            *p &= 0x00FFFFFF;
+            if (keyed [y * w + x])
+                continue;
+            *p |= edge ? (Uint32)(0x40 + ((x * 7 + y * 13) & 0x7F)) << 24 :
+                0xFF000000;
+        }
+    }
+
+    free (keyed);
+}
+
+static Uint32* get_bitmap_pixels (HDC ref, const BITMAP* bmp)
+{
+    HDC hdc;
+    Uint32* pixels;
+    Uint8* bits;
+    int y, pitch;
+
+    hdc = CreateMemDC (bmp->bmWidth, bmp->bmHeight, 32,
+            MEMDC_FLAG_SWSURFACE, ARGB_MASKS);
+    if (hdc == HDC_INVALID)
+        return NULL;
+
+    FillBoxWithBitmap (hdc, 0, 0, bmp->bmWidth, bmp->bmHeight, bmp);
+
+    pixels = malloc (bmp->bmWidth * bmp->bmHeight * 4);
+    bits = LockDC (hdc, NULL, NULL, NULL, &pitch);
+    for (y = 0; y < (int)bmp->bmHeight; y++)
+        memcpy (pixels + y * bmp->bmWidth, bits + y * pitch,
+                bmp->bmWidth * 4);
+    UnlockDC (hdc);
+    DeleteMemDC (hdc);
+    return pixels;
+}
+
+static void set_sprite_modes (SPRITE* sp, Uint32 key, BOOL rle)
+{
+    DWORD rle_flag = rle ? MEMDC_FLAG_RLEACCEL : 0;
+    HDC ckey = rle ? sp->ckey : sp->ckey_ref;
+    HDC alpha = rle ? sp->alpha : sp->alpha_ref;
+
+    SetMemDCColorKey (ckey, MEMDC_FLAG_SRCCOLORKEY | rle_flag, key);
+    SetMemDCAlpha (alpha, MEMDC_FLAG_SRCPIXELALPHA | rle_flag, 0);
+}
+
+static BOOL load_sprites (const char* dir)
+{
+    HDC ref;
+    int i;
+
+    ref = CreateMemDC (1, 1, 32, MEMDC_FLAG_SWSURFACE, ARGB_MASKS);
+
+    for (i = 0; i < NR_SKINS; i++) {
+        char path [PATH_MAX + 1];
+        const char* ext = strstr (skin_files [i], ".gif") ? "gif" : "bmp";
+        unsigned char* data;
+        size_t size;
+        BITMAP bmp;
+        Uint32* pixels, key;
+        SPRITE* sp = sprites + nr_sprites;
+
+        snprintf (path, sizeof (path), "%s/%s", dir, skin_files [i]);
+        if ((data = read_image_source (path, &size)) == NULL) {
+            fprintf (stderr, "Failed to read %s\n", path);
+            continue;
+        }
+
+        if (LoadBitmapFromMem (ref, &bmp, data, size, ext)) {
+            fprintf (stderr, "Failed to load %s\n", path);
+            free (data);
+            continue;
+        }
+        free (data);
+
+        sp->w = bmp.bmWidth;
+        sp->h = bmp.bmHeight;
+        pixels = get_bitmap_pixels (ref, &bmp);
+        UnloadBitmap (&bmp);
+        if (pixels == NULL)
+            continue;
+
+        key = pixels [0];
+        sp->ckey = create_sprite (sp->w, sp->h, pixels);
+        sp->ckey_ref = create_sprite (sp->w, sp->h, pixels);
+
+        make_alpha (pixels, sp->w, sp->h, key);
+        sp->alpha = create_sprite (sp->w, sp->h, pixels);
+        sp->alpha_ref = create_sprite (sp->w, sp->h, pixels);
+        free (pixels);
+
+        set_sprite_modes (sp, key, TRUE);
+        set_sprite_modes (sp, key, FALSE);
+
+        nr_sprites++;
+    }
+
+    DeleteMemDC (ref);
+    return nr_sprites > 0;
+}
+
+static void fill_background (HDC hdc)
+{
+    SetBrushColor (hdc, RGB2Pixel (hdc, 0x20, 0x60, 0xA0));
+    FillBox (hdc, 0, 0, DST_WIDTH, DST_HEIGHT);
+    SetBrushColor (hdc, RGB2Pixel (hdc, 0xE0, 0xC0, 0x40));
+    FillBox (hdc, DST_WIDTH / 4, DST_HEIGHT / 4, DST_WIDTH / 2, DST_HEIGHT / 2);
+}
+
+/* blits the sprites at different places, clipped at the right edge */
+static void blit_sprites (HDC dst, BOOL rle, int round)
+{
+    int i;
+
+    for (i = 0; i < nr_sprites; i++) {
+        SPRITE* sp = sprites + i;
+        int x = (i * 53 + round * 7) % DST_WIDTH - 8;
+        int y = (i * 37 + round * 3) % (DST_HEIGHT - 32) - 8;
+
+        BitBlt (rle ? sp->ckey : sp->ckey_ref, 0, 0, sp->w, sp->h,
+                dst, x, y, 0);
+        BitBlt (rle ? sp->alpha : sp->alpha_ref, 0, 0, sp->w, sp->h,
+                dst, x + 16, y + 16, 0);
+    }
+}
+
+/* copies the pixels out, for LockDC can not lock two DCs at the same time */
+static Uint8* get_dc_pixels (HDC hdc, int bpp)
+{
+    Uint8 *bits, *pixels;
+    int y, pitch;
+
+    pixels = malloc (DST_WIDTH * DST_HEIGHT * bpp);
+    bits = LockDC (hdc, NULL, NULL, NULL, &pitch);
+    for (y = 0; y < DST_HEIGHT; y++)
+        memcpy (pixels + y * DST_WIDTH * bpp, bits + y * pitch,
+                DST_WIDTH * bpp);
+    UnlockDC (hdc);
+    return pixels;
+}
+
+static int compare_dcs (HDC a, HDC b, int depth)
+{
+    Uint8 *pa, *pb;
+    int i, bad = 0;
+
+    pa = get_dc_pixels (a, depth / 8);
+    pb = get_dc_pixels (b, depth / 8);
+    for (i = 0; i < DST_WIDTH * DST_HEIGHT; i++) {
+        Uint32 va, vb;
+
+        if (depth == 32) {
+            va = ((Uint32*)pa) [i] & 0x00FFFFFF;
+            vb = ((Uint32*)pb) [i] & 0x00FFFFFF;
+        }
+        else {
+            va = ((Uint16*)pa) [i];
+            vb = ((Uint16*)pb) [i];
+        }
+        if (va != vb && bad++ < 4)
+            printf ("  %dbpp: pixel (%d, %d) is %08x, not %08x\n",
+                    depth, i % DST_WIDTH, i / DST_WIDTH, va, vb);
+    }
+
+    free (pa);
+    free (pb);
+    return bad;
+}
+
+static int check_sprites (void)
+{
+    HDC dst [2], ref [2];
+    int depth [2] = { 32, 16 };
+    int i, r, bad = 0;
+
+    dst [0] = CreateMemDC (DST_WIDTH, DST_HEIGHT, 32,
+            MEMDC_FLAG_SWSURFACE, XRGB_MASKS);
+    ref [0] = CreateMemDC (DST_WIDTH, DST_HEIGHT, 32,
+            MEMDC_FLAG_SWSURFACE, XRGB_MASKS);
+    dst [1] = CreateMemDC (DST_WIDTH, DST_HEIGHT, 16,
+            MEMDC_FLAG_SWSURFACE, RGB565_MASKS);
+    ref [1] = CreateMemDC (DST_WIDTH, DST_HEIGHT, 16,
+            MEMDC_FLAG_SWSURFACE, RGB565_MASKS);
+
+    for (i = 0; i < 2; i++) {
+        fill_background (dst [i]);
+        fill_background (ref [i]);
+        for (r = 0; r < 8; r++) {
+            blit_sprites (dst [i], TRUE, r);
+            blit_sprites (ref [i], FALSE, r);
+        }
+        bad += compare_dcs (dst [i], ref [i], depth [i]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        DeleteMemDC (dst [i]);
+        DeleteMemDC (ref [i]);
+    }
+    return bad;
+}
+
+static void bench_sprites (int rounds)
+{
+    HDC dst32, dst16;
+    double t0, t1, t2;
+    int r;
+
+    dst32 = CreateMemDC (DST_WIDTH, DST_HEIGHT, 32,
+            MEMDC_FLAG_SWSURFACE, XRGB_MASKS);
+    dst16 = CreateMemDC (DST_WIDTH, DST_HEIGHT, 16,
+            MEMDC_FLAG_SWSURFACE, RGB565_MASKS);
+    fill_background (dst32);
+    fill_background (dst16);
+
+    /* warm up */
+    blit_sprites (dst32, TRUE, 0);
+    blit_sprites (dst16, TRUE, 0);
+
+    t0 = now_ms ();
+    for (r = 0; r < rounds; r++)
+        blit_sprites (dst32, TRUE, r);
+    t1 = now_ms ();
+    for (r = 0; r < rounds; r++) {
+        blit_sprites (dst32, TRUE, r);
+        blit_sprites (dst16, TRUE, r);
+    }
+    t2 = now_ms ();
+
+    printf ("%d sprites to XRGB8888: %.3f ms per frame\n",
+            nr_sprites * 2, (t1 - t0) / rounds);
+    printf ("%d sprites to XRGB8888 and RGB565 in turn: %.3f ms per frame\n",
+            nr_sprites * 2, (t2 - t1) / rounds / 2);
+
+    DeleteMemDC (dst32);
+    DeleteMemDC (dst16);
+}
+
+static void bench_big_sprite (void)
+{
+    SPRITE* bkgnd = sprites;
+    HDC big, dst;
+    Uint32* pixels;
+    Uint8* bits;
+    int x, y, pitch, i;
+    double t0, t1, t2;
+
+    big = CreateMemDC (BIG_WIDTH, BIG_HEIGHT, 32,
+            MEMDC_FLAG_SWSURFACE, ARGB_MASKS);
+    dst = CreateMemDC (BIG_WIDTH, BIG_HEIGHT, 32,
+            MEMDC_FLAG_SWSURFACE, XRGB_MASKS);
+
+    for (y = 0; y < BIG_HEIGHT; y += bkgnd->h)
+        for (x = 0; x < BIG_WIDTH; x += bkgnd->w)
+            BitBlt (bkgnd->alpha_ref, 0, 0, bkgnd->w, bkgnd->h, big, x, y, 0);
+
+    /* punch holes so that the encoding has runs of all kinds */
+    bits = LockDC (big, NULL, NULL, NULL, &pitch);
+    pixels = malloc (BIG_WIDTH * BIG_HEIGHT * 4);
+    for (y = 0; y < BIG_HEIGHT; y++)
+        memcpy (pixels + y * BIG_WIDTH, bits + y * pitch, BIG_WIDTH * 4);
+    for (y = 0; y < BIG_HEIGHT; y++)
+        for (x = 0; x < BIG_WIDTH; x++)
+            if (((x / 24) ^ (y / 24)) & 1)
+                pixels [y * BIG_WIDTH + x] = 0x00FF00FF;
+    make_alpha (pixels, BIG_WIDTH, BIG_HEIGHT, 0x00FF00FF);
+    for (y = 0; y < BIG_HEIGHT; y++)
+        memcpy (bits + y * pitch, pixels + y * BIG_WIDTH, BIG_WIDTH * 4);
+    UnlockDC (big);
+    free (pixels);
+
+    SetMemDCAlpha (big, MEMDC_FLAG_SRCPIXELALPHA | MEMDC_FLAG_RLEACCEL, 0);
+
+    t0 = now_ms ();
+    BitBlt (big, 0, 0, BIG_WIDTH, BIG_HEIGHT, dst, 0, 0, 0);
+    t1 = now_ms ();
+    for (i = 0; i < 10; i++)
+        BitBlt (big, 0, 0, BIG_WIDTH, BIG_HEIGHT, dst, 0, 0, 0);
+    t2 = now_ms ();
+
+    printf ("%dx%d sprite: first blit %.3f ms, then %.3f ms per blit\n",
+            BIG_WIDTH, BIG_HEIGHT, t1 - t0, (t2 - t1) / 10);
+
+    DeleteMemDC (big);
+    DeleteMemDC (dst);
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    int rounds = DEF_ROUNDS, i, bad;
+    const char* dir = DEF_BMP_DIR;
+
+    if (argc > 1)
+        rounds = atoi (argv [1]);
+    if (argc > 2)
+        dir = argv [2];
+    if (rounds <= 0) {
+        fprintf (stderr, "Usage: %s [rounds] [bmp directory]\n", argv [0]);
+        return 1;
+    }
+
+    if (!load_sprites (dir)) {
+        fprintf (stderr, "No bitmap loaded from %s\n", dir);
+        return 1;
+    }
+
+    bad = check_sprites ();
+    printf ("%s\n", bad ? "MISMATCH" : "RLE blits match the plain blits");
+
+    bench_sprites (rounds);
+    bench_big_sprite ();
+
+    for (i = 0; i < nr_sprites; i++) {
+        DeleteMemDC (sprites [i].ckey);
+        DeleteMemDC (sprites [i].alpha);
+        DeleteMemDC (sprites [i].ckey_ref);
+        DeleteMemDC (sprites [i].alpha_ref);
+    }
+    return bad ? 1 : 0;
+}
@@ -49,6 +49,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "common.h"
 #include "minigui.h"
@@ -752,50 +753,91 @@ void GAL_UpdateRect (GAL_Surface *screen,
     GAL_UpdateRects (screen, 1, &rect);
 }
 
-#ifdef _MGSCHEMA_COMPOSITING
-static void mark_surface_dirty (GAL_Surface* surface,
-            int numrects, GAL_Rect* rects)
+static inline int area_of_rect (const RECT* rc)
 {
-    int i;
-    GAL_DirtyInfo* di = surface->dirty_info;
+    return RECTWP (rc) * RECTHP (rc);
+}
 
-    assert (di);
-    assert (numrects <= NR_DIRTY_RECTS);
-
-    if (di->nr_dirty_rcs + numrects <= NR_DIRTY_RECTS) {
-        for (i = di->nr_dirty_rcs; i < (di->nr_dirty_rcs + numrects); i++) {
-            int j = i - di->nr_dirty_rcs;
-            di->dirty_rcs [i].left     = rects[j].x;
-            di->dirty_rcs [i].top      = rects[j].y;
-            di->dirty_rcs [i].right    = rects[j].x + rects[j].w;
-            di->dirty_rcs [i].bottom   = rects[j].y + rects[j].h;
+int GAL_AddDirtyRect (RECT* rcs, int nr_rcs, int max_rcs, const RECT* rc)
+{
+    RECT bound = *rc, merged;
+    int i, least, growth, best;
+
+    if (IsRectEmpty (&bound))
+        return nr_rcs;
+
+again:
+    for (i = 0; i < nr_rcs; i++) {
+        GetBoundRect (&merged, &bound, rcs + i);
+        if (area_of_rect (&merged) <=
+                area_of_rect (&bound) + area_of_rect (rcs + i)) {
+            rcs [i] = rcs [--nr_rcs];
+            bound = merged;
+            goto again;
         }
+    }
 
-        di->nr_dirty_rcs += numrects;
+    if (nr_rcs < max_rcs) {
+        rcs [nr_rcs++] = bound;
+        return nr_rcs;
     }
-    else {
-        RECT rc_bound;
 
-        SetRect (&rc_bound, 0, 0, 0, 0);
-        for (i = 0; i < di->nr_dirty_rcs; i++) {
-            GetBoundRect (&rc_bound, &rc_bound, di->dirty_rcs + i);
+    best = 0;
+    least = INT_MAX;
+    for (i = 0; i < nr_rcs; i++) {
+        GetBoundRect (&merged, &bound, rcs + i);
+        growth = area_of_rect (&merged) - area_of_rect (rcs + i);
+        if (growth < least) {
+            least = growth;
+            best = i;
         }
+    }
 
-        for (i = 0; i < numrects; i++) {
-            RECT rc = { rects [i].x,  rects [i].y,
-                        rects [i].x + rects [i].w,
-                        rects [i].y + rects [i].h };
+    GetBoundRect (&bound, &bound, rcs + best);
+    rcs [best] = rcs [--nr_rcs];
+    goto again;
+}
 
-            GetBoundRect (&rc_bound, &rc_bound, &rc);
-        }
+BOOL GUIAPI GetVideoUpdateStats (GHANDLE video, VIDEOUPDATESTATS* stats)
+{
+    GAL_VideoDevice *this = (GAL_VideoDevice *)video;
+
+    if (this == NULL || stats == NULL)
+        return FALSE;
+
+    *stats = this->update_stats;
+    return TRUE;
+}
+
+#ifdef _MGSCHEMA_COMPOSITING
+static void mark_surface_dirty (GAL_Surface* surface,
+            int numrects, GAL_Rect* rects)
+{
+    int i;
+    GAL_DirtyInfo* di = surface->dirty_info;
 
-        di->nr_dirty_rcs = 1;
-        di->dirty_rcs[0] = rc_bound;
+    assert (di);
 
-        _DBG_PRINTF("Too many un-synced dirty rects, merged to one.\n");
+    for (i = 0; i < numrects; i++) {
+        RECT rc = { rects [i].x,  rects [i].y,
+                    rects [i].x + rects [i].w,
+                    rects [i].y + rects [i].h };
+
+        di->nr_dirty_rcs = GAL_AddDirtyRect (di->dirty_rcs, di->nr_dirty_rcs,
+                NR_DIRTY_RECTS, &rc);
     }
 
     di->dirty_age++;
+
+    /* tell the compositor which znode changed */
+    if (surface->dirty_word) {
+#ifdef __GNUC__
+        __atomic_fetch_or (surface->dirty_word, surface->dirty_mask,
+                __ATOMIC_RELEASE);
+#else
+        *surface->dirty_word |= surface->dirty_mask;
+#endif
+    }
 }
 #endif /* defined _MGSCHEMA_COMPOSITING */
 
@@ -860,36 +902,24 @@ notsupport:
 int __mg_convert_region_to_rects (const CLIPRGN * rgn,
         GAL_Rect *rects, int max_nr)
 {
-    int nr = 0;
+    int i, nr = 0;
     PCLIPRECT clip_rect = rgn->head;
-    RECT left_rc;
+    RECT rcs [NR_DIRTY_RECTS];
 
-    while (clip_rect && ((nr + 1) < max_nr)) {
-        rects [nr].x = clip_rect->rc.left;
-        rects [nr].y = clip_rect->rc.top;
-        rects [nr].w = clip_rect->rc.right - clip_rect->rc.left;
-        rects [nr].h = clip_rect->rc.bottom - clip_rect->rc.top;
+    if (max_nr > NR_DIRTY_RECTS)
+        max_nr = NR_DIRTY_RECTS;
 
-        nr++;
+    /* merge the rectangles only when it is cheaper to copy the bound */
+    while (clip_rect) {
+        nr = GAL_AddDirtyRect (rcs, nr, max_nr, &clip_rect->rc);
         clip_rect = clip_rect->next;
     }
 
-    if (clip_rect == NULL) {
-        return nr;
-    }
-    else {
-        SetRect (&left_rc, 0, 0, 0, 0);
-        while (clip_rect) {
-            GetBoundRect (&left_rc, &left_rc, &clip_rect->rc);
-            clip_rect = clip_rect->next;
-        }
-
-        rects [nr].x = left_rc.left;
-        rects [nr].y = left_rc.top;
-        rects [nr].w = left_rc.right - left_rc.left;
-        rects [nr].h = left_rc.bottom - left_rc.top;
-
-        nr++;
+    for (i = 0; i < nr; i++) {
+        rects [i].x = rcs [i].left;
+        rects [i].y = rcs [i].top;
+        rects [i].w = rcs [i].right - rcs [i].left;
+        rects [i].h = rcs [i].bottom - rcs [i].top;
     }
 
     return nr;
@@ -1158,6 +1188,9 @@ void GAL_VideoQuit (void)
         video->free(this);
         __mg_current_video = NULL;
 
+        /* the blit selections may refer to the video device */
+        GAL_FlushBlitCache();
+
 #ifdef _MGUSE_UPDATE_REGION
         DestroyFreeClipRectList (&__mg_free_update_region_list);
 #endif
@@ -1270,6 +1303,7 @@ static GAL_Surface *Slave_CreateSurface (GAL_VideoDevice *this,
 #if IS_COMPOSITING_SCHEMA
     surface->shared_header = NULL;
     surface->dirty_info = NULL;
+    surface->dirty_word = NULL;
 #endif
     GAL_SetClipRect(surface, NULL);
 
@@ -1258,7 +1258,8 @@ int GAL_DisplayYUV_SW(_THIS, GAL_Overlay *overlay, GAL_Rect *dstrect)
 
     if ( stretch ) {
         display = swdata->display;
-        GAL_SoftStretch(stretch, NULL, display, dstrect);
+        GAL_SoftStretch(stretch, NULL, display, dstrect,
+                        NULL, GAL_STRETCH_NEAREST);
     }
 
     return(0);
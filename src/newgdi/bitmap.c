@@ -1926,6 +1926,34 @@ static BOOL BitmapBilinerScaler(void* context,
     if (dst_w <= 0 || dst_h <= 0 || src_bmp == NULL)
         return FALSE;
 
+    if (!format) {
+        PDC pdc = dc_HDC2PDC(HDC_SCREEN_SYS);
+        format = pdc->surface->format;
+    }
+
+    /* Since 5.0.16, use the stretch engine if the pixels can be
+       interpolated without any extra information. */
+    if (!(src_bmp->bmType &
+                (BMP_TYPE_RLE | BMP_TYPE_COLORKEY | BMP_TYPE_ALPHA_MASK))
+            && src_bmp->bmBytesPerPixel > 1
+            && src_bmp->bmBytesPerPixel == format->BytesPerPixel) {
+        GAL_StretchContext* ctxt;
+
+        ctxt = GAL_CreateStretchContext (format, GAL_STRETCH_BILINEAR,
+                src_bmp->bmBits, src_bmp->bmPitch,
+                src_bmp->bmWidth, src_bmp->bmHeight, dst_w, dst_h);
+        if (ctxt) {
+            for (y = 0; y < dst_h; y++) {
+                dp2 = cb_line_buff (context, y, (void*)&dp4);
+                GAL_StretchLine (ctxt, y, 0, dst_w, dp2);
+                cb_line_scaled (context, dp2, y);
+            }
+
+            GAL_DestroyStretchContext (ctxt);
+            return TRUE;
+        }
+    }
+
     xfactor = muldiv64 (src_bmp->bmWidth, 65536, dst_w);    /* scaled by 65536 */
     yfactor = muldiv64 (src_bmp->bmHeight, 65536, dst_h);   /* scaled by 65536 */
 
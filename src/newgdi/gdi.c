@@ -105,13 +105,299 @@ pthread_mutex_t __mg_gdilock;
 #endif
 
 /**************************** static data ************************************/
-/* General DC */
-static DC DCSlot [DCSLOTNUMBER];
+/*
+ * The pool of general DCs.
+ *
+ * Since 5.0.16, the general DCs are allocated in chunks of DCSLOTNUMBER DCs
+ * and the pool grows by chunks on demand. The free DCs are linked in a
+ * free list by their indices in the pool; when there are multiple message
+ * threads, the free list is a lock-free stack and the head carries
+ * a generation number to avoid the ABA problem.
+ *
+ * Every message thread also keeps a few recently released DCs, so that
+ * a thread getting and releasing DCs in its message loop will not touch
+ * the shared free list at all.
+ */
+#define MAX_DC_CHUNKS           64
+#define NR_THREAD_CACHED_DCS    4
 
-#ifdef _MGRM_THREADS
-/* mutex ensuring exclusive access to DC slot.  */
-static pthread_mutex_t dcslot;
+#define DC_FROM_POOL_INDEX(idx) \
+    (dc_chunks [((idx) - 1) / DCSLOTNUMBER] + ((idx) - 1) % DCSLOTNUMBER)
+
+/* the head of the free list: the generation and the index of the first DC */
+#define DC_INDEX_BITS           11
+#define DC_INDEX_MASK           ((1U << DC_INDEX_BITS) - 1)
+#define FREE_DC_INDEX(head)     ((head) & DC_INDEX_MASK)
+#define MAKE_FREE_DC_HEAD(old_head, idx) \
+    ((((old_head) & ~DC_INDEX_MASK) + (1U << DC_INDEX_BITS)) | (idx))
+
+#if defined(_MGHAVE_VIRTUAL_WINDOW) && defined(__GNUC__)
+#   define _MG_LOCKFREE_DCPOOL  1
+#endif
+
+static PDC dc_chunks [MAX_DC_CHUNKS];
+static int nr_dc_chunks;
+static Uint32 dc_free_head;
+static DCPOOLSTATS dc_pool_stats;
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+/* mutex ensuring exclusive access to the DC chunks.  */
+static pthread_mutex_t dcpool_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define LOCK_DCPOOL()        pthread_mutex_lock (&dcpool_lock)
+#   define UNLOCK_DCPOOL()      pthread_mutex_unlock (&dcpool_lock)
+#else
+#   define LOCK_DCPOOL()
+#   define UNLOCK_DCPOOL()
+#endif
+
+#ifdef _MG_LOCKFREE_DCPOOL
+#   define DCPOOL_STATS_INC(field)  \
+        __atomic_add_fetch (&dc_pool_stats.field, 1, __ATOMIC_RELAXED)
+#   define DCPOOL_STATS_DEC(field)  \
+        __atomic_sub_fetch (&dc_pool_stats.field, 1, __ATOMIC_RELAXED)
+#else
+#   define DCPOOL_STATS_INC(field)  (++dc_pool_stats.field)
+#   define DCPOOL_STATS_DEC(field)  (--dc_pool_stats.field)
+#endif
+
+/* raise the high-water mark of the used DCs to nr_used */
+static inline void update_max_used_dcs (size_t nr_used)
+{
+#ifdef _MG_LOCKFREE_DCPOOL
+    size_t max_used = __atomic_load_n (&dc_pool_stats.max_used,
+            __ATOMIC_RELAXED);
+
+    while (nr_used > max_used &&
+            !__atomic_compare_exchange_n (&dc_pool_stats.max_used, &max_used,
+                nr_used, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#else
+    if (nr_used > dc_pool_stats.max_used)
+        dc_pool_stats.max_used = nr_used;
+#endif
+}
+
+/* push the free DCs linked from first to last to the free list */
+static void push_free_dcs (PDC first, PDC last)
+{
+#ifdef _MG_LOCKFREE_DCPOOL
+    Uint32 head = __atomic_load_n (&dc_free_head, __ATOMIC_RELAXED);
+
+    do {
+        __atomic_store_n (&last->next_free, FREE_DC_INDEX (head),
+                __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n (&dc_free_head, &head,
+                MAKE_FREE_DC_HEAD (head, first->pool_idx), TRUE,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#else
+    LOCK_DCPOOL ();
+    last->next_free = FREE_DC_INDEX (dc_free_head);
+    dc_free_head = MAKE_FREE_DC_HEAD (dc_free_head, first->pool_idx);
+    UNLOCK_DCPOOL ();
+#endif
+}
+
+static PDC pop_free_dc (void)
+{
+    PDC pdc;
+
+#ifdef _MG_LOCKFREE_DCPOOL
+    Uint32 head = __atomic_load_n (&dc_free_head, __ATOMIC_ACQUIRE);
+    unsigned int next;
+
+    do {
+        if (FREE_DC_INDEX (head) == 0)
+            return NULL;
+
+        /* the chunks are never freed before the pool is terminated,
+           so it is safe to read a DC which was popped by other thread;
+           the generation in the head will make the CAS fail. */
+        pdc = DC_FROM_POOL_INDEX (FREE_DC_INDEX (head));
+        next = __atomic_load_n (&pdc->next_free, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n (&dc_free_head, &head,
+                MAKE_FREE_DC_HEAD (head, next), TRUE,
+                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+#else
+    LOCK_DCPOOL ();
+    if (FREE_DC_INDEX (dc_free_head) == 0) {
+        UNLOCK_DCPOOL ();
+        return NULL;
+    }
+
+    pdc = DC_FROM_POOL_INDEX (FREE_DC_INDEX (dc_free_head));
+    dc_free_head = MAKE_FREE_DC_HEAD (dc_free_head, pdc->next_free);
+    UNLOCK_DCPOOL ();
+#endif
+
+    return pdc;
+}
+
+/* add a new chunk of DCs to the pool; returns FALSE if the pool is full */
+static BOOL grow_dc_pool (void)
+{
+    PDC chunk;
+    int i;
+
+    LOCK_DCPOOL ();
+    if (nr_dc_chunks >= MAX_DC_CHUNKS ||
+            (chunk = calloc (DCSLOTNUMBER, sizeof (DC))) == NULL) {
+        UNLOCK_DCPOOL ();
+        return FALSE;
+    }
+
+    for (i = 0; i < DCSLOTNUMBER; i++) {
+        chunk [i].pool_idx = nr_dc_chunks * DCSLOTNUMBER + i + 1;
+        chunk [i].next_free = chunk [i].pool_idx + 1;
+    }
+
+    dc_chunks [nr_dc_chunks++] = chunk;
+    dc_pool_stats.nr_dcs = nr_dc_chunks * DCSLOTNUMBER;
+    UNLOCK_DCPOOL ();
+
+    push_free_dcs (chunk, chunk + DCSLOTNUMBER - 1);
+    return TRUE;
+}
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+typedef struct _THREADDCCACHE {
+    unsigned long   serial;
+    int             nr_dcs;
+    PDC             dcs [NR_THREAD_CACHED_DCS];
+} THREADDCCACHE;
+
+static pthread_once_t dc_cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t dc_cache_key;
+/* the serial number of the pool; changed when the pool is terminated. */
+static unsigned long dc_pool_serial;
+
+static void destroy_thread_dc_cache (void* data)
+{
+    THREADDCCACHE* cache = data;
+    int i;
+
+    LOCK_DCPOOL ();
+    if (cache->serial != dc_pool_serial)
+        cache->nr_dcs = 0;
+    UNLOCK_DCPOOL ();
+
+    for (i = 0; i < cache->nr_dcs; i++)
+        push_free_dcs (cache->dcs [i], cache->dcs [i]);
+
+    free (cache);
+}
+
+static void create_dc_cache_key (void)
+{
+    pthread_key_create (&dc_cache_key, destroy_thread_dc_cache);
+}
+
+static THREADDCCACHE* get_thread_dc_cache (void)
+{
+    THREADDCCACHE* cache;
+
+    pthread_once (&dc_cache_key_once, create_dc_cache_key);
+
+    cache = pthread_getspecific (dc_cache_key);
+    if (MG_UNLIKELY (cache == NULL)) {
+        cache = calloc (1, sizeof (THREADDCCACHE));
+        if (cache == NULL || pthread_setspecific (dc_cache_key, cache)) {
+            free (cache);
+            return NULL;
+        }
+        cache->serial = dc_pool_serial;
+    }
+    else if (MG_UNLIKELY (cache->serial != dc_pool_serial)) {
+        /* the cached DCs have gone with the last pool */
+        cache->serial = dc_pool_serial;
+        cache->nr_dcs = 0;
+    }
+
+    return cache;
+}
+#endif  /* defined _MGHAVE_VIRTUAL_WINDOW */
+
+/* allocate a general DC from the pool; returns NULL if the pool is full */
+static PDC alloc_general_dc (void)
+{
+    PDC pdc;
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    THREADDCCACHE* cache = get_thread_dc_cache ();
+
+    if (cache && cache->nr_dcs > 0) {
+        pdc = cache->dcs [--cache->nr_dcs];
+        goto done;
+    }
+#endif
+
+    while ((pdc = pop_free_dc ()) == NULL) {
+        if (!grow_dc_pool ()) {
+            DCPOOL_STATS_INC (nr_exhausted);
+            _WRN_PRINTF ("The DC pool is exhausted (%d DCs in use)\n",
+                    MAX_DC_CHUNKS * DCSLOTNUMBER);
+            return NULL;
+        }
+    }
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+done:
 #endif
+    pdc->bInUse = TRUE;
+    update_max_used_dcs (DCPOOL_STATS_INC (nr_used));
+    return pdc;
+}
+
+static void free_general_dc (PDC pdc)
+{
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    THREADDCCACHE* cache = get_thread_dc_cache ();
+#endif
+
+    pdc->bInUse = FALSE;
+    DCPOOL_STATS_DEC (nr_used);
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    if (cache && cache->nr_dcs < NR_THREAD_CACHED_DCS) {
+        cache->dcs [cache->nr_dcs++] = pdc;
+        return;
+    }
+#endif
+
+    push_free_dcs (pdc, pdc);
+}
+
+static void dc_TerminateDCPool (void)
+{
+    int i;
+
+    LOCK_DCPOOL ();
+    if (dc_pool_stats.nr_used > 0) {
+        _WRN_PRINTF ("There are still %zu DCs not released\n",
+                dc_pool_stats.nr_used);
+    }
+
+    for (i = 0; i < nr_dc_chunks; i++) {
+        free (dc_chunks [i]);
+        dc_chunks [i] = NULL;
+    }
+
+    nr_dc_chunks = 0;
+    dc_free_head = 0;
+    memset (&dc_pool_stats, 0, sizeof (dc_pool_stats));
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    dc_pool_serial++;
+#endif
+    UNLOCK_DCPOOL ();
+}
+
+BOOL GUIAPI GetDCPoolStats (DCPOOLSTATS* stats)
+{
+    if (stats == NULL)
+        return FALSE;
+
+    LOCK_DCPOOL ();
+    *stats = dc_pool_stats;
+    UNLOCK_DCPOOL ();
+    return TRUE;
+}
 
 BLOCKHEAP __mg_FreeClipRectList;
 
@@ -275,7 +561,6 @@ BOOL mg_InitScreenDC (void)
 #endif
 
     INIT_LOCK (&__mg_gdilock, NULL);
-    INIT_LOCK (&dcslot, NULL);
 
     dc_InitClipRgnInfo ();
 #ifdef _MGSCHEMA_COMPOSITING
@@ -333,7 +618,7 @@ void mg_TerminateScreenDC (void)
     __mg_destroy_common_rgba8888_dc ();
 
     DESTROY_LOCK (&__mg_gdilock);
-    DESTROY_LOCK (&dcslot);
+    dc_TerminateDCPool ();
 
     /* [2010/06/02] DongJunJie : fix a dead-lock bug of mgncs. */
     DestroyFreeClipRectList (&__mg_FreeClipRectList);
@@ -355,6 +640,20 @@ BOOL mg_InitGDI (void)
         goto error;
     }
 
+    if (!font_InitGlyphCache ()) {
+        _WRN_PRINTF ("Can not initialize glyph cache!\n");
+        goto error;
+    }
+
+    font_InitIndexCache ();
+
+#ifdef _MGCHARSET_UNICODE
+    if (!gdi_InitShapedRunCache ()) {
+        _WRN_PRINTF ("Can not initialize shaped run cache!\n");
+        goto error;
+    }
+#endif
+
 #ifdef _MGFONT_RBF
     INIT_SPECIFICAL_FONTS (FONT_ETC_SECTION_NAME_RBF);
 #endif
@@ -440,6 +739,10 @@ void mg_TerminateGDI( void )
     font_TerminateIncoreFonts ();
     font_ResetDevFont ();
 
+#ifdef _MGCHARSET_UNICODE
+    gdi_TermShapedRunCache ();
+#endif
+    font_TermGlyphCache ();
     TermTextBitmapBuffer ();
 }
 #endif
@@ -675,6 +978,14 @@ PDC __mg_check_ecrgn (HDC hdc)
     return pdc;
 }
 
+/* Since 5.0.16: the RLE encodings of a surface are dropped once the surface
+   is to be drawn to; they will be generated again by the next blit. */
+static inline void drop_rle_encodings (PDC pdc)
+{
+    if (pdc->surface->flags & GAL_RLEACCELOK)
+        GAL_DropRLESurface (pdc->surface);
+}
+
 int __mg_enter_drawing (PDC pdc)
 {
     BLOCK_DRAW_SEM (pdc);
@@ -690,6 +1001,7 @@ int __mg_enter_drawing (PDC pdc)
     LOCK (&__mg_gdilock);
     if (!dc_IsMemDC (pdc))
         kernel_ShowCursorForGDI (FALSE, pdc);
+    drop_rle_encodings (pdc);
 
     /* Since 5.0.12, to fix issue #107.
        Always use the background mode set by user as the initial value of
@@ -710,6 +1022,7 @@ void __mg_enter_drawing_nocheck (PDC pdc)
 
     if (!dc_IsMemDC (pdc))
         kernel_ShowCursorForGDI (FALSE, pdc);
+    drop_rle_encodings (pdc);
 }
 
 void __mg_leave_drawing(PDC pdc)
@@ -728,6 +1041,19 @@ void __mg_leave_drawing(PDC pdc)
     UNBLOCK_DRAW_SEM (pdc);
 }
 
+/* Since 5.0.16: the long spans are done by the SIMD fill kernels if there are */
+#define MIN_KERNEL_SPAN_BYTES   128
+
+static inline BOOL draw_span_by_kernels (COMP_CTXT* comp_ctxt, int bpp,
+        int op, int w)
+{
+    if (comp_ctxt->step != 1 || w * bpp < MIN_KERNEL_SPAN_BYTES)
+        return FALSE;
+
+    return GAL_FillSpans (comp_ctxt->cur_dst, 0, bpp, comp_ctxt->cur_pixel,
+            op, w, 1);
+}
+
 static void _dc_draw_pixel_span_set_0 (COMP_CTXT* comp_ctxt, int bytes_per_pixel, int w)
 {
     int n = w * bytes_per_pixel;
@@ -758,6 +1084,10 @@ static void _dc_draw_pixel_span_set_1 (COMP_CTXT* comp_ctxt, int w)
 static void _dc_draw_pixel_span_set_2 (COMP_CTXT* comp_ctxt, int w)
 {
     int step = comp_ctxt->step;
+
+    if (draw_span_by_kernels (comp_ctxt, 2, GAL_FILLOP_SET, w))
+        return;
+
     if (comp_ctxt->cur_pixel != 0 || comp_ctxt->step != 1) {
         Uint16 * dest16 = (Uint16 *)comp_ctxt->cur_dst;
         if (w < 5 || step != 1)
@@ -802,6 +1132,9 @@ static void _dc_draw_pixel_span_set_2 (COMP_CTXT* comp_ctxt, int w)
 
 static void  _dc_draw_pixel_span_set_3 (COMP_CTXT* comp_ctxt, int w)
 {
+    if (draw_span_by_kernels (comp_ctxt, 3, GAL_FILLOP_SET, w))
+        return;
+
     if (comp_ctxt->step == 1 && comp_ctxt->cur_pixel == 0) {
         _dc_draw_pixel_span_set_0 (comp_ctxt, 3, w);
     }
@@ -826,6 +1159,9 @@ static void  _dc_draw_pixel_span_set_4 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint32* row = (Uint32*)comp_ctxt->cur_dst;
 
+    if (draw_span_by_kernels (comp_ctxt, 4, GAL_FILLOP_SET, w))
+        return;
+
     if (comp_ctxt->step == 1) {
         GAL_memset4 (row, comp_ctxt->cur_pixel, w);
     }
@@ -861,6 +1197,10 @@ static void  _dc_draw_pixel_span_and_1 (COMP_CTXT* comp_ctxt, int w)
 static void  _dc_draw_pixel_span_and_2 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint16* row = (Uint16*)comp_ctxt->cur_dst;
+
+    if (draw_span_by_kernels (comp_ctxt, 2, GAL_FILLOP_AND, w))
+        return;
+
 #ifdef ASM_memandset4
     if (comp_ctxt->step == 1 && !((Uint32)row & 3)
             && !(w & 1) && (w > 1)) {
@@ -881,6 +1221,10 @@ static void  _dc_draw_pixel_span_and_3 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint8* row = comp_ctxt->cur_dst;
     int step = (comp_ctxt->step << 1) + comp_ctxt->step;
+
+    if (draw_span_by_kernels (comp_ctxt, 3, GAL_FILLOP_AND, w))
+        return;
+
 #ifdef ASM_memandset3
     if (comp_ctxt->step == 1) {
         ASM_memandset3 (row, comp_ctxt->cur_pixel, w);
@@ -898,6 +1242,10 @@ static void  _dc_draw_pixel_span_and_3 (COMP_CTXT* comp_ctxt, int w)
 static void  _dc_draw_pixel_span_and_4 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint32* row = (Uint32*)comp_ctxt->cur_dst;
+
+    if (draw_span_by_kernels (comp_ctxt, 4, GAL_FILLOP_AND, w))
+        return;
+
 #ifdef ASM_memandset4
     if (comp_ctxt->step == 1) {
         ASM_memandset4 (row, comp_ctxt->cur_pixel, w);
@@ -935,6 +1283,10 @@ static void  _dc_draw_pixel_span_or_1 (COMP_CTXT* comp_ctxt, int w)
 static void  _dc_draw_pixel_span_or_2 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint16* row = (Uint16*)comp_ctxt->cur_dst;
+
+    if (draw_span_by_kernels (comp_ctxt, 2, GAL_FILLOP_OR, w))
+        return;
+
 #ifdef ASM_memorset4
     if (comp_ctxt->step == 1 && !((Uint32)row & 3)
             && !(w & 1) && (w > 1)) {
@@ -956,6 +1308,9 @@ static void  _dc_draw_pixel_span_or_3 (COMP_CTXT* comp_ctxt, int w)
     Uint8* row = comp_ctxt->cur_dst;
     int step = (comp_ctxt->step << 1) + comp_ctxt->step;
 
+    if (draw_span_by_kernels (comp_ctxt, 3, GAL_FILLOP_OR, w))
+        return;
+
 #ifdef ASM_memorset3
     if (comp_ctxt->step == 1) {
         ASM_memorset3 (row, comp_ctxt->cur_pixel, w);
@@ -973,6 +1328,10 @@ static void  _dc_draw_pixel_span_or_3 (COMP_CTXT* comp_ctxt, int w)
 static void  _dc_draw_pixel_span_or_4 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint32* row = (Uint32*)comp_ctxt->cur_dst;
+
+    if (draw_span_by_kernels (comp_ctxt, 4, GAL_FILLOP_OR, w))
+        return;
+
 #ifdef ASM_memorset4
     if (comp_ctxt->step == 1) {
         ASM_memorset4 (row, comp_ctxt->cur_pixel, w);
@@ -1010,6 +1369,10 @@ static void  _dc_draw_pixel_span_xor_1 (COMP_CTXT* comp_ctxt, int w)
 static void  _dc_draw_pixel_span_xor_2 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint16* row = (Uint16*)comp_ctxt->cur_dst;
+
+    if (draw_span_by_kernels (comp_ctxt, 2, GAL_FILLOP_XOR, w))
+        return;
+
 #ifdef ASM_memxorset4
     if (comp_ctxt->step == 1 && !((Uint32)comp_ctxt->cur_dst & 3)
             && !(w & 1) && (w > 1)) {
@@ -1031,6 +1394,9 @@ static void  _dc_draw_pixel_span_xor_3 (COMP_CTXT* comp_ctxt, int w)
     Uint8* row = comp_ctxt->cur_dst;
     int step = (comp_ctxt->step << 1) + comp_ctxt->step;
 
+    if (draw_span_by_kernels (comp_ctxt, 3, GAL_FILLOP_XOR, w))
+        return;
+
 #ifdef ASM_memxorset3
     if (comp_ctxt->step == 1) {
         ASM_memxorset3 (comp_ctxt->cur_dst, comp_ctxt->cur_pixel, w);
@@ -1048,6 +1414,10 @@ static void  _dc_draw_pixel_span_xor_3 (COMP_CTXT* comp_ctxt, int w)
 static void  _dc_draw_pixel_span_xor_4 (COMP_CTXT* comp_ctxt, int w)
 {
     Uint32* row = (Uint32*)comp_ctxt->cur_dst;
+
+    if (draw_span_by_kernels (comp_ctxt, 4, GAL_FILLOP_XOR, w))
+        return;
+
 #ifdef ASM_memxorset4
     if (comp_ctxt->step == 1) {
         ASM_memxorset4 (comp_ctxt->cur_dst, comp_ctxt->cur_pixel, w);
@@ -2325,23 +2695,12 @@ HDC GUIAPI GetClientDC (HWND hWnd)
 
 HDC GUIAPI GetDCEx (HWND hWnd, BOOL bClient)
 {
-    int i;
     PDC pdc;
 
     MG_CHECK_RET (MG_IS_GRAPHICS_WINDOW(hWnd), HDC_INVALID);
 
-    /* allocate an empty dc slot exclusively */
-    LOCK (&dcslot);
-    for (i = 0; i < DCSLOTNUMBER; i++) {
-        if (!DCSlot[i].bInUse) {
-            pdc = DCSlot + i;
-            pdc->bInUse = TRUE;
-            break;
-        }
-    }
-    UNLOCK(&dcslot);
-
-    if (i >= DCSLOTNUMBER)
+    /* allocate a free dc from the pool exclusively */
+    if ((pdc = alloc_general_dc ()) == NULL)
         return HDC_SCREEN;
 
     pdc->DataType = TYPE_HDC;
@@ -2469,9 +2828,7 @@ void GUIAPI ReleaseDC (HDC hDC)
         pdc->pGCRInfo = NULL;
         pdc->oldage = 0;
 #endif
-        LOCK (&dcslot);
-        pdc->bInUse = FALSE;
-        UNLOCK(&dcslot);
+        free_general_dc (pdc);
     }
 }
 
@@ -2538,7 +2895,6 @@ static BOOL dc_InitSubDC (HDC hdcDest, HDC hdc, int off_x, int off_y,
  */
 HDC GUIAPI GetSubDC (HDC hdc, int off_x, int off_y, int width, int height)
 {
-    int i;
     int parent_width,parent_height;
     PDC pdc;
     PDC pdc_parent;
@@ -2561,28 +2917,20 @@ HDC GUIAPI GetSubDC (HDC hdc, int off_x, int off_y, int width, int height)
     if (off_y+height > parent_height)
         height = parent_height - off_y;
 
-    pdc = NULL;
-    LOCK (&dcslot);
-    for (i = 0; i < DCSLOTNUMBER; i++) {
-        if (!DCSlot[i].bInUse) {
-            pdc = &DCSlot [i];
-            pdc->bInUse   = TRUE;
-            pdc->DataType = pdc_parent->DataType;
-            pdc->DCType   = pdc_parent->DCType;
-            break;
-        }
-    }
-    UNLOCK (&dcslot);
-
-    if (pdc == NULL)
+    if ((pdc = alloc_general_dc ()) == NULL)
         return HDC_INVALID;
 
+    pdc->DataType = pdc_parent->DataType;
+    pdc->DCType   = pdc_parent->DCType;
+
     InitClipRgn (&pdc->lcrgn, &__mg_FreeClipRectList);
     MAKE_REGION_INFINITE(&pdc->lcrgn);
     InitClipRgn (&pdc->ecrgn, &__mg_FreeClipRectList);
 
     if (!dc_InitSubDC((HDC)pdc, hdc, off_x, off_y, width, height)) {
-        pdc->bInUse = FALSE;
+        EmptyClipRgn (&pdc->lcrgn);
+        EmptyClipRgn (&pdc->ecrgn);
+        free_general_dc (pdc);
         return HDC_INVALID;
     }
     return (HDC)pdc;
@@ -2870,7 +3218,6 @@ void ReleaseSecondarySubDC (HDC secondary_subdc)
 
 HDC GUIAPI GetDCInSecondarySurface (HWND hwnd, BOOL client)
 {
-    int i;
     PDC pdc = NULL, pdc_secondary;
     PCONTROL pCtrl;
     RECT minimal;
@@ -2889,21 +3236,9 @@ HDC GUIAPI GetDCInSecondarySurface (HWND hwnd, BOOL client)
         return GetDCEx (hwnd, client);
     }
 
-    /* allocate an empty dc slot exclusively */
-    LOCK (&dcslot);
-    for (i = 0; i < DCSLOTNUMBER; i++) {
-        if (!DCSlot[i].bInUse) {
-            pdc = DCSlot + i;
-            pdc->bInUse = TRUE;
-            break;
-        }
-    }
-    UNLOCK(&dcslot);
-
-    if (i >= DCSLOTNUMBER) {
-        _WRN_PRINTF ("No DC slot.\n");
+    /* allocate a free dc from the pool exclusively */
+    if ((pdc = alloc_general_dc ()) == NULL)
         return HDC_INVALID;
-    }
 
     pdc->DataType  = TYPE_HDC;
     pdc->DCType    = TYPE_MEMDC;
@@ -3058,6 +3393,7 @@ Uint8* GUIAPI LockDC (HDC hdc, const RECT* rw_rc, int* width, int* height,
     LOCK (&__mg_gdilock);
     if (!dc_IsMemDC (pdc))
         kernel_ShowCursorForGDI (FALSE, pdc);
+    drop_rle_encodings (pdc);
 
     if (width) *width = RECTW(pdc->rc_output);
     if (height) *height = RECTH(pdc->rc_output);
@@ -3123,6 +3459,7 @@ BOOL GUIAPI LockDCEx (HDC hdc, const PCLIPRGN region,
 
     if (!dc_IsMemDC (pdc))
         kernel_ShowCursorForGDI (FALSE, pdc);
+    drop_rle_encodings (pdc);
 
     pitch = pdc->surface->pitch;
     bpp = pdc->surface->format->BytesPerPixel;
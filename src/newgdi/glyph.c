@@ -422,6 +422,8 @@ typedef struct _GLYPH_CTXT
     int   style;
     CB_DRAW_SCANLINE cb;
 
+    /* the glyph in the glyph cache, must be released after drawn */
+    const CACHEDGLYPH* cached;
 } GLYPH_CTXT;
 
 /* global variable for fast check of clipping */
@@ -1935,6 +1937,39 @@ static BYTE* _gdi_flip_bitmap_vert (BYTE* src_bits, const SIZE* size, int pitch)
     return _scaled_bits;
 }
 
+/*
+ * The glyphs which need to be expanded or flipped are kept in the glyph cache.
+ * The device fonts creating instances for logical fonts are not cached:
+ * the instances are destroyed along with the logical fonts.
+ */
+#define IS_GLYPH_CACHEABLE(devfont) \
+    ((devfont)->font_ops->delete_instance == NULL)
+
+static BOOL _gdi_lookup_cached_glyph (PLOGFONT logfont, DEVFONT* devfont,
+        Glyph32 glyph_value, int bold, SIZE* bbox, GLYPH_CTXT* ctxt,
+        GLYPHKEY* key)
+{
+    key->devfont  = devfont;
+    key->glyph    = glyph_value;
+    key->size     = logfont->size;
+    key->rotation = logfont->rotation;
+    key->style    = logfont->style;
+    key->flags    = (DWORD)bold;
+    if (ctxt->cb == _dc_regular_scan_line)
+        key->flags |= 0x100;
+
+    ctxt->cached = font_LookupGlyph (key);
+    if (ctxt->cached == NULL)
+        return FALSE;
+
+    *bbox = ctxt->cached->bbox;
+    ctxt->data  = (BYTE*)ctxt->cached->bits;
+    ctxt->pitch = ctxt->cached->pitch;
+    ctxt->scale = ctxt->cached->scale;
+    ctxt->style = logfont->style;
+    return TRUE;
+}
+
 static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
         SIZE* bbox, int bold, GLYPH_CTXT* ctxt)
 {
@@ -1943,6 +1978,8 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
     BYTE* data = NULL;
     PLOGFONT logfont = pdc->pLogFont;
     DEVFONT* devfont = SELECT_DEVFONT_BY_GLYPH(pdc->pLogFont, glyph_value);
+    BOOL to_cache = FALSE;
+    GLYPHKEY key;
     glyph_value = REAL_GLYPH(glyph_value);
 
     DWORD bmptype = devfont->font_ops->get_glyph_bmptype (logfont, devfont);
@@ -1964,6 +2001,16 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
             ctxt->cb = _dc_regular_scan_line;
         }
 
+        if (IS_GLYPH_CACHEABLE (devfont) && (bold ||
+                    (logfont->style & (FS_FLIP_HORZ | FS_FLIP_VERT)) ||
+                    (GET_DEVFONT_SCALE (logfont, devfont) > 1 &&
+                        ctxt->cb != _dc_regular_scan_line))) {
+            if (_gdi_lookup_cached_glyph (logfont, devfont, glyph_value,
+                        bold, bbox, ctxt, &key))
+                return TRUE;
+            to_cache = TRUE;
+        }
+
         data = (BYTE*)(*devfont->font_ops->get_glyph_monobitmap) (logfont,
                 devfont, glyph_value, bbox, &pitch, &scale);
         bbox->cx += bold;
@@ -1999,9 +2046,17 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
     case GLYPHBMP_TYPE_GREY:
         /* get preybitmap */
         if (devfont->font_ops->get_glyph_greybitmap) {
+            ctxt->cb = _dc_bookgrey_scan_line;
+            if (IS_GLYPH_CACHEABLE (devfont) &&
+                    (logfont->style & (FS_FLIP_HORZ | FS_FLIP_VERT))) {
+                if (_gdi_lookup_cached_glyph (logfont, devfont, glyph_value,
+                            0, bbox, ctxt, &key))
+                    return TRUE;
+                to_cache = TRUE;
+            }
+
             data = (BYTE*)(*devfont->font_ops->get_glyph_greybitmap) (logfont,
                     devfont, glyph_value, bbox, &pitch, &scale);
-            ctxt->cb = _dc_bookgrey_scan_line;
             if (data && scale > 1) {
                 bbox->cx = bbox->cx / scale;
                 bbox->cy = bbox->cy / scale;
@@ -2070,6 +2125,9 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
     if (!data || !ctxt->cb)
         return FALSE;
 
+    if (to_cache)
+        font_CacheGlyph (&key, bbox, pitch, scale, data);
+
 #if 0
     if (ctxt->cb != _dc_bmpfont_scan_line && logfont->style & FS_FLIP_VERT) {
         data  = data + (bbox->cy-1) * pitch;
@@ -2171,6 +2229,8 @@ static inline void _gdi_direct_fillglyph (PDC pdc, Glyph32 glyph_value,
         old_pixel_x = -1;
         old_pixel_y = -1;
 #endif
+        if (ctxt->cached)
+            font_ReleaseGlyph (ctxt->cached);
     }
 }
 
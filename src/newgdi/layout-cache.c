@@ -0,0 +1,383 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** layout-cache.c: the cache of the shaped layout runs.
+**
+** Create date: 2026/10/18
+**
+** The labels of list views and menus are laid out again and again with
+** the same text and the same font. This cache keeps the glyph strings
+** returned by the shaping engine, keyed by the text of the layout run,
+** the logfont, the script, the language, the embedding level, the
+** direction, the orientation, the run flags, and the shaping engine.
+** The least recently used runs are evicted to honor the byte budget.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#ifdef _MGCHARSET_UNICODE
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+#   include <pthread.h>
+#endif
+
+#include "minigui.h"
+#include "gdi.h"
+#include "window.h"
+#include "devfont.h"
+#include "layout.h"
+
+/* the default byte budget of the cache in KiB */
+#define DEF_SHAPED_RUN_KBYTES   512
+
+/* the average size of a cached run, used to size the hash table */
+#define AVG_SHAPED_RUN_BYTES    512
+#define MIN_SHAPED_RUN_BUCKETS  64
+
+/* a run larger than this part of the budget is not cached */
+#define MAX_SHAPED_RUN_PART     16
+
+typedef struct _ShapedRunKey {
+    Uint64          hash;       // the hash of the uchars
+    const void*     engine;     // the shaping callback
+    RES_KEY         font;       // the resource key of the logfont
+    DWORD32         style;
+    int             size;
+    int             len;
+    Uint8           lc;
+    Uint8           st;
+    Uint8           el;
+    Uint8           dir;
+    Uint8           ort;
+    Uint8           flags;
+} ShapedRunKey;
+
+typedef struct _ShapedRun {
+    struct list_head    lru;
+    struct _ShapedRun*  hash_next;
+    ShapedRunKey        key;
+    size_t              nr_bytes;
+    int                 nr_glyphs;
+
+    /* the following arrays are allocated with the entry */
+    ShapedGlyph*        glyphs;
+    int*                log_clusters;
+    Uchar32*            ucs;
+} ShapedRun;
+
+typedef struct _ShapedRunCache {
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_mutex_t     lock;
+#endif
+    ShapedRun**         buckets;
+    unsigned int        bucket_mask;
+    size_t              max_bytes;
+    size_t              nr_bytes;
+    size_t              nr_runs;
+    struct list_head    lru;        // the most recently used run first
+
+    unsigned long       nr_hits;
+    unsigned long       nr_misses;
+    unsigned long       nr_evictions;
+} ShapedRunCache;
+
+static ShapedRunCache run_cache;
+static BOOL run_cache_enabled;
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+#   define LOCK_RUN_CACHE()     pthread_mutex_lock(&run_cache.lock)
+#   define UNLOCK_RUN_CACHE()   pthread_mutex_unlock(&run_cache.lock)
+#else
+#   define LOCK_RUN_CACHE()
+#   define UNLOCK_RUN_CACHE()
+#endif
+
+static BOOL make_run_key(const TEXTRUNS* truns, const LayoutRun* lrun,
+        ShapedRunKey* key)
+{
+    const FONT_RES* font_res = (const FONT_RES*)lrun->lf;
+    Uint64 h = 0xCBF29CE484222325ULL;
+    int i;
+
+    // the logfonts of layouts are always loaded as resources
+    if (font_res == NULL || font_res->key == RES_KEY_INVALID)
+        return FALSE;
+
+    for (i = 0; i < lrun->len; i++) {
+        h = (h ^ lrun->ucs[i]) * 0x100000001B3ULL;
+    }
+
+    memset(key, 0, sizeof(ShapedRunKey));
+    key->hash = h;
+    key->engine = (const void*)truns->sei.shape;
+    key->font = font_res->key;
+    key->style = lrun->lf->style;
+    key->size = lrun->lf->size;
+    key->len = lrun->len;
+    key->lc = lrun->lc;
+    key->st = lrun->st;
+    key->el = lrun->el;
+    key->dir = lrun->dir;
+    key->ort = lrun->ort;
+    key->flags = lrun->flags;
+    return TRUE;
+}
+
+static inline unsigned int get_bucket(const ShapedRunKey* key)
+{
+    Uint64 h = key->hash;
+
+    h = (h ^ ((Uint64)key->font << 32 | (Uint32)key->size))
+            * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ ((Uint64)key->st << 24 | (Uint64)key->el << 16 |
+                (Uint64)key->dir << 8 | key->ort)) * 0xC2B2AE3D27D4EB4FULL;
+
+    return (unsigned int)(h >> 32) & run_cache.bucket_mask;
+}
+
+static ShapedRun* find_shaped_run(const ShapedRunKey* key,
+        const Uchar32* ucs)
+{
+    ShapedRun* run = run_cache.buckets[get_bucket(key)];
+
+    while (run) {
+        if (memcmp(&run->key, key, sizeof(ShapedRunKey)) == 0 &&
+                memcmp(run->ucs, ucs, sizeof(Uchar32) * key->len) == 0)
+            return run;
+        run = run->hash_next;
+    }
+
+    return NULL;
+}
+
+static void remove_shaped_run(ShapedRun* run)
+{
+    ShapedRun** pprev = run_cache.buckets + get_bucket(&run->key);
+
+    while (*pprev != run)
+        pprev = &(*pprev)->hash_next;
+    *pprev = run->hash_next;
+
+    list_del(&run->lru);
+    run_cache.nr_bytes -= run->nr_bytes;
+    run_cache.nr_runs--;
+    free(run);
+}
+
+BOOL gdi_InitShapedRunCache(void)
+{
+    int kbytes;
+    unsigned int nr_buckets = MIN_SHAPED_RUN_BUCKETS;
+
+    if (GetMgEtcIntValue("glyphcache", "shaped_run_kbytes", &kbytes) < 0)
+        kbytes = DEF_SHAPED_RUN_KBYTES;
+
+    if (kbytes <= 0) {
+        _DBG_PRINTF("The shaped run cache is disabled\n");
+        run_cache_enabled = FALSE;
+        return TRUE;
+    }
+
+    memset(&run_cache, 0, sizeof(ShapedRunCache));
+    run_cache.max_bytes = (size_t)kbytes * 1024;
+    while (nr_buckets * AVG_SHAPED_RUN_BYTES < run_cache.max_bytes)
+        nr_buckets <<= 1;
+
+    run_cache.buckets = calloc(nr_buckets, sizeof(ShapedRun*));
+    if (run_cache.buckets == NULL) {
+        _WRN_PRINTF("Failed to allocate the shaped run cache\n");
+        return FALSE;
+    }
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_mutex_init(&run_cache.lock, NULL);
+#endif
+    run_cache.bucket_mask = nr_buckets - 1;
+    INIT_LIST_HEAD(&run_cache.lru);
+
+    run_cache_enabled = TRUE;
+    return TRUE;
+}
+
+void gdi_TermShapedRunCache(void)
+{
+    if (!run_cache_enabled)
+        return;
+
+    gdi_InvalidateShapedRunCache();
+    run_cache_enabled = FALSE;
+
+#ifdef _MGHAVE_VIRTUAL_WINDOW
+    pthread_mutex_destroy(&run_cache.lock);
+#endif
+    free(run_cache.buckets);
+    run_cache.buckets = NULL;
+}
+
+void gdi_InvalidateShapedRunCache(void)
+{
+    if (!run_cache_enabled)
+        return;
+
+    LOCK_RUN_CACHE();
+    while (!list_empty(&run_cache.lru)) {
+        remove_shaped_run((ShapedRun*)run_cache.lru.next);
+    }
+    UNLOCK_RUN_CACHE();
+}
+
+BOOL __mg_lookup_shaped_run(const TEXTRUNS* truns, const LayoutRun* lrun,
+        GlyphString* gs)
+{
+    ShapedRunKey key;
+    ShapedRun* run;
+
+    if (!run_cache_enabled || !make_run_key(truns, lrun, &key))
+        return FALSE;
+
+    LOCK_RUN_CACHE();
+    run = find_shaped_run(&key, lrun->ucs);
+    if (run) {
+        list_del(&run->lru);
+        list_add(&run->lru, &run_cache.lru);
+
+        __mg_glyph_string_set_size(gs, run->nr_glyphs);
+        memcpy(gs->glyphs, run->glyphs, sizeof(ShapedGlyph) * run->nr_glyphs);
+        memcpy(gs->log_clusters, run->log_clusters,
+                sizeof(int) * run->nr_glyphs);
+        run_cache.nr_hits++;
+    }
+    else {
+        run_cache.nr_misses++;
+    }
+    UNLOCK_RUN_CACHE();
+
+    return (run != NULL);
+}
+
+void __mg_cache_shaped_run(const TEXTRUNS* truns, const LayoutRun* lrun,
+        const GlyphString* gs)
+{
+    ShapedRunKey key;
+    ShapedRun* run;
+    size_t nr_bytes;
+
+    if (!run_cache_enabled || gs->nr_glyphs <= 0 ||
+            !make_run_key(truns, lrun, &key))
+        return;
+
+    nr_bytes = sizeof(ShapedRun) +
+        (sizeof(ShapedGlyph) + sizeof(int)) * gs->nr_glyphs +
+        sizeof(Uchar32) * lrun->len;
+    if (nr_bytes > run_cache.max_bytes / MAX_SHAPED_RUN_PART)
+        return;
+
+    /* copy the glyphs before taking the lock */
+    run = malloc(nr_bytes);
+    if (run == NULL)
+        return;
+
+    run->key = key;
+    run->nr_bytes = nr_bytes;
+    run->nr_glyphs = gs->nr_glyphs;
+    run->glyphs = (ShapedGlyph*)(run + 1);
+    run->log_clusters = (int*)(run->glyphs + gs->nr_glyphs);
+    run->ucs = (Uchar32*)(run->log_clusters + gs->nr_glyphs);
+    memcpy(run->glyphs, gs->glyphs, sizeof(ShapedGlyph) * gs->nr_glyphs);
+    memcpy(run->log_clusters, gs->log_clusters, sizeof(int) * gs->nr_glyphs);
+    memcpy(run->ucs, lrun->ucs, sizeof(Uchar32) * lrun->len);
+
+    LOCK_RUN_CACHE();
+    /* another thread may have cached the run in the meantime */
+    if (find_shaped_run(&key, lrun->ucs)) {
+        UNLOCK_RUN_CACHE();
+        free(run);
+        return;
+    }
+
+    while (run_cache.nr_bytes + nr_bytes > run_cache.max_bytes) {
+        remove_shaped_run((ShapedRun*)run_cache.lru.prev);
+        run_cache.nr_evictions++;
+    }
+
+    {
+        unsigned int bucket = get_bucket(&key);
+        run->hash_next = run_cache.buckets[bucket];
+        run_cache.buckets[bucket] = run;
+    }
+    list_add(&run->lru, &run_cache.lru);
+    run_cache.nr_bytes += nr_bytes;
+    run_cache.nr_runs++;
+    UNLOCK_RUN_CACHE();
+}
+
+BOOL GUIAPI GetShapedRunCacheStats(SHAPEDRUNCACHESTATS* stats)
+{
+    if (stats == NULL)
+        return FALSE;
+
+    memset(stats, 0, sizeof(SHAPEDRUNCACHESTATS));
+    if (!run_cache_enabled)
+        return TRUE;
+
+    LOCK_RUN_CACHE();
+    stats->max_bytes = run_cache.max_bytes;
+    stats->nr_bytes = run_cache.nr_bytes;
+    stats->nr_runs = run_cache.nr_runs;
+    stats->nr_hits = run_cache.nr_hits;
+    stats->nr_misses = run_cache.nr_misses;
+    stats->nr_evictions = run_cache.nr_evictions;
+    UNLOCK_RUN_CACHE();
+
+    return TRUE;
+}
+
+#endif /* _MGCHARSET_UNICODE */
@@ -152,6 +152,7 @@ LAYOUT* GUIAPI CreateLayout(
     }
 
     INIT_LIST_HEAD(&layout->lines);
+    INIT_LIST_HEAD(&layout->stale_lines);
     layout->nr_left_ucs = truns->nr_ucs;
 
     if (render_flags & GRF_WRITING_MODE_VERTICAL_FLAG) {
@@ -234,10 +235,153 @@ BOOL GUIAPI DestroyLayout(LAYOUT* layout)
         release_line(line);
     }
 
+    while (!list_empty(&layout->stale_lines)) {
+        LAYOUTLINE* line = (LAYOUTLINE*)layout->stale_lines.prev;
+        list_del(layout->stale_lines.prev);
+        release_line(line);
+    }
+
     mg_slice_delete(LAYOUT, layout);
     return TRUE;
 }
 
+/*
+ * A line starting after the edited text keeps its glyphs; only the indices
+ * need to be shifted. Ellipsized lines and the lines overlapping the edited
+ * text are released.
+ */
+static void stale_line(LAYOUT* layout, LAYOUTLINE* line,
+        int edit_end, int delta)
+{
+    struct list_head* i;
+
+    if (line->is_ellipsized || line->si < edit_end) {
+        release_line(line);
+        return;
+    }
+
+    line->si += delta;
+    list_for_each(i, &line->gruns) {
+        GlyphRun* run = (GlyphRun*)i;
+        run->lrun->si += delta;
+    }
+
+    list_add_tail(&line->list, &layout->stale_lines);
+}
+
+/*
+ * The text buffer may be changed by the edit; let the runs of a line
+ * kept or reused refer to the new one.
+ */
+static void rebase_line_text(LAYOUT* layout, LAYOUTLINE* line)
+{
+    struct list_head* i;
+
+    list_for_each(i, &line->gruns) {
+        GlyphRun* run = (GlyphRun*)i;
+        run->lrun->ucs = layout->truns->ucs + run->lrun->si;
+    }
+}
+
+/*
+ * Try to reuse a stale line when the new line boundary resynchronizes
+ * with it and the line is laid out in the same way.
+ */
+static LAYOUTLINE* reuse_stale_line(LAYOUT* layout,
+        int start_index, int max_extent, BOOL last_line)
+{
+    while (!list_empty(&layout->stale_lines)) {
+        LAYOUTLINE* line = (LAYOUTLINE*)layout->stale_lines.next;
+
+        if (line->si > start_index)
+            break;
+
+        list_del(&line->list);
+        if (line->si < start_index || line->max_extent != max_extent ||
+                line->is_last_line != (last_line ? 1 : 0)) {
+            release_line(line);
+            continue;
+        }
+
+        rebase_line_text(layout, line);
+        return line;
+    }
+
+    return NULL;
+}
+
+int GUIAPI UpdateLayout(LAYOUT* layout, const BreakOppo* break_oppos,
+        int start_index, int nr_del_ucs, int nr_ins_ucs,
+        LAYOUTLINE** last_kept_line)
+{
+    struct list_head stale_lines;
+    LAYOUTLINE* kept = NULL;
+    int nr_kept = 0, kept_end = 0;
+    int edit_end, delta;
+
+    if (layout == NULL || break_oppos == NULL)
+        return -1;
+
+    edit_end = start_index + nr_del_ucs;
+    delta = nr_ins_ucs - nr_del_ucs;
+    if (start_index < 0 || nr_del_ucs < 0 || nr_ins_ucs < 0 ||
+            start_index + nr_ins_ucs > layout->truns->nr_ucs)
+        return -1;
+
+    layout->bos = break_oppos;
+    INIT_LIST_HEAD(&stale_lines);
+
+    if (layout->persist) {
+        struct list_head *i, *n;
+        int index = 0;
+
+        /* A line ending before the edited text keeps its content, but
+           the break at its end may change if the first word of the next
+           line is edited; so we always re-lay out the last one of them. */
+        list_for_each(i, &layout->lines) {
+            LAYOUTLINE* line = (LAYOUTLINE*)i;
+            if (line->si + line->len >= start_index || line->is_ellipsized)
+                break;
+            nr_kept++;
+        }
+
+        if (nr_kept > 0)
+            nr_kept--;
+
+        list_for_each_safe(i, n, &layout->lines) {
+            if (index++ < nr_kept) {
+                kept = (LAYOUTLINE*)i;
+                rebase_line_text(layout, kept);
+                continue;
+            }
+
+            list_del(i);
+            list_add_tail(i, &stale_lines);
+        }
+
+        if (kept)
+            kept_end = kept->si + kept->len;
+    }
+
+    /* The pending stale lines follow the lines laid out, and they are
+       in the coordinates before this edit as well. */
+    list_concat(&stale_lines, &layout->stale_lines);
+
+    layout->nr_lines = nr_kept;
+    layout->nr_left_ucs = layout->truns->nr_ucs - kept_end;
+
+    while (!list_empty(&stale_lines)) {
+        LAYOUTLINE* line = (LAYOUTLINE*)stale_lines.next;
+        list_del(&line->list);
+        stale_line(layout, line, edit_end, delta);
+    }
+
+    if (last_kept_line)
+        *last_kept_line = kept;
+
+    return nr_kept;
+}
+
 typedef struct _LayoutState LayoutState;
 
 typedef enum {
@@ -573,15 +717,19 @@ static void shape_full(const Uchar32* lrun_ucs, int nr_lrun_ucs,
         const TEXTRUNS* truns, const LayoutRun* lrun,
         GlyphString* gs)
 {
-    if (!truns->sei.shape(truns->sei.inst, truns, lrun, gs)) {
-        shape_fallback(truns, lrun, gs);
-    }
+    __mg_shape_layout_run(truns, lrun, gs);
 }
 
 int __mg_shape_layout_run(const TEXTRUNS* truns, const LayoutRun* lrun,
         GlyphString* gs)
 {
-    if (!truns->sei.shape(truns->sei.inst, truns, lrun, gs)) {
+    if (__mg_lookup_shaped_run(truns, lrun, gs))
+        return gs->nr_glyphs;
+
+    if (truns->sei.shape(truns->sei.inst, truns, lrun, gs)) {
+        __mg_cache_shaped_run(truns, lrun, gs);
+    }
+    else {
         shape_fallback(truns, lrun, gs);
     }
 
@@ -2278,7 +2426,11 @@ LAYOUTLINE* GUIAPI LayoutNextLine(
     state.line_width = max_extent;
     state.remaining_width = max_extent;
 
-    next_line = check_next_line(layout, &state);
+    if (!list_empty(&layout->stale_lines))
+        next_line = reuse_stale_line(layout, state.line_start_index,
+                max_extent, last_line);
+    if (next_line == NULL)
+        next_line = check_next_line(layout, &state);
 
     if (state.glyphs) {
         __mg_glyph_string_free(state.glyphs);
@@ -146,6 +146,7 @@ struct _LAYOUT {
     int                 indent;     // indent value
 
     struct list_head    lines;      // the list head of lines
+    struct list_head    stale_lines;// the lines may be reused after an edit
 
     LOGFONT*            lf_upright; // the default upright logfont
     int                 nr_left_ucs;// the number of chars not laied out
@@ -223,6 +224,12 @@ BOOL __mg_layout_line_ellipsize(LAYOUTLINE *line, int goal_width);
 int __mg_shape_layout_run(const TEXTRUNS* info, const LayoutRun* run,
         GlyphString* glyphs);
 
+/* the cache of shaped runs; see layout-cache.c */
+BOOL __mg_lookup_shaped_run(const TEXTRUNS* truns, const LayoutRun* lrun,
+        GlyphString* gs);
+void __mg_cache_shaped_run(const TEXTRUNS* truns, const LayoutRun* lrun,
+        const GlyphString* gs);
+
 void __mg_reverse_shaped_glyphs(ShapedGlyph* glyphs, int len);
 void __mg_reverse_log_clusters(int* clusters, int len);
 
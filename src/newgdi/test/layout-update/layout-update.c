@@ -0,0 +1,463 @@
+/*
+** layout-update.c: regression test for the incremental relayout.
+**
+** Usage: layout-update [logfont-name]
+**
+** This program lays out a paragraph with a persisted LAYOUT object, then
+** edits the text step by step: it inserts, deletes, and replaces words,
+** and inserts or removes Hebrew text, which changes the embedding levels,
+** or, at the start of the paragraph, flips the base direction. After every
+** edit, it updates the breaking opportunities, the text runs, and the layout
+** by UStrUpdateBreaks, UpdateTextRuns, and UpdateLayout, lays out the changed
+** lines, and checks the breaking opportunities against the ones calculated
+** for the whole edited text, and every line against a new LAYOUT object
+** created for the edited text: the size of the line, and the glyph value,
+** the position, the character, and the font of every glyph, in the visual
+** order, with the starts of the runs.
+**
+** The edits are checked for a fixed line extent with the first line
+** indented, and for a variable line extent.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+#define MAX_GLYPHS      2048
+#define MAX_LINES       128
+
+typedef struct {
+    Glyph32 gv;
+    int x, y, x_off, y_off, advance;
+    int uc_index;
+    Uchar32 uc;
+    int font_size;
+    int flags;
+    BOOL run_start;
+} LAIDOUTGLYPH;
+
+typedef struct {
+    int nr_lines;
+    int nr_glyphs;
+    SIZE sizes [MAX_LINES];
+    int first_glyphs [MAX_LINES + 1];
+    LAIDOUTGLYPH glyphs [MAX_GLYPHS];
+    LOGFONT* last_lf;
+} LINESINFO;
+
+typedef struct {
+    Uchar32* ucs;
+    int nr_ucs;
+    BreakOppo* bos;
+    TEXTRUNS* truns;
+    LAYOUT* layout;
+} PARAGRAPH;
+
+typedef struct {
+    const char* desc;
+    int start;      /* < 0: from the end of the paragraph */
+    int nr_del;
+    const char* ins;
+} EDIT;
+
+typedef struct {
+    const char* desc;
+    Uint32 render_flags;
+    int max_extent;     /* for the variable line extent */
+} LAYOUTMODE;
+
+static const char* text =
+    "The quick brown fox jumps over the lazy dog, "
+    "and the lazy dog sleeps in the sun all the afternoon. "
+    "Then the fox comes back with a friend, "
+    "and they run around the farm until the farmer wakes up.";
+
+static const EDIT edits [] = {
+    { "insert a word in the first line", 4, 0, "very " },
+    { "insert a word in the middle", 60, 0, "really " },
+    { "delete a word", 10, 6, NULL },
+    { "replace a word", 40, 4, "cat" },
+    { "delete a space between two lines", 80, 1, NULL },
+    { "insert a line separator", 70, 0, "\342\200\250" },
+    { "edit after the line separator", 75, 3, "fast" },
+    { "edit before the line separator", 62, 2, NULL },
+    { "insert a long word", 100, 0, "Supercalifragilistic " },
+    { "append a sentence", -1, 0, " The end." },
+    { "insert Hebrew text in the middle", 50, 0,
+        "\327\251\327\234\327\225\327\235 \327\242\327\225\327\234\327\235 " },
+    { "replace the Hebrew text", 50, 4, "\327\244\327\251\327\225\327\230" },
+    { "flip the base direction to RTL", 0, 0,
+        "\327\242\327\221\327\250\327\231\327\252 " },
+    { "edit the tail of an RTL paragraph", -10, 4, "cow" },
+    { "flip the base direction back to LTR", 0, 6, NULL },
+    { "delete a whole line", 20, 40, NULL },
+    { "delete almost everything", 1, -2, NULL },
+};
+
+static const LAYOUTMODE modes [] = {
+    { "fixed extent, first line indented",
+        GRF_WRITING_MODE_HORIZONTAL_TB | GRF_LINE_EXTENT_FIXED |
+        GRF_INDENT_FIRST_LINE, 0 },
+    { "variable extent",
+        GRF_WRITING_MODE_HORIZONTAL_TB | GRF_LINE_EXTENT_VARIABLE, 140 },
+};
+
+static PLOGFONT lf_utf8;
+static const char* fontname = "ttf-dejavu-rrncnn-0-16-UTF-8";
+static const char* big_fontname = "ttf-dejavu-rrncnn-0-20-UTF-8";
+
+static int to_uchars (const char* utf8, Uchar32** ucs)
+{
+    int n = 0, consumed;
+
+    *ucs = NULL;
+    if (utf8 == NULL || utf8 [0] == '\0')
+        return 0;
+
+    consumed = GetUCharsUntilParagraphBoundary (lf_utf8, utf8,
+            strlen (utf8), WSR_PRE_WRAP, ucs, &n);
+    if (consumed <= 0)
+        return 0;
+    return n;
+}
+
+static BOOL get_breaks (PARAGRAPH* para)
+{
+    free (para->bos);
+    para->bos = NULL;
+    return UStrGetBreaks (LANGCODE_en, CTR_NONE, WBR_NORMAL, LBP_NORMAL,
+            para->ucs, para->nr_ucs, &para->bos) > 0;
+}
+
+/* updates the breaks after an edit, and checks them */
+static BOOL update_breaks (PARAGRAPH* para, int* start, int* nr_del,
+        int* nr_ins)
+{
+    BreakOppo* bos = NULL;
+    int n;
+
+    if (UStrUpdateBreaks (LANGCODE_en, CTR_NONE, WBR_NORMAL, LBP_NORMAL,
+                para->ucs, para->nr_ucs, start, nr_del, nr_ins,
+                &para->bos) != para->nr_ucs + 1)
+        return FALSE;
+
+    n = UStrGetBreaks (LANGCODE_en, CTR_NONE, WBR_NORMAL, LBP_NORMAL,
+            para->ucs, para->nr_ucs, &bos);
+    if (n != para->nr_ucs + 1 ||
+            memcmp (bos, para->bos, sizeof (BreakOppo) * n)) {
+        fprintf (stderr, "The breaks updated differ from the new ones\n");
+        free (bos);
+        return FALSE;
+    }
+
+    free (bos);
+    return TRUE;
+}
+
+static BOOL glyph_laid_out (GHANDLE ctxt, Glyph32 gv,
+        const GLYPHPOS* pos, const RENDERDATA* data)
+{
+    LINESINFO* info = (LINESINFO*)ctxt;
+    LAIDOUTGLYPH* gi;
+
+    if (info->nr_glyphs >= MAX_GLYPHS)
+        return FALSE;
+
+    gi = info->glyphs + info->nr_glyphs++;
+    gi->gv = gv;
+    gi->x = pos->x;
+    gi->y = pos->y;
+    gi->x_off = pos->x_off;
+    gi->y_off = pos->y_off;
+    gi->advance = pos->advance;
+    gi->uc_index = data->uc_index;
+    gi->uc = data->uc;
+    gi->font_size = data->logfont->size;
+    gi->flags = pos->suppressed | (pos->whitespace << 1) |
+        (pos->ellipsis << 2) | (pos->orientation << 3) | (pos->hanged << 5);
+    gi->run_start = (data->logfont != info->last_lf);
+    info->last_lf = data->logfont;
+    return TRUE;
+}
+
+/* lays out the lines after the line `line`, if there are */
+static int layout_lines (LAYOUT* layout, LAYOUTLINE* line, int max_extent)
+{
+    int n = 0;
+
+    while ((line = LayoutNextLine (layout, line, max_extent, FALSE,
+                    NULL, 0)) && n < MAX_LINES) {
+        n++;
+    }
+
+    return n;
+}
+
+/* gets the lines of a persisted layout which has been laid out */
+static void get_lines (LAYOUT* layout, int max_extent, LINESINFO* info)
+{
+    LAYOUTLINE* line = NULL;
+
+    info->nr_lines = 0;
+    info->nr_glyphs = 0;
+    while (info->nr_lines < MAX_LINES) {
+        info->last_lf = NULL;
+        info->first_glyphs [info->nr_lines] = info->nr_glyphs;
+        line = LayoutNextLine (layout, line, max_extent, FALSE,
+                glyph_laid_out, (GHANDLE)info);
+        if (line == NULL)
+            break;
+
+        GetLayoutLineSize (line, info->sizes + info->nr_lines);
+        info->nr_lines++;
+    }
+    info->first_glyphs [info->nr_lines] = info->nr_glyphs;
+}
+
+static char why [256];
+
+static int compare_lines (const LINESINFO* updated, const LINESINFO* fresh)
+{
+    int i, j;
+
+    if (updated->nr_lines != fresh->nr_lines) {
+        snprintf (why, sizeof (why), "%d lines, but %d lines in a new layout",
+                updated->nr_lines, fresh->nr_lines);
+        return 1;
+    }
+
+    for (i = 0; i < fresh->nr_lines; i++) {
+        int first = fresh->first_glyphs [i];
+        int nr_glyphs = fresh->first_glyphs [i + 1] - first;
+
+        if (updated->first_glyphs [i] != first ||
+                updated->first_glyphs [i + 1] - first != nr_glyphs) {
+            snprintf (why, sizeof (why),
+                    "line %d: %d glyphs, but %d glyphs in a new layout", i,
+                    updated->first_glyphs [i + 1] - updated->first_glyphs [i],
+                    nr_glyphs);
+            return 1;
+        }
+
+        if (updated->sizes [i].cx != fresh->sizes [i].cx ||
+                updated->sizes [i].cy != fresh->sizes [i].cy) {
+            snprintf (why, sizeof (why),
+                    "line %d: size %dx%d, but %dx%d in a new layout", i,
+                    updated->sizes [i].cx, updated->sizes [i].cy,
+                    fresh->sizes [i].cx, fresh->sizes [i].cy);
+            return 1;
+        }
+
+        for (j = first; j < first + nr_glyphs; j++) {
+            const LAIDOUTGLYPH* a = updated->glyphs + j;
+            const LAIDOUTGLYPH* b = fresh->glyphs + j;
+
+            if (a->gv != b->gv || a->x != b->x || a->y != b->y ||
+                    a->x_off != b->x_off || a->y_off != b->y_off ||
+                    a->advance != b->advance ||
+                    a->uc_index != b->uc_index || a->uc != b->uc ||
+                    a->font_size != b->font_size || a->flags != b->flags ||
+                    a->run_start != b->run_start) {
+                snprintf (why, sizeof (why),
+                        "line %d, glyph %d: U+%04X at %d (index %d), "
+                        "but U+%04X at %d (index %d) in a new layout",
+                        i, j - first, a->uc, a->x, a->uc_index,
+                        b->uc, b->x, b->uc_index);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static LAYOUT* create_layout (PARAGRAPH* para, const LAYOUTMODE* mode)
+{
+    return CreateLayout (para->truns, mode->render_flags, para->bos + 1,
+            TRUE, 160, 12, 0, 0, 4, NULL, 0);
+}
+
+static BOOL create_paragraph (PARAGRAPH* para, const Uchar32* ucs,
+        int nr_ucs, const LAYOUTMODE* mode, const TEXTRUNS* fonts_from)
+{
+    memset (para, 0, sizeof (PARAGRAPH));
+    para->ucs = malloc (sizeof (Uchar32) * nr_ucs);
+    memcpy (para->ucs, ucs, sizeof (Uchar32) * nr_ucs);
+    para->nr_ucs = nr_ucs;
+    if (!get_breaks (para))
+        return FALSE;
+
+    para->truns = CreateTextRuns (para->ucs, para->nr_ucs, LANGCODE_en,
+            BIDI_PGDIR_ON, fontname, MakeRGB (0, 0, 0), 0, para->bos + 1);
+    if (para->truns == NULL)
+        return FALSE;
+
+    if (fonts_from) {
+        /* use the fonts kept by the updated text runs */
+        int i;
+        for (i = 0; i < nr_ucs; i++) {
+            const char* name = GetFontNameInTextRuns (fonts_from, i);
+            if (name && strcmp (name, fontname))
+                SetFontNameInTextRuns (para->truns, i, 1, name);
+        }
+    }
+    else {
+        SetFontNameInTextRuns (para->truns, 20, 30, big_fontname);
+    }
+
+    if (!InitBasicShapingEngine (para->truns))
+        return FALSE;
+
+    para->layout = create_layout (para, mode);
+    return para->layout != NULL;
+}
+
+static void destroy_paragraph (PARAGRAPH* para)
+{
+    if (para->layout)
+        DestroyLayout (para->layout);
+    if (para->truns)
+        DestroyTextRuns (para->truns);
+    free (para->bos);
+    free (para->ucs);
+}
+
+/* edits the text of the paragraph, and updates the layout */
+static int edit_paragraph (PARAGRAPH* para, const EDIT* edit,
+        int max_extent, int* nr_kept)
+{
+    Uchar32 *ins, *ucs, *old_ucs = para->ucs;
+    int nr_ins = to_uchars (edit->ins, &ins);
+    int start = edit->start, nr_del = edit->nr_del, nr_ucs;
+    int dmg_start, dmg_del, dmg_ins;
+    LAYOUTLINE* last_kept;
+
+    if (start < 0)
+        start += para->nr_ucs + 1;
+    if (nr_del < 0)
+        nr_del += para->nr_ucs - start + 1;
+    if (start + nr_del > para->nr_ucs)
+        nr_del = para->nr_ucs - start;
+
+    nr_ucs = para->nr_ucs - nr_del + nr_ins;
+    ucs = malloc (sizeof (Uchar32) * nr_ucs);
+    memcpy (ucs, para->ucs, sizeof (Uchar32) * start);
+    if (nr_ins > 0)
+        memcpy (ucs + start, ins, sizeof (Uchar32) * nr_ins);
+    memcpy (ucs + start + nr_ins, para->ucs + start + nr_del,
+            sizeof (Uchar32) * (para->nr_ucs - start - nr_del));
+    free (ins);
+
+    para->ucs = ucs;
+    para->nr_ucs = nr_ucs;
+
+    dmg_start = start;
+    dmg_del = nr_del;
+    dmg_ins = nr_ins;
+    if (!update_breaks (para, &dmg_start, &dmg_del, &dmg_ins)) {
+        free (old_ucs);
+        return -1;
+    }
+
+    if (!UpdateTextRuns (para->truns, para->ucs, para->nr_ucs,
+                para->bos + 1, &dmg_start, &dmg_del, &dmg_ins)) {
+        free (old_ucs);
+        return -1;
+    }
+
+    *nr_kept = UpdateLayout (para->layout, para->bos + 1,
+            dmg_start, dmg_del, dmg_ins, &last_kept);
+
+    /* the layout does not refer to the old text any more */
+    free (old_ucs);
+    if (*nr_kept < 0)
+        return -1;
+
+    return layout_lines (para->layout, last_kept, max_extent);
+}
+
+static int check_mode (const LAYOUTMODE* mode)
+{
+    PARAGRAPH para, fresh;
+    static LINESINFO updated, expected;
+    Uchar32* ucs;
+    int i, nr_ucs, bad = 0;
+
+    printf ("%s:\n", mode->desc);
+
+    nr_ucs = to_uchars (text, &ucs);
+    if (nr_ucs <= 0 || !create_paragraph (&para, ucs, nr_ucs, mode, NULL)) {
+        fprintf (stderr, "Failed to create the paragraph\n");
+        free (ucs);
+        return 1;
+    }
+    free (ucs);
+
+    layout_lines (para.layout, NULL, mode->max_extent);
+
+    for (i = 0; i < (int)TABLESIZE (edits); i++) {
+        int nr_kept, nr_laid_out;
+
+        nr_laid_out = edit_paragraph (&para, edits + i, mode->max_extent,
+                &nr_kept);
+        if (nr_laid_out < 0) {
+            printf ("  %-40s FAILED to update\n", edits [i].desc);
+            bad++;
+            break;
+        }
+
+        get_lines (para.layout, mode->max_extent, &updated);
+
+        if (!create_paragraph (&fresh, para.ucs, para.nr_ucs, mode,
+                    para.truns)) {
+            fprintf (stderr, "Failed to create the new paragraph\n");
+            destroy_paragraph (&fresh);
+            bad++;
+            break;
+        }
+
+        layout_lines (fresh.layout, NULL, mode->max_extent);
+        get_lines (fresh.layout, mode->max_extent, &expected);
+
+        printf ("  %-40s %2d lines, %2d kept, %2d laid out: ",
+                edits [i].desc, updated.nr_lines, nr_kept, nr_laid_out);
+        if (compare_lines (&updated, &expected)) {
+            printf ("MISMATCH\n    %s\n", why);
+            bad++;
+        }
+        else {
+            printf ("ok\n");
+        }
+
+        destroy_paragraph (&fresh);
+    }
+
+    destroy_paragraph (&para);
+    return bad;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    int i, bad = 0;
+
+    if (argc > 1)
+        fontname = argv [1];
+
+    lf_utf8 = CreateLogFontForMChar2UChar ("UTF-8");
+    if (lf_utf8 == NULL) {
+        fprintf (stderr, "Failed to create the logfont\n");
+        return 1;
+    }
+
+    for (i = 0; i < (int)TABLESIZE (modes); i++) {
+        bad += check_mode (modes + i);
+    }
+    printf ("%s\n", bad ? "MISMATCH" : "all lines match the new layouts");
+
+    DestroyLogFont (lf_utf8);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/*
+** listview-bench.c: benchmark for laying out the rows of a list view.
+**
+** Usage: listview-bench [logfont-name] [frames]
+**
+** This program redraws a list view of 1000 rows in three columns to a
+** memory DC for the given number of frames (20 by default). The label of
+** every cell is laid out with a LAYOUT object and drawn by DrawLayoutLine,
+** as a list view does when it is scrolled or repainted. It reports the time
+** to lay out the rows of a frame, the time to redraw a frame, and the
+** statistics of the shaped run cache.
+**
+** To compare the redrawing with and without the shaped run cache, run this
+** program again with `shaped_run_kbytes=0` in the section `glyphcache` of
+** MiniGUI.cfg.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define NR_ROWS         1000
+#define NR_COLUMNS      3
+#define ROW_HEIGHT      20
+#define DEF_FRAMES      20
+
+static const int col_widths [NR_COLUMNS] = { 240, 160, 80 };
+
+static const char* file_types [] = {
+    "Text Document",
+    "PNG Image",
+    "Folder",
+    "Shell Script",
+    "Compressed Archive",
+};
+
+static PLOGFONT lf_utf8;
+
+static double now_ms (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void make_cell_text (int row, int col, char* buff, size_t size)
+{
+    switch (col) {
+    case 0:
+        snprintf (buff, size, "Quarterly report %04d (final).txt", row);
+        break;
+    case 1:
+        snprintf (buff, size, "%s",
+                file_types [row % TABLESIZE (file_types)]);
+        break;
+    default:
+        snprintf (buff, size, "%d KB", (row * 37) % 512 + 1);
+        break;
+    }
+}
+
+static int draw_cell (HDC hdc, const char* fontname, const char* text,
+        int x, int y, int width)
+{
+    Uchar32* ucs = NULL;
+    BreakOppo* bos = NULL;
+    TEXTRUNS* truns;
+    LAYOUT* layout;
+    LAYOUTLINE* line = NULL;
+    int nr_ucs, n, nr_lines = 0;
+
+    nr_ucs = GetUCharsUntilParagraphBoundary (lf_utf8, text,
+            strlen (text), WSR_NOWRAP, &ucs, &n);
+    if (nr_ucs <= 0 || n <= 0)
+        goto out;
+
+    if (UStrGetBreaks (LANGCODE_en, CTR_NONE, WBR_NORMAL, LBP_NORMAL,
+                ucs, n, &bos) <= 0)
+        goto out;
+
+    truns = CreateTextRuns (ucs, n, LANGCODE_en, BIDI_PGDIR_LTR,
+            fontname, MakeRGB (0, 0, 0), 0, bos + 1);
+    if (truns == NULL)
+        goto out;
+
+    InitBasicShapingEngine (truns);
+    layout = CreateLayout (truns, GRF_WRITING_MODE_HORIZONTAL_TB |
+            GRF_OVERFLOW_ELLIPSIZE_END, bos + 1, FALSE, width,
+            0, 0, 0, 4, NULL, 0);
+    if (layout) {
+        while ((line = LayoutNextLine (layout, line, 0, TRUE, NULL, 0))) {
+            if (hdc != HDC_INVALID)
+                DrawLayoutLine (hdc, line, x, y);
+            nr_lines++;
+        }
+        DestroyLayout (layout);
+    }
+    DestroyTextRuns (truns);
+
+out:
+    free (bos);
+    free (ucs);
+    return nr_lines;
+}
+
+static int redraw_listview (HDC hdc, const char* fontname)
+{
+    char text [128];
+    int row, col, x, nr_lines = 0;
+
+    for (row = 0; row < NR_ROWS; row++) {
+        x = 0;
+        for (col = 0; col < NR_COLUMNS; col++) {
+            make_cell_text (row, col, text, sizeof (text));
+            nr_lines += draw_cell (hdc, fontname, text,
+                    x, (row * ROW_HEIGHT) % 480, col_widths [col]);
+            x += col_widths [col];
+        }
+    }
+
+    return nr_lines;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    const char* fontname = "ttf-dejavu-rrncnn-0-16-UTF-8";
+    int nr_frames = DEF_FRAMES, n, nr_lines = 0;
+    SHAPEDRUNCACHESTATS stats;
+    HDC hdc;
+    double t, t_first, t_layout;
+
+    if (argc > 1)
+        fontname = argv [1];
+    if (argc > 2 && atoi (argv [2]) > 0)
+        nr_frames = atoi (argv [2]);
+
+    lf_utf8 = CreateLogFontForMChar2UChar ("UTF-8");
+    hdc = CreateMemDC (col_widths [0] + col_widths [1] + col_widths [2], 480,
+            32, MEMDC_FLAG_SWSURFACE, 0, 0, 0, 0);
+    if (lf_utf8 == NULL || hdc == HDC_INVALID) {
+        fprintf (stderr, "Failed to create the logfont or memory DC\n");
+        return 1;
+    }
+
+    /* the first frame fills the cache */
+    t_first = now_ms ();
+    redraw_listview (hdc, fontname);
+    t_first = now_ms () - t_first;
+
+    t_layout = now_ms ();
+    for (n = 0; n < nr_frames; n++) {
+        redraw_listview (HDC_INVALID, fontname);
+    }
+    t_layout = (now_ms () - t_layout) / nr_frames;
+
+    t = now_ms ();
+    for (n = 0; n < nr_frames; n++) {
+        nr_lines += redraw_listview (hdc, fontname);
+    }
+    t = (now_ms () - t) / nr_frames;
+
+    printf ("first frame:     %8.3f ms\n", t_first);
+    printf ("layout only:     %8.3f ms per frame\n", t_layout);
+    printf ("layout and draw: %8.3f ms per frame (%d lines)\n",
+            t, nr_lines / nr_frames);
+
+    if (GetShapedRunCacheStats (&stats)) {
+        unsigned long nr_lookups = stats.nr_hits + stats.nr_misses;
+
+        printf ("shaped run cache: %lu hits, %lu misses (%.1f%%), "
+                "%lu evictions, %lu runs in %lu/%lu bytes\n",
+                stats.nr_hits, stats.nr_misses,
+                nr_lookups ? stats.nr_hits * 100.0 / nr_lookups : 0.0,
+                stats.nr_evictions, (unsigned long)stats.nr_runs,
+                (unsigned long)stats.nr_bytes,
+                (unsigned long)stats.max_bytes);
+    }
+
+    DeleteMemDC (hdc);
+    DestroyLogFont (lf_utf8);
+    return 0;
+}
@@ -450,16 +450,58 @@ out:
     return ok;
 }
 
+/* Resolve the embedding levels and split the whole paragraph into runs */
+static BOOL itemize_text_runs(TEXTRUNS* runinfo, BreakOppo* break_oppos)
+{
+    BOOL ok = FALSE;
+    BidiLevel  local_els[LOCAL_ARRAY_SIZE];
+    BidiLevel* els = NULL;
+
+    if (runinfo->nr_ucs < LOCAL_ARRAY_SIZE)
+        els = local_els;
+    else
+        els = (BidiLevel*)malloc(runinfo->nr_ucs * sizeof(BidiLevel));
+
+    if (!els) {
+        _ERR_PRINTF("%s: failed to allocate space for embedding levels.\n",
+            __FUNCTION__);
+        goto out;
+    }
+
+    runinfo->base_dir = runinfo->spec_dir;
+    UBidiGetParagraphEmbeddingLevelsAlt(runinfo->ucs, runinfo->nr_ucs,
+            &runinfo->base_dir, els);
+
+    if (!create_text_runs(runinfo, els)) {
+        _ERR_PRINTF("%s: failed to call create_text_runs.\n",
+            __FUNCTION__);
+        goto out;
+    }
+
+    if (break_oppos) {
+        struct list_head* i;
+        list_for_each(i, &runinfo->truns) {
+            TextRun* trun = (TextRun*)i;
+            UStrTailorBreaks(trun->st, runinfo->ucs + trun->si, trun->len,
+                break_oppos + trun->si);
+        }
+    }
+
+    ok = TRUE;
+
+out:
+    if (els && els != local_els)
+        free(els);
+
+    return ok;
+}
+
 TEXTRUNS* GUIAPI CreateTextRuns(const Uchar32* ucs, int nr_ucs,
         LanguageCode lang_code, ParagraphDir base_dir,
         const char* logfont_name, RGBCOLOR color, RGBCOLOR bg_color,
         BreakOppo* break_oppos)
 {
-    BOOL ok = FALSE;
-
     TEXTRUNS* runinfo;
-    BidiLevel  local_els[LOCAL_ARRAY_SIZE];
-    BidiLevel* els = NULL;
 
     if (ucs == NULL || nr_ucs <= 0 || logfont_name == NULL) {
         return NULL;
@@ -475,19 +517,6 @@ TEXTRUNS* GUIAPI CreateTextRuns(const Uchar32* ucs, int nr_ucs,
         return NULL;
     }
 
-    if (nr_ucs < LOCAL_ARRAY_SIZE)
-        els = local_els;
-    else
-        els = (BidiLevel*)malloc(nr_ucs * sizeof(BidiLevel));
-
-    if (!els) {
-        _ERR_PRINTF("%s: failed to allocate space for embedding levels.\n",
-            __FUNCTION__);
-        goto out;
-    }
-
-    UBidiGetParagraphEmbeddingLevelsAlt(ucs, nr_ucs, &base_dir, els);
-
     // Initialize other fields
     runinfo->ucs        = ucs;
     runinfo->fontname   = strdup(logfont_name);
@@ -496,7 +525,7 @@ TEXTRUNS* GUIAPI CreateTextRuns(const Uchar32* ucs, int nr_ucs,
         runinfo->lc     = LANGCODE_en;  // fallback to English
     else
         runinfo->lc     = lang_code;
-    runinfo->base_dir = base_dir;
+    runinfo->spec_dir   = base_dir;
 
 #if 0
     runinfo->base_level = (base_dir == BIDI_PGDIR_LTR) ? 0 : 1;
@@ -521,32 +550,10 @@ TEXTRUNS* GUIAPI CreateTextRuns(const Uchar32* ucs, int nr_ucs,
     INIT_LIST_HEAD(&runinfo->truns);
     runinfo->nr_runs = 0;
 
-    if (!create_text_runs(runinfo, els)) {
-        _ERR_PRINTF("%s: failed to call create_text_runs.\n",
-            __FUNCTION__);
-        goto out;
-    }
-
-    if (break_oppos) {
-        struct list_head* i;
-        list_for_each(i, &runinfo->truns) {
-            TextRun* trun = (TextRun*)i;
-            UStrTailorBreaks(trun->st, runinfo->ucs + trun->si, trun->len,
-                break_oppos + trun->si);
-        }
-    }
-
-    ok = TRUE;
-
-out:
-    if (els && els != local_els)
-        free(els);
-
-    if (ok)
+    if (itemize_text_runs(runinfo, break_oppos))
         return runinfo;
 
     mg_slice_delete(TEXTRUNS, runinfo);
-
     return NULL;
 }
 
@@ -627,13 +634,59 @@ TextRun* __mg_text_run_split(TextRun *orig, int split_index)
     return new_run;
 }
 
-BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
+/* Split the runs at the range boundaries and set the font name for them */
+static BOOL set_fontname_in_range(TEXTRUNS* runinfo,
         int start_index, int length, const char* logfont_name)
 {
-    TextRun* run;
-    int start_offset;
-    int left_ucs;;
+    while (length > 0) {
+        TextRun* run;
+        TextRun* new_run;
+        int start_offset;
+
+        run = __mg_text_run_get_by_offset(runinfo, start_index, &start_offset);
+        if (run == NULL)
+            return FALSE;
+
+        // no need to change
+        if (run->fontname && strcmp(logfont_name, run->fontname) == 0) {
+            start_index = run->si + run->len;
+            length -= run->len - start_offset;
+            continue;
+        }
+
+        if (start_offset > 0) {
+            // the head of the run keeps the old fontname
+            new_run = __mg_text_run_split(run, start_offset);
+            if (new_run->fontname)
+                new_run->fontname = strdup(new_run->fontname);
+            __list_add(&new_run->list, run->list.prev, &run->list);
+            runinfo->nr_runs++;
+        }
+        else if (length < run->len) {
+            new_run = __mg_text_run_split(run, length);
+            new_run->fontname = strdup(logfont_name);
+            __list_add(&new_run->list, run->list.prev, &run->list);
+            runinfo->nr_runs++;
+            length = 0;
+        }
+        else {
+            // change the fontname of current run
+            if (run->fontname) {
+                free(run->fontname);
+            }
+            run->fontname = strdup(logfont_name);
+
+            start_index += run->len;
+            length -= run->len;
+        }
+    }
 
+    return TRUE;
+}
+
+BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
+        int start_index, int length, const char* logfont_name)
+{
     if (runinfo == NULL || logfont_name == NULL ||
             start_index < 0 || start_index >= runinfo->nr_ucs)
         return FALSE;
@@ -674,55 +727,7 @@ BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
         return TRUE;
     }
 
-    left_ucs = length;
-    while (left_ucs > 0) {
-        run = __mg_text_run_get_by_offset(runinfo, start_index, &start_offset);
-
-        if (run == NULL)
-            return FALSE;
-
-        // no need to change
-        if (run->fontname && strcmp(logfont_name, run->fontname) == 0) {
-            start_index = run->si + run->len;
-            left_ucs -= run->len - start_offset;
-            continue;
-        }
-
-        if (start_offset == 0) {
-            if (left_ucs >= run->len) {
-                // change the fontname of current run
-                if (run->fontname) {
-                    free(run->fontname);
-                }
-                run->fontname = strdup(logfont_name);
-
-                start_index += run->len;
-                left_ucs -= run->len;
-            }
-            else {
-                TextRun* new_run;
-
-                new_run = __mg_text_run_split(run, run->len - left_ucs);
-                new_run->fontname = strdup(logfont_name);
-                // insert the new run to the list.
-                __list_add(&new_run->list, run->list.prev, &run->list);
-
-                left_ucs = 0;
-            }
-        }
-        else {
-            TextRun* new_run;
-
-            new_run = __mg_text_run_split(run, start_offset);
-            if (new_run->fontname)
-                new_run->fontname = strdup(new_run->fontname);
-
-            // insert the new run to the list.
-            __list_add(&new_run->list, run->list.prev, &run->list);
-        }
-    }
-
-    return TRUE;
+    return set_fontname_in_range(runinfo, start_index, length, logfont_name);
 }
 
 const char* GUIAPI GetFontNameInTextRuns(const TEXTRUNS* runinfo, int index)
@@ -867,6 +872,191 @@ RGBCOLOR GetBackgroundColorInTextRuns(const TEXTRUNS* runinfo, int index)
     return runinfo->bg_colors.value;
 }
 
+/*
+ * Map a range of the text before an edit to the text after the edit.
+ * The inserted text inherits the attributes of the character before it,
+ * or the character after it if the text is inserted at the beginning.
+ * Returns FALSE if nothing is left.
+ */
+static BOOL map_range_for_edit(int* si, int* len, int nr_old_ucs,
+        int edit_start, int nr_del_ucs, int nr_ins_ucs)
+{
+    int edit_end = edit_start + nr_del_ucs;
+    int anchor = (edit_start > 0) ? (edit_start - 1) : edit_end;
+    int start = *si, end = *si + *len;
+
+    if (start >= edit_end)
+        start += nr_ins_ucs - nr_del_ucs;
+    else if (start >= edit_start)
+        start = edit_start + nr_ins_ucs;
+
+    if (end >= edit_end)
+        end += nr_ins_ucs - nr_del_ucs;
+    else if (end > edit_start)
+        end = edit_start;
+
+    if (anchor < nr_old_ucs && anchor >= *si && anchor < *si + *len) {
+        if (edit_start > 0) {
+            if (end < edit_start + nr_ins_ucs)
+                end = edit_start + nr_ins_ucs;
+        }
+        else {
+            start = 0;
+        }
+    }
+
+    *si = start;
+    *len = end - start;
+    return (*len > 0);
+}
+
+static void map_color_map_for_edit(TextColorMap* head, int nr_old_ucs,
+        int edit_start, int nr_del_ucs, int nr_ins_ucs)
+{
+    struct list_head *i, *n;
+
+    head->len = nr_old_ucs - nr_del_ucs + nr_ins_ucs;
+    list_for_each_safe(i, n, &head->list) {
+        TextColorMap* entry = (TextColorMap*)i;
+        if (!map_range_for_edit(&entry->si, &entry->len, nr_old_ucs,
+                    edit_start, nr_del_ucs, nr_ins_ucs)) {
+            list_del(i);
+            mg_slice_delete(TextColorMap, entry);
+        }
+    }
+}
+
+static inline BOOL is_same_run_attrs(const TextRun* one, const TextRun* other)
+{
+    if (one->lc != other->lc || one->st != other->st ||
+            one->el != other->el || one->flags != other->flags)
+        return FALSE;
+
+    if (one->fontname == NULL || other->fontname == NULL)
+        return (one->fontname == other->fontname);
+
+    return (strcmp(one->fontname, other->fontname) == 0);
+}
+
+BOOL GUIAPI UpdateTextRuns(TEXTRUNS* runinfo,
+        const Uchar32* ucs, int nr_ucs, BreakOppo* break_oppos,
+        int* start_index, int* nr_del_ucs, int* nr_ins_ucs)
+{
+    struct list_head old_runs;
+    struct list_head *o, *n;
+    ParagraphDir old_dir;
+    int old_nr_ucs, edit_start, edit_end, delta;
+    int dmg_start, dmg_end;
+    BOOL ok;
+
+    if (runinfo == NULL || ucs == NULL || nr_ucs <= 0 ||
+            start_index == NULL || nr_del_ucs == NULL || nr_ins_ucs == NULL)
+        return FALSE;
+
+    old_nr_ucs = runinfo->nr_ucs;
+    edit_start = *start_index;
+    edit_end = edit_start + *nr_del_ucs;
+    delta = *nr_ins_ucs - *nr_del_ucs;
+    if (edit_start < 0 || *nr_del_ucs < 0 || *nr_ins_ucs < 0 ||
+            edit_end > old_nr_ucs || old_nr_ucs + delta != nr_ucs) {
+        _WRN_PRINTF("bad edit: start(%d), deleted(%d), inserted(%d)\n",
+                edit_start, *nr_del_ucs, *nr_ins_ucs);
+        return FALSE;
+    }
+
+    /* Itemizing the paragraph does not touch the fonts, so it is cheap
+       compared to shaping; re-itemize it and find out the characters
+       whose runs changed. */
+    list_move(&old_runs, &runinfo->truns);
+    old_dir = runinfo->base_dir;
+
+    runinfo->ucs = ucs;
+    runinfo->nr_ucs = nr_ucs;
+    runinfo->nr_runs = 0;
+    ok = itemize_text_runs(runinfo, break_oppos);
+
+    list_for_each(o, &old_runs) {
+        TextRun* trun = (TextRun*)o;
+        int si = trun->si, len = trun->len;
+
+        if (ok && trun->fontname &&
+                map_range_for_edit(&si, &len, old_nr_ucs,
+                    edit_start, *nr_del_ucs, *nr_ins_ucs)) {
+            ok = set_fontname_in_range(runinfo, si, len, trun->fontname);
+        }
+    }
+
+    map_color_map_for_edit(&runinfo->fg_colors, old_nr_ucs,
+            edit_start, *nr_del_ucs, *nr_ins_ucs);
+    map_color_map_for_edit(&runinfo->bg_colors, old_nr_ucs,
+            edit_start, *nr_del_ucs, *nr_ins_ucs);
+
+    if (!ok || runinfo->base_dir != old_dir) {
+        dmg_start = 0;
+        dmg_end = old_nr_ucs;
+        goto done;
+    }
+
+    // the leading runs not changed
+    dmg_start = 0;
+    o = old_runs.next;
+    n = runinfo->truns.next;
+    while (o != &old_runs && n != &runinfo->truns) {
+        TextRun* old_run = (TextRun*)o;
+        TextRun* new_run = (TextRun*)n;
+
+        if (!is_same_run_attrs(old_run, new_run))
+            break;
+
+        if (old_run->len != new_run->len) {
+            dmg_start = old_run->si + MIN(old_run->len, new_run->len);
+            break;
+        }
+
+        dmg_start = old_run->si + old_run->len;
+        o = o->next;
+        n = n->next;
+    }
+
+    // the trailing runs not changed, in the coordinates before the edit
+    dmg_end = old_nr_ucs;
+    o = old_runs.prev;
+    n = runinfo->truns.prev;
+    while (o != &old_runs && n != &runinfo->truns) {
+        TextRun* old_run = (TextRun*)o;
+        TextRun* new_run = (TextRun*)n;
+
+        if (!is_same_run_attrs(old_run, new_run))
+            break;
+
+        if (old_run->si != new_run->si - delta) {
+            dmg_end = MAX(old_run->si, new_run->si - delta);
+            break;
+        }
+
+        dmg_end = old_run->si;
+        o = o->prev;
+        n = n->prev;
+    }
+
+    dmg_start = MIN(dmg_start, edit_start);
+    dmg_end = MAX(dmg_end, edit_end);
+
+done:
+    while (!list_empty(&old_runs)) {
+        TextRun* run = (TextRun*)old_runs.prev;
+        list_del(old_runs.prev);
+        if (run->fontname)
+            free(run->fontname);
+        mg_slice_delete(TextRun, run);
+    }
+
+    *start_index = dmg_start;
+    *nr_del_ucs = dmg_end - dmg_start;
+    *nr_ins_ucs = dmg_end + delta - dmg_start;
+    return ok;
+}
+
 BOOL GUIAPI DestroyTextRuns(TEXTRUNS* runinfo)
 {
     if (runinfo == NULL)
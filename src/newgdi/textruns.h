@@ -120,6 +120,7 @@ struct _TEXTRUNS {
     int                 nr_runs;    // number of runs
     LanguageCode        lc;         // language code specified
     ParagraphDir        base_dir;   // paragraph base direction
+    ParagraphDir        spec_dir;   // paragraph base direction specified
 
 #if 0
     Uint32      lc:8;           // language code specified
@@ -69,6 +69,7 @@
 #include "server.h"
 #include "sharedres.h"
 #include "drawsemop.h"
+#include "reqring.h"
 
 #define    NALLOC       4        /* #Client structs to alloc/realloc for */
 
@@ -231,8 +232,11 @@ void __mg_remove_client (int cli, int clifd)
     DO_COMPSOR_OP_ARGS (on_layer_op, LCO_REMOVE_CLIENT,
                 mgClients[cli].layer, mgClients + cli);
 
+#ifdef _MGHAVE_CLIENT_REQRING
+    __mg_reqring_detach (cli);
+#endif
     __mg_client_del (cli);    /* client has closed conn */
-    FD_CLR (clifd, &__mg_dsk_msg_queue->rfdset);
+    __mg_server_unwatch_client_fd (cli, clifd, SRVFD_SOCKET);
     close (clifd);
 }
 
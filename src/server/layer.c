@@ -190,6 +190,11 @@ static BOOL do_alloc_layer (MG_Layer* layer, const char* name,
     }
 #endif  /* deprectated code */
 
+#ifdef _MGSCHEMA_COMPOSITING
+    /* Since 5.0.16: the compositor polls all znodes if this fails */
+    __kernel_alloc_znode_dirty_map (zi);
+#endif
+
     /* init usage bitmap. */
     memset (zi + 1, 0xFF, size_usage_bmp);
     __mg_slot_set_use ((unsigned char*)(zi + 1), 0);
@@ -0,0 +1,354 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** reqring.c: the server side of the shared memory request rings of clients.
+**
+** Create date: 2026/10/18
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "common.h"
+
+#ifdef _MGHAVE_CLIENT_REQRING
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "minigui.h"
+#include "gdi.h"
+#include "window.h"
+#include "cliprect.h"
+#include "internals.h"
+#include "sockio.h"
+#include "client.h"
+#include "server.h"
+#include "reqring.h"
+
+/* handle at most so many requests of a ring in one round */
+#define MAX_REQS_PER_ROUND      (REQRING_NR_SLOTS * 2)
+
+typedef struct _CLIREQRING {
+    REQRING*    ring;
+    int         doorbell;
+    /* the number of requests handled from the socket since attached */
+    Uint32      nr_sock_reqs;
+} CLIREQRING;
+
+static CLIREQRING* sg_rings;
+static int sg_nr_rings;
+
+/* the request from a ring being handled */
+static REQRING* sg_cur_ring;
+static int sg_cur_clifd = -1;
+static Uint32 sg_cur_len_rslt;
+
+static char sg_ring_data_buff [REQRING_SIZE_DATA];
+
+int __mg_reqring_attach (int cli, int mem_fd)
+{
+    REQRING* ring;
+    struct stat st;
+    int doorbell;
+
+    if (cli >= sg_nr_rings) {
+        CLIREQRING* rings;
+        int i;
+
+        rings = realloc (sg_rings, sizeof (CLIREQRING) * (cli + 1));
+        if (rings == NULL)
+            return -1;
+
+        for (i = sg_nr_rings; i <= cli; i++) {
+            rings [i].ring = NULL;
+            rings [i].doorbell = -1;
+        }
+
+        sg_rings = rings;
+        sg_nr_rings = cli + 1;
+    }
+
+    __mg_reqring_detach (cli);
+
+    if (fstat (mem_fd, &st) < 0 || st.st_size < (off_t)sizeof (REQRING)) {
+        _WRN_PRINTF ("bad request ring file from client %d\n", cli);
+        return -1;
+    }
+
+    ring = mmap (NULL, sizeof (REQRING), PROT_READ | PROT_WRITE,
+            MAP_SHARED, mem_fd, 0);
+    if (ring == MAP_FAILED) {
+        _WRN_PRINTF ("failed to map the request ring of client %d: %m\n",
+                cli);
+        return -1;
+    }
+
+    if (ring->magic != REQRING_MAGIC || ring->nr_slots != REQRING_NR_SLOTS) {
+        _WRN_PRINTF ("bad request ring of client %d\n", cli);
+        munmap (ring, sizeof (REQRING));
+        return -1;
+    }
+
+    doorbell = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (doorbell < 0) {
+        _WRN_PRINTF ("failed to create the doorbell of client %d: %m\n", cli);
+        munmap (ring, sizeof (REQRING));
+        return -1;
+    }
+
+    ring->tail = ring->head;
+    __atomic_store_n (&ring->doorbell_armed, 1, __ATOMIC_SEQ_CST);
+
+    if (!__mg_server_watch_client_fd (cli, doorbell, SRVFD_DOORBELL)) {
+        close (doorbell);
+        munmap (ring, sizeof (REQRING));
+        return -1;
+    }
+
+    sg_rings [cli].ring = ring;
+    sg_rings [cli].doorbell = doorbell;
+    /* the request setting up the ring will be counted after handled */
+    sg_rings [cli].nr_sock_reqs = (Uint32)-1;
+
+    return doorbell;
+}
+
+void __mg_reqring_detach (int cli)
+{
+    CLIREQRING* cr;
+
+    if (cli >= sg_nr_rings || sg_rings [cli].ring == NULL)
+        return;
+
+    cr = sg_rings + cli;
+    if (sg_cur_ring == cr->ring) {
+        sg_cur_ring = NULL;
+        sg_cur_clifd = -1;
+    }
+
+    __mg_server_unwatch_client_fd (cli, cr->doorbell, SRVFD_DOORBELL);
+    close (cr->doorbell);
+    munmap (cr->ring, sizeof (REQRING));
+
+    cr->ring = NULL;
+    cr->doorbell = -1;
+}
+
+int __mg_reqring_doorbell (int cli)
+{
+    if (cli >= sg_nr_rings)
+        return -1;
+
+    return sg_rings [cli].doorbell;
+}
+
+/* returns FALSE if the client has been removed */
+static BOOL handle_one_request (int cli, REQRING* ring, Uint32 tail)
+{
+    REQRINGSLOT* slot = ring->slots + (tail % REQRING_NR_SLOTS);
+    int clifd = mgClients [cli].fd;
+    Uint32 req_id, len_data, len_rslt;
+    int n;
+
+    /* copy the request out of the slot and release the slot at once;
+       the client must not be able to change the data while we use it. */
+    req_id = slot->req_id;
+    len_data = slot->len_data;
+    len_rslt = slot->len_rslt;
+    if (len_data > REQRING_SIZE_DATA || len_rslt > REQRING_SIZE_REPLY) {
+        _WRN_PRINTF ("bad request in the ring of client %d\n", cli);
+        __mg_remove_client (cli, clifd);
+        return FALSE;
+    }
+
+    memcpy (sg_ring_data_buff, slot->data, len_data);
+    __atomic_store_n (&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    sg_cur_ring = ring;
+    sg_cur_clifd = clifd;
+    sg_cur_len_rslt = len_rslt;
+
+    n = __mg_dispatch_request (cli, clifd, req_id,
+            sg_ring_data_buff, len_data, -1);
+
+    /* the client has been removed by the handler */
+    if (n == SOCKERR_CLOSED || sg_cur_ring == NULL) {
+        sg_cur_clifd = -1;
+        return FALSE;
+    }
+
+    /* do not let the client wait for a reply which will never come */
+    if (sg_cur_len_rslt > 0) {
+        _WRN_PRINTF ("request 0x%x of client %d was not replied\n",
+                req_id, cli);
+        ring->len_reply = REQRING_NO_REPLY;
+        __atomic_add_fetch (&ring->reply_seq, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n (&ring->reply_waiting, __ATOMIC_SEQ_CST))
+            syscall (SYS_futex, &ring->reply_seq, FUTEX_WAKE, 1,
+                    NULL, NULL, 0);
+    }
+
+    sg_cur_ring = NULL;
+    sg_cur_clifd = -1;
+    return sg_rings [cli].ring == ring;
+}
+
+/* wake up the client waiting for a free slot; we do this after handling
+   a batch of requests instead of every request to avoid ping-pong. */
+static inline void wake_slot_waiter (REQRING* ring)
+{
+    if (__atomic_load_n (&ring->slot_waiting, __ATOMIC_SEQ_CST))
+        syscall (SYS_futex, &ring->tail, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* returns the number of requests handled, or -1 if the client has been
+   removed. */
+int __mg_reqring_handle (int cli, BOOL doorbell_rung)
+{
+    REQRING* ring;
+    Uint32 head, tail;
+    int nr_handled = 0;
+
+    if (cli >= sg_nr_rings || (ring = sg_rings [cli].ring) == NULL)
+        return 0;
+
+    if (doorbell_rung) {
+        uint64_t counter;
+        if (read (sg_rings [cli].doorbell, &counter, sizeof (counter)) < 0
+                && errno != EAGAIN)
+            _WRN_PRINTF ("failed to read the doorbell of client %d\n", cli);
+    }
+
+    do {
+        tail = ring->tail;
+        head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+        if (head - tail > REQRING_NR_SLOTS) {
+            _WRN_PRINTF ("bad head of the request ring of client %d\n", cli);
+            __mg_remove_client (cli, mgClients [cli].fd);
+            return -1;
+        }
+
+        while (tail != head) {
+            REQRINGSLOT* slot = ring->slots + (tail % REQRING_NR_SLOTS);
+
+            /* the client sent some requests through the socket before
+               this one; come back after handled them. */
+            if ((Sint32)(slot->sock_seq - sg_rings [cli].nr_sock_reqs) > 0) {
+                wake_slot_waiter (ring);
+                return nr_handled;
+            }
+
+            if (nr_handled >= MAX_REQS_PER_ROUND) {
+                /* give other clients a chance; ring the doorbell ourselves
+                   to come back in the next round. */
+                uint64_t one = 1;
+                if (write (sg_rings [cli].doorbell, &one, sizeof (one)) < 0)
+                    _WRN_PRINTF ("failed to ring the doorbell of client %d\n",
+                            cli);
+                wake_slot_waiter (ring);
+                return nr_handled;
+            }
+
+            nr_handled++;
+            if (!handle_one_request (cli, ring, tail))
+                return (mgClients [cli].fd < 0) ? -1 : nr_handled;
+
+            tail++;
+        }
+
+        wake_slot_waiter (ring);
+
+        /* arm the doorbell, then check again for the requests pushed
+           before the client saw the doorbell armed. */
+        __atomic_store_n (&ring->doorbell_armed, 1, __ATOMIC_SEQ_CST);
+    } while (__atomic_load_n (&ring->head, __ATOMIC_SEQ_CST) != ring->tail);
+
+    return nr_handled;
+}
+
+void __mg_reqring_socket_request_handled (int cli)
+{
+    if (cli < sg_nr_rings && sg_rings [cli].ring)
+        sg_rings [cli].nr_sock_reqs++;
+}
+
+BOOL __mg_reqring_send_reply (int clifd, const void* reply, int len)
+{
+    REQRING* ring = sg_cur_ring;
+
+    if (ring == NULL || clifd != sg_cur_clifd)
+        return FALSE;
+
+    /* the client does not wait for any reply of this request */
+    if (sg_cur_len_rslt == 0)
+        return TRUE;
+
+    if (len < 0)
+        len = 0;
+    else if (len > REQRING_SIZE_REPLY)
+        len = REQRING_SIZE_REPLY;
+
+    memcpy (ring->reply, reply, len);
+    ring->len_reply = len;
+    sg_cur_len_rslt = 0;
+
+    __atomic_add_fetch (&ring->reply_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&ring->reply_waiting, __ATOMIC_SEQ_CST))
+        syscall (SYS_futex, &ring->reply_seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+
+    return TRUE;
+}
+
+#endif  /* _MGHAVE_CLIENT_REQRING */
+
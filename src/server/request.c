@@ -54,6 +54,7 @@
 */
 
 #include <signal.h>
+#include <sys/ioctl.h>
 
 #include "common.h"
 #include "minigui.h"
@@ -72,6 +73,7 @@
 #include "misc.h"
 #include "map.h"
 #include "dc.h"
+#include "reqring.h"
 
 typedef void (* ReleaseProc) (void* );
 
@@ -166,6 +168,15 @@ int GUIAPI ServerSendReplyEx (int clifd,
     if (!mgIsServer)
         return SOCKERR_IO;
 
+#ifdef _MGHAVE_CLIENT_REQRING
+    /* the reply of a request from the request ring of the client */
+    if (__mg_reqring_send_reply (clifd, reply, len)) {
+        if (fd_to_send >= 0)
+            _WRN_PRINTF ("Can not send a file descriptor through the request ring.\n");
+        return SOCKERR_OK;
+    }
+#endif
+
     {
         MSG msg = {HWND_INVALID, 0};
 
@@ -999,6 +1010,26 @@ static int authenticate_client (int cli, int clifd, void* buff, size_t len)
     return ServerSendReply (clifd, &auth_result, sizeof (int));
 }
 
+#ifdef _MGHAVE_CLIENT_REQRING
+static int setup_reqring (int cli, int clifd, void* buff, size_t len, int fd)
+{
+    int doorbell = -1;
+    int result = -1;
+
+    /* the client tells the size of the ring to make sure we agree */
+    if (fd >= 0 && len >= sizeof (int) && *(int*)buff == sizeof (REQRING)) {
+        doorbell = __mg_reqring_attach (cli, fd);
+        if (doorbell >= 0)
+            result = 0;
+    }
+
+    if (fd >= 0)
+        close (fd);
+
+    return ServerSendReplyEx (clifd, &result, sizeof (int), doorbell);
+}
+#endif
+
 static struct req_request {
     void* handler;
     int version;
@@ -1056,7 +1087,11 @@ static struct req_request {
     { load_cursor_png_file, 0 },        // REQID_LOADCURSOR_PNG
     { load_cursor_png_mem, 0 },         // REQID_LOADCURSOR_PNG_MEM
     { operate_nssurface, 1 },           // REQID_OPERATENSSURF
+#ifdef _MGHAVE_CLIENT_REQRING
+    { setup_reqring, 1 },               // REQID_SETUPREQRING
+#else
     { NULL, 0 },
+#endif
 #if 0 // Deprecated since 5.2.0
     { alloc_sem_for_shared_surf, 0 },   // REQID_ALLOC_SURF_SEM
     { free_sem_for_shared_surf, 0 },    // REQID_FREE_SURF_SEM
@@ -1065,7 +1100,11 @@ static struct req_request {
     { NULL, 0 },
     { NULL, 0 },
     { NULL, 0 },
+#ifdef _MGHAVE_CLIENT_REQRING
+    { setup_reqring, 1 },               // REQID_SETUPREQRING
+#else
     { NULL, 0 },
+#endif
 #endif
     { move_to_layer, 0 },       // REQID_MOVETOLAYER
     { calc_position, 0 },       // REQID_CALCPOSITION
@@ -1128,6 +1167,44 @@ void* GUIAPI GetRequestHandlerEx (int req_id, int* version)
 
 static char _request_data_buff [1024];
 
+/* Since 5.0.16: call the handler of a request read from the socket or
+   the request ring of a client */
+int __mg_dispatch_request (int cli, int clifd, int req_id,
+        void* buff, size_t len_data, int fd_received)
+{
+    int n;
+
+    req_id &= ~REQMASK_FLAGS;
+    if (req_id > MAX_REQID || req_id <= 0 ||
+            handlers [req_id - 1].handler == NULL)
+        return SOCKERR_INVARG;
+
+    if (handlers [req_id - 1].version == 1) {
+        REQ_HANDLER_V1 handler = handlers [req_id - 1].handler;
+        n = handler (cli, clifd, buff, len_data, fd_received);
+    }
+    else {
+        REQ_HANDLER handler = handlers [req_id - 1].handler;
+
+        if (fd_received >= 0) {
+            close (fd_received);
+            _WRN_PRINTF ("A file descriptor received, but the request handler is version 0.\n");
+        }
+
+        n = handler (cli, clifd, buff, len_data);
+    }
+
+    if (n == SOCKERR_IO) {
+        __mg_remove_client (cli, clifd);
+        return SOCKERR_CLOSED;
+    }
+
+    if (req_id == REQID_IAMLIVE && mgClients [cli].has_dirty)
+        __mg_check_dirty_znode (cli);
+
+    return n;
+}
+
 int __mg_handle_request (int clifd, int req_id, int cli)
 {
     int n;
@@ -1165,7 +1242,8 @@ int __mg_handle_request (int clifd, int req_id, int cli)
         goto error;
     }
 #else /* use recvmsg */
-    {
+    /* Since 5.0.16: nothing to receive for a request without data */
+    if (len_data > 0) {
         struct iovec    iov[2];
         struct msghdr   msg;
         struct cmsghdr  *cmsg = NULL;
@@ -1185,7 +1263,7 @@ int __mg_handle_request (int clifd, int req_id, int cli)
         msg.msg_control     = cmsg;
         msg.msg_controllen  = CMSG_LEN (sizeof (int));
 
-        if ((n = sock_recvmsg (clifd, &msg, 0)) == SOCKERR_IO) {
+        if ((n = sock_recvmsg (clifd, &msg, MSG_WAITALL)) == SOCKERR_IO) {
             return SOCKERR_IO;
         }
         else if (n == SOCKERR_CLOSED) {
@@ -1198,35 +1276,12 @@ int __mg_handle_request (int clifd, int req_id, int cli)
     }
 #endif
 
-    req_id &= ~REQMASK_FLAGS;
-    if (req_id > MAX_REQID || req_id <= 0 ||
-            handlers [req_id - 1].handler == NULL)
-        return SOCKERR_INVARG;
-
-    if (handlers [req_id - 1].version == 1) {
-        REQ_HANDLER_V1 handler = handlers [req_id - 1].handler;
-        n = handler (cli, clifd, buff, len_data, fd_received);
-    }
-    else {
-        REQ_HANDLER handler = handlers [req_id - 1].handler;
-
-        if (fd_received >= 0) {
-            close (fd_received);
-            _WRN_PRINTF ("A file descriptor received, but the request handler is version 0.\n");
-        }
-
-        n = handler (cli, clifd, buff, len_data);
-    }
+    n = __mg_dispatch_request (cli, clifd, req_id, buff, len_data,
+            fd_received);
 
     if (len_data > sizeof (_request_data_buff))
         free (buff);
 
-    if (n == SOCKERR_IO)
-        goto error;
-
-    if (req_id == REQID_IAMLIVE && mgClients [cli].has_dirty)
-        __mg_check_dirty_znode (cli);
-
     return n;
 
 error:
@@ -1234,3 +1289,61 @@ error:
     return SOCKERR_CLOSED;
 }
 
+/* handle at most so many requests from the socket of a client in one round */
+#define MAX_REQS_PER_BATCH      16
+
+/*
+ * Since 5.0.16: handle the requests queued in the socket of a client in
+ * one round, instead of one request for each select call. The client
+ * can have many asynchronous requests outstanding.
+ *
+ * Returns the number of requests handled (including the requests in
+ * the request ring), or -1 if the client has been removed.
+ */
+int __mg_handle_client_requests (int cli, int clifd)
+{
+    int n, req_id, nr_reqs = 0, nr_handled = 0, nr_bytes;
+
+    do {
+#ifdef _MGHAVE_CLIENT_REQRING
+        /* handle the requests in the ring which were sent before
+           the request in the socket to keep the order of requests. */
+        if ((n = __mg_reqring_handle (cli, FALSE)) < 0)
+            return -1;
+        nr_handled += n;
+#endif
+
+        /* read request id from client */
+        if ((n = sock_read (clifd, &req_id, sizeof (int))) < 0) {
+#ifdef _DEBUG
+            __mg_err_msg ("server: read error on fd %d", clifd);
+#endif
+            if (OnNewDelClient) OnNewDelClient (LCO_DEL_CLIENT, cli);
+            __mg_remove_client (cli, clifd);
+            return -1;
+        }
+
+        /* process client's rquest */
+        n = __mg_handle_request (clifd, req_id, cli);
+        if (mgClients [cli].fd != clifd)
+            return -1;
+
+        nr_handled++;
+        if (n == SOCKERR_IO)
+            break;
+
+#ifdef _MGHAVE_CLIENT_REQRING
+        __mg_reqring_socket_request_handled (cli);
+#endif
+    } while (++nr_reqs < MAX_REQS_PER_BATCH &&
+            ioctl (clifd, FIONREAD, &nr_bytes) == 0 && nr_bytes > 0);
+
+#ifdef _MGHAVE_CLIENT_REQRING
+    if ((n = __mg_reqring_handle (cli, FALSE)) < 0)
+        return -1;
+    nr_handled += n;
+#endif
+
+    return nr_handled;
+}
+
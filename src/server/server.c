@@ -53,11 +53,15 @@
 ** NOTE: The idea comes from sample code in APUE.
 */
 
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <signal.h>
+#include <time.h>
 #include <sys/times.h>
 #include <sys/poll.h>
+#include <sys/ioctl.h>
 
 #include "common.h"
 #include "minigui.h"
@@ -77,9 +81,14 @@
 #include "server.h"
 #include "sharedres.h"
 #include "drawsemop.h"
+#include "reqring.h"
 #include "timer.h"
 #include "license.h"
 
+#ifdef _MGHAVE_SERVER_EPOLL
+#include <sys/epoll.h>
+#endif
+
 extern DWORD __mg_tick_counter;
 
 ON_NEW_DEL_CLIENT OnNewDelClient = NULL;
@@ -266,6 +275,328 @@ static void ParseEvent (PMSGQUEUE msg_que, int event)
 static int listenfd;
 static int maxi;
 
+/*
+ * Since 5.0.16: the clients ready for handling. The server handles
+ * the requests of a ready client in a round with a budget (see
+ * __mg_handle_client_requests), and puts the client back to the tail of
+ * the ready queue if it still has requests, so that a busy client can not
+ * starve others.
+ */
+#define CLIREADY_SOCKET     0x01
+#define CLIREADY_DOORBELL   0x02
+#define CLIREADY_QUEUED     0x04
+#define CLIREADY_HANGUP     0x08
+
+#define NR_SRV_EPOLL_EVENTS 64
+
+/* the data of the epoll events of the listening socket and the IAL fds;
+   the clients use (cli << 1) | type. */
+#define SRV_EPOLL_TAG_LISTEN    ((Uint64)-1)
+#define SRV_EPOLL_TAG_IAL       ((Uint64)-2)
+#define NR_IAL_EVENT_FDS        8
+
+/* the fds found ready by check_epoll_events */
+#define SRVREADY_LISTEN     0x01
+#define SRVREADY_IAL        0x02
+
+typedef struct _SRVCLIENT {
+    /* the ready flags of the client */
+    Uint32      ready;
+    /* the next client in the ready queue */
+    int         next;
+    /* the time when the server noticed the client ready */
+    Uint64      ready_us;
+
+    CLIREQSTATS stats;
+} SRVCLIENT;
+
+static SRVCLIENT* srv_clients;
+static int nr_srv_clients;
+
+static int ready_head = -1;
+static int ready_tail = -1;
+static int nr_ready;
+
+#ifdef _MGHAVE_SERVER_EPOLL
+static int srv_epoll_fd = -1;
+/* TRUE if the listening socket and the IAL fds are in the epoll instance */
+static BOOL srv_epoll_all;
+/* TRUE if the IAL engine may have buffered more events */
+static BOOL ial_pending;
+#endif
+
+static Uint64 get_time_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (Uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static SRVCLIENT* get_srv_client (int cli)
+{
+    if (cli >= nr_srv_clients) {
+        SRVCLIENT* clients;
+        int n = cli + 1;
+
+        clients = realloc (srv_clients, sizeof (SRVCLIENT) * n);
+        if (clients == NULL)
+            return NULL;
+
+        memset (clients + nr_srv_clients, 0,
+                sizeof (SRVCLIENT) * (n - nr_srv_clients));
+        srv_clients = clients;
+        nr_srv_clients = n;
+    }
+
+    return srv_clients + cli;
+}
+
+static void mark_client_ready (int cli, Uint32 ready, Uint64 now)
+{
+    SRVCLIENT* sc = srv_clients + cli;
+
+    sc->ready |= ready;
+    if (sc->ready & CLIREADY_QUEUED)
+        return;
+
+    sc->ready |= CLIREADY_QUEUED;
+    sc->ready_us = now;
+    sc->next = -1;
+    if (ready_tail >= 0)
+        srv_clients [ready_tail].next = cli;
+    else
+        ready_head = cli;
+    ready_tail = cli;
+    nr_ready++;
+}
+
+BOOL __mg_server_watch_client_fd (int cli, int fd, int type)
+{
+    SRVCLIENT* sc = get_srv_client (cli);
+
+    if (sc == NULL)
+        return FALSE;
+
+    if (type == SRVFD_SOCKET) {
+        /* keep the queued flag; the client may be still in the queue */
+        sc->ready &= CLIREADY_QUEUED;
+        memset (&sc->stats, 0, sizeof (CLIREQSTATS));
+    }
+
+#ifdef _MGHAVE_SERVER_EPOLL
+    {
+        struct epoll_event ev;
+
+        /* the socket is edge-triggered: the server reads the requests
+           until the socket is empty or the client used up its budget,
+           and keeps the client in the ready queue for the latter. */
+        ev.events = (type == SRVFD_SOCKET) ? (EPOLLIN | EPOLLRDHUP | EPOLLET) :
+            EPOLLIN;
+        ev.data.u64 = ((Uint64)cli << 1) | type;
+        if (epoll_ctl (srv_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            _WRN_PRINTF ("failed to watch fd %d of client %d: %m\n", fd, cli);
+            return FALSE;
+        }
+    }
+#else
+    FD_SET (fd, &__mg_dsk_msg_queue->rfdset);
+    if (fd > __mg_dsk_msg_queue->maxfd)
+        __mg_dsk_msg_queue->maxfd = fd;  /* max fd for select() */
+#endif
+
+    return TRUE;
+}
+
+void __mg_server_unwatch_client_fd (int cli, int fd, int type)
+{
+    if (cli < nr_srv_clients) {
+        srv_clients [cli].ready &= (type == SRVFD_SOCKET) ?
+            CLIREADY_QUEUED : ~CLIREADY_DOORBELL;
+    }
+
+#ifdef _MGHAVE_SERVER_EPOLL
+    epoll_ctl (srv_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    FD_CLR (fd, &__mg_dsk_msg_queue->rfdset);
+#endif
+}
+
+#ifdef _MGHAVE_SERVER_EPOLL
+/* Since 5.0.16: watches the listening socket and the fds of the IAL engine
+   by the epoll instance, so that the server waits in epoll_wait() alone. */
+static BOOL watch_server_fds (void)
+{
+    struct epoll_event ev;
+    int fds [NR_IAL_EVENT_FDS];
+    int i, n;
+
+    /* the engine selects on the fds it does not tell */
+    if ((n = IAL_GetEventFds (fds, NR_IAL_EVENT_FDS)) < 0)
+        return FALSE;
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = SRV_EPOLL_TAG_LISTEN;
+    if (epoll_ctl (srv_epoll_fd, EPOLL_CTL_ADD, listenfd, &ev) < 0)
+        goto fail;
+
+    ev.data.u64 = SRV_EPOLL_TAG_IAL;
+    for (i = 0; i < n; i++) {
+        if (epoll_ctl (srv_epoll_fd, EPOLL_CTL_ADD, fds [i], &ev) < 0) {
+            while (--i >= 0)
+                epoll_ctl (srv_epoll_fd, EPOLL_CTL_DEL, fds [i], NULL);
+            epoll_ctl (srv_epoll_fd, EPOLL_CTL_DEL, listenfd, NULL);
+            goto fail;
+        }
+    }
+
+    /* the engine may have read events before */
+    ial_pending = TRUE;
+    return TRUE;
+
+fail:
+    _WRN_PRINTF ("failed to watch the IAL fds by epoll; use select: %m\n");
+    return FALSE;
+}
+
+/* returns the SRVREADY_XXX flags, or -1 on error */
+static int check_epoll_events (int timeout)
+{
+    struct epoll_event events [NR_SRV_EPOLL_EVENTS];
+    Uint64 now;
+    int i, n, ready = 0;
+
+    n = epoll_wait (srv_epoll_fd, events, NR_SRV_EPOLL_EVENTS, timeout);
+    if (n < 0)
+        return -1;
+
+    now = get_time_us ();
+    for (i = 0; i < n; i++) {
+        int cli = (int)(events [i].data.u64 >> 1);
+        int type = (int)(events [i].data.u64 & 0x01);
+
+        if (events [i].data.u64 == SRV_EPOLL_TAG_LISTEN) {
+            ready |= SRVREADY_LISTEN;
+            continue;
+        }
+        else if (events [i].data.u64 == SRV_EPOLL_TAG_IAL) {
+            ready |= SRVREADY_IAL;
+            continue;
+        }
+
+        if (cli >= nr_srv_clients || mgClients [cli].fd < 0)
+            continue;
+
+        if (type == SRVFD_DOORBELL)
+            mark_client_ready (cli, CLIREADY_DOORBELL, now);
+        else if (events [i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            mark_client_ready (cli, CLIREADY_SOCKET | CLIREADY_HANGUP, now);
+        else
+            mark_client_ready (cli, CLIREADY_SOCKET, now);
+    }
+
+    return ready;
+}
+#else
+static void check_client_fds (fd_set* rset, Uint64 now)
+{
+    int i, clifd;
+
+    for (i = 0; i <= maxi; i++) {    /* go through client[] array */
+        if ((clifd = mgClients[i].fd) < 0 || i >= nr_srv_clients)
+            continue;
+
+        if (FD_ISSET (clifd, rset))
+            mark_client_ready (i, CLIREADY_SOCKET, now);
+#ifdef _MGHAVE_CLIENT_REQRING
+        {
+            int doorbell = __mg_reqring_doorbell (i);
+            if (doorbell >= 0 && FD_ISSET (doorbell, rset))
+                mark_client_ready (i, CLIREADY_DOORBELL, now);
+        }
+#endif
+    }
+}
+#endif
+
+/* handles the clients in the ready queue once */
+static void handle_ready_clients (void)
+{
+    int n = nr_ready;
+
+    while (n-- > 0) {
+        int cli = ready_head, clifd, nr_handled = 0, nr_bytes;
+        SRVCLIENT* sc = srv_clients + cli;
+        Uint64 start_us, end_us;
+
+        ready_head = sc->next;
+        if (ready_head < 0)
+            ready_tail = -1;
+        nr_ready--;
+        sc->ready &= ~CLIREADY_QUEUED;
+
+        if ((clifd = mgClients[cli].fd) < 0 ||
+                !(sc->ready & (CLIREADY_SOCKET | CLIREADY_DOORBELL))) {
+            sc->ready = 0;
+            continue;
+        }
+
+        start_us = get_time_us ();
+
+#ifdef _MGHAVE_CLIENT_REQRING
+        if (sc->ready & CLIREADY_DOORBELL) {
+            sc->ready &= ~CLIREADY_DOORBELL;
+            if ((nr_handled = __mg_reqring_handle (cli, TRUE)) < 0)
+                continue;
+        }
+#endif
+
+        if (sc->ready & CLIREADY_SOCKET) {
+            int n = __mg_handle_client_requests (cli, clifd);
+            if (n < 0)
+                continue;
+            nr_handled += n;
+
+            if (ioctl (clifd, FIONREAD, &nr_bytes) == 0 && nr_bytes > 0) {
+                sc->stats.nr_deferred++;
+            }
+            else if (sc->ready & CLIREADY_HANGUP) {
+                /* no more edge will come for the hang-up */
+                if (OnNewDelClient) OnNewDelClient (LCO_DEL_CLIENT, cli);
+                __mg_remove_client (cli, clifd);
+                continue;
+            }
+            else {
+                sc->ready &= ~CLIREADY_SOCKET;
+            }
+        }
+
+        end_us = get_time_us ();
+
+        sc->stats.nr_requests += nr_handled;
+        sc->stats.nr_rounds++;
+        sc->stats.total_wait_us += start_us - sc->ready_us;
+        if (start_us - sc->ready_us > sc->stats.max_wait_us)
+            sc->stats.max_wait_us = (DWORD)(start_us - sc->ready_us);
+        sc->stats.total_busy_us += end_us - start_us;
+        if (end_us - start_us > sc->stats.max_busy_us)
+            sc->stats.max_busy_us = (DWORD)(end_us - start_us);
+
+        if (sc->ready & (CLIREADY_SOCKET | CLIREADY_DOORBELL))
+            mark_client_ready (cli, 0, end_us);
+    }
+}
+
+BOOL GUIAPI GetClientRequestStats (int cli, CLIREQSTATS* stats)
+{
+    if (!mgIsServer || cli <= 0 || cli >= nr_srv_clients ||
+            mgClients [cli].fd < 0)
+        return FALSE;
+
+    *stats = srv_clients [cli].stats;
+    return TRUE;
+}
+
 BOOL GUIAPI ServerStartup (int nr_globals,
                 int def_nr_topmosts, int def_nr_normals)
 {
@@ -317,6 +648,21 @@ BOOL GUIAPI ServerStartup (int nr_globals,
     __mg_dsk_msg_queue->maxfd = listenfd;
     maxi = -1;
 
+#ifdef _MGHAVE_SERVER_EPOLL
+    /* Since 5.0.16: wait for the clients by epoll; the epoll instance
+       becomes readable when any client is ready. */
+    if ((srv_epoll_fd = epoll_create1 (EPOLL_CLOEXEC)) < 0) {
+        _ERR_PRINTF ("mginit: failed to create epoll instance: %m\n");
+        goto fail;
+    }
+
+    FD_SET (srv_epoll_fd, &__mg_dsk_msg_queue->rfdset);
+    if (srv_epoll_fd > __mg_dsk_msg_queue->maxfd)
+        __mg_dsk_msg_queue->maxfd = srv_epoll_fd;
+
+    srv_epoll_all = watch_server_fds ();
+#endif
+
     mg_InitTimer ();
 
     __mg_start_server_desktop ();
@@ -351,12 +697,26 @@ void server_ServerCleanup (void)
 
     mg_TerminateTimer ();
 
+#ifdef _MGHAVE_SERVER_EPOLL
+    if (srv_epoll_fd >= 0) {
+        close (srv_epoll_fd);
+        srv_epoll_fd = -1;
+    }
+    srv_epoll_all = FALSE;
+#endif
+    free (srv_clients);
+    srv_clients = NULL;
+    nr_srv_clients = 0;
+    ready_head = ready_tail = -1;
+    nr_ready = 0;
+
     unlink (CS_PATH);
 }
 
 BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
 {
-    int    i, evt, clifd, nread;
+    int    i, evt, clifd, ready;
+    DWORD  timeout_ms;
     pid_t  pid;
     uid_t  uid;
     struct timeval sel_timeout = {0, 10000};
@@ -366,6 +726,13 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
     fd_set* esetptr = NULL;
     EXTRA_INPUT_EVENT extra;    // Since 4.0.0; for extra input events
     int nevts = 0;              // Since 5.0.0; for timer and fd events
+#ifdef _MGHAVE_SERVER_EPOLL
+    BOOL by_epoll = FALSE;      // Since 5.0.16; waited in epoll_wait()
+#endif
+
+    /* Since 5.0.16: do not sleep after the next timer expires */
+    timeout_ms = __mg_get_timer_timeout (msg_queue, sel_timeout.tv_usec / 1000);
+    sel_timeout.tv_usec = timeout_ms * 1000;
 
     /* rset gets modified each time around */
     rset = __mg_dsk_msg_queue->rfdset;
@@ -391,8 +758,50 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
 #endif
 
     extra.params_mask = 0;
-    if ((evt = IAL_WaitEvent (__mg_dsk_msg_queue->maxfd, &rset, wsetptr, esetptr,
-                wait?&sel_timeout:&sel_timeout_nd, &extra)) < 0) {
+    evt = 0;
+#ifdef _MGHAVE_SERVER_EPOLL
+    /* Since 5.0.16: wait for the clients, the listening socket and the IAL
+       fds in epoll_wait(), unless the fds registered by RegisterListenFD()
+       need select(). */
+    if (srv_epoll_all && __mg_dsk_msg_queue->nr_rfds == 0 &&
+            wsetptr == NULL && esetptr == NULL) {
+        by_epoll = TRUE;
+        ready = check_epoll_events (
+                (wait && nr_ready == 0 && !ial_pending) ? (int)timeout_ms : 0);
+        if (ready < 0) {
+            /* handle EINTR as select() does */
+            if (errno == EINTR)
+                evt = -1;
+            ready = 0;
+        }
+        else if (ready & SRVREADY_LISTEN) {
+            /* accept the new client first; read the input events next time */
+            if (ready & SRVREADY_IAL)
+                ial_pending = TRUE;
+        }
+        else if ((ready & SRVREADY_IAL) || ial_pending) {
+            fd_set ial_rset;
+
+            /* the engine reads its fds without waiting */
+            mg_fd_zero (&ial_rset);
+            evt = IAL_WaitEvent (-1, &ial_rset, NULL, NULL, &sel_timeout_nd,
+                    &extra);
+            ial_pending = (evt != 0);
+            if (evt < 0)
+                evt = 0;
+        }
+    }
+    else
+#endif
+    {
+        /* Since 5.0.16: do not sleep if any client is still ready */
+        evt = IAL_WaitEvent (__mg_dsk_msg_queue->maxfd, &rset, wsetptr, esetptr,
+                (wait && nr_ready == 0) ? &sel_timeout : &sel_timeout_nd,
+                &extra);
+        ready = FD_ISSET (listenfd, &rset) ? SRVREADY_LISTEN : 0;
+    }
+
+    if (evt < 0) {
 
         /* It is time to check event again. */
         if (errno == EINTR) {
@@ -400,9 +809,7 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
                 ParseEvent (msg_queue, 0);
 
                 /* Since 5.0.3: Always check timers */
-                nevts += __mg_check_expired_timers (msg_queue,
-                        SHAREDRES_TIMER_COUNTER - msg_queue->old_tick_count);
-                msg_queue->old_tick_count = SHAREDRES_TIMER_COUNTER;
+                nevts += __mg_check_expired_timers (msg_queue);
                 return (nevts > 0);
             }
 
@@ -413,7 +820,7 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
 #endif
     }
 
-    if (FD_ISSET (listenfd, &rset)) {
+    if (ready & SRVREADY_LISTEN) {
         /* accept new client request */
         if ( (clifd = serv_accept (listenfd, &pid, &uid)) < 0) {
 #ifdef _DEBUG
@@ -429,9 +836,11 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
         }
         if (OnNewDelClient) OnNewDelClient (LCO_NEW_CLIENT, i);
 
-        FD_SET (clifd, &__mg_dsk_msg_queue->rfdset);
-        if (clifd > __mg_dsk_msg_queue->maxfd)
-            __mg_dsk_msg_queue->maxfd = clifd;  /* max fd for select() */
+        if (!__mg_server_watch_client_fd (i, clifd, SRVFD_SOCKET)) {
+            if (OnNewDelClient) OnNewDelClient (LCO_DEL_CLIENT, i);
+            __mg_remove_client (i, clifd);
+            return TRUE;
+        }
         if (i > maxi)
             maxi = i;       /* max index in client[] array */
 #ifdef _DEBUG
@@ -440,29 +849,14 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
         return TRUE;
     }
 
-    for (i = 0; i <= maxi; i++) {    /* go through client[] array */
-        if ( (clifd = mgClients[i].fd) < 0)
-            continue;
-        if (FD_ISSET (clifd, &rset)) {
-            int req_id;
-
-            /* read request id from client */
-            if ((nread = sock_read (clifd, &req_id, sizeof (int)))
-                            == SOCKERR_IO) {
-#ifdef _DEBUG
-                __mg_err_msg ("server: read error on fd %d", clifd);
+    /* Since 5.0.16: queue the ready clients, then handle them in turn */
+#ifdef _MGHAVE_SERVER_EPOLL
+    if (!by_epoll && FD_ISSET (srv_epoll_fd, &rset))
+        check_epoll_events (0);
+#else
+    check_client_fds (&rset, get_time_us ());
 #endif
-                if (OnNewDelClient) OnNewDelClient (LCO_DEL_CLIENT, i);
-                __mg_remove_client (i, clifd);
-            }
-            else if (nread == SOCKERR_CLOSED) {
-                if (OnNewDelClient) OnNewDelClient (LCO_DEL_CLIENT, i);
-                __mg_remove_client (i, clifd);
-            }
-            else    /* process client's rquest */
-                __mg_handle_request (clifd, req_id, i);
-        }
-    }
+    handle_ready_clients ();
 
     /* handle intput event (mouse/touch-screen or keyboard) */
     if (evt & IAL_MOUSEEVENT) {
@@ -519,9 +913,7 @@ BOOL server_IdleHandler4Server (PMSGQUEUE msg_queue, BOOL wait)
     }
 
     /* Since 5.0.0: Always check timers */
-    nevts += __mg_check_expired_timers (msg_queue,
-            SHAREDRES_TIMER_COUNTER - msg_queue->old_tick_count);
-    msg_queue->old_tick_count = SHAREDRES_TIMER_COUNTER;
+    nevts += __mg_check_expired_timers (msg_queue);
 
     /* go through registered listening fds */
     nevts += __mg_kernel_check_listen_fds (msg_queue, &rset, wsetptr, esetptr);
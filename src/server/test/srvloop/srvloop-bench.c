@@ -0,0 +1,176 @@
+/*
+** srvloop-bench.c: check the fairness of the server loop among clients.
+**
+** When run as the server (mginit), this program runs itself as many
+** clients at the same time: one chatty client floods the server with
+** asynchronous requests which want no reply, and the others send
+** synchronous requests and report the average latency. The server reports
+** the request statistics (GetClientRequestStats) of every client when
+** it quits.
+**
+** The clients use the socket only (MG_CLIENT_REQRING=0). Build MiniGUI
+** with and without --enable-srvepoll to compare. Run it as:
+**
+**  $ ln -sf srvloop-bench mginit
+**  $ ./mginit [nr_clients]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define REQID_BENCH_ECHO    (MAX_SYS_REQID + 1)
+#define REQID_BENCH_NOTE    (MAX_SYS_REQID + 2)
+
+#define DEF_NR_CLIENTS      32
+#define NR_ECHOS            2000
+#define NR_NOTES            200000
+#define SIZE_PAYLOAD        64
+
+static int nr_clients;
+static int nr_quit;
+
+static int echo_handler (int cli, int clifd, void* buff, size_t len)
+{
+    return ServerSendReply (clifd, buff, len);
+}
+
+static int note_handler (int cli, int clifd, void* buff, size_t len)
+{
+    return 0;
+}
+
+static void run_client (const char* role)
+{
+    if (fork () == 0) {
+        setenv ("MG_CLIENT_REQRING", "0", 1);
+        execl ("./srvloop-bench", "srvloop-bench", role, NULL);
+        perror ("execl");
+        exit (1);
+    }
+}
+
+static void on_new_del_client (int op, int cli)
+{
+    CLIREQSTATS stats;
+
+    if (op != LCO_DEL_CLIENT)
+        return;
+
+    if (GetClientRequestStats (cli, &stats)) {
+        printf ("client %2d: %7lu requests in %6lu rounds (%5lu deferred); "
+                "wait: %6.1f us avg, %6lu us max; "
+                "busy: %6.1f us avg, %6lu us max\n", cli,
+                (unsigned long)stats.nr_requests,
+                (unsigned long)stats.nr_rounds,
+                (unsigned long)stats.nr_deferred,
+                stats.nr_rounds ?
+                    (double)stats.total_wait_us / stats.nr_rounds : 0.0,
+                (unsigned long)stats.max_wait_us,
+                stats.nr_rounds ?
+                    (double)stats.total_busy_us / stats.nr_rounds : 0.0,
+                (unsigned long)stats.max_busy_us);
+        fflush (stdout);
+    }
+
+    if (++nr_quit == nr_clients)
+        PostQuitMessage (HWND_DESKTOP);
+}
+
+static double elapsed_us (const struct timespec* ts)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - ts->tv_sec) * 1000000.0 +
+        (now.tv_nsec - ts->tv_nsec) / 1000.0;
+}
+
+static int chatty_client (void)
+{
+    REQUEST req;
+    char payload [SIZE_PAYLOAD];
+    int i;
+
+    memset (payload, 'x', sizeof (payload));
+    req.id = REQID_BENCH_NOTE;
+    req.data = payload;
+    req.len_data = sizeof (payload);
+    for (i = 0; i < NR_NOTES; i++) {
+        if (ClientRequestAsync (&req, NULL, 0, -1, NULL, 0, NULL, NULL) < 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static int normal_client (void)
+{
+    REQUEST req;
+    char payload [SIZE_PAYLOAD], reply [SIZE_PAYLOAD];
+    struct timespec ts;
+    int i;
+
+    memset (payload, 'x', sizeof (payload));
+    req.id = REQID_BENCH_ECHO;
+    req.data = payload;
+    req.len_data = sizeof (payload);
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    for (i = 0; i < NR_ECHOS; i++) {
+        if (ClientRequest (&req, reply, sizeof (reply)) < 0)
+            return 1;
+    }
+
+    printf ("pid %6d: %8.2f us/request\n", (int)getpid (),
+            elapsed_us (&ts) / NR_ECHOS);
+    fflush (stdout);
+    return 0;
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    MSG msg;
+    int i;
+
+    if (mgIsServer) {
+        nr_clients = (argc > 1 && atoi (argv [1]) > 1) ?
+            atoi (argv [1]) : DEF_NR_CLIENTS;
+
+        if (!ServerStartup (0, 0, 0)) {
+            fprintf (stderr, "Can not start the server.\n");
+            return 1;
+        }
+
+        RegisterRequestHandler (REQID_BENCH_ECHO, echo_handler);
+        RegisterRequestHandler (REQID_BENCH_NOTE, note_handler);
+        OnNewDelClient = on_new_del_client;
+
+        run_client ("chatty");
+        for (i = 1; i < nr_clients; i++)
+            run_client ("normal");
+
+        while (GetMessage (&msg, HWND_DESKTOP)) {
+            DispatchMessage (&msg);
+        }
+
+        return 0;
+    }
+
+    if (JoinLayer (NAME_DEF_LAYER, argv [1], 0, 0) == INV_LAYER_HANDLE) {
+        fprintf (stderr, "Can not join the layer.\n");
+        return 1;
+    }
+
+    if (strcmp (argv [1], "chatty") == 0)
+        return chatty_client ();
+
+    return normal_client ();
+}
@@ -228,6 +228,10 @@ BOOL salone_IdleHandler4StandAlone (PMSGQUEUE msg_queue, BOOL wait)
 
     __mg_update_tick_count (NULL);
 
+    /* Since 5.0.16: do not sleep after the next timer expires */
+    sel_timeout.tv_usec =
+        __mg_get_timer_timeout (msg_queue, sel_timeout.tv_usec / 1000) * 1000;
+
     /* rset gets modified each time around */
     if (msg_queue->nr_rfds) {
         rset = msg_queue->rfdset;
@@ -319,9 +323,7 @@ BOOL salone_IdleHandler4StandAlone (PMSGQUEUE msg_queue, BOOL wait)
     /* Since 5.0.0: always check timers */
     __mg_update_tick_count (NULL);
 
-    nevts += __mg_check_expired_timers (msg_queue,
-            __mg_tick_counter - msg_queue->old_tick_count);
-    msg_queue->old_tick_count = __mg_tick_counter;
+    nevts += __mg_check_expired_timers (msg_queue);
 
     /* go through registered listen fds */
     nevts += __mg_kernel_check_listen_fds (msg_queue, &rset, wsetptr, esetptr);
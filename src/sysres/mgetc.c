@@ -206,6 +206,15 @@ static char* _truetypefonts_keys[]={
 static char* _truetypefonts_values[]={
     "0"
 };
+// Section: glyphcache
+static char* _glyphcache_keys[]={
+    "max_kbytes",
+    "shaped_run_kbytes"
+};
+static char* _glyphcache_values[]={
+    "512",
+    "512"
+};
 // Section: mouse
 static char* _mouse_keys[]={
     "dblclicktime"
@@ -822,6 +831,7 @@ static ETCSECTION _etc_sections [] = {
     {0, 1, "upf", _upf_keys,_upf_values },
     {0, 1, "qpf", _qpf_keys,_qpf_values },
     {0, 1, "truetypefonts", _truetypefonts_keys,_truetypefonts_values },
+    {0, 2, "glyphcache", _glyphcache_keys,_glyphcache_values },
     {0, 1, "mouse", _mouse_keys,_mouse_values },
     {0, 2, "event", _event_keys,_event_values },
     {0, 25, "cursorinfo", _cursorinfo_keys,_cursorinfo_values },